@@ -8,26 +8,59 @@
 
 struct block_device;
 
+#define BALLOC_RESV_SLOTS   16  // 预留窗口数(线程按编号散列到窗口)
+#define BALLOC_RESV_DEFAULT 64  // 默认每个窗口一次预留的块数
+
+// 分配组: 数据区按group_blocks块切分,每组有自己的锁、空闲计数和Next-Fit游标,
+// 不同组的分配互不阻塞。组大小是64的倍数,各组的位图字互不重叠
+typedef struct balloc_group {
+    pthread_mutex_t lock;           // 组锁
+    uint32_t start;                 // 组内第一个位
+    uint32_t len;                   // 组内块数
+    uint32_t free;                  // 组内空闲块数(受组锁保护)
+    uint32_t cursor;                // Next-Fit游标: 组内下次搜索的起始位
+} __attribute__((aligned(64))) balloc_group_t;
+
+// 预留窗口: [next, end)中的块已在位图中置位、计入已用,但还没有交给调用者。
+// 窗口总是取自同一个组。线程从自己的窗口分配时只持有窗口锁,用完后才在组锁下再取一段
+typedef struct balloc_resv {
+    pthread_mutex_t lock;           // 窗口锁(只在散列到同一窗口的线程之间竞争)
+    uint32_t next;                  // 下一个可分配位
+    uint32_t end;                   // 窗口结束位(不含)
+    uint32_t avail;                 // end - next,供统计时不加窗口锁读取
+    uint64_t alloc_count;           // 从窗口分配的次数,收回或补充时并入总计数
+} __attribute__((aligned(64))) balloc_resv_t;
+
 typedef struct block_allocator {
     struct block_device *dev;       // 块设备
     uint8_t *bitmap;                // 内存中的位图
     uint32_t bitmap_blocks;         // 位图占用的块数
+    uint64_t *dirty;                // 上次同步后改动过的位图块(每块一位,原子置位)
     uint32_t total_blocks;          // 总块数
-    uint32_t free_blocks;           // 空闲块数
+    uint32_t free_blocks;           // 空闲块数(各组之和,原子更新)
     uint32_t data_start;            // 数据区起始块号
     uint32_t bitmap_start;          // 位图起始块号
 
-    pthread_mutex_t alloc_lock;     // 分配锁
+    // 分配组,加锁顺序: 按组号从小到大
+    balloc_group_t *groups;         // group_count个组
+    uint32_t group_count;           // 组数
+    uint32_t group_blocks;          // 每组块数(最后一组可能不满)
+
+    // 预留窗口(NULL表示未启用),加锁顺序: 先窗口锁后组锁
+    balloc_resv_t *resv;            // BALLOC_RESV_SLOTS个窗口
+    uint32_t resv_blocks;           // 每次预留的块数
 
-    // 统计信息
+    // 统计信息(原子更新)
     uint64_t alloc_count;           // 分配次数
     uint64_t free_count;            // 释放次数
 } block_allocator_t;
 
 // ============ 块分配器API ============
 
+#define BALLOC_NO_GROUP UINT32_MAX   // 不指定分配组
+
 /**
- * 初始化块分配器
+ * 初始化块分配器(整个数据区为一组,按超级块切分时调用block_alloc_set_groups)
  * @param dev 块设备
  * @param bitmap_start 位图起始块号
  * @param bitmap_blocks 位图块数
@@ -50,12 +83,39 @@ block_allocator_t* block_alloc_init(
 void block_alloc_destroy(block_allocator_t *alloc);
 
 /**
- * 分配一个块
+ * 按组大小重新切分数据区,重新统计各组空闲块并重置游标
+ * 只能在没有并发分配时调用(例如挂载初始化阶段)
+ * @param alloc 分配器结构
+ * @param group_blocks 每组块数,须为64的倍数;0表示整个数据区一组
+ * @return 0成功,负数为错误码
+ */
+int block_alloc_set_groups(block_allocator_t *alloc, uint32_t group_blocks);
+
+/**
+ * 块所在的分配组
+ * @param alloc 分配器结构
+ * @param block 块号
+ * @return 组号,块不在数据区时返回BALLOC_NO_GROUP
+ */
+uint32_t block_alloc_group_of(block_allocator_t *alloc, block_t block);
+
+/**
+ * 分配一个块(从当前线程所在组的上次分配结束处向后查找,组内回绕,组满时换下一组)
+ * 启用预留窗口时优先从当前线程的窗口分配
  * @param alloc 分配器结构
  * @return 成功返回块号,失败返回0
  */
 block_t block_alloc(block_allocator_t *alloc);
 
+/**
+ * 在指定分配组中分配一个块,该组满时换下一组
+ * 当前线程的预留窗口属于该组时从窗口分配
+ * @param alloc 分配器结构
+ * @param group 组号(超出范围或BALLOC_NO_GROUP时等价于block_alloc)
+ * @return 成功返回块号,失败返回0
+ */
+block_t block_alloc_in_group(block_allocator_t *alloc, uint32_t group);
+
 /**
  * 释放一个块
  * @param alloc 分配器结构
@@ -65,7 +125,7 @@ block_t block_alloc(block_allocator_t *alloc);
 int block_free(block_allocator_t *alloc, block_t block);
 
 /**
- * 分配多个连续块
+ * 分配多个连续块(与block_alloc共用Next-Fit游标)
  * @param alloc 分配器结构
  * @param count 请求的块数
  * @param out_start 输出起始块号
@@ -79,6 +139,64 @@ int block_alloc_multiple(
     uint32_t *out_count
 );
 
+/**
+ * 在目标位置附近分配一段长度在[min_len, max_len]内的连续块
+ * 优先从goal开始在goal所在组内向后(到组末尾后回绕)寻找至少max_len块的空闲区间,
+ * 再依次找后面的组;都找不到时退而取遇到的第一段不短于min_len的空闲区间
+ * @param alloc 分配器结构
+ * @param goal 期望的起始块号,超出数据区时从Next-Fit游标处找
+ * @param min_len 最少块数
+ * @param max_len 最多块数
+ * @param out_start 输出起始块号
+ * @param out_len 输出实际分配的块数(min_len..max_len)
+ * @return 0成功,-ENOSPC为没有足够长的空闲区间,其他负数为错误码
+ */
+int block_alloc_extent(
+    block_allocator_t *alloc,
+    block_t goal,
+    uint32_t min_len,
+    uint32_t max_len,
+    block_t *out_start,
+    uint32_t *out_len
+);
+
+/**
+ * 在指定分配组中从该组的Next-Fit游标处分配一段长度在[min_len, max_len]内的连续块,
+ * 该组放不下时依次找后面的组
+ * @param alloc 分配器结构
+ * @param group 组号(超出范围或BALLOC_NO_GROUP时从当前线程所在组开始)
+ * @return 0成功,-ENOSPC为没有足够长的空闲区间,其他负数为错误码
+ */
+int block_alloc_group_extent(
+    block_allocator_t *alloc,
+    uint32_t group,
+    uint32_t min_len,
+    uint32_t max_len,
+    block_t *out_start,
+    uint32_t *out_len
+);
+
+/**
+ * 在目标位置附近分配一段连续块
+ * 优先从goal开始向后寻找至少count块的空闲区间;找不到时
+ * 退而取遇到的第一段空闲区间,因此实际分配的块数可能少于count
+ * @param alloc 分配器结构
+ * @param goal 期望的起始块号,超出数据区时从Next-Fit游标处找
+ * @param count 期望的块数
+ * @param out_start 输出起始块号
+ * @param out_count 输出实际分配的块数(1..count)
+ * @return 0成功,-ENOSPC为没有空闲块,其他负数为错误码
+ *
+ * 等价于block_alloc_extent(alloc, goal, 1, count, ...)
+ */
+int block_alloc_near(
+    block_allocator_t *alloc,
+    block_t goal,
+    uint32_t count,
+    block_t *out_start,
+    uint32_t *out_count
+);
+
 /**
  * 释放多个连续块
  * @param alloc 分配器结构
@@ -101,14 +219,31 @@ int block_free_multiple(
 bool block_is_allocated(block_allocator_t *alloc, block_t block);
 
 /**
- * 同步位图到磁盘
+ * 同步位图到磁盘(先收回所有预留窗口,写下去的位图只含真正分配出去的块)
+ * 只写上次同步后改动过的位图块
  * @param alloc 分配器结构
  * @return 0成功,负数为错误码
  */
 int block_alloc_sync(block_allocator_t *alloc);
 
+/**
+ * 启用或关闭线程预留窗口
+ * 只能在没有并发分配时调用(例如挂载初始化阶段)
+ * @param alloc 分配器结构
+ * @param blocks 每次预留的块数,0表示关闭
+ * @return 0成功,负数为错误码
+ */
+int block_alloc_set_reservation(block_allocator_t *alloc, uint32_t blocks);
+
+/**
+ * 把所有预留窗口中未分配的块还回空闲空间
+ * @param alloc 分配器结构
+ */
+void block_alloc_release_reservations(block_allocator_t *alloc);
+
 /**
  * 获取分配器统计信息
+ * 预留窗口中尚未分配的块计为空闲
  */
 void block_alloc_stats(
     block_allocator_t *alloc,
@@ -118,4 +253,11 @@ void block_alloc_stats(
     float *usage
 );
 
+/**
+ * 计算碎片率: (连续空闲区间数 - 1) / 总块数,空闲块全部连续时为0
+ * @param alloc 分配器结构
+ * @return 碎片率(0.0 - 1.0)
+ */
+float block_alloc_fragmentation(block_allocator_t *alloc);
+
 #endif // MODERNFS_BLOCK_ALLOC_H
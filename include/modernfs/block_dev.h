@@ -2,6 +2,9 @@
 #define MODERNFS_BLOCK_DEV_H
 
 #include "types.h"
+#include "buffer_cache.h"
+#include "io_engine.h"
+#include <sys/uio.h>
 
 // ============ 块设备结构 ============
 
@@ -12,6 +15,7 @@ typedef struct block_device {
     uint64_t total_blocks;          // 总块数
     uint64_t total_size;            // 总大小(字节)
     struct buffer_cache *cache;     // 块缓存
+    io_engine_t *io;                // 批量I/O引擎
     superblock_t *superblock;       // 超级块
 } block_device_t;
 
@@ -24,6 +28,14 @@ typedef struct block_device {
  */
 block_device_t* blkdev_open(const char *path);
 
+/**
+ * 以指定I/O引擎打开块设备
+ * @param path 设备路径
+ * @param engine I/O引擎类型(io_uring不可用时回退到IO_ENGINE_SYNC)
+ * @return 成功返回设备结构,失败返回NULL
+ */
+block_device_t* blkdev_open_ex(const char *path, io_engine_type_t engine);
+
 /**
  * 关闭块设备
  * @param dev 设备结构
@@ -48,6 +60,98 @@ int blkdev_read(block_device_t *dev, block_t block, void *buf);
  */
 int blkdev_write(block_device_t *dev, block_t block, const void *buf);
 
+/**
+ * 批量读取多个块
+ * 缓存命中的块直接拷贝,未命中的块作为一批提交给I/O引擎后加入缓存
+ * @param dev 设备结构
+ * @param blocks 块号数组
+ * @param count 块数
+ * @param buf 缓冲区(至少count * BLOCK_SIZE字节,第i块写入buf + i * BLOCK_SIZE)
+ * @return 0成功,负数为错误码
+ */
+int blkdev_read_blocks(block_device_t *dev, const block_t *blocks, uint32_t count, void *buf);
+
+// ============ 连续块区间读写 ============
+//
+// 对物理连续的一段块只发一次preadv/pwritev,数据直接在调用者的缓冲区和
+// 磁盘之间传输,不经过缓存的4KB拷贝。iovec可以把调用者缓冲区和首尾块的
+// 临时缓冲区拼在一起,总长度必须是BLOCK_SIZE的整数倍。
+// 区间读取会用缓存中较新的块覆盖读到的数据;区间写入会同步更新已缓存的块,
+// 但不把新块加入缓存。调用者须保证同一区间不被并发读写(如持有Inode锁)。
+
+#define BLKDEV_RANGE_MAX_IOV    16  // 每次区间读写最多的iovec数
+#define BLKDEV_RANGE_PIN_BLOCKS 256 // 区间读取不超过该块数时不分配内存
+
+/**
+ * 读取一段连续的块
+ * @param dev 设备结构
+ * @param start 起始块号
+ * @param iov 目标缓冲区数组(总长度为BLOCK_SIZE的整数倍)
+ * @param iovcnt 缓冲区个数(不超过BLKDEV_RANGE_MAX_IOV)
+ * @return 0成功,负数为错误码
+ */
+int blkdev_read_range(block_device_t *dev, block_t start,
+                      const struct iovec *iov, int iovcnt);
+
+/**
+ * 写入一段连续的块(直接写盘)
+ * @param dev 设备结构
+ * @param start 起始块号
+ * @param iov 源缓冲区数组(总长度为BLOCK_SIZE的整数倍)
+ * @param iovcnt 缓冲区个数(不超过BLKDEV_RANGE_MAX_IOV)
+ * @return 0成功,负数为错误码
+ */
+int blkdev_write_range(block_device_t *dev, block_t start,
+                       const struct iovec *iov, int iovcnt);
+
+// ============ 零拷贝块访问 ============
+//
+// blkdev_get_block返回一个被钉住的缓冲区,调用者直接在bh->data上读写,
+// 省去blkdev_read/blkdev_write的4KB拷贝和调用方的临时缓冲区。
+// 访问数据时须持有bh->lock(读用rdlock,改用wrlock),用完后调用
+// blkdev_release_block释放,修改过的块传dirty=true。
+
+/**
+ * 获取并钉住块(必要时从磁盘读取)
+ * @param dev 设备结构
+ * @param block 块号
+ * @return 成功返回缓冲区头,失败返回NULL
+ */
+buffer_head_t* blkdev_get_block(block_device_t *dev, block_t block);
+
+/**
+ * 获取并钉住块,内容清零而不读盘
+ * 用于新分配的块或即将整块覆盖的块
+ * @param dev 设备结构
+ * @param block 块号
+ * @return 成功返回缓冲区头,失败返回NULL
+ */
+buffer_head_t* blkdev_get_new_block(block_device_t *dev, block_t block);
+
+/**
+ * 释放blkdev_get_block/blkdev_get_new_block返回的块
+ * 脏块超过硬阈值时会短暂等待后台写回线程
+ * @param dev 设备结构
+ * @param bh 缓冲区头
+ * @param dirty 是否修改过(需要写回)
+ */
+void blkdev_release_block(block_device_t *dev, buffer_head_t *bh, bool dirty);
+
+// ============ 线程私有暂存块 ============
+//
+// 上层做不完整块的读-改-写、拼装日志块镜像时使用,避免每次调用在堆上分配
+// 或在栈上放置整块缓冲区。每个线程每个槽位一块,调用者自行约定槽位用途,
+// 同一线程内嵌套使用同一槽位会互相覆盖。
+
+#define BLKDEV_SCRATCH_SLOTS    3   // 每个线程的暂存块数
+
+/**
+ * 获取当前线程的暂存块
+ * @param slot 槽位(小于BLKDEV_SCRATCH_SLOTS)
+ * @return BLOCK_SIZE字节的缓冲区,槽位越界返回NULL
+ */
+uint8_t* blkdev_scratch(uint32_t slot);
+
 /**
  * 同步所有脏块到磁盘
  * @param dev 设备结构
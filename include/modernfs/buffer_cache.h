@@ -2,8 +2,32 @@
 #define MODERNFS_BUFFER_CACHE_H
 
 #include "types.h"
+#include "io_engine.h"
 #include <pthread.h>
 
+// ============ 替换策略 (2Q) ============
+//
+// 新块先进入A1in(FIFO),只有在被淘汰后短期内再次访问(命中A1out幽灵队列)
+// 才晋升到Am(LRU)。一次性的顺序扫描只会冲刷A1in,不会挤掉Am中的热块。
+
+#define BH_QUEUE_A1IN   0           // 首次访问队列(FIFO)
+#define BH_QUEUE_AM     1           // 热块队列(LRU)
+
+#define CACHE_A1IN_RATIO    4       // A1in目标大小 = max_buffers / 4
+#define CACHE_A1OUT_RATIO   2       // A1out幽灵队列大小 = max_buffers / 2
+
+// ============ 后台写回 ============
+//
+// 写回线程周期性醒来,把脏了足够久的块写回磁盘;脏块比例超过后台阈值时
+// 不看年龄全部写回。超过硬阈值时写入者会被节流,等待写回线程完成一轮。
+
+#define CACHE_DIRTY_EXPIRE_MS       5000    // 脏块超过该时间即写回
+#define CACHE_FLUSH_INTERVAL_MS     1000    // 写回线程唤醒周期
+#define CACHE_DIRTY_BG_RATIO        10      // 脏块占比(%)超过时立即后台写回
+#define CACHE_DIRTY_RATIO           40      // 脏块占比(%)超过时节流写入者
+
+struct buffer_cache;
+
 // ============ 缓冲区头结构 ============
 
 typedef struct buffer_head {
@@ -12,44 +36,131 @@ typedef struct buffer_head {
     bool dirty;                     // 脏标志
     bool valid;                     // 有效标志
     int ref_count;                  // 引用计数
+    uint8_t queue;                  // 所在队列(BH_QUEUE_*)
+    uint64_t dirty_time;            // 变脏时刻(单调时钟,毫秒)
+    struct buffer_cache *cache;     // 所属缓存(维护脏块计数)
     pthread_rwlock_t lock;          // 读写锁
 
-    // LRU链表
+    // LRU/FIFO链表
     struct buffer_head *next;
     struct buffer_head *prev;
 
     // 哈希表
     struct buffer_head *hash_next;
+
+    // 所在分片的脏链表(按变脏先后排列)
+    struct buffer_head *dirty_next;
+    struct buffer_head *dirty_prev;
 } buffer_head_t;
 
-// ============ 缓存管理器结构 ============
+// ============ 缓冲区链表 ============
 
-typedef struct buffer_cache {
+typedef struct bh_list {
+    buffer_head_t *head;            // 链表头(最近使用)
+    buffer_head_t *tail;            // 链表尾(淘汰候选)
+    uint32_t count;                 // 节点数
+} bh_list_t;
+
+// ============ 缓存分片 ============
+//
+// 缓存按块号拆分为多个分片,每个分片有独立的哈希表、2Q队列和锁,
+// 不同分片上的查找/插入互不阻塞。
+
+#define CACHE_DEFAULT_SHARDS    16  // 默认分片数
+#define CACHE_HUGE_PAGE_SIZE    (2 * 1024 * 1024)   // 大页大小(编译时开启MODERNFS_CACHE_HUGE_PAGES)
+
+typedef struct buffer_cache_shard {
     buffer_head_t **hash_table;     // 哈希表
     uint32_t hash_size;             // 哈希表大小
 
-    buffer_head_t *lru_head;        // LRU链表头
-    buffer_head_t *lru_tail;        // LRU链表尾
+    bh_list_t a1in;                 // 首次访问队列(FIFO)
+    bh_list_t am;                   // 热块队列(LRU)
+
+    // A1out幽灵队列: 只记录最近从A1in淘汰的块号,不持有数据
+    block_t *ghost_blocks;          // 环形队列
+    int32_t *ghost_next;            // 幽灵哈希链 (按槽位索引)
+    int32_t *ghost_hash;            // 幽灵哈希桶
+    uint32_t ghost_size;            // 环形队列容量
+    uint32_t ghost_head;            // 下一个写入槽位
+    uint32_t ghost_count;           // 有效槽位数
+
+    uint32_t max_buffers;           // 本分片最大缓冲区数
+    uint32_t current_buffers;       // 本分片当前缓冲区数
+    uint32_t a1in_target;           // A1in目标大小
 
-    uint32_t max_buffers;           // 最大缓冲区数
-    uint32_t current_buffers;       // 当前缓冲区数
+    pthread_mutex_t lock;           // 分片锁
 
-    pthread_mutex_t cache_lock;     // 缓存锁
+    // 脏链表: 标记脏块时可能持有缓冲区锁,因此用独立的叶子锁保护,
+    // 持有dirty_lock时不再获取其他锁
+    buffer_head_t *dirty_head;      // 最早变脏的块
+    buffer_head_t *dirty_tail;      // 最近变脏的块
+    pthread_mutex_t dirty_lock;     // 脏链表锁
+
+    // 缓冲区池: 本分片的缓冲区头和数据页在初始化时一次性分配,之后只在空闲链表上复用
+    buffer_head_t *pool;            // 本分片的缓冲区头数组(max_buffers个)
+    buffer_head_t *free_list;       // 空闲缓冲区头(经next链接)
 
     // 统计信息
     uint64_t hit_count;             // 命中次数
     uint64_t miss_count;            // 未命中次数
     uint64_t evict_count;           // 淘汰次数
+    uint64_t writeback_count;       // 淘汰时写回的脏块数
+} __attribute__((aligned(64))) buffer_cache_shard_t;
+
+// ============ 缓存管理器结构 ============
+
+typedef struct buffer_cache {
+    buffer_cache_shard_t *shards;   // 分片数组
+    uint32_t num_shards;            // 分片数
+
+    uint32_t max_buffers;           // 最大缓冲区数(所有分片之和)
+
+    // 缓冲区池
+    buffer_head_t *bh_pool;         // 所有分片的缓冲区头
+    uint8_t *page_pool;             // 所有分片的数据页(页对齐,mmap分配)
+    size_t page_pool_size;          // 数据页区域大小
+    bool huge_pages;                // 数据页是否由大页(MAP_HUGETLB)支撑
+
+    int dev_fd;                     // 设备文件描述符(写回脏牺牲块)
+    io_engine_t *io;                // 批量写回使用的I/O引擎(NULL时用pwrite)
+
+    uint32_t dirty_count;           // 当前脏块数(原子访问)
+
+    // 后台写回线程
+    pthread_t flusher_thread;       // 写回线程
+    bool flusher_running;           // 写回线程运行标志
+    pthread_mutex_t flusher_lock;   // 保护以下字段
+    pthread_cond_t flusher_wake;    // 唤醒写回线程
+    pthread_cond_t flusher_done;    // 一轮写回完成(唤醒被节流的写入者)
+    uint64_t flusher_rounds;        // 已完成的写回轮数
+    uint32_t dirty_expire_ms;       // 脏块过期时间
+    uint32_t flush_interval_ms;     // 写回周期
+    uint64_t flusher_writebacks;    // 写回线程写回的块数
+
+    // 写回
+    struct writeback_ctx *writeback; // 预分配的写回上下文
+    pthread_mutex_t writeback_lock; // 串行化写回(sync与后台写回线程)
+
+    // 写回统计(原子访问)
+    uint64_t flush_blocks;          // 写回的块数
+    uint64_t flush_requests;        // 合并后发出的写请求数
 } buffer_cache_t;
 
+// 写回时先把脏块按块号排序,相邻块合并为一个pwritev请求;
+// 块号按分片交错分布,因此排序在收集所有分片的脏块之后进行
+#define CACHE_SYNC_BATCH        64  // 写回时每批提交的写请求数
+#define CACHE_FLUSH_MAX_RUN     64  // 单个写请求合并的最大块数
+
 // ============ 缓存API ============
 
 /**
  * 初始化缓存
  * @param max_buffers 最大缓冲区数
+ * @param num_shards 分片数(0表示使用CACHE_DEFAULT_SHARDS)
+ * @param dev_fd 设备文件描述符(淘汰脏块时写回)
  * @return 成功返回缓存结构,失败返回NULL
  */
-buffer_cache_t* buffer_cache_init(uint32_t max_buffers);
+buffer_cache_t* buffer_cache_init(uint32_t max_buffers, uint32_t num_shards, int dev_fd);
 
 /**
  * 销毁缓存
@@ -67,13 +178,23 @@ buffer_head_t* buffer_cache_lookup(buffer_cache_t *cache, block_t block);
 
 /**
  * 插入缓存块
+ * 缓存已满时按2Q策略淘汰一个未被引用的块,脏块先写回磁盘
  * @param cache 缓存结构
  * @param block 块号
  * @param data 数据(BLOCK_SIZE字节)
- * @return 成功返回缓冲区头,失败返回NULL
+ * @return 成功返回缓冲区头,所有缓冲区都被引用或写回失败时返回NULL
  */
 buffer_head_t* buffer_cache_insert(buffer_cache_t *cache, block_t block, const void *data);
 
+/**
+ * 查找或分配缓存块(不读盘)
+ * 未命中时分配一个valid=false的缓冲区,由调用者在写锁下填充数据
+ * @param cache 缓存结构
+ * @param block 块号
+ * @return 成功返回已增加引用计数的缓冲区头,所有缓冲区都被引用时返回NULL
+ */
+buffer_head_t* buffer_cache_getblk(buffer_cache_t *cache, block_t block);
+
 /**
  * 获取缓冲区(增加引用计数)
  * @param bh 缓冲区头
@@ -94,6 +215,7 @@ void buffer_head_mark_dirty(buffer_head_t *bh);
 
 /**
  * 写回所有脏缓冲区
+ * 脏块按块号排序、相邻块合并写回,I/O期间不持有分片锁
  * @param cache 缓存结构
  * @param dev_fd 设备文件描述符
  * @return 0成功,负数为错误码
@@ -101,11 +223,49 @@ void buffer_head_mark_dirty(buffer_head_t *bh);
 int buffer_cache_sync(buffer_cache_t *cache, int dev_fd);
 
 /**
- * 获取缓存统计信息
+ * 启动后台写回线程
+ * @param cache 缓存结构
+ * @return 0成功,负数为错误码
+ */
+int buffer_cache_start_flusher(buffer_cache_t *cache);
+
+/**
+ * 停止后台写回线程(未启动时无操作),不会写回剩余脏块
+ * @param cache 缓存结构
+ */
+void buffer_cache_stop_flusher(buffer_cache_t *cache);
+
+/**
+ * 写入者在修改缓存后调用: 脏块超过后台阈值时唤醒写回线程,
+ * 超过硬阈值时等待写回线程完成一轮
+ * 最多等待一个写回周期;写回线程跳过被锁住的缓冲区,持锁调用不会死锁
+ * @param cache 缓存结构
+ */
+void buffer_cache_balance_dirty(buffer_cache_t *cache);
+
+/**
+ * 获取当前脏块数
+ * @param cache 缓存结构
+ * @return 脏块数
+ */
+uint32_t buffer_cache_dirty_count(buffer_cache_t *cache);
+
+/**
+ * 获取缓存统计信息(所有分片之和)
  */
 void buffer_cache_stats(buffer_cache_t *cache, uint64_t *hits, uint64_t *misses,
                         uint64_t *evicts, float *hit_rate);
 
+/**
+ * 获取当前缓存的块数和淘汰时写回的脏块数(所有分片之和)
+ */
+void buffer_cache_usage(buffer_cache_t *cache, uint32_t *buffers, uint64_t *writebacks);
+
+/**
+ * 获取写回统计: 写回的块数和合并后的写请求数
+ */
+void buffer_cache_flush_stats(buffer_cache_t *cache, uint64_t *blocks, uint64_t *requests);
+
 /**
  * 使指定块的缓存失效
  * @param cache 缓存结构
@@ -0,0 +1,69 @@
+#ifndef MODERNFS_EXTENT_H
+#define MODERNFS_EXTENT_H
+
+#include "modernfs/types.h"
+#include "modernfs/inode.h"
+
+// ============ Extent树 ============
+//
+// 普通文件的块映射。磁盘格式见types.h;节点块通过块分配器分配并计入disk.blocks。
+// 所有操作都要求调用者持有Inode锁。
+
+#define EXTENT_ROOT_ENTRIES \
+    ((INODE_EXTENT_ROOT_SIZE - sizeof(extent_header_t)) / sizeof(extent_t))    // 5
+#define EXTENT_BLOCK_ENTRIES \
+    ((BLOCK_SIZE - sizeof(extent_header_t)) / sizeof(extent_t))                 // 340
+#define EXTENT_MAX_DEPTH 4
+
+/**
+ * 初始化空的extent树并设置INODE_FLAG_EXTENTS
+ * @param inode Inode指针
+ */
+void extent_tree_init(inode_t_mem *inode);
+
+/**
+ * 查找逻辑块所在的映射区间
+ * @param cache Inode缓存
+ * @param inode Inode指针
+ * @param lblk 逻辑块号
+ * @param pblk_out 输出物理块号,空洞时为0
+ * @param len_out 输出从lblk起的区间长度: 已映射时为extent剩余块数,
+ *                空洞时为到下一个extent(或逻辑地址空间末尾)的块数
+ * @return 成功返回0,失败返回负数错误码
+ */
+int extent_map(inode_cache_t *cache, inode_t_mem *inode, uint32_t lblk,
+               block_t *pblk_out, uint32_t *len_out);
+
+/**
+ * 插入一段映射,与相邻extent逻辑和物理都连续时直接合并
+ * @param cache Inode缓存
+ * @param inode Inode指针
+ * @param lblk 起始逻辑块号(该区间必须尚未映射)
+ * @param pblk 起始物理块号
+ * @param len 块数
+ * @return 成功返回0,失败返回负数错误码
+ */
+int extent_insert(inode_cache_t *cache, inode_t_mem *inode, uint32_t lblk,
+                  block_t pblk, uint32_t len);
+
+/**
+ * 删除逻辑块号>=first_lblk的全部映射,释放数据块和变空的节点块
+ * @param cache Inode缓存
+ * @param inode Inode指针
+ * @param first_lblk 第一个被删除的逻辑块号
+ * @return 成功返回0,失败返回负数错误码
+ */
+int extent_truncate(inode_cache_t *cache, inode_t_mem *inode, uint32_t first_lblk);
+
+/**
+ * 统计extent树的叶子记录数和深度
+ * @param cache Inode缓存
+ * @param inode Inode指针
+ * @param extents_out 输出extent数(可为NULL)
+ * @param depth_out 输出树深度(可为NULL)
+ * @return 成功返回0,失败返回负数错误码
+ */
+int extent_stats(inode_cache_t *cache, inode_t_mem *inode,
+                 uint32_t *extents_out, uint32_t *depth_out);
+
+#endif // MODERNFS_EXTENT_H
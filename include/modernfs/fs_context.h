@@ -10,6 +10,19 @@
 #include "superblock.h"
 #include "rust_ffi.h"
 
+/**
+ * 挂载选项
+ */
+typedef struct {
+    bool read_only;                     // 只读挂载
+    io_engine_type_t io_engine;         // 块设备I/O引擎
+    bool delalloc;                      // 普通文件延迟分配数据块
+    uint32_t icache_mb;                 // Inode缓存内存预算(MB),0表示默认
+    bool inline_data;                   // 小文件和小目录内联存放在Inode中
+    inode_atime_mode_t atime_mode;      // 读时如何更新atime
+    bool lazytime;                      // 只改时间戳的Inode延迟批量写回
+} fs_mount_opts_t;
+
 /**
  * ModernFS文件系统上下文
  * 在FUSE挂载时创建，保存文件系统的全局状态
@@ -17,7 +30,7 @@
 typedef struct {
     // 块设备层
     block_device_t *dev;
-    block_allocator_t *balloc;
+    block_allocator_t *balloc;          // 数据块分配器 (单块和extent分配共用)
 
     // Inode层
     inode_cache_t *icache;
@@ -27,7 +40,6 @@ typedef struct {
 
     // Rust核心模块 (Week 5-6)
     RustJournalManager *journal;        // Journal Manager
-    RustExtentAllocator *extent_alloc;  // Extent Allocator
 
     // 后台线程
     pthread_t checkpoint_thread;        // Checkpoint线程
@@ -40,6 +52,7 @@ typedef struct {
 
     // 挂载选项
     bool read_only;
+    io_engine_type_t io_engine;
     char device_path[256];
 
     // 统计信息
@@ -55,6 +68,14 @@ typedef struct {
  */
 fs_context_t* fs_context_init(const char *device_path, bool read_only);
 
+/**
+ * 按挂载选项初始化文件系统上下文
+ * @param device_path 磁盘镜像路径
+ * @param opts 挂载选项(NULL表示默认选项)
+ * @return 成功返回上下文指针，失败返回NULL
+ */
+fs_context_t* fs_context_init_opts(const char *device_path, const fs_mount_opts_t *opts);
+
 /**
  * 销毁文件系统上下文
  * @param ctx 上下文指针
@@ -7,6 +7,27 @@
 #include <pthread.h>
 #include <sys/types.h>
 
+// ============ 块映射缓存 ============
+
+#define INODE_MAP_CACHE_RUNS 4          // 每个Inode缓存的映射区间数
+
+// 一段逻辑连续且物理连续的已映射区间
+typedef struct inode_map_run {
+    uint32_t lblk;                  // 起始逻辑块号
+    block_t pblk;                   // 起始物理块号
+    uint32_t len;                   // 块数,0表示空槽
+} inode_map_run_t;
+
+// ============ 延迟分配 ============
+
+#define INODE_DELALLOC_MAX_PAGES 1024   // 单个Inode最多暂存的待分配页(4MB)
+
+// 已写入但尚未分配物理块的页
+typedef struct inode_delalloc_page {
+    uint32_t lblk;                  // 逻辑块号
+    uint8_t *data;                  // 块数据(BLOCK_SIZE字节)
+} inode_delalloc_page_t;
+
 // ============ 内存中的Inode结构 ============
 
 typedef struct inode {
@@ -14,20 +35,75 @@ typedef struct inode {
     disk_inode_t disk;              // 磁盘Inode数据
 
     // 缓存管理
-    int ref_count;                  // 引用计数
+    int ref_count;                  // 引用计数(原子更新)
     int valid;                      // 是否已从磁盘读取
     int dirty;                      // 是否需要写回磁盘
+    int time_dirty;                 // 只有时间戳改动(lazytime),inode_sync_all不写回
+    int referenced;                 // 命中后置位,淘汰扫描时清零并给一次机会(原子更新)
 
-    // LRU链表
+    // LRU链表(受cache_lock写锁保护,命中时不移动)
     struct inode *prev;
     struct inode *next;
 
     // 哈希链表
     struct inode *hash_next;
 
+    struct inode_slab *slab;        // 所属slab
+
+    // 脏Inode链表(受dirty_lock保护): on_dirty_list在写回前一直保留,
+    // 期间被单独inode_sync过的Inode在批量写回时跳过
+    struct inode *dirty_next;
+    bool on_dirty_list;
+
+    // 块映射缓存(受Inode锁保护): 最近查到的已映射区间,截断和重新加载时清空
+    inode_map_run_t map_runs[INODE_MAP_CACHE_RUNS];
+    uint32_t map_next;              // 下一个被替换的槽位
+
+    // 延迟分配(受Inode锁保护): 按逻辑块号排序的待分配页
+    inode_delalloc_page_t *delalloc_pages;
+    uint32_t delalloc_count;
+    uint32_t delalloc_cap;
+    bool delalloc_flushing;         // 正在落盘暂存页,分配时可以动用预留的块
+
     pthread_mutex_t lock;           // Inode锁
 } inode_t_mem;
 
+// ============ 缓存条目slab ============
+
+#define INODE_SLAB_ENTRIES 64                   // 每个slab的条目数
+#define INODE_CACHE_DEFAULT_BUDGET (16u << 20)  // 默认内存预算(16MB)
+#define INODE_HASH_MIN 32                       // 哈希表最少桶数
+
+// 缓存条目按slab成块分配,条目地址在slab释放前不变。
+// 有空闲条目的slab排在链表前面,全空的slab在超出预算时释放
+typedef struct inode_slab {
+    struct inode_slab *prev;
+    struct inode_slab *next;
+    inode_t_mem *free_list;         // 本slab的空闲条目(通过next链接)
+    uint32_t used;                  // 已用条目数
+    inode_t_mem entries[INODE_SLAB_ENTRIES];
+} inode_slab_t;
+
+// ============ 访问时间策略 ============
+
+#define INODE_RELATIME_INTERVAL (24 * 3600)     // relatime: atime至少隔这么久更新一次
+
+typedef enum {
+    INODE_ATIME_RELATIME = 0,       // atime不晚于mtime/ctime或超过一天时才更新(默认)
+    INODE_ATIME_NOATIME,            // 读不更新atime
+    INODE_ATIME_STRICT,             // 每次读都更新atime
+} inode_atime_mode_t;
+
+// ============ Inode分配组 ============
+
+// Inode按超级块的分配组切分,每组记录空闲数和Next-Fit游标(受bitmap_lock保护)
+typedef struct inode_group {
+    uint32_t start;                 // 组内第一个Inode号
+    uint32_t len;                   // 组内Inode数
+    uint32_t free;                  // 组内空闲Inode数
+    uint32_t cursor;                // Next-Fit游标: 组内下次搜索的起始Inode号
+} inode_group_t;
+
 // ============ Inode缓存管理器 ============
 
 typedef struct inode_cache {
@@ -36,23 +112,53 @@ typedef struct inode_cache {
 
     superblock_t sb;                // 超级块副本
 
-    inode_t_mem *inodes;            // Inode缓存池
-    uint32_t max_inodes;            // 最大缓存Inode数
+    // 缓存条目按需从slab分配,条目数超过max_inodes后优先换出,
+    // 全部条目都被引用时临时超出预算,之后再收缩回来
+    inode_slab_t *slabs;            // slab链表,有空闲条目的在前
+    uint32_t slab_count;            // slab数
+    uint32_t nr_inodes;             // 在用条目数(都在LRU链表上)
+    uint32_t max_inodes;            // 条目数上限(由内存预算换算)
 
     // LRU链表
     inode_t_mem *lru_head;
     inode_t_mem *lru_tail;
 
-    // 哈希表
+    // 哈希表: 平均链长超过2时扩大一倍,低于1/8时缩小一半(不小于hash_min)
     inode_t_mem **hash_table;
     uint32_t hash_size;
+    uint32_t hash_min;
+
+    // 缓存锁: 命中只加读锁,换入换出加写锁,写回脏的淘汰对象时不持有
+    pthread_rwlock_t cache_lock;
 
-    pthread_rwlock_t cache_lock;    // 缓存锁
+    // 脏Inode链表: inode_sync_all只遍历这里的Inode,
+    // 只有time_dirty的Inode留在链表上等inode_sync_times
+    inode_t_mem *dirty_head;
+    uint32_t dirty_count;
+    pthread_mutex_t dirty_lock;
 
     // Inode位图操作（需要与block_alloc集成）
     uint8_t *inode_bitmap;          // Inode位图缓存
     uint32_t bitmap_blocks;         // 位图块数
     pthread_mutex_t bitmap_lock;    // 位图锁
+    inode_group_t *groups;          // 分配组(超级块没有分配组时整个Inode表一组)
+    uint32_t group_count;           // 组数
+    uint32_t dir_rotor;             // 顶层目录分散放置时的起始组
+
+    // 延迟分配: 普通文件写入空洞时数据先暂存在Inode中,
+    // 到fsync/sync/checkpoint或Inode被淘汰时再整段分配物理块
+    bool delalloc;                  // 是否启用
+    uint32_t delalloc_reserved;     // 为暂存页及落盘时的extent节点预留的空闲块,
+                                    // 其他分配不能动用
+
+    // 内联数据: 不超过INODE_INLINE_SIZE的文件和目录直接存放在Inode中,
+    // 变大时再搬到数据块。关闭时仍能读写已有的内联Inode
+    bool inline_data;
+
+    // 时间戳: 读时按atime_mode更新访问时间。启用lazytime时只改时间戳的Inode
+    // 不算脏,由后台线程、卸载或淘汰时批量写回
+    inode_atime_mode_t atime_mode;
+    bool lazytime;
 } inode_cache_t;
 
 // ============ Inode缓存初始化和销毁 ============
@@ -61,8 +167,8 @@ typedef struct inode_cache {
  * 初始化Inode缓存
  * @param dev 块设备
  * @param balloc 块分配器
- * @param max_inodes 最大缓存Inode数
- * @param hash_size 哈希表大小
+ * @param max_inodes 缓存条目数上限(条目按需分配,不预先占用内存)
+ * @param hash_size 哈希表初始桶数(随条目数自动伸缩)
  * @return 成功返回inode_cache_t指针，失败返回NULL
  */
 inode_cache_t *inode_cache_init(block_device_t *dev,
@@ -70,6 +176,13 @@ inode_cache_t *inode_cache_init(block_device_t *dev,
                                 uint32_t max_inodes,
                                 uint32_t hash_size);
 
+/**
+ * 按内存预算设置缓存条目数上限,超出新上限的空闲干净条目立即释放
+ * @param cache Inode缓存
+ * @param bytes 缓存条目可占用的字节数(至少容纳一个slab)
+ */
+void inode_cache_set_budget(inode_cache_t *cache, size_t bytes);
+
 /**
  * 销毁Inode缓存
  * @param cache Inode缓存
@@ -79,13 +192,26 @@ void inode_cache_destroy(inode_cache_t *cache);
 // ============ Inode分配和释放 ============
 
 /**
- * 分配一个新的Inode
+ * 分配一个新的Inode(不指定父目录,等价于inode_alloc_near(cache, type, 0))
  * @param cache Inode缓存
  * @param type Inode类型 (INODE_TYPE_FILE, INODE_TYPE_DIR, INODE_TYPE_SYMLINK)
  * @return 成功返回Inode指针，失败返回NULL
  */
 inode_t_mem *inode_alloc(inode_cache_t *cache, uint8_t type);
 
+/**
+ * 在父目录附近分配一个新的Inode(Orlov策略)
+ * - 普通文件和符号链接: 优先放进父目录Inode所在的Inode表块,其次父目录所在组
+ * - 根目录下的目录: 分散到空闲Inode最多、空闲块不低于平均值的组
+ * - 其他目录: 父目录所在组的空闲Inode和空闲块都不低于平均值时留在该组,否则同上分散
+ * 选中的组满时依次换下一组
+ * @param cache Inode缓存
+ * @param type Inode类型
+ * @param parent 父目录Inode号(0表示不指定)
+ * @return 成功返回Inode指针，失败返回NULL
+ */
+inode_t_mem *inode_alloc_near(inode_cache_t *cache, uint8_t type, inode_t parent);
+
 /**
  * 释放一个Inode
  * @param cache Inode缓存
@@ -133,15 +259,101 @@ void inode_unlock(inode_t_mem *inode);
  */
 int inode_sync(inode_cache_t *cache, inode_t_mem *inode);
 
+/**
+ * 标记Inode需要写回并挂到脏Inode链表上
+ * 修改disk字段后用它代替直接置dirty,否则inode_sync_all看不到这个Inode
+ * @param cache Inode缓存
+ * @param inode Inode指针
+ */
+void inode_mark_dirty(inode_cache_t *cache, inode_t_mem *inode);
+
+/**
+ * 标记Inode只有时间戳改动
+ * 启用lazytime时挂到脏Inode链表上但不置dirty,否则等同inode_mark_dirty
+ * @param cache Inode缓存
+ * @param inode Inode指针
+ */
+void inode_mark_time_dirty(inode_cache_t *cache, inode_t_mem *inode);
+
+/**
+ * 读取后按缓存的atime策略更新访问时间,调用者需持有Inode锁
+ * @param cache Inode缓存
+ * @param inode Inode指针
+ */
+void inode_touch_atime(inode_cache_t *cache, inode_t_mem *inode);
+
 /**
  * 同步所有脏Inode到磁盘
+ * 只遍历脏Inode链表,按Inode表块分批: 同一块中的脏Inode只读改写一次。
+ * 只有时间戳改动的Inode(lazytime)留在链表上,供内部的例行写回使用;
+ * sync/fsync要用inode_sync_times
  * @param cache Inode缓存
  * @return 成功返回0，失败返回负数错误码
  */
 int inode_sync_all(inode_cache_t *cache);
 
+/**
+ * 同步所有脏Inode到磁盘,包括只有时间戳改动的Inode
+ * 由fs_context_sync(sync/fsync)、后台线程和卸载时调用
+ * @param cache Inode缓存
+ * @return 成功返回0，失败返回负数错误码
+ */
+int inode_sync_times(inode_cache_t *cache);
+
+/**
+ * 为Inode暂存的延迟分配页分配物理块并写入块缓存
+ * 逻辑连续的页按整段分配,调用者需持有Inode锁
+ * @param cache Inode缓存
+ * @param inode Inode指针
+ * @return 成功返回0，失败返回负数错误码(未写入的页保留)
+ */
+int inode_flush_delalloc(inode_cache_t *cache, inode_t_mem *inode);
+
+/**
+ * 写出所有Inode暂存的延迟分配页
+ * 逐个加锁Inode,调用者不能持有任何Inode锁
+ * @param cache Inode缓存
+ * @return 成功返回0，失败返回第一个错误码
+ */
+int inode_flush_all_delalloc(inode_cache_t *cache);
+
+// ============ 内联数据 ============
+
+/**
+ * Inode的数据是否内联存放
+ * @param inode Inode指针
+ * @return true内联,false使用数据块
+ */
+bool inode_is_inline(const inode_t_mem *inode);
+
+/**
+ * 把内联数据搬到数据块,之后按普通文件/目录的块映射访问(文件大小不变)
+ * 普通文件换成extent树,其他类型换成直接/间接块。调用者需持有Inode锁
+ * @param cache Inode缓存
+ * @param inode Inode指针
+ * @return 成功返回0(不是内联Inode时什么也不做)，失败返回负数错误码且Inode保持原样
+ */
+int inode_inline_spill(inode_cache_t *cache, inode_t_mem *inode);
+
 // ============ 数据块映射 ============
 
+/**
+ * Inode所在的分配组,该Inode的数据块和映射块优先从同组分配
+ * @param cache Inode缓存
+ * @param inum Inode号
+ * @return 组号,超级块没有分配组时返回BALLOC_NO_GROUP
+ */
+uint32_t inode_group(inode_cache_t *cache, inode_t inum);
+
+/**
+ * 为Inode分配一个块(间接块、extent节点、目录块等),优先从Inode所在的组分配
+ * 除非正在落盘该Inode的暂存页,否则不动用为延迟分配预留的块
+ * @param cache Inode缓存
+ * @param inode Inode指针
+ * @return 成功返回块号,空间不足返回0
+ */
+block_t inode_alloc_block(inode_cache_t *cache, inode_t_mem *inode);
+
 /**
  * 将文件内偏移映射到块号
  * @param cache Inode缓存
@@ -157,6 +369,28 @@ int inode_bmap(inode_cache_t *cache,
                bool alloc_if_missing,
                block_t *block_out);
 
+/**
+ * 映射一段物理连续的块
+ * 从offset所在块开始,向后延伸直到物理块号不再连续或达到max_blocks;
+ * 空洞同样按连续的空洞区间返回(block_out为0)。
+ * 已映射的区间记入Inode的映射缓存,顺序读每段区间只需一次元数据查找
+ * @param cache Inode缓存
+ * @param inode Inode指针
+ * @param offset 文件内偏移（字节）
+ * @param max_blocks 最多映射的块数
+ * @param alloc_if_missing 如果块不存在是否分配
+ * @param block_out 输出起始块号
+ * @param run_out 输出连续块数(至少为1)
+ * @return 成功返回0，失败返回负数错误码
+ */
+int inode_bmap_run(inode_cache_t *cache,
+                   inode_t_mem *inode,
+                   uint64_t offset,
+                   uint32_t max_blocks,
+                   bool alloc_if_missing,
+                   block_t *block_out,
+                   uint32_t *run_out);
+
 /**
  * 截断文件到指定大小
  * @param cache Inode缓存
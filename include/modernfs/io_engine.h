@@ -0,0 +1,97 @@
+#ifndef MODERNFS_IO_ENGINE_H
+#define MODERNFS_IO_ENGINE_H
+
+#include "types.h"
+#include <pthread.h>
+#include <sys/uio.h>
+
+// ============ I/O引擎 ============
+//
+// 块设备下层的批量I/O接口。调用者一次提交一组请求,引擎负责把它们发出去
+// 并等待全部完成:
+//   - IO_ENGINE_SYNC:  逐个pread/pwrite
+//   - IO_ENGINE_URING: 一次io_uring_enter提交整批请求,多个I/O同时在途
+// 单块读写仍走pread/pwrite,批量路径(多块读、缓存刷写)才使用引擎。
+
+#define IO_ENGINE_DEFAULT_DEPTH 64  // io_uring队列深度
+
+typedef enum {
+    IO_ENGINE_SYNC = 0,             // pread/pwrite
+    IO_ENGINE_URING = 1,            // io_uring批量提交
+} io_engine_type_t;
+
+typedef enum {
+    IO_OP_READ = 0,
+    IO_OP_WRITE = 1,
+} io_op_t;
+
+typedef struct io_request {
+    io_op_t op;                     // 读或写
+    block_t block;                  // 起始块号
+    void *buf;                      // 数据缓冲区(iov为NULL时使用)
+    uint32_t len;                   // 字节数(向量请求为各段长度之和)
+    const struct iovec *iov;        // 非NULL时为向量请求(preadv/pwritev),忽略buf
+    int iovcnt;                     // iov段数
+    int result;                     // 完成后: 0成功,负数为错误码
+} io_request_t;
+
+typedef struct io_engine io_engine_t;
+
+/**
+ * 创建I/O引擎
+ * io_uring不可用(编译时关闭或内核不支持)时回退到IO_ENGINE_SYNC
+ * @param fd 设备文件描述符(不接管所有权)
+ * @param type 引擎类型
+ * @param queue_depth io_uring队列深度,0表示使用默认值
+ * @return 成功返回引擎指针,失败返回NULL
+ */
+io_engine_t* io_engine_create(int fd, io_engine_type_t type, uint32_t queue_depth);
+
+/**
+ * 销毁I/O引擎
+ * @param engine 引擎指针
+ */
+void io_engine_destroy(io_engine_t *engine);
+
+/**
+ * 获取引擎实际使用的类型
+ * @param engine 引擎指针
+ * @return 引擎类型
+ */
+io_engine_type_t io_engine_type(const io_engine_t *engine);
+
+/**
+ * 引擎类型名称
+ * @param type 引擎类型
+ * @return "sync" 或 "uring"
+ */
+const char* io_engine_name(io_engine_type_t type);
+
+/**
+ * 按名称解析引擎类型
+ * @param name "sync" 或 "uring"
+ * @param type_out 输出引擎类型
+ * @return 0成功,-EINVAL为未知名称
+ */
+int io_engine_parse(const char *name, io_engine_type_t *type_out);
+
+/**
+ * 提交一批请求并等待全部完成
+ * 每个请求的result字段会被填写;请求之间没有顺序保证
+ * @param engine 引擎指针
+ * @param reqs 请求数组
+ * @param count 请求数
+ * @return 全部成功返回0,否则返回第一个失败请求的错误码
+ */
+int io_engine_submit(io_engine_t *engine, io_request_t *reqs, uint32_t count);
+
+/**
+ * 不经过引擎,直接用pread/pwrite完成一批请求
+ * @param fd 设备文件描述符
+ * @param reqs 请求数组
+ * @param count 请求数
+ * @return 全部成功返回0,否则返回第一个失败请求的错误码
+ */
+int io_submit_sync(int fd, io_request_t *reqs, uint32_t count);
+
+#endif // MODERNFS_IO_ENGINE_H
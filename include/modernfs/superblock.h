@@ -12,6 +12,11 @@
 #define MODERNFS_MAGIC 0x4D4F4446  // "MODF" (ModernFS)
 #define MODERNFS_VERSION 1
 
+// 分配组大小: 每组最多占一个数据位图块,小卷缩小组以保证至少有几组可并行分配
+#define GROUP_MAX_DATA_BLOCKS   32768
+#define GROUP_MIN_DATA_BLOCKS   4096
+#define GROUP_MIN_COUNT         4
+
 // 文件系统状态常量
 #define FS_STATE_CLEAN  0
 #define FS_STATE_DIRTY  1
@@ -37,4 +42,9 @@ int superblock_validate(const superblock_t *sb);
  */
 void superblock_init(superblock_t *sb, uint32_t total_blocks);
 
+/**
+ * 按数据区块数和Inode数计算分配组参数(data_blocks和total_inodes须已确定)
+ */
+void superblock_init_groups(superblock_t *sb);
+
 #endif // MODERNFS_SUPERBLOCK_H
@@ -54,7 +54,14 @@ typedef struct superblock {
     uint64_t write_time;            // 最后写入时间
     uint32_t mount_count;           // 挂载次数
 
-    uint8_t padding[3988];          // 填充到4096字节
+    // 分配组: 数据区和Inode表按组切分,第g组拥有数据块[g*group_data_blocks, ...)
+    // 和Inode[g*group_inodes, ...)以及它们在两张位图中对应的部分(最后一组可能不满)。
+    // group_count为0的旧镜像按整个数据区一组处理
+    uint32_t group_count;           // 分配组数
+    uint32_t group_data_blocks;     // 每组数据块数
+    uint32_t group_inodes;          // 每组Inode数
+
+    uint8_t padding[3976];          // 填充到4096字节
 } __attribute__((packed)) superblock_t;
 
 // ============ Inode类型 ============
@@ -70,6 +77,12 @@ typedef struct superblock {
 #define INODE_DIRECT_BLOCKS     12      // 直接块数
 #define INODE_INDIRECT_BLOCKS   1       // 一级间接块数
 #define INODE_DOUBLE_INDIRECT   1       // 二级间接块数
+#define INODE_EXTENT_ROOT_SIZE  76      // Inode内extent树根的字节数
+
+#define INODE_FLAG_EXTENTS      0x01    // 使用extent树映射数据块
+#define INODE_FLAG_INLINE       0x02    // 数据直接存放在Inode的映射区,没有数据块
+
+#define INODE_INLINE_SIZE       INODE_EXTENT_ROOT_SIZE  // 内联数据的最大字节数
 
 typedef struct disk_inode {
     uint16_t mode;                  // 文件模式和权限
@@ -87,14 +100,43 @@ typedef struct disk_inode {
     uint64_t mtime;                 // 修改时间
     uint64_t ctime;                 // 创建时间
 
-    // 数据块指针
-    block_t  direct[INODE_DIRECT_BLOCKS];       // 直接块
-    block_t  indirect;                          // 一级间接块
-    block_t  double_indirect;                   // 二级间接块
-
-    uint8_t  padding[20];           // 填充到128字节 (108 + 20 = 128)
+    // 数据块映射: flags含INODE_FLAG_EXTENTS时为extent树根,含INODE_FLAG_INLINE时
+    // 为文件内容或目录项本身,否则为直接/间接块指针
+    union {
+        struct {
+            block_t  direct[INODE_DIRECT_BLOCKS];   // 直接块
+            block_t  indirect;                      // 一级间接块
+            block_t  double_indirect;               // 二级间接块
+
+            uint8_t  padding[20];   // 填充到128字节 (108 + 20 = 128)
+        } __attribute__((packed));
+        uint8_t extent_root[INODE_EXTENT_ROOT_SIZE];    // extent树根节点
+        uint8_t inline_data[INODE_INLINE_SIZE];         // 内联数据
+    };
 } __attribute__((packed)) disk_inode_t;
 
+// ============ Extent树 ============
+//
+// 普通文件用extent树描述块映射: 每条记录表示一段逻辑连续且物理连续的块。
+// 根节点放在Inode内(头部 + 5条记录),更深的节点各占一个数据块(头部 + 340条记录)。
+// 叶子节点(depth=0)的记录是extent;索引节点的记录中physical为子节点块号,
+// logical为子树覆盖的最小逻辑块号,length未使用。
+
+#define EXTENT_MAGIC    0xF30A
+
+typedef struct extent_header {
+    uint16_t magic;                 // EXTENT_MAGIC
+    uint16_t entries;               // 有效记录数
+    uint16_t max;                   // 节点容量
+    uint16_t depth;                 // 0为叶子节点
+} __attribute__((packed)) extent_header_t;
+
+typedef struct extent {
+    uint32_t logical;               // 起始逻辑块号
+    block_t  physical;              // 起始物理块号(索引节点中为子节点块号)
+    uint32_t length;                // 块数
+} __attribute__((packed)) extent_t;
+
 // ============ 目录项结构 ============
 
 typedef struct dirent {
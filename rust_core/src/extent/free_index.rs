@@ -0,0 +1,176 @@
+// rust_core/src/extent/free_index.rs
+// 空闲区间索引: 按起始块号和按长度各维护一棵 B 树
+
+use std::collections::{BTreeMap, BTreeSet};
+
+/// 空闲区间索引
+///
+/// 两棵树始终保存同一组互不相邻的空闲区间:
+/// - `by_start`: 起始块号 -> 长度,用于就近查找和释放时合并相邻区间
+/// - `by_size`: (长度, 起始块号),用于最佳适配
+#[derive(Debug, Default)]
+pub struct FreeIndex {
+    by_start: BTreeMap<u32, u32>,
+    by_size: BTreeSet<(u32, u32)>,
+}
+
+impl FreeIndex {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// 空闲区间数量
+    pub fn fragments(&self) -> usize {
+        self.by_start.len()
+    }
+
+    /// 最大空闲区间的长度
+    #[cfg(test)]
+    pub fn largest(&self) -> u32 {
+        self.by_size.last().map_or(0, |&(len, _)| len)
+    }
+
+    /// 按起始块号升序遍历空闲区间 (起始块号, 长度)
+    #[cfg(test)]
+    pub fn runs(&self) -> impl Iterator<Item = (u32, u32)> + '_ {
+        self.by_start.iter().map(|(&start, &len)| (start, len))
+    }
+
+    fn add(&mut self, start: u32, len: u32) {
+        self.by_start.insert(start, len);
+        self.by_size.insert((len, start));
+    }
+
+    fn remove(&mut self, start: u32, len: u32) {
+        self.by_start.remove(&start);
+        self.by_size.remove(&(len, start));
+    }
+
+    /// 包含 block 的空闲区间
+    fn containing(&self, block: u32) -> Option<(u32, u32)> {
+        self.by_start
+            .range(..=block)
+            .next_back()
+            .map(|(&start, &len)| (start, len))
+            .filter(|&(start, len)| block - start < len)
+    }
+
+    /// 加入一段空闲区间,与前后相邻的区间合并
+    ///
+    /// 调用者保证 [start, start + len) 当前不在索引中
+    pub fn insert(&mut self, mut start: u32, mut len: u32) {
+        if len == 0 {
+            return;
+        }
+
+        if let Some((&prev, &prev_len)) = self.by_start.range(..start).next_back() {
+            if prev + prev_len == start {
+                self.remove(prev, prev_len);
+                start = prev;
+                len += prev_len;
+            }
+        }
+        if let Some(&next_len) = self.by_start.get(&(start + len)) {
+            self.remove(start + len, next_len);
+            len += next_len;
+        }
+
+        self.add(start, len);
+    }
+
+    /// 从索引中取走 [start, start + len),该范围必须落在同一段空闲区间内
+    pub fn take(&mut self, start: u32, len: u32) {
+        let (free_start, free_len) = self
+            .containing(start)
+            .expect("taking blocks that are not free");
+        debug_assert!(start + len <= free_start + free_len);
+
+        self.remove(free_start, free_len);
+        if start > free_start {
+            self.add(free_start, start - free_start);
+        }
+        let tail = free_start + free_len - (start + len);
+        if tail > 0 {
+            self.add(start + len, tail);
+        }
+    }
+
+    /// 查找可分配的区间,返回 (起始块号, 长度),长度在 [min_len, max_len] 内
+    ///
+    /// 依次尝试:
+    /// 1. 包含 goal 的区间从 goal 开始的部分
+    /// 2. goal 之后的第一段区间
+    /// 3. 最佳适配: 能放下 max_len 的最短区间,没有则取最长的区间
+    pub fn find(&self, goal: u32, min_len: u32, max_len: u32) -> Option<(u32, u32)> {
+        if let Some((start, len)) = self.containing(goal) {
+            let avail = start + len - goal;
+            if avail >= min_len {
+                return Some((goal, avail.min(max_len)));
+            }
+        }
+
+        if let Some((&start, &len)) = self.by_start.range(goal..).next() {
+            if len >= min_len {
+                return Some((start, len.min(max_len)));
+            }
+        }
+
+        if let Some(&(len, start)) = self.by_size.range((max_len, 0)..).next() {
+            return Some((start, len.min(max_len)));
+        }
+        match self.by_size.last() {
+            Some(&(len, start)) if len >= min_len => Some((start, len)),
+            _ => None,
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_insert_merges_neighbours() {
+        let mut index = FreeIndex::new();
+        index.insert(0, 10);
+        index.insert(20, 10);
+        assert_eq!(index.fragments(), 2);
+
+        index.insert(10, 10);
+        assert_eq!(index.fragments(), 1);
+        assert_eq!(index.largest(), 30);
+    }
+
+    #[test]
+    fn test_take_splits() {
+        let mut index = FreeIndex::new();
+        index.insert(0, 100);
+        index.take(40, 20);
+        assert_eq!(index.fragments(), 2);
+        assert_eq!(index.largest(), 40);
+
+        index.take(0, 40);
+        assert_eq!(index.fragments(), 1);
+        assert_eq!(index.find(0, 1, 100), Some((60, 40)));
+    }
+
+    #[test]
+    fn test_find_order() {
+        let mut index = FreeIndex::new();
+        index.insert(0, 8);
+        index.insert(100, 64);
+        index.insert(500, 16);
+        index.insert(1000, 32);
+
+        // goal 落在空闲区间内
+        assert_eq!(index.find(104, 8, 8), Some((104, 8)));
+        // goal 之后的第一段区间
+        assert_eq!(index.find(200, 8, 8), Some((500, 8)));
+        // 就近的区间太短时最佳适配
+        assert_eq!(index.find(200, 20, 20), Some((1000, 20)));
+        assert_eq!(index.find(0, 40, 40), Some((100, 40)));
+        // 没有能放下 max_len 的区间时取最长的
+        assert_eq!(index.find(2000, 10, 100), Some((100, 64)));
+        assert_eq!(index.find(2000, 65, 100), None);
+    }
+}
@@ -1,15 +1,20 @@
 // rust_core/src/extent/mod.rs
 // Extent Allocator 实现
 
+mod free_index;
 mod types;
 
 pub use types::{AllocStats, Extent};
 
+use free_index::FreeIndex;
+
 use anyhow::{bail, Result};
 use bitvec::prelude::*;
+use std::collections::BTreeSet;
 use std::fs::File;
-use std::io::{Read, Seek, SeekFrom, Write};
+use std::io::{Read, Seek, SeekFrom};
 use std::mem::ManuallyDrop;
+use std::os::unix::fs::FileExt;
 use std::os::unix::io::{FromRawFd, RawFd};
 use std::sync::{
     atomic::{AtomicU32, AtomicU64, Ordering},
@@ -18,6 +23,12 @@ use std::sync::{
 
 const BLOCK_SIZE: usize = 4096;
 
+/// 位图字宽: BitVec<usize, Lsb0> 中第 i 位位于第 i / WORD_BITS 个字的低 i % WORD_BITS 位
+const WORD_BITS: usize = usize::BITS as usize;
+
+/// 每个位图块管理的块数
+const BITS_PER_BITMAP_BLOCK: usize = BLOCK_SIZE * 8;
+
 /// Extent Allocator: 管理连续块区域的分配器
 pub struct ExtentAllocator {
     /// 设备文件句柄
@@ -34,6 +45,12 @@ pub struct ExtentAllocator {
     /// 位图 (使用 bitvec，true=已分配, false=空闲)
     bitmap: RwLock<BitVec>,
 
+    /// 空闲区间索引 (与位图同步更新,加锁顺序: 先 bitmap 后 index)
+    index: RwLock<FreeIndex>,
+
+    /// 上次同步后改动过的位图块 (在位图写锁下更新)
+    dirty: Mutex<BTreeSet<u32>>,
+
     /// 统计信息
     stats: Arc<Mutex<AllocStats>>,
 
@@ -42,6 +59,9 @@ pub struct ExtentAllocator {
 
     /// 分配计数器
     alloc_count: AtomicU64,
+
+    /// Next-Fit 游标: 没有有效 hint 时下次搜索的起始位 (在位图写锁下更新)
+    cursor: AtomicU32,
 }
 
 impl ExtentAllocator {
@@ -64,6 +84,9 @@ impl ExtentAllocator {
         // 创建初始位图（全部空闲）
         let bitmap = bitvec![0; total_blocks as usize];
 
+        let mut index = FreeIndex::new();
+        index.insert(0, total_blocks);
+
         let stats = AllocStats::new(total_blocks);
 
         let allocator = Self {
@@ -71,9 +94,12 @@ impl ExtentAllocator {
             bitmap_start,
             total_blocks,
             bitmap: RwLock::new(bitmap),
+            index: RwLock::new(index),
+            dirty: Mutex::new(BTreeSet::new()),
             stats: Arc::new(Mutex::new(stats)),
             free_blocks: AtomicU32::new(total_blocks),
             alloc_count: AtomicU64::new(0),
+            cursor: AtomicU32::new(0),
         };
 
         // 尝试从磁盘加载位图
@@ -89,10 +115,13 @@ impl ExtentAllocator {
     /// 分配 Extent
     ///
     /// # 参数
-    /// - `hint`: 分配提示位置（从这里开始搜索）
+    /// - `hint`: 分配提示位置（优先在这里或之后分配,超出范围时用 Next-Fit 游标）
     /// - `min_len`: 最小长度
     /// - `max_len`: 最大长度
     ///
+    /// 在空闲区间索引上查找: hint 处或之后的区间够长时就近分配,否则最佳适配,
+    /// 复杂度 O(log n)
+    ///
     /// # 返回
     /// 成功返回 Extent，失败返回错误
     pub fn allocate_extent(&self, hint: u32, min_len: u32, max_len: u32) -> Result<Extent> {
@@ -101,14 +130,30 @@ impl ExtentAllocator {
         }
 
         let mut bitmap = self.bitmap.write().unwrap();
+        let mut index = self.index.write().unwrap();
 
-        // First-Fit 搜索
-        let (start, length) = self.find_consecutive_free(&bitmap, hint, min_len, max_len)?;
+        let goal = if hint < self.total_blocks {
+            hint
+        } else {
+            self.cursor.load(Ordering::Relaxed)
+        };
+        let (start, length) = match index.find(goal, min_len, max_len) {
+            Some(found) => found,
+            None => bail!(
+                "No free extent found: requested {} blocks, free_blocks={}",
+                min_len,
+                self.free_blocks.load(Ordering::Relaxed)
+            ),
+        };
 
         // 标记为已分配
-        for i in start..(start + length) {
-            bitmap.set(i as usize, true);
-        }
+        index.take(start, length);
+        bitmap[start as usize..(start + length) as usize].fill(true);
+        self.mark_dirty(start, length);
+
+        let next = start + length;
+        self.cursor
+            .store(if next == self.total_blocks { 0 } else { next }, Ordering::Relaxed);
 
         // 更新统计
         self.free_blocks.fetch_sub(length, Ordering::Relaxed);
@@ -134,12 +179,13 @@ impl ExtentAllocator {
         let mut bitmap = self.bitmap.write().unwrap();
 
         // Double-free 检测
-        for i in extent.start..(extent.start + extent.length) {
-            if !bitmap[i as usize] {
-                bail!("Double free detected at block {}", i);
-            }
-            bitmap.set(i as usize, false);
+        let range = extent.start as usize..extent.end() as usize;
+        if let Some(i) = bitmap[range.clone()].first_zero() {
+            bail!("Double free detected at block {}", extent.start as usize + i);
         }
+        bitmap[range].fill(false);
+        self.index.write().unwrap().insert(extent.start, extent.length);
+        self.mark_dirty(extent.start, extent.length);
 
         // 更新统计
         self.free_blocks.fetch_add(extent.length, Ordering::Relaxed);
@@ -160,30 +206,11 @@ impl ExtentAllocator {
     /// 碎片率 = (实际碎片数 - 理想碎片数) / 总块数
     /// - 实际碎片数 = 连续空闲区域的数量
     /// - 理想碎片数 = 如果所有空闲块连续则为1，否则为0
+    ///
+    /// 实际碎片数直接取自空闲区间索引,复杂度 O(1)
     pub fn fragmentation_ratio(&self) -> f32 {
-        let bitmap = self.bitmap.read().unwrap();
-        let free_blocks = self.free_blocks.load(Ordering::Relaxed);
-
-        if free_blocks == 0 {
-            return 0.0; // 没有空闲块，无碎片
-        }
-
-        // 统计连续空闲区域数量
-        let mut fragments = 0;
-        let mut in_free_region = false;
-
-        for bit in bitmap.iter() {
-            if !*bit {
-                // 空闲块
-                if !in_free_region {
-                    fragments += 1;
-                    in_free_region = true;
-                }
-            } else {
-                // 已分配块
-                in_free_region = false;
-            }
-        }
+        // 连续空闲区域数量,没有空闲块时为 0
+        let fragments = self.index.read().unwrap().fragments();
 
         // 理想情况：所有空闲块连续，只有1个碎片
         let ideal_fragments = 1.0;
@@ -227,8 +254,9 @@ impl ExtentAllocator {
             bitmap.set(i, loaded_bitmap[i]);
         }
 
-        // 重新计算空闲块数
-        let free_count = bitmap.iter().filter(|b| !**b).count() as u32;
+        // 重新计算空闲块数并重建空闲区间索引
+        let free_count = bitmap.count_zeros() as u32;
+        *self.index.write().unwrap() = build_index(&bitmap);
         self.free_blocks.store(free_count, Ordering::Relaxed);
 
         let mut stats = self.stats.lock().unwrap();
@@ -244,80 +272,147 @@ impl ExtentAllocator {
         Ok(())
     }
 
+    /// 记下 [start, start + len) 所在的位图块
+    fn mark_dirty(&self, start: u32, len: u32) {
+        let first = start as usize / BITS_PER_BITMAP_BLOCK;
+        let last = (start + len - 1) as usize / BITS_PER_BITMAP_BLOCK;
+        self.dirty
+            .lock()
+            .unwrap()
+            .extend((first..=last).map(|b| b as u32));
+    }
+
     /// 同步位图到磁盘
+    ///
+    /// 只写上次同步后改动过的位图块,没有改动时不做任何 I/O
     pub fn sync_bitmap_to_disk(&self) -> Result<()> {
         let bitmap = self.bitmap.read().unwrap();
+        let dirty = std::mem::take(&mut *self.dirty.lock().unwrap());
+        if dirty.is_empty() {
+            return Ok(());
+        }
 
-        let bitmap_bytes = (self.total_blocks as usize + 7) / 8;
-        let bitmap_blocks = (bitmap_bytes + BLOCK_SIZE - 1) / BLOCK_SIZE;
-
-        let mut buffer = vec![0u8; bitmap_blocks * BLOCK_SIZE];
+        let device = self.device.lock().unwrap();
+        let words = bitmap.as_raw_slice();
+        let word_bytes = std::mem::size_of::<usize>();
+        let words_per_block = BLOCK_SIZE / word_bytes;
+        let mut buffer = vec![0u8; BLOCK_SIZE];
+
+        for (n, &block) in dirty.iter().enumerate() {
+            // Lsb0 的字按小端展开就是磁盘上的字节顺序
+            let first = block as usize * words_per_block;
+            let last = (first + words_per_block).min(words.len());
+            buffer.fill(0);
+            for (chunk, w) in buffer.chunks_exact_mut(word_bytes).zip(first..last) {
+                let mut word = words[w];
+                // 超出 total_blocks 的位写成 0
+                let valid = bitmap.len() - w * WORD_BITS;
+                if valid < WORD_BITS {
+                    word &= (1 << valid) - 1;
+                }
+                chunk.copy_from_slice(&word.to_le_bytes());
+            }
 
-        // 手动转换 BitVec 到字节数组
-        for (i, bit) in bitmap.iter().enumerate() {
-            if *bit {
-                let byte_idx = i / 8;
-                let bit_idx = i % 8;
-                buffer[byte_idx] |= 1 << bit_idx;
+            let offset = (self.bitmap_start as u64 + block as u64) * BLOCK_SIZE as u64;
+            if let Err(e) = device.write_all_at(&buffer, offset) {
+                // 没写成功的块留到下次同步
+                self.dirty
+                    .lock()
+                    .unwrap()
+                    .extend(dirty.iter().skip(n).copied());
+                return Err(e.into());
             }
         }
+        device.sync_data()?;
 
-        let offset = (self.bitmap_start as u64) * BLOCK_SIZE as u64;
+        eprintln!(
+            "[ExtentAllocator] Bitmap synced to disk ({} blocks)",
+            dirty.len()
+        );
 
-        let mut device = self.device.lock().unwrap();
-        device.seek(SeekFrom::Start(offset))?;
-        device.write_all(&buffer)?;
-        device.sync_all()?;
+        Ok(())
+    }
+}
+
+/// 按字扫描位图,把所有连续空闲区域加入新的索引
+fn build_index(bitmap: &BitVec) -> FreeIndex {
+    let words = bitmap.as_raw_slice();
+    let total = bitmap.len();
+    let mut index = FreeIndex::new();
+
+    let mut pos = 0;
+    while pos < total {
+        let start = find_bit(words, pos, total, false);
+        if start >= total {
+            break;
+        }
+        let stop = find_bit(words, start, total, true);
+        index.insert(start as u32, (stop - start) as u32);
+        pos = stop;
+    }
 
-        eprintln!("[ExtentAllocator] Bitmap synced to disk");
+    index
+}
 
-        Ok(())
+// ============ 按字扫描 ============
+
+/// 跳过 [word, end) 中等于 pattern 的字,返回第一个不等的字下标或 end
+fn skip_words(words: &[usize], word: usize, end: usize, pattern: usize) -> usize {
+    #[cfg(target_arch = "x86_64")]
+    {
+        if is_x86_feature_detected!("avx2") {
+            // SAFETY: 已检测到 CPU 支持 AVX2
+            return unsafe { skip_words_avx2(words, word, end, pattern) };
+        }
     }
+    skip_words_generic(words, word, end, pattern)
+}
 
-    /// First-Fit 搜索算法
-    ///
-    /// 从 hint 位置开始循环搜索，找到第一个满足 [min_len, max_len] 的连续空闲区域
-    fn find_consecutive_free(
-        &self,
-        bitmap: &BitVec,
-        hint: u32,
-        min_len: u32,
-        max_len: u32,
-    ) -> Result<(u32, u32)> {
-        let total = bitmap.len() as u32;
-        let start_pos = hint % total;
-
-        let mut consecutive = 0;
-        let mut region_start = 0;
-
-        // 从 hint 开始循环搜索
-        for offset in 0..total {
-            let pos = (start_pos + offset) % total;
-
-            if !bitmap[pos as usize] {
-                // 空闲块
-                if consecutive == 0 {
-                    region_start = pos;
-                }
-                consecutive += 1;
+fn skip_words_generic(words: &[usize], mut word: usize, end: usize, pattern: usize) -> usize {
+    while word < end && words[word] == pattern {
+        word += 1;
+    }
+    word
+}
 
-                // 找到足够大的区域
-                if consecutive >= min_len {
-                    let allocated_len = consecutive.min(max_len);
-                    return Ok((region_start, allocated_len));
-                }
-            } else {
-                // 已分配块，重置计数
-                consecutive = 0;
-            }
+/// 一次比较 4 个 64 位字
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn skip_words_avx2(words: &[usize], mut word: usize, end: usize, pattern: usize) -> usize {
+    use std::arch::x86_64::*;
+
+    let expect = _mm256_set1_epi64x(pattern as i64);
+    while word + 4 <= end {
+        let v = _mm256_loadu_si256(words.as_ptr().add(word) as *const __m256i);
+        if _mm256_movemask_epi8(_mm256_cmpeq_epi64(v, expect)) != -1 {
+            break;
         }
+        word += 4;
+    }
+    skip_words_generic(words, word, end, pattern)
+}
+
+/// 返回 [from, end) 中第一个值为 set 的位,不存在时返回 end
+fn find_bit(words: &[usize], from: usize, end: usize, set: bool) -> usize {
+    if from >= end {
+        return end;
+    }
 
-        bail!(
-            "No free extent found: requested {} blocks, free_blocks={}",
-            min_len,
-            self.free_blocks.load(Ordering::Relaxed)
-        )
+    // 取反后要找的位变为 1
+    let flip = if set { 0 } else { !0 };
+    let end_word = (end + WORD_BITS - 1) / WORD_BITS;
+    let mut word = from / WORD_BITS;
+    let mut w = (words[word] ^ flip) & (!0usize << (from % WORD_BITS));
+
+    while w == 0 {
+        word = skip_words(words, word + 1, end_word, flip);
+        if word >= end_word {
+            return end;
+        }
+        w = words[word] ^ flip;
     }
+
+    (word * WORD_BITS + w.trailing_zeros() as usize).min(end)
 }
 
 impl Drop for ExtentAllocator {
@@ -391,4 +486,201 @@ mod tests {
         assert!(frag > 0.0);
         println!("Fragmentation: {:.2}%", frag * 100.0);
     }
+
+    #[test]
+    fn test_sync_writes_only_dirty_blocks() {
+        let file = tempfile().unwrap();
+        let fd = file.as_raw_fd();
+        let total = 3 * BITS_PER_BITMAP_BLOCK as u32;
+
+        let allocator = ExtentAllocator::new(fd, 0, total).unwrap();
+        file.write_all_at(&vec![0xFF; 3 * BLOCK_SIZE], 0).unwrap();
+
+        // 只改动第 2 个位图块
+        let base = 2 * BITS_PER_BITMAP_BLOCK as u32;
+        let extent = allocator.allocate_extent(base + 5, 3, 3).unwrap();
+        assert_eq!(extent.start, base + 5);
+        allocator.sync_bitmap_to_disk().unwrap();
+
+        let mut buf = vec![0u8; 3 * BLOCK_SIZE];
+        file.read_exact_at(&mut buf, 0).unwrap();
+        assert!(buf[..2 * BLOCK_SIZE].iter().all(|&b| b == 0xFF));
+        assert_eq!(buf[2 * BLOCK_SIZE], 0b1110_0000);
+        assert!(buf[2 * BLOCK_SIZE + 1..].iter().all(|&b| b == 0));
+
+        // 没有新的改动时不再写
+        file.write_all_at(&vec![0xFF; BLOCK_SIZE], 2 * BLOCK_SIZE as u64).unwrap();
+        allocator.sync_bitmap_to_disk().unwrap();
+        file.read_exact_at(&mut buf, 0).unwrap();
+        assert!(buf.iter().all(|&b| b == 0xFF));
+    }
+
+    /// 参考实现: 逐位扫描的首次适配
+    fn naive_find(bitmap: &BitVec, len: usize) -> Option<usize> {
+        let mut run = 0;
+        for (i, bit) in bitmap.iter().enumerate() {
+            if *bit {
+                run = 0;
+            } else {
+                run += 1;
+                if run == len {
+                    return Some(i + 1 - len);
+                }
+            }
+        }
+        None
+    }
+
+    /// 交替填充已分配/空闲区域,空闲区域长度为 1..=max_free,占用率约为 fill
+    fn fill_bitmap(bitmap: &mut BitVec, fill: f64, max_free: usize, seed: &mut u64) {
+        let mut next = || {
+            *seed = seed.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+            (*seed >> 33) as usize
+        };
+        bitmap.fill(false);
+        if fill <= 0.0 {
+            return;
+        }
+        let max_used = ((max_free + 1) as f64 * fill / (1.0 - fill)) as usize + 1;
+        let mut bit = 0;
+        while bit < bitmap.len() {
+            let used = (1 + next() % max_used).min(bitmap.len() - bit);
+            bitmap[bit..bit + used].fill(true);
+            bit += used + 1 + next() % max_free;
+        }
+    }
+
+    fn load(allocator: &ExtentAllocator, src: &BitVec) {
+        let mut bitmap = allocator.bitmap.write().unwrap();
+        bitmap.copy_from_bitslice(src);
+        allocator
+            .free_blocks
+            .store(bitmap.count_zeros() as u32, Ordering::Relaxed);
+        allocator.cursor.store(0, Ordering::Relaxed);
+        *allocator.index.write().unwrap() = build_index(&bitmap);
+    }
+
+    /// 参考实现: 逐位统计连续空闲区域
+    fn naive_runs(bitmap: &BitVec) -> Vec<(u32, u32)> {
+        let mut runs = Vec::new();
+        let mut start = None;
+        for i in 0..=bitmap.len() {
+            let free = i < bitmap.len() && !bitmap[i];
+            match (free, start) {
+                (true, None) => start = Some(i),
+                (false, Some(s)) => {
+                    runs.push((s as u32, (i - s) as u32));
+                    start = None;
+                }
+                _ => {}
+            }
+        }
+        runs
+    }
+
+    #[test]
+    fn test_index_matches_bitmap() {
+        let file = tempfile().unwrap();
+        let total = 10_000;
+        let allocator = ExtentAllocator::new(file.as_raw_fd(), 0, total).unwrap();
+
+        let mut src = bitvec![0; total as usize];
+        let mut seed = 7;
+        for fill in [0.5, 0.9, 0.99] {
+            fill_bitmap(&mut src, fill, 64, &mut seed);
+            load(&allocator, &src);
+
+            // 从位图重建的索引与逐位扫描一致
+            let runs = naive_runs(&src);
+            assert_eq!(allocator.index.read().unwrap().runs().collect::<Vec<_>>(), runs);
+
+            // 分配和释放之后索引仍与位图一致
+            let mut extents = Vec::new();
+            for len in [1, 3, 8, 31, 64] {
+                if let Ok(e) = allocator.allocate_extent(seed as u32 % total, 1, len) {
+                    extents.push(e);
+                }
+            }
+            for e in extents.iter().step_by(2) {
+                allocator.free_extent(e).unwrap();
+            }
+            let bitmap = allocator.bitmap.read().unwrap().clone();
+            assert_eq!(
+                allocator.index.read().unwrap().runs().collect::<Vec<_>>(),
+                naive_runs(&bitmap)
+            );
+        }
+    }
+
+    #[test]
+    fn test_next_fit_cursor() {
+        let file = tempfile().unwrap();
+        let allocator = ExtentAllocator::new(file.as_raw_fd(), 0, 1000).unwrap();
+
+        // 释放的区域不会被立即重用
+        let e1 = allocator.allocate_extent(u32::MAX, 10, 10).unwrap();
+        allocator.free_extent(&e1).unwrap();
+        let e2 = allocator.allocate_extent(u32::MAX, 10, 10).unwrap();
+        assert_eq!(e2.start, 10);
+
+        // hint 所在区间不够长时取其后的区间
+        let e3 = allocator.allocate_extent(995, 5, 5).unwrap();
+        assert_eq!(e3, Extent::new(995, 5));
+        let e4 = allocator.allocate_extent(5, 8, 8).unwrap();
+        assert_eq!(e4, Extent::new(20, 8));
+
+        // 就近没有合适的区间时最佳适配
+        let e6 = allocator.allocate_extent(990, 6, 6).unwrap();
+        assert_eq!(e6, Extent::new(0, 6));
+
+        // 区域尽量扩展到 max_len
+        let e5 = allocator.allocate_extent(100, 1, 64).unwrap();
+        assert_eq!(e5, Extent::new(100, 64));
+    }
+
+    /// 不同填充率下的分配延迟: cargo test --release -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn bench_allocation_latency_vs_fill() {
+        use std::time::Instant;
+
+        const TOTAL: u32 = 1 << 22;
+        const ALLOCS: u32 = 1024;
+
+        let file = tempfile().unwrap();
+        let allocator = ExtentAllocator::new(file.as_raw_fd(), 0, TOTAL).unwrap();
+        let mut src = bitvec![0; TOTAL as usize];
+
+        println!("{} blocks, {} allocations per cell (ns/alloc)", TOTAL, ALLOCS);
+        println!("{:>6} {:>14} {:>14} {:>14} {:>14}", "fill", "1 blk index", "1 blk bit", "8 blk index", "8 blk bit");
+
+        for fill in [0.0, 0.5, 0.9, 0.99] {
+            let mut seed = 1234;
+            fill_bitmap(&mut src, fill, 16, &mut seed);
+
+            let mut row = Vec::new();
+            for len in [1u32, 8] {
+                load(&allocator, &src);
+                let begin = Instant::now();
+                for _ in 0..ALLOCS {
+                    let _ = allocator.allocate_extent(TOTAL, len, len);
+                }
+                row.push(begin.elapsed().as_nanos() as f64 / ALLOCS as f64);
+
+                let mut naive = src.clone();
+                let begin = Instant::now();
+                for _ in 0..ALLOCS {
+                    if let Some(start) = naive_find(&naive, len as usize) {
+                        naive[start..start + len as usize].fill(true);
+                    }
+                }
+                row.push(begin.elapsed().as_nanos() as f64 / ALLOCS as f64);
+            }
+
+            println!(
+                "{:>5.0}% {:>14.0} {:>14.0} {:>14.0} {:>14.0}",
+                fill * 100.0, row[0], row[1], row[2], row[3]
+            );
+        }
+    }
 }
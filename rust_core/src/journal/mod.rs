@@ -7,10 +7,12 @@
 // 4. 崩溃恢复时重放已提交的事务
 
 use anyhow::{bail, Context as AnyhowContext, Result};
+use std::borrow::Cow;
 use std::collections::HashMap;
 use std::fs::File;
 use std::io::{Read, Seek, SeekFrom, Write};
 use std::mem::ManuallyDrop;
+use std::os::unix::fs::FileExt;
 use std::os::unix::io::{FromRawFd, RawFd};
 use std::sync::atomic::{AtomicU64, Ordering};
 use std::sync::{Arc, Mutex, RwLock};
@@ -23,6 +25,9 @@ const JOURNAL_MAGIC: u32 = 0x4A524E4C; // "JRNL"
 #[allow(dead_code)]
 const JOURNAL_VERSION: u32 = 1;
 
+/// 提交时待写入的Journal块: (Journal块号, 块内容)
+type JournalBatch<'a> = Vec<(u32, Cow<'a, [u8]>)>;
+
 // ============ Journal Manager主结构 ============
 
 pub struct JournalManager {
@@ -140,13 +145,17 @@ impl JournalManager {
             return Ok(());
         }
 
+        // 先组装整个事务的Journal块,再按连续区间一次性写出
+        let mut batch: JournalBatch = Vec::with_capacity(txn_inner.writes.len() * 2);
         let mut journal_blocks_used = Vec::new();
         for (block_num, data) in &txn_inner.writes {
             let journal_block = self.allocate_journal_block()?;
-            self.write_journal_data(journal_block, *block_num, data)?;
+            self.write_journal_data(&mut batch, journal_block, *block_num, data)?;
             journal_blocks_used.push(journal_block);
         }
+        self.flush_journal_batch(&mut batch)?;
 
+        // commit记录在所有数据块之后单独写出
         let commit_block = self.allocate_journal_block()?;
         self.write_commit_record(commit_block, txn_inner.id, &journal_blocks_used)?;
 
@@ -188,7 +197,14 @@ impl JournalManager {
         Ok(allocated)
     }
 
-    fn write_journal_data(&self, journal_block: u32, target_block: u32, data: &[u8]) -> Result<()> {
+    /// 生成数据块的header块和数据块,加入待写批次
+    fn write_journal_data<'a>(
+        &self,
+        batch: &mut JournalBatch<'a>,
+        journal_block: u32,
+        target_block: u32,
+        data: &'a [u8],
+    ) -> Result<()> {
         if data.len() != BLOCK_SIZE {
             bail!("Invalid data size");
         }
@@ -202,7 +218,7 @@ impl JournalManager {
             checksum: Self::calculate_checksum(data),
         };
 
-        // 先写入header块
+        // header块 + 完整数据块
         let mut header_block = vec![0u8; BLOCK_SIZE];
         unsafe {
             std::ptr::copy_nonoverlapping(
@@ -211,15 +227,39 @@ impl JournalManager {
                 std::mem::size_of::<JournalDataHeader>(),
             );
         }
-        let offset = ((self.journal_start + journal_block) as u64) * (BLOCK_SIZE as u64);
-        let mut device = self.device.lock().unwrap();
-        device.seek(SeekFrom::Start(offset))?;
-        device.write_all(&header_block)?;
+        batch.push((journal_block, Cow::Owned(header_block)));
+        batch.push((data_journal_block, Cow::Borrowed(data)));
+
+        Ok(())
+    }
+
+    /// 写出一批Journal块: 按块号排序后,每段连续的块合并为一次pwrite
+    fn flush_journal_batch(&self, batch: &mut JournalBatch) -> Result<()> {
+        batch.sort_by_key(|(block, _)| *block);
 
-        // 再写入完整数据块
-        let data_offset = ((self.journal_start + data_journal_block) as u64) * (BLOCK_SIZE as u64);
-        device.seek(SeekFrom::Start(data_offset))?;
-        device.write_all(data)?;
+        let device = self.device.lock().unwrap();
+        let mut run_buf = Vec::new();
+        let mut i = 0;
+
+        while i < batch.len() {
+            let mut j = i + 1;
+            while j < batch.len() && batch[j].0 == batch[j - 1].0 + 1 {
+                j += 1;
+            }
+
+            let offset = ((self.journal_start + batch[i].0) as u64) * (BLOCK_SIZE as u64);
+            if j - i == 1 {
+                device.write_all_at(&batch[i].1, offset)?;
+            } else {
+                run_buf.clear();
+                for (_, block) in &batch[i..j] {
+                    run_buf.extend_from_slice(block);
+                }
+                device.write_all_at(&run_buf, offset)?;
+            }
+
+            i = j;
+        }
 
         Ok(())
     }
@@ -25,6 +25,316 @@ static inline void bitmap_clear(uint8_t *bitmap, uint32_t bit) {
     bitmap[byte] &= ~(1 << offset);
 }
 
+static void bitmap_set_range(uint8_t *bitmap, uint32_t start, uint32_t count) {
+    for (uint32_t i = start; i < start + count; i++) {
+        bitmap_set(bitmap, i);
+    }
+}
+
+// ============ 按字扫描 ============
+//
+// 位图在字节内低位在前,按小端读成64位字后第i位就是块i,
+// 查找时用ctz一次处理64个块;整字已满(或全空)时成批跳过,支持AVX2时一次比较4个字。
+
+#define BITS_PER_WORD 64
+
+static inline uint64_t bitmap_word(const uint8_t *bitmap, uint32_t word) {
+    uint64_t w;
+    memcpy(&w, bitmap + (size_t)word * sizeof(uint64_t), sizeof(w));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+// 跳过[word, end)中等于pattern的字,返回第一个不等的字下标或end
+static uint32_t skip_words_generic(const uint8_t *bitmap, uint32_t word, uint32_t end,
+                                   uint64_t pattern) {
+    while (word < end && bitmap_word(bitmap, word) == pattern) {
+        word++;
+    }
+    return word;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+__attribute__((target("avx2")))
+static uint32_t skip_words_avx2(const uint8_t *bitmap, uint32_t word, uint32_t end,
+                                uint64_t pattern) {
+    __m256i expect = _mm256_set1_epi64x((long long)pattern);
+    while (word + 4 <= end) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(bitmap + (size_t)word * sizeof(uint64_t)));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(v, expect)) != -1) {
+            break;
+        }
+        word += 4;
+    }
+    return skip_words_generic(bitmap, word, end, pattern);
+}
+#endif
+
+static uint32_t skip_words(const uint8_t *bitmap, uint32_t word, uint32_t end, uint64_t pattern) {
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        return skip_words_avx2(bitmap, word, end, pattern);
+    }
+#endif
+    return skip_words_generic(bitmap, word, end, pattern);
+}
+
+// 返回[from, end)中第一个值为set的位,不存在时返回end
+static uint32_t find_bit(const uint8_t *bitmap, uint32_t from, uint32_t end, bool set) {
+    if (from >= end) {
+        return end;
+    }
+
+    // 异或后要找的位变为1
+    uint64_t flip = set ? 0 : ~0ULL;
+    uint32_t end_word = (end + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    uint32_t word = from / BITS_PER_WORD;
+    uint64_t w = (bitmap_word(bitmap, word) ^ flip) & (~0ULL << (from % BITS_PER_WORD));
+
+    while (w == 0) {
+        word = skip_words(bitmap, word + 1, end_word, flip);
+        if (word >= end_word) {
+            return end;
+        }
+        w = bitmap_word(bitmap, word) ^ flip;
+    }
+
+    uint32_t bit = word * BITS_PER_WORD + (uint32_t)__builtin_ctzll(w);
+    return bit < end ? bit : end;
+}
+
+// 统计[start, end)中的空闲位,start须是64的倍数
+static uint32_t count_free_bits(const uint8_t *bitmap, uint32_t start, uint32_t end) {
+    uint32_t used = 0;
+    uint32_t word = start / BITS_PER_WORD;
+    uint32_t full_words = end / BITS_PER_WORD;
+
+    for (; word < full_words; word++) {
+        used += (uint32_t)__builtin_popcountll(bitmap_word(bitmap, word));
+    }
+    if (end % BITS_PER_WORD) {
+        uint64_t mask = (1ULL << (end % BITS_PER_WORD)) - 1;
+        used += (uint32_t)__builtin_popcountll(bitmap_word(bitmap, full_words) & mask);
+    }
+    return end - start - used;
+}
+
+// ============ 脏位图块 ============
+
+#define BITS_PER_BITMAP_BLOCK (BLOCK_SIZE * 8)
+
+// 记下[start, start + count)所在的位图块,调用者持有这些位所在组的锁
+static void mark_dirty(block_allocator_t *alloc, uint32_t start, uint32_t count) {
+    uint32_t first = start / BITS_PER_BITMAP_BLOCK;
+    uint32_t last = (start + count - 1) / BITS_PER_BITMAP_BLOCK;
+    for (uint32_t b = first; b <= last; b++) {
+        __atomic_fetch_or(&alloc->dirty[b / BITS_PER_WORD], 1ULL << (b % BITS_PER_WORD),
+                          __ATOMIC_RELAXED);
+    }
+}
+
+// ============ 分配组 ============
+
+static inline uint32_t group_index(const block_allocator_t *alloc, uint32_t bit) {
+    return bit / alloc->group_blocks;
+}
+
+// 线程编号在首次分配时取得,用来选择默认分配组和预留窗口
+static __thread uint32_t balloc_thread_id = UINT32_MAX;
+static uint32_t balloc_next_thread_id;
+
+static uint32_t thread_id(void) {
+    if (balloc_thread_id == UINT32_MAX) {
+        balloc_thread_id = __atomic_fetch_add(&balloc_next_thread_id, 1, __ATOMIC_RELAXED);
+    }
+    return balloc_thread_id;
+}
+
+// 没有指定组时从当前线程的默认组开始,不同线程的分配落在不同组上
+static uint32_t resolve_group(const block_allocator_t *alloc, uint32_t group) {
+    if (group < alloc->group_count) {
+        return group;
+    }
+    return thread_id() % alloc->group_count;
+}
+
+// 在组g内从from开始扫描到组末尾,再从组首回绕到from,寻找至少count块的空闲区间。
+// 找到时返回true;否则若partial非NULL,通过它返回扫描中遇到的第一段不短于min_len的
+// 空闲区间(长度不超过count,长度为0表示没有这样的区间)。区间不会越过组边界
+static bool find_free_run(const block_allocator_t *alloc, const balloc_group_t *g,
+                          uint32_t from, uint32_t min_len, uint32_t count,
+                          uint32_t *start_out, uint32_t *partial_len) {
+    uint32_t end = g->start + g->len;
+    uint32_t first_start = 0;
+    uint32_t first_len = 0;
+
+    for (int pass = 0; pass < 2; pass++) {
+        // 第二轮只考虑起点在from之前的区间,区间本身可以越过from
+        uint32_t pos = (pass == 0) ? from : g->start;
+        uint32_t limit = (pass == 0) ? end : from;
+
+        while (pos < limit) {
+            uint32_t start = find_bit(alloc->bitmap, pos, limit, false);
+            if (start >= limit) {
+                break;
+            }
+
+            uint32_t want_end = (end - start > count) ? start + count : end;
+            uint32_t stop = find_bit(alloc->bitmap, start, want_end, true);
+            if (stop - start == count) {
+                *start_out = start;
+                return true;
+            }
+
+            if (first_len == 0 && stop - start >= min_len) {
+                first_start = start;
+                first_len = stop - start;
+            }
+            pos = stop + 1;
+        }
+    }
+
+    if (partial_len) {
+        *start_out = first_start;
+        *partial_len = first_len;
+    }
+    return false;
+}
+
+// 在组g内分配一段连续块,from为组内起始位(UINT32_MAX表示组的Next-Fit游标)。
+// partial_ok为false时只接受满max_len的区间
+static bool group_take(block_allocator_t *alloc, balloc_group_t *g, uint32_t from,
+                       uint32_t min_len, uint32_t max_len, bool partial_ok,
+                       uint32_t *start_out, uint32_t *len_out) {
+    // 不加锁先看计数,空间不够的组直接跳过
+    if (__atomic_load_n(&g->free, __ATOMIC_RELAXED) < (partial_ok ? min_len : max_len)) {
+        return false;
+    }
+
+    pthread_mutex_lock(&g->lock);
+
+    if (from < g->start || from >= g->start + g->len) {
+        from = g->cursor;
+    }
+
+    uint32_t start = 0;
+    uint32_t len = max_len;
+    bool found = find_free_run(alloc, g, from, min_len, max_len, &start,
+                               partial_ok ? &len : NULL) || (partial_ok && len > 0);
+    if (found) {
+        bitmap_set_range(alloc->bitmap, start, len);
+        mark_dirty(alloc, start, len);
+        __atomic_fetch_sub(&g->free, len, __ATOMIC_RELAXED);
+        g->cursor = (start + len == g->start + g->len) ? g->start : start + len;
+    }
+
+    pthread_mutex_unlock(&g->lock);
+
+    if (!found) {
+        return false;
+    }
+    __atomic_fetch_sub(&alloc->free_blocks, len, __ATOMIC_RELAXED);
+    *start_out = start;
+    *len_out = len;
+    return true;
+}
+
+// 从group组开始依次尝试各组,第一轮只要满max_len的区间,第二轮接受不短于min_len的区间
+// (只有一组时一轮扫描同时记下退路)。from只对第一个组有效。不更新分配计数
+static int take_run(block_allocator_t *alloc, uint32_t group, uint32_t from,
+                    uint32_t min_len, uint32_t max_len,
+                    uint32_t *start_out, uint32_t *len_out) {
+    if (__atomic_load_n(&alloc->free_blocks, __ATOMIC_RELAXED) < min_len) {
+        return -ENOSPC;
+    }
+
+    group = resolve_group(alloc, group);
+    int passes = (alloc->group_count == 1) ? 1 : 2;
+
+    for (int pass = 0; pass < passes; pass++) {
+        bool partial_ok = (pass == passes - 1);
+        for (uint32_t i = 0; i < alloc->group_count; i++) {
+            uint32_t g = (group + i) % alloc->group_count;
+            if (group_take(alloc, &alloc->groups[g], (i == 0) ? from : UINT32_MAX,
+                           min_len, max_len, partial_ok, start_out, len_out)) {
+                return 0;
+            }
+        }
+    }
+    return -ENOSPC;
+}
+
+// 按从小到大的顺序锁住覆盖[first, last]的组
+static void lock_groups(block_allocator_t *alloc, uint32_t first, uint32_t last) {
+    for (uint32_t g = first; g <= last; g++) {
+        pthread_mutex_lock(&alloc->groups[g].lock);
+    }
+}
+
+static void unlock_groups(block_allocator_t *alloc, uint32_t first, uint32_t last) {
+    for (uint32_t g = last + 1; g-- > first;) {
+        pthread_mutex_unlock(&alloc->groups[g].lock);
+    }
+}
+
+int block_alloc_set_groups(block_allocator_t *alloc, uint32_t group_blocks) {
+    if (!alloc || group_blocks % BITS_PER_WORD != 0) return -EINVAL;
+
+    if (group_blocks == 0 || group_blocks > alloc->total_blocks) {
+        group_blocks = alloc->total_blocks ? alloc->total_blocks : 1;
+    }
+    uint32_t count = (alloc->total_blocks + group_blocks - 1) / group_blocks;
+    if (count == 0) {
+        count = 1;
+    }
+
+    balloc_group_t *groups;
+    if (posix_memalign((void**)&groups, 64, count * sizeof(balloc_group_t)) != 0) {
+        return -ENOMEM;
+    }
+    memset(groups, 0, count * sizeof(balloc_group_t));
+
+    // 窗口中的块按旧的切分计过数,先还回去
+    block_alloc_release_reservations(alloc);
+
+    uint32_t free_blocks = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        balloc_group_t *g = &groups[i];
+        pthread_mutex_init(&g->lock, NULL);
+        g->start = i * group_blocks;
+        g->len = (alloc->total_blocks - g->start < group_blocks) ?
+                 alloc->total_blocks - g->start : group_blocks;
+        g->free = count_free_bits(alloc->bitmap, g->start, g->start + g->len);
+        g->cursor = g->start;
+        free_blocks += g->free;
+    }
+
+    if (alloc->groups) {
+        for (uint32_t i = 0; i < alloc->group_count; i++) {
+            pthread_mutex_destroy(&alloc->groups[i].lock);
+        }
+        free(alloc->groups);
+    }
+
+    alloc->groups = groups;
+    alloc->group_count = count;
+    alloc->group_blocks = group_blocks;
+    alloc->free_blocks = free_blocks;
+    return 0;
+}
+
+uint32_t block_alloc_group_of(block_allocator_t *alloc, block_t block) {
+    if (!alloc || block < alloc->data_start ||
+        block >= alloc->data_start + alloc->total_blocks) {
+        return BALLOC_NO_GROUP;
+    }
+    return group_index(alloc, block - alloc->data_start);
+}
+
 // ============ 块分配器初始化 ============
 
 block_allocator_t* block_alloc_init(
@@ -60,26 +370,41 @@ block_allocator_t* block_alloc_init(
         return NULL;
     }
 
+    // 每个位图块一个脏位
+    alloc->dirty = calloc(bitmap_blocks / BITS_PER_WORD + 1,
+                          sizeof(uint64_t));
+    if (!alloc->dirty) {
+        fprintf(stderr, "block_alloc_init: malloc dirty map failed\n");
+        free(alloc->bitmap);
+        free(alloc);
+        return NULL;
+    }
+
     // 从磁盘加载位图
     for (uint32_t i = 0; i < bitmap_blocks; i++) {
         int ret = blkdev_read(dev, bitmap_start + i, alloc->bitmap + i * BLOCK_SIZE);
         if (ret < 0) {
             fprintf(stderr, "block_alloc_init: blkdev_read failed for bitmap block %u\n", i);
+            free(alloc->dirty);
             free(alloc->bitmap);
             free(alloc);
             return NULL;
         }
     }
 
-    // 统计空闲块
-    alloc->free_blocks = 0;
-    for (uint32_t i = 0; i < total_blocks; i++) {
-        if (!bitmap_test(alloc->bitmap, i)) {
-            alloc->free_blocks++;
-        }
-    }
+    alloc->resv = NULL;
+    alloc->resv_blocks = 0;
 
-    pthread_mutex_init(&alloc->alloc_lock, NULL);
+    // 整个数据区一组,同时统计空闲块
+    alloc->groups = NULL;
+    alloc->group_count = 0;
+    if (block_alloc_set_groups(alloc, 0) != 0) {
+        fprintf(stderr, "block_alloc_init: malloc groups failed\n");
+        free(alloc->dirty);
+        free(alloc->bitmap);
+        free(alloc);
+        return NULL;
+    }
 
     alloc->alloc_count = 0;
     alloc->free_count = 0;
@@ -95,51 +420,181 @@ block_allocator_t* block_alloc_init(
 void block_alloc_destroy(block_allocator_t *alloc) {
     if (!alloc) return;
 
-    // 同步位图到磁盘
+    // 同步位图到磁盘(同时收回预留窗口)
     block_alloc_sync(alloc);
+    block_alloc_set_reservation(alloc, 0);
 
-    pthread_mutex_destroy(&alloc->alloc_lock);
+    for (uint32_t i = 0; i < alloc->group_count; i++) {
+        pthread_mutex_destroy(&alloc->groups[i].lock);
+    }
+    free(alloc->groups);
+    free(alloc->dirty);
     free(alloc->bitmap);
     free(alloc);
 
     printf("[BALLOC] Destroyed\n");
 }
 
-// ============ 分配单个块 ============
+// ============ 预留窗口 ============
 
-block_t block_alloc(block_allocator_t *alloc) {
-    if (!alloc) return 0;
+static balloc_resv_t* resv_slot(block_allocator_t *alloc) {
+    return &alloc->resv[thread_id() % BALLOC_RESV_SLOTS];
+}
 
-    pthread_mutex_lock(&alloc->alloc_lock);
+// 把窗口剩余的块还回所属的组,调用者持有窗口锁
+static void resv_return(block_allocator_t *alloc, balloc_resv_t *r) {
+    uint32_t len = r->end - r->next;
+    if (len > 0) {
+        balloc_group_t *g = &alloc->groups[group_index(alloc, r->next)];
+        pthread_mutex_lock(&g->lock);
+        for (uint32_t bit = r->next; bit < r->end; bit++) {
+            bitmap_clear(alloc->bitmap, bit);
+        }
+        mark_dirty(alloc, r->next, len);
+        __atomic_fetch_add(&g->free, len, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&g->lock);
+        __atomic_fetch_add(&alloc->free_blocks, len, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&alloc->alloc_count, r->alloc_count, __ATOMIC_RELAXED);
+    r->next = r->end = 0;
+    __atomic_store_n(&r->avail, 0, __ATOMIC_RELAXED);
+    r->alloc_count = 0;
+}
 
-    if (alloc->free_blocks == 0) {
-        fprintf(stderr, "block_alloc: no free blocks\n");
-        pthread_mutex_unlock(&alloc->alloc_lock);
+// 所有窗口中尚未分配的块数。不持有窗口锁,并发分配时只是近似值
+static uint32_t resv_unused(const block_allocator_t *alloc) {
+    uint32_t unused = 0;
+    for (uint32_t i = 0; alloc->resv && i < BALLOC_RESV_SLOTS; i++) {
+        unused += __atomic_load_n(&alloc->resv[i].avail, __ATOMIC_RELAXED);
+    }
+    return unused;
+}
+
+// 从当前线程的窗口分配一个块,窗口用完时从group组(或线程默认组)补充。
+// 窗口属于其他组或没有空闲块时返回0
+static block_t resv_alloc(block_allocator_t *alloc, uint32_t group) {
+    balloc_resv_t *r = resv_slot(alloc);
+
+    pthread_mutex_lock(&r->lock);
+
+    if (r->next != r->end && group != BALLOC_NO_GROUP &&
+        group_index(alloc, r->next) != group) {
+        pthread_mutex_unlock(&r->lock);
         return 0;
     }
 
-    // 线性搜索第一个空闲块
-    for (uint32_t i = 0; i < alloc->total_blocks; i++) {
-        if (!bitmap_test(alloc->bitmap, i)) {
-            // 找到空闲块
-            bitmap_set(alloc->bitmap, i);
-            alloc->free_blocks--;
-            alloc->alloc_count++;
+    if (r->next == r->end) {
+        __atomic_fetch_add(&alloc->alloc_count, r->alloc_count, __ATOMIC_RELAXED);
+        r->alloc_count = 0;
+
+        uint32_t start;
+        uint32_t len;
+        if (take_run(alloc, group, UINT32_MAX, 1, alloc->resv_blocks, &start, &len) < 0) {
+            pthread_mutex_unlock(&r->lock);
+            return 0;
+        }
+        r->next = start;
+        r->end = start + len;
+    }
+
+    uint32_t bit = r->next++;
+    __atomic_store_n(&r->avail, r->end - r->next, __ATOMIC_RELAXED);
+    r->alloc_count++;
+    pthread_mutex_unlock(&r->lock);
 
-            block_t block_num = alloc->data_start + i;
+    return alloc->data_start + bit;
+}
 
-            pthread_mutex_unlock(&alloc->alloc_lock);
-            return block_num;
+int block_alloc_set_reservation(block_allocator_t *alloc, uint32_t blocks) {
+    if (!alloc) return -EINVAL;
+
+    if (blocks == 0) {
+        if (alloc->resv) {
+            block_alloc_release_reservations(alloc);
+            for (uint32_t i = 0; i < BALLOC_RESV_SLOTS; i++) {
+                pthread_mutex_destroy(&alloc->resv[i].lock);
+            }
+            free(alloc->resv);
+            alloc->resv = NULL;
         }
+        alloc->resv_blocks = 0;
+        return 0;
     }
 
-    // 不应该到达这里
-    fprintf(stderr, "block_alloc: inconsistent state (free_blocks=%u but no free block found)\n",
-            alloc->free_blocks);
-    pthread_mutex_unlock(&alloc->alloc_lock);
+    if (!alloc->resv) {
+        balloc_resv_t *resv;
+        if (posix_memalign((void**)&resv, 64, BALLOC_RESV_SLOTS * sizeof(balloc_resv_t)) != 0) {
+            return -ENOMEM;
+        }
+        memset(resv, 0, BALLOC_RESV_SLOTS * sizeof(balloc_resv_t));
+        for (uint32_t i = 0; i < BALLOC_RESV_SLOTS; i++) {
+            pthread_mutex_init(&resv[i].lock, NULL);
+        }
+        alloc->resv = resv;
+    }
+    alloc->resv_blocks = blocks;
     return 0;
 }
 
+void block_alloc_release_reservations(block_allocator_t *alloc) {
+    if (!alloc || !alloc->resv) return;
+
+    for (uint32_t i = 0; i < BALLOC_RESV_SLOTS; i++) {
+        balloc_resv_t *r = &alloc->resv[i];
+        pthread_mutex_lock(&r->lock);
+        resv_return(alloc, r);
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+// ============ 分配公共路径 ============
+
+// 从group组的位from(UINT32_MAX表示组的Next-Fit游标处)开始分配一段长度在
+// [min_len, max_len]内的连续块,优先取满max_len的区间;空间不足时先收回预留窗口再试一次
+static int alloc_run(block_allocator_t *alloc, uint32_t group, uint32_t from,
+                     uint32_t min_len, uint32_t max_len,
+                     uint32_t *start_out, uint32_t *len_out) {
+    int ret = take_run(alloc, group, from, min_len, max_len, start_out, len_out);
+    if (ret == -ENOSPC && alloc->resv) {
+        block_alloc_release_reservations(alloc);
+        ret = take_run(alloc, group, from, min_len, max_len, start_out, len_out);
+    }
+    if (ret == 0) {
+        __atomic_fetch_add(&alloc->alloc_count, *len_out, __ATOMIC_RELAXED);
+    }
+    return ret;
+}
+
+// ============ 分配单个块 ============
+
+block_t block_alloc_in_group(block_allocator_t *alloc, uint32_t group) {
+    if (!alloc) return 0;
+
+    if (group >= alloc->group_count) {
+        group = BALLOC_NO_GROUP;
+    }
+
+    if (alloc->resv) {
+        block_t block = resv_alloc(alloc, group);
+        if (block) {
+            return block;
+        }
+    }
+
+    // Next-Fit: 从组内上次分配结束的位置开始找空闲块
+    uint32_t bit;
+    uint32_t len;
+    if (alloc_run(alloc, group, UINT32_MAX, 1, 1, &bit, &len) < 0) {
+        fprintf(stderr, "block_alloc: no free blocks\n");
+        return 0;
+    }
+    return alloc->data_start + bit;
+}
+
+block_t block_alloc(block_allocator_t *alloc) {
+    return block_alloc_in_group(alloc, BALLOC_NO_GROUP);
+}
+
 // ============ 释放单个块 ============
 
 int block_free(block_allocator_t *alloc, block_t block) {
@@ -153,26 +608,30 @@ int block_free(block_allocator_t *alloc, block_t block) {
     }
 
     uint32_t bit = block - alloc->data_start;
+    balloc_group_t *g = &alloc->groups[group_index(alloc, bit)];
 
-    pthread_mutex_lock(&alloc->alloc_lock);
+    pthread_mutex_lock(&g->lock);
 
     // 检查是否已分配
     if (!bitmap_test(alloc->bitmap, bit)) {
         fprintf(stderr, "block_free: double free detected for block %u\n", block);
-        pthread_mutex_unlock(&alloc->alloc_lock);
+        pthread_mutex_unlock(&g->lock);
         return -EINVAL;
     }
 
     // 释放块
     bitmap_clear(alloc->bitmap, bit);
-    alloc->free_blocks++;
-    alloc->free_count++;
+    mark_dirty(alloc, bit, 1);
+    __atomic_fetch_add(&g->free, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&g->lock);
 
-    pthread_mutex_unlock(&alloc->alloc_lock);
+    __atomic_fetch_add(&alloc->free_blocks, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&alloc->free_count, 1, __ATOMIC_RELAXED);
     return 0;
 }
 
-// ============ 分配多个连续块 ============
+// ============ 分配连续块 ============
 
 int block_alloc_multiple(
     block_allocator_t *alloc,
@@ -184,50 +643,86 @@ int block_alloc_multiple(
         return -EINVAL;
     }
 
-    pthread_mutex_lock(&alloc->alloc_lock);
-
-    if (alloc->free_blocks < count) {
-        fprintf(stderr, "block_alloc_multiple: not enough free blocks (requested=%u, free=%u)\n",
-                count, alloc->free_blocks);
-        pthread_mutex_unlock(&alloc->alloc_lock);
-        return -ENOSPC;
+    // Next-Fit: 从上次分配结束的位置开始找足够长的连续空闲块
+    uint32_t start;
+    uint32_t len;
+    int ret = alloc_run(alloc, BALLOC_NO_GROUP, UINT32_MAX, count, count, &start, &len);
+    if (ret < 0) {
+        fprintf(stderr, "block_alloc_multiple: no %u consecutive free blocks\n", count);
+        return ret;
     }
 
-    // First-Fit: 查找第一个满足条件的连续空闲块
-    uint32_t consecutive = 0;
-    uint32_t start = 0;
+    *out_start = alloc->data_start + start;
+    *out_count = len;
+    return 0;
+}
 
-    for (uint32_t i = 0; i < alloc->total_blocks; i++) {
-        if (!bitmap_test(alloc->bitmap, i)) {
-            if (consecutive == 0) {
-                start = i;
-            }
-            consecutive++;
+// ============ 就近分配连续块 ============
+
+int block_alloc_extent(
+    block_allocator_t *alloc,
+    block_t goal,
+    uint32_t min_len,
+    uint32_t max_len,
+    block_t *out_start,
+    uint32_t *out_len
+) {
+    if (!alloc || !out_start || !out_len || min_len == 0 || min_len > max_len) {
+        return -EINVAL;
+    }
 
-            if (consecutive >= count) {
-                // 找到足够的连续块
-                for (uint32_t j = start; j < start + count; j++) {
-                    bitmap_set(alloc->bitmap, j);
-                }
+    // 没有有效目标时从当前线程默认组的next-fit游标开始
+    uint32_t group = BALLOC_NO_GROUP;
+    uint32_t from = UINT32_MAX;
+    if (goal >= alloc->data_start && goal < alloc->data_start + alloc->total_blocks) {
+        from = goal - alloc->data_start;
+        group = group_index(alloc, from);
+    }
 
-                alloc->free_blocks -= count;
-                alloc->alloc_count += count;
+    uint32_t start;
+    uint32_t len;
+    int ret = alloc_run(alloc, group, from, min_len, max_len, &start, &len);
+    if (ret < 0) {
+        return ret;
+    }
 
-                *out_start = alloc->data_start + start;
-                *out_count = count;
+    *out_start = alloc->data_start + start;
+    *out_len = len;
+    return 0;
+}
 
-                pthread_mutex_unlock(&alloc->alloc_lock);
-                return 0;
-            }
-        } else {
-            consecutive = 0;
-        }
+int block_alloc_group_extent(
+    block_allocator_t *alloc,
+    uint32_t group,
+    uint32_t min_len,
+    uint32_t max_len,
+    block_t *out_start,
+    uint32_t *out_len
+) {
+    if (!alloc || !out_start || !out_len || min_len == 0 || min_len > max_len) {
+        return -EINVAL;
     }
 
-    // 没有找到足够的连续块
-    fprintf(stderr, "block_alloc_multiple: no %u consecutive free blocks\n", count);
-    pthread_mutex_unlock(&alloc->alloc_lock);
-    return -ENOSPC;
+    uint32_t start;
+    uint32_t len;
+    int ret = alloc_run(alloc, group, UINT32_MAX, min_len, max_len, &start, &len);
+    if (ret < 0) {
+        return ret;
+    }
+
+    *out_start = alloc->data_start + start;
+    *out_len = len;
+    return 0;
+}
+
+int block_alloc_near(
+    block_allocator_t *alloc,
+    block_t goal,
+    uint32_t count,
+    block_t *out_start,
+    uint32_t *out_count
+) {
+    return block_alloc_extent(alloc, goal, 1, count, out_start, out_count);
 }
 
 // ============ 释放多个连续块 ============
@@ -249,29 +744,39 @@ int block_free_multiple(
         return -EINVAL;
     }
 
-    pthread_mutex_lock(&alloc->alloc_lock);
-
     uint32_t bit_start = start - alloc->data_start;
+    uint32_t bit_end = bit_start + count;
+
+    // 相邻两次分配的区间可能被合并后一起释放,因此范围可以跨组
+    uint32_t first = group_index(alloc, bit_start);
+    uint32_t last = group_index(alloc, bit_end - 1);
+    lock_groups(alloc, first, last);
 
     // 检查所有块是否已分配
-    for (uint32_t i = 0; i < count; i++) {
-        if (!bitmap_test(alloc->bitmap, bit_start + i)) {
-            fprintf(stderr, "block_free_multiple: block %u is not allocated\n",
-                    start + i);
-            pthread_mutex_unlock(&alloc->alloc_lock);
-            return -EINVAL;
-        }
+    uint32_t hole = find_bit(alloc->bitmap, bit_start, bit_end, false);
+    if (hole < bit_end) {
+        fprintf(stderr, "block_free_multiple: block %u is not allocated\n",
+                alloc->data_start + hole);
+        unlock_groups(alloc, first, last);
+        return -EINVAL;
     }
 
     // 释放所有块
-    for (uint32_t i = 0; i < count; i++) {
-        bitmap_clear(alloc->bitmap, bit_start + i);
+    for (uint32_t i = bit_start; i < bit_end; i++) {
+        bitmap_clear(alloc->bitmap, i);
+    }
+    mark_dirty(alloc, bit_start, count);
+    for (uint32_t g = first; g <= last; g++) {
+        balloc_group_t *grp = &alloc->groups[g];
+        uint32_t lo = bit_start > grp->start ? bit_start : grp->start;
+        uint32_t hi = bit_end < grp->start + grp->len ? bit_end : grp->start + grp->len;
+        __atomic_fetch_add(&grp->free, hi - lo, __ATOMIC_RELAXED);
     }
 
-    alloc->free_blocks += count;
-    alloc->free_count += count;
+    unlock_groups(alloc, first, last);
 
-    pthread_mutex_unlock(&alloc->alloc_lock);
+    __atomic_fetch_add(&alloc->free_blocks, count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&alloc->free_count, count, __ATOMIC_RELAXED);
     return 0;
 }
 
@@ -285,10 +790,11 @@ bool block_is_allocated(block_allocator_t *alloc, block_t block) {
     }
 
     uint32_t bit = block - alloc->data_start;
+    balloc_group_t *g = &alloc->groups[group_index(alloc, bit)];
 
-    pthread_mutex_lock(&alloc->alloc_lock);
+    pthread_mutex_lock(&g->lock);
     bool allocated = bitmap_test(alloc->bitmap, bit);
-    pthread_mutex_unlock(&alloc->alloc_lock);
+    pthread_mutex_unlock(&g->lock);
 
     return allocated;
 }
@@ -298,22 +804,30 @@ bool block_is_allocated(block_allocator_t *alloc, block_t block) {
 int block_alloc_sync(block_allocator_t *alloc) {
     if (!alloc) return -EINVAL;
 
-    pthread_mutex_lock(&alloc->alloc_lock);
-
-    // 使用初始化时保存的位图起始块
-    uint32_t bitmap_start = alloc->bitmap_start;
-
-    // 写入所有位图块
-    for (uint32_t i = 0; i < alloc->bitmap_blocks; i++) {
-        int ret = blkdev_write(
-            alloc->dev,
-            bitmap_start + i,
-            alloc->bitmap + i * BLOCK_SIZE
-        );
-        if (ret < 0) {
-            fprintf(stderr, "block_alloc_sync: blkdev_write failed for bitmap block %u\n", i);
-            pthread_mutex_unlock(&alloc->alloc_lock);
-            return ret;
+    block_alloc_release_reservations(alloc);
+
+    lock_groups(alloc, 0, alloc->group_count - 1);
+
+    // 只写改动过的位图块
+    uint32_t written = 0;
+    uint32_t dirty_words = (alloc->bitmap_blocks + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    for (uint32_t w = 0; w < dirty_words; w++) {
+        uint64_t bits = __atomic_exchange_n(&alloc->dirty[w], 0, __ATOMIC_RELAXED);
+        while (bits) {
+            uint32_t i = w * BITS_PER_WORD + (uint32_t)__builtin_ctzll(bits);
+            bits &= bits - 1;
+
+            int ret = blkdev_write(alloc->dev, alloc->bitmap_start + i,
+                                   alloc->bitmap + (size_t)i * BLOCK_SIZE);
+            if (ret < 0) {
+                fprintf(stderr, "block_alloc_sync: blkdev_write failed for bitmap block %u\n", i);
+                // 没写成功的块留到下次同步
+                __atomic_fetch_or(&alloc->dirty[w], bits | (1ULL << (i % BITS_PER_WORD)),
+                                  __ATOMIC_RELAXED);
+                unlock_groups(alloc, 0, alloc->group_count - 1);
+                return ret;
+            }
+            written++;
         }
     }
 
@@ -323,10 +837,10 @@ int block_alloc_sync(block_allocator_t *alloc) {
         // inode统计由inode_cache管理，这里不更新
     }
 
-    pthread_mutex_unlock(&alloc->alloc_lock);
+    unlock_groups(alloc, 0, alloc->group_count - 1);
 
-    printf("[BALLOC] Synced bitmap to disk (blocks %u-%u)\n",
-           bitmap_start, bitmap_start + alloc->bitmap_blocks - 1);
+    printf("[BALLOC] Synced bitmap to disk (%u of %u blocks)\n",
+           written, alloc->bitmap_blocks);
     return 0;
 }
 
@@ -341,14 +855,42 @@ void block_alloc_stats(
 ) {
     if (!alloc) return;
 
-    pthread_mutex_lock(&alloc->alloc_lock);
+    // 预留窗口中还没分配出去的块仍算空闲
+    uint32_t free_blocks = __atomic_load_n(&alloc->free_blocks, __ATOMIC_RELAXED) +
+                           resv_unused(alloc);
 
     if (total) *total = alloc->total_blocks;
-    if (free) *free = alloc->free_blocks;
-    if (used) *used = alloc->total_blocks - alloc->free_blocks;
+    if (free) *free = free_blocks;
+    if (used) *used = alloc->total_blocks - free_blocks;
     if (usage) {
-        *usage = (float)(alloc->total_blocks - alloc->free_blocks) / alloc->total_blocks;
+        *usage = (float)(alloc->total_blocks - free_blocks) / alloc->total_blocks;
     }
+}
+
+float block_alloc_fragmentation(block_allocator_t *alloc) {
+    if (!alloc) return 0.0f;
 
-    pthread_mutex_unlock(&alloc->alloc_lock);
+    lock_groups(alloc, 0, alloc->group_count - 1);
+
+    // 统计连续空闲区间数量
+    uint32_t fragments = 0;
+    uint32_t pos = 0;
+    while (pos < alloc->total_blocks) {
+        uint32_t start = find_bit(alloc->bitmap, pos, alloc->total_blocks, false);
+        if (start >= alloc->total_blocks) {
+            break;
+        }
+        fragments++;
+        pos = find_bit(alloc->bitmap, start, alloc->total_blocks, true);
+    }
+
+    uint32_t total = alloc->total_blocks;
+    unlock_groups(alloc, 0, alloc->group_count - 1);
+
+    // 所有空闲块连续(或没有空闲块)时没有碎片
+    if (fragments <= 1) {
+        return 0.0f;
+    }
+    float ratio = (float)(fragments - 1) / total;
+    return ratio < 1.0f ? ratio : 1.0f;
 }
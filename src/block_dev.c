@@ -9,10 +9,15 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 // ============ 块设备打开 ============
 
 block_device_t* blkdev_open(const char *path) {
+    return blkdev_open_ex(path, IO_ENGINE_SYNC);
+}
+
+block_device_t* blkdev_open_ex(const char *path, io_engine_type_t engine) {
     if (!path) {
         fprintf(stderr, "blkdev_open: path is NULL\n");
         return NULL;
@@ -47,7 +52,7 @@ block_device_t* blkdev_open(const char *path) {
     dev->superblock = NULL;
 
     // 初始化缓存(默认1024个缓冲区)
-    dev->cache = buffer_cache_init(1024);
+    dev->cache = buffer_cache_init(1024, CACHE_DEFAULT_SHARDS, fd);
     if (!dev->cache) {
         fprintf(stderr, "blkdev_open: buffer_cache_init failed\n");
         close(fd);
@@ -55,8 +60,20 @@ block_device_t* blkdev_open(const char *path) {
         return NULL;
     }
 
-    printf("[BLKDEV] Opened device: %s (size=%lu MB, blocks=%lu)\n",
-           path, dev->total_size / 1024 / 1024, dev->total_blocks);
+    // 初始化I/O引擎,缓存刷写也经由它批量提交
+    dev->io = io_engine_create(fd, engine, IO_ENGINE_DEFAULT_DEPTH);
+    if (!dev->io) {
+        fprintf(stderr, "blkdev_open: io_engine_create failed\n");
+        buffer_cache_destroy(dev->cache);
+        close(fd);
+        free(dev);
+        return NULL;
+    }
+    dev->cache->io = dev->io;
+
+    printf("[BLKDEV] Opened device: %s (size=%lu MB, blocks=%lu, io=%s)\n",
+           path, dev->total_size / 1024 / 1024, dev->total_blocks,
+           io_engine_name(io_engine_type(dev->io)));
 
     return dev;
 }
@@ -74,6 +91,9 @@ void blkdev_close(block_device_t *dev) {
         buffer_cache_destroy(dev->cache);
     }
 
+    // 销毁I/O引擎
+    io_engine_destroy(dev->io);
+
     // 释放超级块
     if (dev->superblock) {
         free(dev->superblock);
@@ -151,8 +171,9 @@ int blkdev_read(block_device_t *dev, block_t block, void *buf) {
         return -EIO;
     }
 
-    // 3. 加入缓存
-    buffer_cache_insert(dev->cache, block, buf);
+    // 3. 加入缓存(插入会持有一个引用,必须释放,否则该块永远无法被淘汰)
+    bh = buffer_cache_insert(dev->cache, block, buf);
+    buffer_head_put(bh);
 
     return 0;
 }
@@ -176,9 +197,11 @@ int blkdev_write(block_device_t *dev, block_t block, const void *buf) {
         // 缓存命中,更新缓存
         pthread_rwlock_wrlock(&bh->lock);
         memcpy(bh->data, buf, BLOCK_SIZE);
+        bh->valid = true;
         buffer_head_mark_dirty(bh);
         pthread_rwlock_unlock(&bh->lock);
         buffer_head_put(bh);
+        buffer_cache_balance_dirty(dev->cache);
         return 0;
     }
 
@@ -187,10 +210,11 @@ int blkdev_write(block_device_t *dev, block_t block, const void *buf) {
     if (bh) {
         buffer_head_mark_dirty(bh);
         buffer_head_put(bh);
+        buffer_cache_balance_dirty(dev->cache);
         return 0;
     }
 
-    // 3. 缓存满了,直接写入磁盘
+    // 3. 所有缓冲区都被引用,无法淘汰,直接写入磁盘
     off_t offset = (off_t)block * BLOCK_SIZE;
     ssize_t n = pwrite(dev->fd, buf, BLOCK_SIZE, offset);
     if (n != BLOCK_SIZE) {
@@ -205,6 +229,354 @@ int blkdev_write(block_device_t *dev, block_t block, const void *buf) {
     return 0;
 }
 
+// ============ 批量读取 ============
+
+int blkdev_read_blocks(block_device_t *dev, const block_t *blocks, uint32_t count, void *buf) {
+    if (!dev || !blocks || (!buf && count > 0)) {
+        return -EINVAL;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (blocks[i] >= dev->total_blocks) {
+            fprintf(stderr, "blkdev_read_blocks: block %u out of range (max=%lu)\n",
+                    blocks[i], dev->total_blocks);
+            return -EINVAL;
+        }
+    }
+
+    io_request_t reqs[CACHE_SYNC_BATCH];
+    uint8_t *out = buf;
+
+    for (uint32_t start = 0; start < count; start += CACHE_SYNC_BATCH) {
+        uint32_t end = start + CACHE_SYNC_BATCH < count ? start + CACHE_SYNC_BATCH : count;
+        uint32_t n = 0;
+
+        // 1. 命中的块直接拷贝,未命中的块加入批次
+        for (uint32_t i = start; i < end; i++) {
+            uint8_t *dst = out + (size_t)i * BLOCK_SIZE;
+            buffer_head_t *bh = buffer_cache_lookup(dev->cache, blocks[i]);
+            if (bh) {
+                pthread_rwlock_rdlock(&bh->lock);
+                bool valid = bh->valid;
+                if (valid) {
+                    memcpy(dst, bh->data, BLOCK_SIZE);
+                }
+                pthread_rwlock_unlock(&bh->lock);
+                buffer_head_put(bh);
+                if (valid) {
+                    continue;
+                }
+            }
+
+            reqs[n++] = (io_request_t){
+                .op = IO_OP_READ,
+                .block = blocks[i],
+                .buf = dst,
+                .len = BLOCK_SIZE,
+            };
+        }
+
+        // 2. 一次提交所有未命中的块
+        int ret = io_engine_submit(dev->io, reqs, n);
+        if (ret < 0) {
+            fprintf(stderr, "blkdev_read_blocks: batch read failed (%d)\n", ret);
+            return -EIO;
+        }
+
+        // 3. 加入缓存;读盘期间若该块已被其他线程填充,以缓存中的数据为准
+        for (uint32_t i = 0; i < n; i++) {
+            buffer_head_t *bh = buffer_cache_getblk(dev->cache, reqs[i].block);
+            if (!bh) {
+                continue;
+            }
+
+            pthread_rwlock_wrlock(&bh->lock);
+            if (bh->valid) {
+                memcpy(reqs[i].buf, bh->data, BLOCK_SIZE);
+            } else {
+                memcpy(bh->data, reqs[i].buf, BLOCK_SIZE);
+                bh->valid = true;
+            }
+            pthread_rwlock_unlock(&bh->lock);
+            buffer_head_put(bh);
+        }
+    }
+
+    return 0;
+}
+
+// ============ 连续块区间读写 ============
+
+// 在iovec描述的区间缓冲区与平坦缓冲区之间拷贝,off为区间内字节偏移
+static void iov_copy(const struct iovec *iov, int iovcnt, size_t off,
+                     uint8_t *flat, size_t len, bool to_iov) {
+    for (int i = 0; i < iovcnt && len > 0; i++) {
+        if (off >= iov[i].iov_len) {
+            off -= iov[i].iov_len;
+            continue;
+        }
+
+        size_t n = iov[i].iov_len - off;
+        if (n > len) {
+            n = len;
+        }
+
+        uint8_t *p = (uint8_t *)iov[i].iov_base + off;
+        if (to_iov) {
+            memcpy(p, flat, n);
+        } else {
+            memcpy(flat, p, n);
+        }
+
+        flat += n;
+        len -= n;
+        off = 0;
+    }
+}
+
+// 校验区间参数,返回块数,非法时返回0
+static uint32_t range_blocks(block_device_t *dev, block_t start,
+                             const struct iovec *iov, int iovcnt, const char *who) {
+    if (!dev || !iov || iovcnt <= 0 || iovcnt > BLKDEV_RANGE_MAX_IOV) {
+        return 0;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+
+    if (total == 0 || total % BLOCK_SIZE != 0) {
+        fprintf(stderr, "%s: length %zu is not a multiple of block size\n", who, total);
+        return 0;
+    }
+
+    uint64_t count = total / BLOCK_SIZE;
+    if ((uint64_t)start + count > dev->total_blocks) {
+        fprintf(stderr, "%s: blocks %u+%lu out of range (max=%lu)\n",
+                who, start, count, dev->total_blocks);
+        return 0;
+    }
+
+    return (uint32_t)count;
+}
+
+// preadv/pwritev直到传输完整个区间
+static int rw_range(int fd, bool write, const struct iovec *iov, int iovcnt, off_t offset) {
+    struct iovec local[BLKDEV_RANGE_MAX_IOV];
+    memcpy(local, iov, iovcnt * sizeof(struct iovec));
+
+    struct iovec *cur = local;
+    while (iovcnt > 0) {
+        ssize_t n = write ? pwritev(fd, cur, iovcnt, offset)
+                          : preadv(fd, cur, iovcnt, offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (n == 0) {
+            return -EIO;
+        }
+
+        // 跳过已完成的部分
+        offset += n;
+        while (iovcnt > 0 && (size_t)n >= cur->iov_len) {
+            n -= cur->iov_len;
+            cur++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            cur->iov_base = (uint8_t *)cur->iov_base + n;
+            cur->iov_len -= n;
+        }
+    }
+
+    return 0;
+}
+
+int blkdev_read_range(block_device_t *dev, block_t start,
+                      const struct iovec *iov, int iovcnt) {
+    uint32_t count = range_blocks(dev, start, iov, iovcnt, "blkdev_read_range");
+    if (count == 0) {
+        return -EINVAL;
+    }
+
+    // 先钉住已缓存的块,保证读盘期间它们不会被写回后淘汰
+    buffer_head_t *stack_pinned[BLKDEV_RANGE_PIN_BLOCKS];
+    buffer_head_t **pinned = stack_pinned;
+    if (count > BLKDEV_RANGE_PIN_BLOCKS) {
+        pinned = malloc(count * sizeof(buffer_head_t *));
+        if (!pinned) {
+            return -ENOMEM;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        pinned[i] = buffer_cache_lookup(dev->cache, start + i);
+    }
+
+    int ret = rw_range(dev->fd, false, iov, iovcnt, (off_t)start * BLOCK_SIZE);
+    if (ret < 0) {
+        fprintf(stderr, "blkdev_read_range: preadv failed for blocks %u+%u: %s\n",
+                start, count, strerror(-ret));
+    }
+
+    // 缓存中的块可能比磁盘新(脏块),以缓存为准
+    for (uint32_t i = 0; i < count; i++) {
+        buffer_head_t *bh = pinned[i];
+        if (!bh) {
+            continue;
+        }
+
+        if (ret == 0) {
+            pthread_rwlock_rdlock(&bh->lock);
+            if (bh->valid) {
+                iov_copy(iov, iovcnt, (size_t)i * BLOCK_SIZE, bh->data, BLOCK_SIZE, true);
+            }
+            pthread_rwlock_unlock(&bh->lock);
+        }
+        buffer_head_put(bh);
+    }
+
+    if (pinned != stack_pinned) {
+        free(pinned);
+    }
+
+    return ret < 0 ? -EIO : 0;
+}
+
+int blkdev_write_range(block_device_t *dev, block_t start,
+                       const struct iovec *iov, int iovcnt) {
+    uint32_t count = range_blocks(dev, start, iov, iovcnt, "blkdev_write_range");
+    if (count == 0) {
+        return -EINVAL;
+    }
+
+    // 先更新已缓存的副本:之后无论缓存何时写回,写出的都是新数据
+    for (uint32_t i = 0; i < count; i++) {
+        buffer_head_t *bh = buffer_cache_lookup(dev->cache, start + i);
+        if (!bh) {
+            continue;
+        }
+
+        pthread_rwlock_wrlock(&bh->lock);
+        iov_copy(iov, iovcnt, (size_t)i * BLOCK_SIZE, bh->data, BLOCK_SIZE, false);
+        bh->valid = true;
+        pthread_rwlock_unlock(&bh->lock);
+        buffer_head_put(bh);
+    }
+
+    int ret = rw_range(dev->fd, true, iov, iovcnt, (off_t)start * BLOCK_SIZE);
+    if (ret < 0) {
+        fprintf(stderr, "blkdev_write_range: pwritev failed for blocks %u+%u: %s\n",
+                start, count, strerror(-ret));
+        return -EIO;
+    }
+
+    return 0;
+}
+
+// ============ 零拷贝块访问 ============
+
+buffer_head_t* blkdev_get_block(block_device_t *dev, block_t block) {
+    if (!dev) {
+        return NULL;
+    }
+
+    if (block >= dev->total_blocks) {
+        fprintf(stderr, "blkdev_get_block: block %u out of range (max=%lu)\n",
+                block, dev->total_blocks);
+        return NULL;
+    }
+
+    buffer_head_t *bh = buffer_cache_getblk(dev->cache, block);
+    if (!bh) {
+        fprintf(stderr, "blkdev_get_block: no free buffer for block %u\n", block);
+        return NULL;
+    }
+
+    pthread_rwlock_rdlock(&bh->lock);
+    bool valid = bh->valid;
+    pthread_rwlock_unlock(&bh->lock);
+
+    if (valid) {
+        return bh;
+    }
+
+    // 新分配或已失效的缓冲区,直接读入bh->data
+    pthread_rwlock_wrlock(&bh->lock);
+    if (!bh->valid) {
+        off_t offset = (off_t)block * BLOCK_SIZE;
+        ssize_t n = pread(dev->fd, bh->data, BLOCK_SIZE, offset);
+        if (n != BLOCK_SIZE) {
+            pthread_rwlock_unlock(&bh->lock);
+            buffer_head_put(bh);
+            if (n < 0) {
+                perror("blkdev_get_block: pread failed");
+            } else {
+                fprintf(stderr, "blkdev_get_block: short read (%zd bytes)\n", n);
+            }
+            return NULL;
+        }
+        bh->valid = true;
+    }
+    pthread_rwlock_unlock(&bh->lock);
+
+    return bh;
+}
+
+buffer_head_t* blkdev_get_new_block(block_device_t *dev, block_t block) {
+    if (!dev) {
+        return NULL;
+    }
+
+    if (block >= dev->total_blocks) {
+        fprintf(stderr, "blkdev_get_new_block: block %u out of range (max=%lu)\n",
+                block, dev->total_blocks);
+        return NULL;
+    }
+
+    buffer_head_t *bh = buffer_cache_getblk(dev->cache, block);
+    if (!bh) {
+        fprintf(stderr, "blkdev_get_new_block: no free buffer for block %u\n", block);
+        return NULL;
+    }
+
+    pthread_rwlock_wrlock(&bh->lock);
+    memset(bh->data, 0, BLOCK_SIZE);
+    bh->valid = true;
+    pthread_rwlock_unlock(&bh->lock);
+
+    return bh;
+}
+
+void blkdev_release_block(block_device_t *dev, buffer_head_t *bh, bool dirty) {
+    if (!bh) return;
+
+    if (dirty) {
+        buffer_head_mark_dirty(bh);
+    }
+    buffer_head_put(bh);
+
+    if (dirty && dev) {
+        buffer_cache_balance_dirty(dev->cache);
+    }
+}
+
+// ============ 线程私有暂存块 ============
+
+static __thread uint8_t scratch_blocks[BLKDEV_SCRATCH_SLOTS][BLOCK_SIZE]
+    __attribute__((aligned(64)));
+
+uint8_t* blkdev_scratch(uint32_t slot) {
+    if (slot >= BLKDEV_SCRATCH_SLOTS) {
+        return NULL;
+    }
+    return scratch_blocks[slot];
+}
+
 // ============ 同步脏块 ============
 
 int blkdev_sync(block_device_t *dev) {
@@ -4,6 +4,27 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+
+// ============ 时钟 ============
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// pthread_cond_timedwait使用的绝对超时时刻
+static void deadline_after(struct timespec *ts, uint32_t ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
 
 // ============ 哈希函数 ============
 
@@ -11,55 +32,116 @@ static inline uint32_t hash_block(block_t block, uint32_t hash_size) {
     return block % hash_size;
 }
 
-// ============ LRU链表操作 ============
+// ============ 链表操作 ============
 
-// 从LRU链表中移除节点
-static void lru_remove(buffer_cache_t *cache, buffer_head_t *bh) {
+// 从链表中移除节点
+static void list_remove(bh_list_t *list, buffer_head_t *bh) {
     if (bh->prev) {
         bh->prev->next = bh->next;
     } else {
-        cache->lru_head = bh->next;
+        list->head = bh->next;
     }
 
     if (bh->next) {
         bh->next->prev = bh->prev;
     } else {
-        cache->lru_tail = bh->prev;
+        list->tail = bh->prev;
     }
 
     bh->prev = bh->next = NULL;
+    list->count--;
 }
 
-// 将节点添加到LRU链表头部(最近使用)
-static void lru_add_to_head(buffer_cache_t *cache, buffer_head_t *bh) {
-    bh->next = cache->lru_head;
+// 将节点添加到链表头部(最近使用)
+static void list_add_to_head(bh_list_t *list, buffer_head_t *bh) {
+    bh->next = list->head;
     bh->prev = NULL;
 
-    if (cache->lru_head) {
-        cache->lru_head->prev = bh;
+    if (list->head) {
+        list->head->prev = bh;
     } else {
-        cache->lru_tail = bh;
+        list->tail = bh;
     }
 
-    cache->lru_head = bh;
+    list->head = bh;
+    list->count++;
+}
+
+static inline bh_list_t* queue_of(buffer_cache_shard_t *shard, buffer_head_t *bh) {
+    return bh->queue == BH_QUEUE_AM ? &shard->am : &shard->a1in;
 }
 
-// 将节点移动到LRU链表头部
-static void lru_move_to_head(buffer_cache_t *cache, buffer_head_t *bh) {
-    if (cache->lru_head == bh) {
-        return; // 已经在头部
+// 命中时更新位置: Am中移到头部; A1in是FIFO,短期内的重复访问不改变位置
+static void queue_touch(buffer_cache_shard_t *shard, buffer_head_t *bh) {
+    if (bh->queue != BH_QUEUE_AM || shard->am.head == bh) {
+        return;
     }
 
-    lru_remove(cache, bh);
-    lru_add_to_head(cache, bh);
+    list_remove(&shard->am, bh);
+    list_add_to_head(&shard->am, bh);
+}
+
+// ============ A1out幽灵队列 ============
+
+static int32_t* ghost_bucket(buffer_cache_shard_t *shard, block_t block) {
+    return &shard->ghost_hash[hash_block(block, shard->hash_size)];
+}
+
+// 从幽灵哈希链中摘除槽位
+static void ghost_unlink(buffer_cache_shard_t *shard, uint32_t slot) {
+    int32_t *pp = ghost_bucket(shard, shard->ghost_blocks[slot]);
+
+    while (*pp >= 0) {
+        if ((uint32_t)*pp == slot) {
+            *pp = shard->ghost_next[slot];
+            shard->ghost_next[slot] = -1;
+            return;
+        }
+        pp = &shard->ghost_next[*pp];
+    }
+}
+
+// 查找并移除幽灵记录,返回是否命中
+static bool ghost_take(buffer_cache_shard_t *shard, block_t block) {
+    int32_t *pp = ghost_bucket(shard, block);
+
+    while (*pp >= 0) {
+        uint32_t slot = *pp;
+        if (shard->ghost_blocks[slot] == block) {
+            *pp = shard->ghost_next[slot];
+            shard->ghost_next[slot] = -1;
+            shard->ghost_blocks[slot] = INVALID_BLOCK;
+            return true;
+        }
+        pp = &shard->ghost_next[slot];
+    }
+
+    return false;
+}
+
+// 记录从A1in淘汰的块号,环形队列满时覆盖最老的记录
+static void ghost_push(buffer_cache_shard_t *shard, block_t block) {
+    uint32_t slot = shard->ghost_head;
+    if (shard->ghost_blocks[slot] != INVALID_BLOCK) {
+        ghost_unlink(shard, slot);
+    } else if (shard->ghost_count < shard->ghost_size) {
+        shard->ghost_count++;
+    }
+
+    int32_t *bucket = ghost_bucket(shard, block);
+    shard->ghost_blocks[slot] = block;
+    shard->ghost_next[slot] = *bucket;
+    *bucket = slot;
+
+    shard->ghost_head = (slot + 1) % shard->ghost_size;
 }
 
 // ============ 哈希表操作 ============
 
 // 从哈希表中查找
-static buffer_head_t* hash_lookup(buffer_cache_t *cache, block_t block) {
-    uint32_t hash = hash_block(block, cache->hash_size);
-    buffer_head_t *bh = cache->hash_table[hash];
+static buffer_head_t* hash_lookup(buffer_cache_shard_t *shard, block_t block) {
+    uint32_t hash = hash_block(block, shard->hash_size);
+    buffer_head_t *bh = shard->hash_table[hash];
 
     while (bh) {
         if (bh->block_num == block) {
@@ -72,16 +154,16 @@ static buffer_head_t* hash_lookup(buffer_cache_t *cache, block_t block) {
 }
 
 // 添加到哈希表
-static void hash_insert(buffer_cache_t *cache, buffer_head_t *bh) {
-    uint32_t hash = hash_block(bh->block_num, cache->hash_size);
-    bh->hash_next = cache->hash_table[hash];
-    cache->hash_table[hash] = bh;
+static void hash_insert(buffer_cache_shard_t *shard, buffer_head_t *bh) {
+    uint32_t hash = hash_block(bh->block_num, shard->hash_size);
+    bh->hash_next = shard->hash_table[hash];
+    shard->hash_table[hash] = bh;
 }
 
 // 从哈希表中移除
-static void hash_remove(buffer_cache_t *cache, buffer_head_t *bh) {
-    uint32_t hash = hash_block(bh->block_num, cache->hash_size);
-    buffer_head_t **ptr = &cache->hash_table[hash];
+static void hash_remove(buffer_cache_shard_t *shard, buffer_head_t *bh) {
+    uint32_t hash = hash_block(bh->block_num, shard->hash_size);
+    buffer_head_t **ptr = &shard->hash_table[hash];
 
     while (*ptr) {
         if (*ptr == bh) {
@@ -93,108 +175,362 @@ static void hash_remove(buffer_cache_t *cache, buffer_head_t *bh) {
     }
 }
 
+static inline buffer_cache_shard_t* shard_of(buffer_cache_t *cache, block_t block) {
+    return &cache->shards[block % cache->num_shards];
+}
+
 // ============ 缓冲区头操作 ============
 
-static buffer_head_t* buffer_head_alloc(block_t block) {
-    buffer_head_t *bh = malloc(sizeof(buffer_head_t));
+// 从分片的空闲链表取一个缓冲区头,数据页随缓冲区头复用,内容未初始化
+static buffer_head_t* buffer_head_alloc(buffer_cache_t *cache, block_t block) {
+    buffer_cache_shard_t *shard = shard_of(cache, block);
+    buffer_head_t *bh = shard->free_list;
     if (!bh) {
         return NULL;
     }
-
-    // 使用posix_memalign替代aligned_alloc,更可靠
-    if (posix_memalign((void**)&bh->data, BLOCK_SIZE, BLOCK_SIZE) != 0) {
-        free(bh);
-        return NULL;
-    }
+    shard->free_list = bh->next;
 
     bh->block_num = block;
     bh->dirty = false;
     bh->valid = false;
     bh->ref_count = 1;
+    bh->queue = BH_QUEUE_A1IN;
+    bh->dirty_time = 0;
     bh->next = bh->prev = bh->hash_next = NULL;
-
-    pthread_rwlock_init(&bh->lock, NULL);
+    bh->dirty_next = bh->dirty_prev = NULL;
 
     return bh;
 }
 
-static void buffer_head_free(buffer_head_t *bh) {
+// 归还到分片的空闲链表(调用者持有分片锁)
+static void buffer_head_free(buffer_cache_shard_t *shard, buffer_head_t *bh) {
     if (!bh) return;
 
-    pthread_rwlock_destroy(&bh->lock);
-    free(bh->data);
-    free(bh);
+    bh->next = shard->free_list;
+    shard->free_list = bh;
+}
+
+// ============ 脏链表 ============
+//
+// dirty标志只在持有分片dirty_lock时修改,无锁路径只做原子读取
+
+static void dirty_list_append(buffer_cache_shard_t *shard, buffer_head_t *bh) {
+    bh->dirty_next = NULL;
+    bh->dirty_prev = shard->dirty_tail;
+
+    if (shard->dirty_tail) {
+        shard->dirty_tail->dirty_next = bh;
+    } else {
+        shard->dirty_head = bh;
+    }
+    shard->dirty_tail = bh;
+}
+
+static void dirty_list_remove(buffer_cache_shard_t *shard, buffer_head_t *bh) {
+    if (bh->dirty_prev) {
+        bh->dirty_prev->dirty_next = bh->dirty_next;
+    } else {
+        shard->dirty_head = bh->dirty_next;
+    }
+
+    if (bh->dirty_next) {
+        bh->dirty_next->dirty_prev = bh->dirty_prev;
+    } else {
+        shard->dirty_tail = bh->dirty_prev;
+    }
+
+    bh->dirty_next = bh->dirty_prev = NULL;
+}
+
+// 清除脏标志,移出脏链表并维护脏块计数
+static void buffer_head_clear_dirty(buffer_head_t *bh) {
+    if (!__atomic_load_n(&bh->dirty, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    buffer_cache_shard_t *shard = shard_of(bh->cache, bh->block_num);
+    pthread_mutex_lock(&shard->dirty_lock);
+    if (bh->dirty) {
+        dirty_list_remove(shard, bh);
+        __atomic_store_n(&bh->dirty, false, __ATOMIC_RELEASE);
+        __atomic_fetch_sub(&bh->cache->dirty_count, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&shard->dirty_lock);
 }
 
 // ============ 淘汰策略 ============
 
-// 注意: 此函数当前未使用，但保留用于未来可能的显式淘汰需求
-__attribute__((unused))
-static int evict_lru_buffer(buffer_cache_t *cache, int dev_fd) {
-    // 从尾部开始查找可淘汰的缓冲区(引用计数为0)
-    buffer_head_t *bh = cache->lru_tail;
+// 从队列尾部查找引用计数为0的缓冲区
+static buffer_head_t* find_victim(bh_list_t *list) {
+    buffer_head_t *bh = list->tail;
 
-    while (bh) {
-        if (bh->ref_count == 0) {
-            // 如果是脏块,先写回
-            if (bh->dirty) {
-                off_t offset = (off_t)bh->block_num * BLOCK_SIZE;
-                ssize_t n = pwrite(dev_fd, bh->data, BLOCK_SIZE, offset);
-                if (n != BLOCK_SIZE) {
-                    fprintf(stderr, "evict_lru_buffer: pwrite failed\n");
-                    return -EIO;
-                }
-            }
+    while (bh && __atomic_load_n(&bh->ref_count, __ATOMIC_ACQUIRE) > 0) {
+        bh = bh->prev;
+    }
 
-            // 从LRU链表和哈希表中移除
-            lru_remove(cache, bh);
-            hash_remove(cache, bh);
+    return bh;
+}
 
-            // 释放缓冲区
-            buffer_head_free(bh);
+// 按2Q策略淘汰一个缓冲区(调用者持有分片锁)
+// A1in超过目标大小时优先淘汰A1in,否则淘汰Am的LRU尾部
+static int evict_buffer(buffer_cache_shard_t *shard, int dev_fd) {
+    buffer_head_t *bh = NULL;
 
-            cache->current_buffers--;
-            cache->evict_count++;
+    if (shard->a1in.count > shard->a1in_target) {
+        bh = find_victim(&shard->a1in);
+    }
+    if (!bh) {
+        bh = find_victim(&shard->am);
+    }
+    if (!bh) {
+        bh = find_victim(&shard->a1in);
+    }
 
-            return 0;
+    if (!bh) {
+        // 所有缓冲区都在使用中
+        return -ENOMEM;
+    }
+
+    // 如果是脏块,先写回
+    if (bh->dirty) {
+        off_t offset = (off_t)bh->block_num * BLOCK_SIZE;
+        ssize_t n = pwrite(dev_fd, bh->data, BLOCK_SIZE, offset);
+        if (n != BLOCK_SIZE) {
+            fprintf(stderr, "evict_buffer: pwrite failed for block %u\n",
+                    bh->block_num);
+            return -EIO;
         }
-        bh = bh->prev;
+        buffer_head_clear_dirty(bh);
+        shard->writeback_count++;
+    }
+
+    // 从A1in淘汰的块记入幽灵队列,再次访问时直接进入Am
+    if (bh->queue == BH_QUEUE_A1IN) {
+        ghost_push(shard, bh->block_num);
     }
 
-    // 所有缓冲区都在使用中
-    fprintf(stderr, "evict_lru_buffer: all buffers in use\n");
-    return -ENOMEM;
+    // 从队列和哈希表中移除
+    list_remove(queue_of(shard, bh), bh);
+    hash_remove(shard, bh);
+
+    // 归还缓冲区
+    buffer_head_free(shard, bh);
+
+    shard->current_buffers--;
+    shard->evict_count++;
+
+    return 0;
+}
+
+// ============ 分片管理 ============
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static int shard_init(buffer_cache_t *cache, buffer_cache_shard_t *shard,
+                      uint32_t max_buffers, uint32_t num_shards,
+                      buffer_head_t *pool, uint8_t *pages) {
+    memset(shard, 0, sizeof(*shard));
+
+    // 同一分片内的块号模num_shards同余,哈希表大小与num_shards互素才能用满所有桶
+    shard->hash_size = max_buffers * 2 + 1;
+    while (gcd_u32(shard->hash_size, num_shards) != 1) {
+        shard->hash_size++;
+    }
+
+    shard->hash_table = calloc(shard->hash_size, sizeof(buffer_head_t*));
+    if (!shard->hash_table) {
+        return -ENOMEM;
+    }
+
+    // A1out幽灵队列
+    shard->ghost_size = max_buffers / CACHE_A1OUT_RATIO;
+    if (shard->ghost_size == 0) {
+        shard->ghost_size = 1;
+    }
+    shard->ghost_blocks = malloc(shard->ghost_size * sizeof(block_t));
+    shard->ghost_next = malloc(shard->ghost_size * sizeof(int32_t));
+    shard->ghost_hash = malloc(shard->hash_size * sizeof(int32_t));
+    if (!shard->ghost_blocks || !shard->ghost_next || !shard->ghost_hash) {
+        free(shard->ghost_blocks);
+        free(shard->ghost_next);
+        free(shard->ghost_hash);
+        free(shard->hash_table);
+        return -ENOMEM;
+    }
+    for (uint32_t i = 0; i < shard->ghost_size; i++) {
+        shard->ghost_blocks[i] = INVALID_BLOCK;
+        shard->ghost_next[i] = -1;
+    }
+    for (uint32_t i = 0; i < shard->hash_size; i++) {
+        shard->ghost_hash[i] = -1;
+    }
+
+    shard->max_buffers = max_buffers;
+    shard->a1in_target = max_buffers / CACHE_A1IN_RATIO;
+
+    pthread_mutex_init(&shard->lock, NULL);
+    pthread_mutex_init(&shard->dirty_lock, NULL);
+
+    // 缓冲区头与数据页一一绑定,逆序入栈使低地址先被使用
+    shard->pool = pool;
+    for (uint32_t i = max_buffers; i-- > 0; ) {
+        buffer_head_t *bh = &pool[i];
+        memset(bh, 0, sizeof(*bh));
+        bh->data = pages + (size_t)i * BLOCK_SIZE;
+        bh->cache = cache;
+        pthread_rwlock_init(&bh->lock, NULL);
+        buffer_head_free(shard, bh);
+    }
+
+    return 0;
+}
+
+static void shard_destroy(buffer_cache_shard_t *shard) {
+    for (uint32_t i = 0; i < shard->max_buffers; i++) {
+        pthread_rwlock_destroy(&shard->pool[i].lock);
+    }
+
+    free(shard->ghost_blocks);
+    free(shard->ghost_next);
+    free(shard->ghost_hash);
+    free(shard->hash_table);
+    pthread_mutex_destroy(&shard->lock);
+    pthread_mutex_destroy(&shard->dirty_lock);
+}
+
+// ============ 缓冲区池 ============
+
+static struct writeback_ctx* writeback_ctx_alloc(uint32_t max_buffers);
+static void writeback_ctx_free(struct writeback_ctx *wb);
+
+// 分配所有数据页: 开启MODERNFS_CACHE_HUGE_PAGES时先尝试显式大页,
+// 失败(未预留大页)则退回普通页并建议内核使用透明大页
+static int page_pool_alloc(buffer_cache_t *cache, uint32_t max_buffers) {
+    size_t size = (size_t)max_buffers * BLOCK_SIZE;
+    void *pages = MAP_FAILED;
+
+    cache->huge_pages = false;
+    cache->page_pool = NULL;
+    cache->page_pool_size = 0;
+    if (size == 0) {
+        return 0;
+    }
+
+#if defined(MODERNFS_CACHE_HUGE_PAGES) && defined(MAP_HUGETLB)
+    size_t huge_size = (size + CACHE_HUGE_PAGE_SIZE - 1) & ~((size_t)CACHE_HUGE_PAGE_SIZE - 1);
+    pages = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (pages != MAP_FAILED) {
+        size = huge_size;
+        cache->huge_pages = true;
+    }
+#endif
+
+    if (pages == MAP_FAILED) {
+        pages = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pages == MAP_FAILED) {
+            return -ENOMEM;
+        }
+#if defined(MODERNFS_CACHE_HUGE_PAGES) && defined(MADV_HUGEPAGE)
+        madvise(pages, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    cache->page_pool = pages;
+    cache->page_pool_size = size;
+    return 0;
+}
+
+static void page_pool_free(buffer_cache_t *cache) {
+    if (cache->page_pool) {
+        munmap(cache->page_pool, cache->page_pool_size);
+        cache->page_pool = NULL;
+    }
 }
 
 // ============ 缓存API实现 ============
 
-buffer_cache_t* buffer_cache_init(uint32_t max_buffers) {
+buffer_cache_t* buffer_cache_init(uint32_t max_buffers, uint32_t num_shards, int dev_fd) {
+    if (num_shards == 0) {
+        num_shards = CACHE_DEFAULT_SHARDS;
+    }
+    if (num_shards > max_buffers) {
+        num_shards = max_buffers > 0 ? max_buffers : 1;
+    }
+
     buffer_cache_t *cache = malloc(sizeof(buffer_cache_t));
     if (!cache) {
         return NULL;
     }
 
-    // 哈希表大小为最大缓冲区数的2倍(减少冲突)
-    cache->hash_size = max_buffers * 2;
-    cache->hash_table = calloc(cache->hash_size, sizeof(buffer_head_t*));
-    if (!cache->hash_table) {
+    if (posix_memalign((void**)&cache->shards, 64,
+                       num_shards * sizeof(buffer_cache_shard_t)) != 0) {
         free(cache);
         return NULL;
     }
 
-    cache->lru_head = NULL;
-    cache->lru_tail = NULL;
-    cache->max_buffers = max_buffers;
-    cache->current_buffers = 0;
-
-    pthread_mutex_init(&cache->cache_lock, NULL);
+    // 缓冲区头、数据页和写回用的数组都在这里一次性分配,运行期间不再分配内存
+    cache->bh_pool = calloc(max_buffers > 0 ? max_buffers : 1, sizeof(buffer_head_t));
+    cache->writeback = writeback_ctx_alloc(max_buffers);
+    if (!cache->bh_pool || !cache->writeback || page_pool_alloc(cache, max_buffers) < 0) {
+        fprintf(stderr, "buffer_cache_init: failed to allocate buffer pool\n");
+        writeback_ctx_free(cache->writeback);
+        free(cache->bh_pool);
+        free(cache->shards);
+        free(cache);
+        return NULL;
+    }
 
-    cache->hit_count = 0;
-    cache->miss_count = 0;
-    cache->evict_count = 0;
+    // 容量平均分给各分片,余数分给前几个分片
+    uint32_t pool_offset = 0;
+    for (uint32_t i = 0; i < num_shards; i++) {
+        uint32_t shard_max = max_buffers / num_shards +
+                             (i < max_buffers % num_shards ? 1 : 0);
+        if (shard_init(cache, &cache->shards[i], shard_max, num_shards,
+                       cache->bh_pool + pool_offset,
+                       cache->page_pool + (size_t)pool_offset * BLOCK_SIZE) < 0) {
+            for (uint32_t j = 0; j < i; j++) {
+                shard_destroy(&cache->shards[j]);
+            }
+            page_pool_free(cache);
+            writeback_ctx_free(cache->writeback);
+            free(cache->bh_pool);
+            free(cache->shards);
+            free(cache);
+            return NULL;
+        }
+        pool_offset += shard_max;
+    }
 
-    printf("[CACHE] Initialized: max_buffers=%u, hash_size=%u\n",
-           max_buffers, cache->hash_size);
+    cache->num_shards = num_shards;
+    cache->max_buffers = max_buffers;
+    cache->dev_fd = dev_fd;
+    cache->io = NULL;
+
+    cache->dirty_count = 0;
+    cache->flusher_running = false;
+    cache->flusher_rounds = 0;
+    cache->flusher_writebacks = 0;
+    cache->flush_blocks = 0;
+    cache->flush_requests = 0;
+    cache->dirty_expire_ms = CACHE_DIRTY_EXPIRE_MS;
+    cache->flush_interval_ms = CACHE_FLUSH_INTERVAL_MS;
+    pthread_mutex_init(&cache->flusher_lock, NULL);
+    pthread_cond_init(&cache->flusher_wake, NULL);
+    pthread_cond_init(&cache->flusher_done, NULL);
+    pthread_mutex_init(&cache->writeback_lock, NULL);
+
+    printf("[CACHE] Initialized: max_buffers=%u, shards=%u, policy=2Q (a1in=%u, a1out=%u per shard), pages=%s\n",
+           max_buffers, num_shards, cache->shards[0].a1in_target,
+           cache->shards[0].ghost_size, cache->huge_pages ? "huge" : "4K");
 
     return cache;
 }
@@ -202,16 +538,20 @@ buffer_cache_t* buffer_cache_init(uint32_t max_buffers) {
 void buffer_cache_destroy(buffer_cache_t *cache) {
     if (!cache) return;
 
-    // 释放所有缓冲区
-    buffer_head_t *bh = cache->lru_head;
-    while (bh) {
-        buffer_head_t *next = bh->next;
-        buffer_head_free(bh);
-        bh = next;
+    buffer_cache_stop_flusher(cache);
+    pthread_mutex_destroy(&cache->flusher_lock);
+    pthread_cond_destroy(&cache->flusher_wake);
+    pthread_cond_destroy(&cache->flusher_done);
+    pthread_mutex_destroy(&cache->writeback_lock);
+
+    for (uint32_t i = 0; i < cache->num_shards; i++) {
+        shard_destroy(&cache->shards[i]);
     }
 
-    free(cache->hash_table);
-    pthread_mutex_destroy(&cache->cache_lock);
+    page_pool_free(cache);
+    writeback_ctx_free(cache->writeback);
+    free(cache->bh_pool);
+    free(cache->shards);
     free(cache);
 
     printf("[CACHE] Destroyed\n");
@@ -220,23 +560,24 @@ void buffer_cache_destroy(buffer_cache_t *cache) {
 buffer_head_t* buffer_cache_lookup(buffer_cache_t *cache, block_t block) {
     if (!cache) return NULL;
 
-    pthread_mutex_lock(&cache->cache_lock);
+    buffer_cache_shard_t *shard = shard_of(cache, block);
+    pthread_mutex_lock(&shard->lock);
 
-    buffer_head_t *bh = hash_lookup(cache, block);
+    buffer_head_t *bh = hash_lookup(shard, block);
 
     if (bh) {
         // 缓存命中
-        bh->ref_count++;
-        lru_move_to_head(cache, bh);
-        cache->hit_count++;
+        __sync_fetch_and_add(&bh->ref_count, 1);
+        queue_touch(shard, bh);
+        shard->hit_count++;
 
-        pthread_mutex_unlock(&cache->cache_lock);
+        pthread_mutex_unlock(&shard->lock);
         return bh;
     }
 
     // 缓存未命中
-    cache->miss_count++;
-    pthread_mutex_unlock(&cache->cache_lock);
+    shard->miss_count++;
+    pthread_mutex_unlock(&shard->lock);
 
     return NULL;
 }
@@ -244,10 +585,11 @@ buffer_head_t* buffer_cache_lookup(buffer_cache_t *cache, block_t block) {
 buffer_head_t* buffer_cache_insert(buffer_cache_t *cache, block_t block, const void *data) {
     if (!cache || !data) return NULL;
 
-    pthread_mutex_lock(&cache->cache_lock);
+    buffer_cache_shard_t *shard = shard_of(cache, block);
+    pthread_mutex_lock(&shard->lock);
 
     // 检查是否已存在
-    buffer_head_t *bh = hash_lookup(cache, block);
+    buffer_head_t *bh = hash_lookup(shard, block);
     if (bh) {
         // 已存在,更新数据
         pthread_rwlock_wrlock(&bh->lock);
@@ -255,38 +597,88 @@ buffer_head_t* buffer_cache_insert(buffer_cache_t *cache, block_t block, const v
         bh->valid = true;
         pthread_rwlock_unlock(&bh->lock);
 
-        bh->ref_count++;
-        lru_move_to_head(cache, bh);
+        __sync_fetch_and_add(&bh->ref_count, 1);
+        queue_touch(shard, bh);
 
-        pthread_mutex_unlock(&cache->cache_lock);
+        pthread_mutex_unlock(&shard->lock);
         return bh;
     }
 
     // 检查是否需要淘汰
-    if (cache->current_buffers >= cache->max_buffers) {
-        // 假设dev_fd不可用,只能放弃插入
-        // 注意:这里需要传入dev_fd,暂时返回NULL
-        pthread_mutex_unlock(&cache->cache_lock);
-        return NULL;
+    if (shard->current_buffers >= shard->max_buffers) {
+        if (evict_buffer(shard, cache->dev_fd) < 0) {
+            pthread_mutex_unlock(&shard->lock);
+            return NULL;
+        }
     }
 
     // 分配新缓冲区
-    bh = buffer_head_alloc(block);
+    bh = buffer_head_alloc(cache, block);
     if (!bh) {
-        pthread_mutex_unlock(&cache->cache_lock);
+        pthread_mutex_unlock(&shard->lock);
         return NULL;
     }
 
     memcpy(bh->data, data, BLOCK_SIZE);
     bh->valid = true;
 
-    // 加入哈希表和LRU链表
-    hash_insert(cache, bh);
-    lru_add_to_head(cache, bh);
+    // 最近从A1in淘汰过的块说明有复用,直接进入Am;否则先进入A1in
+    if (ghost_take(shard, block)) {
+        bh->queue = BH_QUEUE_AM;
+    }
 
-    cache->current_buffers++;
+    // 加入哈希表和队列
+    hash_insert(shard, bh);
+    list_add_to_head(queue_of(shard, bh), bh);
 
-    pthread_mutex_unlock(&cache->cache_lock);
+    shard->current_buffers++;
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return bh;
+}
+
+buffer_head_t* buffer_cache_getblk(buffer_cache_t *cache, block_t block) {
+    if (!cache) return NULL;
+
+    buffer_cache_shard_t *shard = shard_of(cache, block);
+    pthread_mutex_lock(&shard->lock);
+
+    buffer_head_t *bh = hash_lookup(shard, block);
+    if (bh) {
+        __sync_fetch_and_add(&bh->ref_count, 1);
+        queue_touch(shard, bh);
+        shard->hit_count++;
+
+        pthread_mutex_unlock(&shard->lock);
+        return bh;
+    }
+
+    shard->miss_count++;
+
+    if (shard->current_buffers >= shard->max_buffers) {
+        if (evict_buffer(shard, cache->dev_fd) < 0) {
+            pthread_mutex_unlock(&shard->lock);
+            return NULL;
+        }
+    }
+
+    bh = buffer_head_alloc(cache, block);
+    if (!bh) {
+        pthread_mutex_unlock(&shard->lock);
+        return NULL;
+    }
+
+    if (ghost_take(shard, block)) {
+        bh->queue = BH_QUEUE_AM;
+    }
+
+    hash_insert(shard, bh);
+    list_add_to_head(queue_of(shard, bh), bh);
+
+    shard->current_buffers++;
+
+    pthread_mutex_unlock(&shard->lock);
 
     return bh;
 }
@@ -303,41 +695,224 @@ void buffer_head_put(buffer_head_t *bh) {
 
 void buffer_head_mark_dirty(buffer_head_t *bh) {
     if (!bh) return;
-    bh->dirty = true;
+
+    // 只在干净->脏的转换时记录时间并加入脏链表,重复标记不会推迟写回
+    if (__atomic_load_n(&bh->dirty, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    buffer_cache_shard_t *shard = shard_of(bh->cache, bh->block_num);
+    pthread_mutex_lock(&shard->dirty_lock);
+    if (!bh->dirty) {
+        // 在锁内取时间,脏链表保持按变脏时间有序
+        __atomic_store_n(&bh->dirty_time, now_ms(), __ATOMIC_RELAXED);
+        dirty_list_append(shard, bh);
+        __atomic_store_n(&bh->dirty, true, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&bh->cache->dirty_count, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&shard->dirty_lock);
 }
 
-int buffer_cache_sync(buffer_cache_t *cache, int dev_fd) {
-    if (!cache) return -EINVAL;
+// ============ 脏块写回 ============
+//
+// 1. 持分片锁收集在cutoff之前变脏的块并增加引用计数(防止被淘汰)
+// 2. 释放所有分片锁,按块号排序
+// 3. 逐块加读锁,块号相邻的块合并为一个pwritev请求,攒够一批后提交给I/O引擎
+
+typedef struct writeback_ctx {
+    buffer_cache_t *cache;
+    int dev_fd;
+    buffer_head_t **blocks;         // 已排序的脏块,跳过的块置NULL
+    struct iovec *iov;              // 每个已加锁的块占一项
+    uint32_t iov_used;
+    io_request_t reqs[CACHE_SYNC_BATCH];
+    uint32_t nreq;
+    uint32_t batch_start;           // 本批第一个块在blocks中的下标
+    int written;
+    int error;
+} writeback_ctx_t;
+
+static writeback_ctx_t* writeback_ctx_alloc(uint32_t max_buffers) {
+    writeback_ctx_t *wb = calloc(1, sizeof(*wb));
+    if (!wb) {
+        return NULL;
+    }
 
-    pthread_mutex_lock(&cache->cache_lock);
+    size_t n = max_buffers > 0 ? max_buffers : 1;
+    wb->blocks = malloc(n * sizeof(*wb->blocks));
+    wb->iov = malloc(n * sizeof(*wb->iov));
+    if (!wb->blocks || !wb->iov) {
+        writeback_ctx_free(wb);
+        return NULL;
+    }
 
-    buffer_head_t *bh = cache->lru_head;
-    int synced = 0;
+    return wb;
+}
 
-    while (bh) {
-        if (bh->dirty) {
-            pthread_rwlock_rdlock(&bh->lock);
+static void writeback_ctx_free(writeback_ctx_t *wb) {
+    if (!wb) return;
+
+    free(wb->blocks);
+    free(wb->iov);
+    free(wb);
+}
+
+static int compare_block_num(const void *a, const void *b) {
+    block_t x = (*(buffer_head_t * const *)a)->block_num;
+    block_t y = (*(buffer_head_t * const *)b)->block_num;
+    return (x > y) - (x < y);
+}
 
-            off_t offset = (off_t)bh->block_num * BLOCK_SIZE;
-            ssize_t n = pwrite(dev_fd, bh->data, BLOCK_SIZE, offset);
+// 收集并钉住在cutoff之前变脏的块,返回块数
+static uint32_t collect_dirty(buffer_cache_t *cache, buffer_head_t **out,
+                              uint32_t cap, uint64_t cutoff) {
+    uint32_t n = 0;
 
-            pthread_rwlock_unlock(&bh->lock);
+    for (uint32_t i = 0; i < cache->num_shards && n < cap; i++) {
+        buffer_cache_shard_t *shard = &cache->shards[i];
 
-            if (n != BLOCK_SIZE) {
-                fprintf(stderr, "buffer_cache_sync: pwrite failed for block %u\n",
+        // 分片锁排除淘汰,dirty_lock保护链表
+        pthread_mutex_lock(&shard->lock);
+        pthread_mutex_lock(&shard->dirty_lock);
+        for (buffer_head_t *bh = shard->dirty_head; bh && n < cap; bh = bh->dirty_next) {
+            if (bh->dirty_time > cutoff) {
+                break;              // 链表按变脏时间有序
+            }
+            __sync_fetch_and_add(&bh->ref_count, 1);
+            out[n++] = bh;
+        }
+        pthread_mutex_unlock(&shard->dirty_lock);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return n;
+}
+
+// 提交当前批次,释放本批所有块的读锁和引用
+static void writeback_submit(writeback_ctx_t *wb, uint32_t end) {
+    if (wb->nreq == 0) {
+        return;
+    }
+
+    buffer_cache_t *cache = wb->cache;
+    int ret = cache->io ? io_engine_submit(cache->io, wb->reqs, wb->nreq)
+                        : io_submit_sync(wb->dev_fd, wb->reqs, wb->nreq);
+    if (ret < 0 && wb->error == 0) {
+        wb->error = ret;
+    }
+
+    // 请求按顺序覆盖本批中未被跳过的块
+    uint32_t idx = wb->batch_start;
+    for (uint32_t r = 0; r < wb->nreq; r++) {
+        io_request_t *req = &wb->reqs[r];
+        for (int k = 0; k < req->iovcnt; k++) {
+            while (!wb->blocks[idx]) {
+                idx++;
+            }
+            buffer_head_t *bh = wb->blocks[idx++];
+
+            // 持有读锁时清除脏标志,期间的修改需要写锁,不会丢失
+            if (req->result == 0) {
+                buffer_head_clear_dirty(bh);
+                wb->written++;
+            } else {
+                fprintf(stderr, "buffer_cache_sync: write failed for block %u\n",
                         bh->block_num);
-                pthread_mutex_unlock(&cache->cache_lock);
-                return -EIO;
             }
+            pthread_rwlock_unlock(&bh->lock);
+            buffer_head_put(bh);
+        }
+    }
+
+    __atomic_fetch_add(&cache->flush_requests, wb->nreq, __ATOMIC_RELAXED);
+
+    wb->nreq = 0;
+    wb->iov_used = 0;
+    wb->batch_start = end;
+}
+
+// 把已加读锁的块加入批次: 与上一个请求的末尾相邻时合并,否则新开一个请求
+static void writeback_add(writeback_ctx_t *wb, buffer_head_t *bh, uint32_t idx) {
+    io_request_t *last = wb->nreq > 0 ? &wb->reqs[wb->nreq - 1] : NULL;
+
+    if (!last || last->block + (block_t)last->iovcnt != bh->block_num ||
+        last->iovcnt >= CACHE_FLUSH_MAX_RUN) {
+        if (wb->nreq == CACHE_SYNC_BATCH) {
+            writeback_submit(wb, idx);
+        }
+        last = &wb->reqs[wb->nreq++];
+        *last = (io_request_t){
+            .op = IO_OP_WRITE,
+            .block = bh->block_num,
+            .iov = &wb->iov[wb->iov_used],
+        };
+    }
+
+    wb->iov[wb->iov_used++] = (struct iovec){ .iov_base = bh->data, .iov_len = BLOCK_SIZE };
+    last->iovcnt++;
+    last->len += BLOCK_SIZE;
+}
+
+// 写回在cutoff之前变脏的块,返回写回块数或负数错误码
+// wait为false时跳过正被其他线程持有写锁的缓冲区(后台写回不等待前台)
+static int cache_writeback(buffer_cache_t *cache, int dev_fd, uint64_t cutoff, bool wait) {
+    // 写回上下文预先分配,同一时刻只有一个写回在进行
+    pthread_mutex_lock(&cache->writeback_lock);
+
+    writeback_ctx_t *wb = cache->writeback;
+    buffer_head_t **blocks = wb->blocks;
+
+    uint32_t n = collect_dirty(cache, blocks, cache->max_buffers, cutoff);
+    qsort(blocks, n, sizeof(*blocks), compare_block_num);
+
+    wb->cache = cache;
+    wb->dev_fd = dev_fd;
+    wb->iov_used = 0;
+    wb->nreq = 0;
+    wb->batch_start = 0;
+    wb->written = 0;
+    wb->error = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        buffer_head_t *bh = blocks[i];
+
+        if (pthread_rwlock_tryrdlock(&bh->lock) != 0) {
+            if (!wait) {
+                buffer_head_put(bh);
+                blocks[i] = NULL;
+                continue;
+            }
+            // 阻塞等锁前先提交本批、释放已持有的读锁,避免与持有写锁的线程互相等待
+            writeback_submit(wb, i);
+            pthread_rwlock_rdlock(&bh->lock);
+        }
 
-            bh->dirty = false;
-            synced++;
+        // 可能已被并发的写回写出
+        if (!bh->dirty) {
+            pthread_rwlock_unlock(&bh->lock);
+            buffer_head_put(bh);
+            blocks[i] = NULL;
+            continue;
         }
 
-        bh = bh->next;
+        writeback_add(wb, bh, i);
     }
+    writeback_submit(wb, n);
+
+    int ret = wb->error < 0 ? -EIO : wb->written;
+    __atomic_fetch_add(&cache->flush_blocks, wb->written, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&cache->writeback_lock);
+    return ret;
+}
 
-    pthread_mutex_unlock(&cache->cache_lock);
+int buffer_cache_sync(buffer_cache_t *cache, int dev_fd) {
+    if (!cache) return -EINVAL;
+
+    int synced = cache_writeback(cache, dev_fd, UINT64_MAX, true);
+    if (synced < 0) {
+        return synced;
+    }
 
     if (synced > 0) {
         printf("[CACHE] Synced %d dirty buffers\n", synced);
@@ -346,39 +921,211 @@ int buffer_cache_sync(buffer_cache_t *cache, int dev_fd) {
     return 0;
 }
 
+// ============ 后台写回线程 ============
+
+static inline uint32_t dirty_threshold(buffer_cache_t *cache, uint32_t ratio) {
+    return (uint32_t)((uint64_t)cache->max_buffers * ratio / 100);
+}
+
+static inline bool over_background(buffer_cache_t *cache) {
+    return buffer_cache_dirty_count(cache) > dirty_threshold(cache, CACHE_DIRTY_BG_RATIO);
+}
+
+// 执行一轮写回: 脏块过多时全部写回,否则只写回过期的脏块
+static int flusher_round(buffer_cache_t *cache) {
+    uint64_t cutoff = UINT64_MAX;
+    if (!over_background(cache)) {
+        uint64_t now = now_ms();
+        if (now < cache->dirty_expire_ms) {
+            return 0;
+        }
+        cutoff = now - cache->dirty_expire_ms;
+    }
+
+    int written = cache_writeback(cache, cache->dev_fd, cutoff, false);
+    if (written < 0) {
+        fprintf(stderr, "[CACHE] Background writeback failed\n");
+        return 0;
+    }
+
+    return written;
+}
+
+static void* flusher_thread_func(void *arg) {
+    buffer_cache_t *cache = (buffer_cache_t *)arg;
+    bool busy = false;
+
+    pthread_mutex_lock(&cache->flusher_lock);
+
+    while (cache->flusher_running) {
+        // 上一轮有进展且脏块仍然过多时不等待,立即开始下一轮
+        if (!busy) {
+            struct timespec ts;
+            deadline_after(&ts, cache->flush_interval_ms);
+            pthread_cond_timedwait(&cache->flusher_wake, &cache->flusher_lock, &ts);
+            if (!cache->flusher_running) {
+                break;
+            }
+        }
+
+        pthread_mutex_unlock(&cache->flusher_lock);
+        int written = flusher_round(cache);
+        busy = written > 0 && over_background(cache);
+        pthread_mutex_lock(&cache->flusher_lock);
+
+        cache->flusher_rounds++;
+        cache->flusher_writebacks += written;
+        pthread_cond_broadcast(&cache->flusher_done);
+    }
+
+    pthread_mutex_unlock(&cache->flusher_lock);
+    return NULL;
+}
+
+int buffer_cache_start_flusher(buffer_cache_t *cache) {
+    if (!cache) return -EINVAL;
+
+    pthread_mutex_lock(&cache->flusher_lock);
+    if (cache->flusher_running) {
+        pthread_mutex_unlock(&cache->flusher_lock);
+        return 0;
+    }
+
+    cache->flusher_running = true;
+    int ret = pthread_create(&cache->flusher_thread, NULL, flusher_thread_func, cache);
+    if (ret != 0) {
+        cache->flusher_running = false;
+        pthread_mutex_unlock(&cache->flusher_lock);
+        fprintf(stderr, "buffer_cache_start_flusher: pthread_create failed\n");
+        return -ret;
+    }
+    pthread_mutex_unlock(&cache->flusher_lock);
+
+    printf("[CACHE] Flusher started: expire=%ums, interval=%ums, ratio=%u%%/%u%%\n",
+           cache->dirty_expire_ms, cache->flush_interval_ms,
+           CACHE_DIRTY_BG_RATIO, CACHE_DIRTY_RATIO);
+
+    return 0;
+}
+
+void buffer_cache_stop_flusher(buffer_cache_t *cache) {
+    if (!cache) return;
+
+    pthread_mutex_lock(&cache->flusher_lock);
+    if (!cache->flusher_running) {
+        pthread_mutex_unlock(&cache->flusher_lock);
+        return;
+    }
+
+    cache->flusher_running = false;
+    pthread_cond_signal(&cache->flusher_wake);
+    pthread_cond_broadcast(&cache->flusher_done);
+    pthread_mutex_unlock(&cache->flusher_lock);
+
+    pthread_join(cache->flusher_thread, NULL);
+
+    printf("[CACHE] Flusher stopped: %lu blocks written back in %lu rounds\n",
+           cache->flusher_writebacks, cache->flusher_rounds);
+}
+
+void buffer_cache_balance_dirty(buffer_cache_t *cache) {
+    if (!cache || !over_background(cache)) return;
+
+    pthread_mutex_lock(&cache->flusher_lock);
+    if (!cache->flusher_running) {
+        pthread_mutex_unlock(&cache->flusher_lock);
+        return;
+    }
+
+    pthread_cond_signal(&cache->flusher_wake);
+
+    // 超过硬阈值: 等写回线程完成一轮再返回,最多等待一个写回周期
+    uint32_t hard = dirty_threshold(cache, CACHE_DIRTY_RATIO);
+    uint64_t round = cache->flusher_rounds;
+    struct timespec ts;
+    deadline_after(&ts, cache->flush_interval_ms);
+
+    while (cache->flusher_running && cache->flusher_rounds == round &&
+           buffer_cache_dirty_count(cache) > hard) {
+        if (pthread_cond_timedwait(&cache->flusher_done, &cache->flusher_lock, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->flusher_lock);
+}
+
+uint32_t buffer_cache_dirty_count(buffer_cache_t *cache) {
+    if (!cache) return 0;
+    return __atomic_load_n(&cache->dirty_count, __ATOMIC_RELAXED);
+}
+
 void buffer_cache_stats(buffer_cache_t *cache, uint64_t *hits, uint64_t *misses,
                         uint64_t *evicts, float *hit_rate) {
     if (!cache) return;
 
-    pthread_mutex_lock(&cache->cache_lock);
+    uint64_t hit_count = 0, miss_count = 0, evict_count = 0;
 
-    if (hits) *hits = cache->hit_count;
-    if (misses) *misses = cache->miss_count;
-    if (evicts) *evicts = cache->evict_count;
+    for (uint32_t i = 0; i < cache->num_shards; i++) {
+        buffer_cache_shard_t *shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        hit_count += shard->hit_count;
+        miss_count += shard->miss_count;
+        evict_count += shard->evict_count;
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    if (hits) *hits = hit_count;
+    if (misses) *misses = miss_count;
+    if (evicts) *evicts = evict_count;
 
     if (hit_rate) {
-        uint64_t total = cache->hit_count + cache->miss_count;
-        *hit_rate = (total > 0) ? ((float)cache->hit_count / total) : 0.0f;
+        uint64_t total = hit_count + miss_count;
+        *hit_rate = (total > 0) ? ((float)hit_count / total) : 0.0f;
     }
+}
+
+void buffer_cache_usage(buffer_cache_t *cache, uint32_t *buffers, uint64_t *writebacks) {
+    if (!cache) return;
 
-    pthread_mutex_unlock(&cache->cache_lock);
+    uint32_t buffer_count = 0;
+    uint64_t writeback_count = 0;
+
+    for (uint32_t i = 0; i < cache->num_shards; i++) {
+        buffer_cache_shard_t *shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->lock);
+        buffer_count += shard->current_buffers;
+        writeback_count += shard->writeback_count;
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    if (buffers) *buffers = buffer_count;
+    if (writebacks) *writebacks = writeback_count;
+}
+
+void buffer_cache_flush_stats(buffer_cache_t *cache, uint64_t *blocks, uint64_t *requests) {
+    if (!cache) return;
+
+    if (blocks) *blocks = __atomic_load_n(&cache->flush_blocks, __ATOMIC_RELAXED);
+    if (requests) *requests = __atomic_load_n(&cache->flush_requests, __ATOMIC_RELAXED);
 }
 
 void buffer_cache_invalidate(buffer_cache_t *cache, block_t block) {
     if (!cache) return;
 
-    pthread_mutex_lock(&cache->cache_lock);
+    buffer_cache_shard_t *shard = shard_of(cache, block);
+    pthread_mutex_lock(&shard->lock);
 
-    buffer_head_t *bh = hash_lookup(cache, block);
+    buffer_head_t *bh = hash_lookup(shard, block);
     if (bh) {
         // 找到了该块,将其标记为无效
         pthread_rwlock_wrlock(&bh->lock);
         bh->valid = false;
-        bh->dirty = false;  // 清除脏标志,因为数据已经过期
+        buffer_head_clear_dirty(bh);  // 清除脏标志,因为数据已经过期
         pthread_rwlock_unlock(&bh->lock);
 
         fprintf(stderr, "[CACHE] Invalidated block %u\n", block);
     }
 
-    pthread_mutex_unlock(&cache->cache_lock);
-}
\ No newline at end of file
+    pthread_mutex_unlock(&shard->lock);
+}
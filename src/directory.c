@@ -1,4 +1,5 @@
 #include "modernfs/directory.h"
+#include <stddef.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
@@ -37,6 +38,120 @@ int dir_make_entry(inode_t inum,
     return MODERNFS_SUCCESS;
 }
 
+// 目录中一段连续的目录项: 一个数据块,或内联目录的Inode映射区
+typedef struct dir_chunk {
+    inode_t_mem *dir;
+    buffer_head_t *bh;              // 数据块(内联目录为NULL)
+    uint8_t *data;                  // 目录项起始地址,空洞为NULL
+    uint32_t len;                   // 有效字节数
+    uint32_t cap;                   // 目录项不能越过的边界
+} dir_chunk_t;
+
+// 取得目录第offset字节所在的一段目录项，直接在缓存块或Inode上解析
+// 空洞块返回成功且chunk->data为NULL
+static int dir_get_chunk(inode_cache_t *cache,
+                         inode_t_mem *dir,
+                         uint64_t offset,
+                         dir_chunk_t *chunk) {
+    uint64_t remaining = dir->disk.size - offset;
+
+    chunk->dir = dir;
+    chunk->bh = NULL;
+    chunk->data = NULL;
+
+    if (inode_is_inline(dir)) {
+        chunk->data = dir->disk.inline_data;
+        chunk->cap = INODE_INLINE_SIZE;
+        chunk->len = remaining < INODE_INLINE_SIZE ? (uint32_t)remaining : INODE_INLINE_SIZE;
+        return MODERNFS_SUCCESS;
+    }
+
+    block_t block;
+    int ret = inode_bmap(cache, dir, offset, false, &block);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    chunk->cap = BLOCK_SIZE;
+    chunk->len = remaining < BLOCK_SIZE ? (uint32_t)remaining : BLOCK_SIZE;
+
+    if (block == 0) {
+        return MODERNFS_SUCCESS;
+    }
+
+    chunk->bh = blkdev_get_block(cache->dev, block);
+    if (!chunk->bh) {
+        return MODERNFS_EIO;
+    }
+    chunk->data = chunk->bh->data;
+
+    return MODERNFS_SUCCESS;
+}
+
+// 内联目录项受目录Inode锁保护(修改目录的调用者持有),只有数据块需要加块锁
+static void chunk_lock(dir_chunk_t *chunk, bool write) {
+    if (!chunk->bh) {
+        return;
+    }
+    if (write) {
+        pthread_rwlock_wrlock(&chunk->bh->lock);
+    } else {
+        pthread_rwlock_rdlock(&chunk->bh->lock);
+    }
+}
+
+static void chunk_unlock(dir_chunk_t *chunk) {
+    if (chunk->bh) {
+        pthread_rwlock_unlock(&chunk->bh->lock);
+    }
+}
+
+static void chunk_release(inode_cache_t *cache, dir_chunk_t *chunk, bool dirty) {
+    if (chunk->bh) {
+        blkdev_release_block(cache->dev, chunk->bh, dirty);
+    } else if (dirty) {
+        inode_mark_dirty(cache, chunk->dir);
+    }
+}
+
+// 把内联目录搬到一个数据块,最后一项的rec_len延伸到块末尾
+static int dir_spill_inline(inode_cache_t *cache, inode_t_mem *dir) {
+    int ret = inode_inline_spill(cache, dir);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    dir_chunk_t chunk;
+    ret = dir_get_chunk(cache, dir, 0, &chunk);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+    if (!chunk.data) {
+        return MODERNFS_EIO;
+    }
+
+    chunk_lock(&chunk, true);
+    uint32_t pos = 0;
+    while (pos < INODE_INLINE_SIZE) {
+        dirent_t *de = (dirent_t *)(chunk.data + pos);
+        if (de->rec_len == 0 || de->rec_len > INODE_INLINE_SIZE - pos) {
+            break;
+        }
+        if (pos + de->rec_len == INODE_INLINE_SIZE) {
+            de->rec_len += BLOCK_SIZE - INODE_INLINE_SIZE;
+            break;
+        }
+        pos += de->rec_len;
+    }
+    chunk_unlock(&chunk);
+    chunk_release(cache, &chunk, true);
+
+    dir->disk.size = BLOCK_SIZE;
+    inode_mark_dirty(cache, dir);
+
+    return MODERNFS_SUCCESS;
+}
+
 // ============ 目录查找 ============
 
 int dir_lookup(inode_cache_t *cache,
@@ -57,27 +172,27 @@ int dir_lookup(inode_cache_t *cache,
     }
 
     // 遍历目录块
-    uint64_t offset = 0;
-    uint8_t block_buf[BLOCK_SIZE];
-
-    while (offset < dir->disk.size) {
-        // 读取一个块
-        ssize_t read = inode_read(cache, dir, block_buf, offset, BLOCK_SIZE);
-        if (read < 0) {
-            return read;
+    for (uint64_t offset = 0; offset < dir->disk.size; offset += BLOCK_SIZE) {
+        dir_chunk_t chunk;
+        int ret = dir_get_chunk(cache, dir, offset, &chunk);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
         }
 
-        if (read == 0) {
-            break;
+        if (!chunk.data) {
+            continue;
         }
 
         // 解析目录项
+        inode_t found = 0;
         uint32_t pos = 0;
-        while (pos < (uint32_t)read) {
-            dirent_t *de = (dirent_t *)(block_buf + pos);
+
+        chunk_lock(&chunk, false);
+        while (pos < chunk.len) {
+            dirent_t *de = (dirent_t *)(chunk.data + pos);
 
             // 检查有效性
-            if (de->rec_len == 0 || de->rec_len > BLOCK_SIZE - pos) {
+            if (de->rec_len == 0 || de->rec_len > chunk.cap - pos) {
                 break;
             }
 
@@ -85,14 +200,19 @@ int dir_lookup(inode_cache_t *cache,
             if (de->inum != 0 &&
                 de->name_len == name_len &&
                 memcmp(de->name, name, name_len) == 0) {
-                *inum_out = de->inum;
-                return MODERNFS_SUCCESS;
+                found = de->inum;
+                break;
             }
 
             pos += de->rec_len;
         }
+        chunk_unlock(&chunk);
+        chunk_release(cache, &chunk, false);
 
-        offset += BLOCK_SIZE;
+        if (found != 0) {
+            *inum_out = found;
+            return MODERNFS_SUCCESS;
+        }
     }
 
     return MODERNFS_ENOENT;
@@ -100,6 +220,77 @@ int dir_lookup(inode_cache_t *cache,
 
 // ============ 目录添加 ============
 
+// 在已有目录项的空闲空间中插入new_entry(rec_len为其实际大小)
+// 返回1已插入,0没有足够空间,负数为错误码
+static int dir_insert(inode_cache_t *cache,
+                      inode_t_mem *dir,
+                      dirent_t *new_entry,
+                      size_t name_len) {
+    uint16_t new_size = new_entry->rec_len;
+
+    // 查找空闲空间
+    for (uint64_t offset = 0; offset < dir->disk.size; offset += BLOCK_SIZE) {
+        dir_chunk_t chunk;
+        int ret = dir_get_chunk(cache, dir, offset, &chunk);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+
+        if (!chunk.data) {
+            continue;
+        }
+
+        bool inserted = false;
+        uint32_t pos = 0;
+
+        chunk_lock(&chunk, true);
+        while (pos < chunk.len) {
+            dirent_t *de = (dirent_t *)(chunk.data + pos);
+
+            if (de->rec_len == 0 || de->rec_len > chunk.cap - pos) {
+                break;
+            }
+
+            // 检查是否有足够空间（删除的项或末尾空闲空间）
+            uint16_t actual_size = dirent_size(de);
+            uint16_t free_space = de->rec_len - actual_size;
+
+            if (de->inum == 0) {
+                // 已删除的项
+                free_space = de->rec_len;
+            }
+
+            if (free_space >= new_size) {
+                // 找到空闲空间，直接在缓存块上修改
+                uint32_t insert_pos = pos;
+                if (de->inum != 0) {
+                    // 分裂现有项
+                    new_entry->rec_len = de->rec_len - actual_size;
+                    de->rec_len = actual_size;
+                    insert_pos += actual_size;
+                } else {
+                    new_entry->rec_len = free_space;
+                }
+
+                // 只写入新项的有效部分，避免覆盖后续目录项
+                memcpy(chunk.data + insert_pos, new_entry, offsetof(dirent_t, name) + name_len);
+                inserted = true;
+                break;
+            }
+
+            pos += de->rec_len;
+        }
+        chunk_unlock(&chunk);
+        chunk_release(cache, &chunk, inserted);
+
+        if (inserted) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
 int dir_add(inode_cache_t *cache,
             inode_t_mem *dir,
             const char *name,
@@ -137,76 +328,31 @@ int dir_add(inode_cache_t *cache,
         return ret;
     }
 
-    // 查找空闲空间
-    uint64_t offset = 0;
-    uint8_t block_buf[BLOCK_SIZE];
-
-    while (offset < dir->disk.size) {
-        // 读取一个块
-        ssize_t read = inode_read(cache, dir, block_buf, offset, BLOCK_SIZE);
-        if (read < 0) {
-            return read;
-        }
-
-        if (read == 0) {
-            break;
-        }
-
-        // 查找空闲空间
-        uint32_t pos = 0;
-        while (pos < (uint32_t)read) {
-            dirent_t *de = (dirent_t *)(block_buf + pos);
-
-            if (de->rec_len == 0 || de->rec_len > BLOCK_SIZE - pos) {
-                break;
-            }
-
-            // 检查是否有足够空间（删除的项或末尾空闲空间）
-            uint16_t actual_size = dirent_size(de);
-            uint16_t free_space = de->rec_len - actual_size;
-
-            if (de->inum == 0) {
-                // 已删除的项
-                free_space = de->rec_len;
-            }
-
-            if (free_space >= new_entry.rec_len) {
-                // 找到空闲空间
-                uint32_t insert_pos = pos;
-                if (de->inum != 0) {
-                    // 分裂现有项 - 需要先写回修改后的原项
-                    uint16_t old_rec_len = de->rec_len;
-                    de->rec_len = actual_size;
-
-                    // 写回修改后的原目录项
-                    ssize_t written = inode_write(cache, dir, de,
-                                                  offset + pos,
-                                                  sizeof(dirent_t), NULL);
-                    if (written < 0) {
-                        return written;
-                    }
-
-                    insert_pos += actual_size;
-                    new_entry.rec_len = old_rec_len - actual_size;
-                } else {
-                    new_entry.rec_len = free_space;
-                }
-
-                // 写入新项
-                ssize_t written = inode_write(cache, dir, &new_entry,
-                                              offset + insert_pos,
-                                              sizeof(dirent_t), NULL);
-                if (written < 0) {
-                    return written;
-                }
-
-                return MODERNFS_SUCCESS;
-            }
+    uint16_t new_size = new_entry.rec_len;
+
+    // 空目录的第一项放得进Inode时建成内联目录
+    if (dir->disk.size == 0 && dir->disk.blocks == 0 && cache->inline_data &&
+        new_size <= INODE_INLINE_SIZE) {
+        memset(dir->disk.inline_data, 0, INODE_INLINE_SIZE);
+        dir->disk.flags = (dir->disk.flags & ~INODE_FLAG_EXTENTS) | INODE_FLAG_INLINE;
+        new_entry.rec_len = INODE_INLINE_SIZE;
+        memcpy(dir->disk.inline_data, &new_entry, offsetof(dirent_t, name) + name_len);
+        dir->disk.size = INODE_INLINE_SIZE;
+        inode_mark_dirty(cache, dir);
+        return MODERNFS_SUCCESS;
+    }
 
-            pos += de->rec_len;
+    ret = dir_insert(cache, dir, &new_entry, name_len);
+    if (ret == 0 && inode_is_inline(dir)) {
+        // 内联目录放不下了,搬到数据块后再找一次
+        ret = dir_spill_inline(cache, dir);
+        if (ret == MODERNFS_SUCCESS) {
+            new_entry.rec_len = new_size;
+            ret = dir_insert(cache, dir, &new_entry, name_len);
         }
-
-        offset += BLOCK_SIZE;
+    }
+    if (ret != 0) {
+        return ret < 0 ? ret : MODERNFS_SUCCESS;
     }
 
     // 没有找到空闲空间，追加到末尾
@@ -240,28 +386,27 @@ int dir_remove(inode_cache_t *cache,
     }
 
     // 遍历目录块
-    uint64_t offset = 0;
-    uint8_t block_buf[BLOCK_SIZE];
-
-    while (offset < dir->disk.size) {
-        // 读取一个块
-        ssize_t read = inode_read(cache, dir, block_buf, offset, BLOCK_SIZE);
-        if (read < 0) {
-            return read;
+    for (uint64_t offset = 0; offset < dir->disk.size; offset += BLOCK_SIZE) {
+        dir_chunk_t chunk;
+        int ret = dir_get_chunk(cache, dir, offset, &chunk);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
         }
 
-        if (read == 0) {
-            break;
+        if (!chunk.data) {
+            continue;
         }
 
         // 解析目录项
+        bool removed = false;
         uint32_t pos = 0;
         dirent_t *prev = NULL;
 
-        while (pos < (uint32_t)read) {
-            dirent_t *de = (dirent_t *)(block_buf + pos);
+        chunk_lock(&chunk, true);
+        while (pos < chunk.len) {
+            dirent_t *de = (dirent_t *)(chunk.data + pos);
 
-            if (de->rec_len == 0 || de->rec_len > BLOCK_SIZE - pos) {
+            if (de->rec_len == 0 || de->rec_len > chunk.cap - pos) {
                 break;
             }
 
@@ -274,28 +419,13 @@ int dir_remove(inode_cache_t *cache,
                 if (prev) {
                     // 合并到前一个项
                     prev->rec_len += de->rec_len;
-
-                    // 写回前一个项
-                    uint32_t prev_pos = (uint8_t *)prev - block_buf;
-                    ssize_t written = inode_write(cache, dir, prev,
-                                                  offset + prev_pos,
-                                                  sizeof(dirent_t), NULL);
-                    if (written < 0) {
-                        return written;
-                    }
                 } else {
                     // 第一个项，只清除inum
                     de->inum = 0;
-
-                    ssize_t written = inode_write(cache, dir, de,
-                                                  offset + pos,
-                                                  sizeof(dirent_t), NULL);
-                    if (written < 0) {
-                        return written;
-                    }
                 }
 
-                return MODERNFS_SUCCESS;
+                removed = true;
+                break;
             }
 
             if (de->inum != 0) {
@@ -304,8 +434,12 @@ int dir_remove(inode_cache_t *cache,
 
             pos += de->rec_len;
         }
+        chunk_unlock(&chunk);
+        chunk_release(cache, &chunk, removed);
 
-        offset += BLOCK_SIZE;
+        if (removed) {
+            return MODERNFS_SUCCESS;
+        }
     }
 
     return MODERNFS_ENOENT;
@@ -326,45 +460,52 @@ int dir_iterate(inode_cache_t *cache,
     }
 
     // 遍历目录块
-    uint64_t offset = 0;
-    uint8_t block_buf[BLOCK_SIZE];
-
-    while (offset < dir->disk.size) {
-        // 读取一个块
-        ssize_t read = inode_read(cache, dir, block_buf, offset, BLOCK_SIZE);
-        if (read < 0) {
-            return read;
+    for (uint64_t offset = 0; offset < dir->disk.size; offset += BLOCK_SIZE) {
+        dir_chunk_t chunk;
+        int ret = dir_get_chunk(cache, dir, offset, &chunk);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
         }
 
-        if (read == 0) {
-            break;
+        if (!chunk.data) {
+            continue;
         }
 
         // 解析目录项
         uint32_t pos = 0;
-        while (pos < (uint32_t)read) {
-            dirent_t *de = (dirent_t *)(block_buf + pos);
+        while (pos < chunk.len) {
+            char name_buf[MAX_FILENAME + 1];
+            inode_t inum;
+            uint16_t rec_len;
+
+            // 只在拷贝目录项时持锁，回调期间不持有块锁
+            chunk_lock(&chunk, false);
+            dirent_t *de = (dirent_t *)(chunk.data + pos);
+            rec_len = de->rec_len;
+            inum = de->inum;
+            if (rec_len != 0 && rec_len <= chunk.cap - pos && inum != 0) {
+                memcpy(name_buf, de->name, de->name_len);
+                name_buf[de->name_len] = '\0';
+            }
+            chunk_unlock(&chunk);
 
-            if (de->rec_len == 0 || de->rec_len > BLOCK_SIZE - pos) {
+            if (rec_len == 0 || rec_len > chunk.cap - pos) {
                 break;
             }
 
             // 调用回调
-            if (de->inum != 0) {
-                char name_buf[MAX_FILENAME + 1];
-                memcpy(name_buf, de->name, de->name_len);
-                name_buf[de->name_len] = '\0';
-
-                int ret = callback(name_buf, de->inum, arg);
+            if (inum != 0) {
+                ret = callback(name_buf, inum, arg);
                 if (ret != 0) {
+                    chunk_release(cache, &chunk, false);
                     return ret;
                 }
             }
 
-            pos += de->rec_len;
+            pos += rec_len;
         }
 
-        offset += BLOCK_SIZE;
+        chunk_release(cache, &chunk, false);
     }
 
     return MODERNFS_SUCCESS;
@@ -0,0 +1,545 @@
+#include "modernfs/extent.h"
+#include <string.h>
+#include <stdio.h>
+
+// ============ 节点访问 ============
+
+// 树节点视图: 根节点位于Inode内(bh为NULL),其余节点位于持锁的缓存块中
+typedef struct ext_node {
+    extent_header_t *hdr;
+    extent_t *ext;
+    buffer_head_t *bh;
+} ext_node_t;
+
+static int node_root(inode_t_mem *inode, ext_node_t *node) {
+    node->hdr = (extent_header_t *)inode->disk.extent_root;
+    node->ext = (extent_t *)(inode->disk.extent_root + sizeof(extent_header_t));
+    node->bh = NULL;
+
+    if (node->hdr->magic != EXTENT_MAGIC ||
+        node->hdr->max != EXTENT_ROOT_ENTRIES ||
+        node->hdr->entries > EXTENT_ROOT_ENTRIES ||
+        node->hdr->depth >= EXTENT_MAX_DEPTH) {
+        fprintf(stderr, "[EXTENT] Corrupted extent root in inode %u\n", inode->inum);
+        return MODERNFS_EIO;
+    }
+    return MODERNFS_SUCCESS;
+}
+
+static void node_put(inode_cache_t *cache, ext_node_t *node, bool dirty) {
+    if (!node->bh) {
+        return;
+    }
+    pthread_rwlock_unlock(&node->bh->lock);
+    blkdev_release_block(cache->dev, node->bh, dirty);
+    node->bh = NULL;
+}
+
+// 读取节点块并加锁(write为true时加写锁),校验头部
+static int node_load(inode_cache_t *cache, block_t block, uint16_t depth,
+                     bool write, ext_node_t *node) {
+    buffer_head_t *bh = blkdev_get_block(cache->dev, block);
+    if (!bh) {
+        return MODERNFS_EIO;
+    }
+
+    if (write) {
+        pthread_rwlock_wrlock(&bh->lock);
+    } else {
+        pthread_rwlock_rdlock(&bh->lock);
+    }
+
+    node->hdr = (extent_header_t *)bh->data;
+    node->ext = (extent_t *)(bh->data + sizeof(extent_header_t));
+    node->bh = bh;
+
+    if (node->hdr->magic != EXTENT_MAGIC ||
+        node->hdr->max != EXTENT_BLOCK_ENTRIES ||
+        node->hdr->entries > EXTENT_BLOCK_ENTRIES ||
+        node->hdr->depth != depth) {
+        fprintf(stderr, "[EXTENT] Corrupted extent node at block %u\n", block);
+        node_put(cache, node, false);
+        return MODERNFS_EIO;
+    }
+    return MODERNFS_SUCCESS;
+}
+
+// 分配并初始化一个空节点块,返回时持有写锁
+static int node_new(inode_cache_t *cache, inode_t_mem *inode, uint16_t depth,
+                    block_t *block_out, ext_node_t *node) {
+    block_t block = inode_alloc_block(cache, inode);
+    if (block == 0) {
+        return MODERNFS_ENOSPC;
+    }
+
+    buffer_head_t *bh = blkdev_get_new_block(cache->dev, block);
+    if (!bh) {
+        block_free(cache->balloc, block);
+        return MODERNFS_EIO;
+    }
+
+    pthread_rwlock_wrlock(&bh->lock);
+    node->hdr = (extent_header_t *)bh->data;
+    node->ext = (extent_t *)(bh->data + sizeof(extent_header_t));
+    node->bh = bh;
+    node->hdr->magic = EXTENT_MAGIC;
+    node->hdr->entries = 0;
+    node->hdr->max = EXTENT_BLOCK_ENTRIES;
+    node->hdr->depth = depth;
+
+    inode->disk.blocks++;
+    *block_out = block;
+    return MODERNFS_SUCCESS;
+}
+
+static void node_free(inode_cache_t *cache, inode_t_mem *inode, block_t block) {
+    block_free(cache->balloc, block);
+    inode->disk.blocks--;
+}
+
+// 返回最后一个logical<=lblk的记录下标,不存在时返回-1
+static int node_search(const ext_node_t *node, uint32_t lblk) {
+    int lo = 0;
+    int hi = (int)node->hdr->entries - 1;
+    int found = -1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (node->ext[mid].logical <= lblk) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+static void node_insert_simple(ext_node_t *node, int pos, extent_t rec) {
+    memmove(&node->ext[pos + 1], &node->ext[pos],
+            (node->hdr->entries - pos) * sizeof(extent_t));
+    node->ext[pos] = rec;
+    node->hdr->entries++;
+}
+
+static void node_remove(ext_node_t *node, int pos) {
+    memmove(&node->ext[pos], &node->ext[pos + 1],
+            (node->hdr->entries - pos - 1) * sizeof(extent_t));
+    node->hdr->entries--;
+}
+
+// a的末尾与b的开头在逻辑和物理上都相接
+static bool extent_joins(const extent_t *a, const extent_t *b) {
+    return a->logical + a->length == b->logical &&
+           a->physical + a->length == b->physical &&
+           a->length <= UINT32_MAX - b->length;
+}
+
+// ============ 插入 ============
+
+// 根节点已满: 把全部记录移到新节点块,根变为只有一个子节点的索引节点
+static int grow_root(inode_cache_t *cache, inode_t_mem *inode, ext_node_t *root) {
+    if (root->hdr->depth + 1 >= EXTENT_MAX_DEPTH) {
+        return MODERNFS_ENOSPC;
+    }
+
+    ext_node_t child;
+    block_t child_block;
+    int ret = node_new(cache, inode, root->hdr->depth, &child_block, &child);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    memcpy(child.ext, root->ext, root->hdr->entries * sizeof(extent_t));
+    child.hdr->entries = root->hdr->entries;
+    uint32_t first = child.ext[0].logical;
+    node_put(cache, &child, true);
+
+    root->hdr->depth++;
+    root->hdr->entries = 1;
+    root->ext[0] = (extent_t){ .logical = first, .physical = child_block, .length = 0 };
+    return MODERNFS_SUCCESS;
+}
+
+// 在pos处插入记录。节点已满时分裂出兄弟节点,通过split_out返回指向它的索引记录
+static int node_insert_at(inode_cache_t *cache, inode_t_mem *inode, ext_node_t *node,
+                          int pos, extent_t rec, extent_t *split_out, bool *split) {
+    *split = false;
+
+    if (node->hdr->entries < node->hdr->max) {
+        node_insert_simple(node, pos, rec);
+        return MODERNFS_SUCCESS;
+    }
+
+    if (!node->bh) {
+        // 根节点满: 先增加树高,再插入到承接原记录的子节点中(子节点容量远大于根)
+        int ret = grow_root(cache, inode, node);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+
+        ext_node_t child;
+        ret = node_load(cache, node->ext[0].physical, node->hdr->depth - 1, true, &child);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+        node_insert_simple(&child, pos, rec);
+        node->ext[0].logical = child.ext[0].logical;
+        node_put(cache, &child, true);
+        return MODERNFS_SUCCESS;
+    }
+
+    ext_node_t sib;
+    block_t sib_block;
+    int ret = node_new(cache, inode, node->hdr->depth, &sib_block, &sib);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    // 追加到末尾时只把新记录放进兄弟节点,顺序写入的文件因此保持节点满载
+    uint16_t n = node->hdr->entries;
+    uint16_t keep = (pos == n) ? n : n / 2;
+    memcpy(sib.ext, &node->ext[keep], (n - keep) * sizeof(extent_t));
+    sib.hdr->entries = n - keep;
+    node->hdr->entries = keep;
+
+    if (keep < n && pos <= keep) {
+        node_insert_simple(node, pos, rec);
+    } else {
+        node_insert_simple(&sib, pos - keep, rec);
+    }
+
+    *split_out = (extent_t){ .logical = sib.ext[0].logical, .physical = sib_block, .length = 0 };
+    *split = true;
+    node_put(cache, &sib, true);
+    return MODERNFS_SUCCESS;
+}
+
+static int leaf_insert(inode_cache_t *cache, inode_t_mem *inode, ext_node_t *node,
+                       extent_t rec, extent_t *split_out, bool *split) {
+    *split = false;
+
+    int i = node_search(node, rec.logical);
+    int n = node->hdr->entries;
+
+    if (i >= 0) {
+        extent_t *prev = &node->ext[i];
+        if (rec.logical - prev->logical < prev->length) {
+            return MODERNFS_EINVAL;     // 已映射
+        }
+        if (extent_joins(prev, &rec)) {
+            prev->length += rec.length;
+            // 填补空洞后可能与后一个extent相接
+            if (i + 1 < n && extent_joins(prev, &node->ext[i + 1])) {
+                prev->length += node->ext[i + 1].length;
+                node_remove(node, i + 1);
+            }
+            return MODERNFS_SUCCESS;
+        }
+    }
+
+    if (i + 1 < n) {
+        extent_t *next = &node->ext[i + 1];
+        if (next->logical - rec.logical < rec.length) {
+            return MODERNFS_EINVAL;     // 与已映射区间重叠
+        }
+        if (extent_joins(&rec, next)) {
+            next->logical = rec.logical;
+            next->physical = rec.physical;
+            next->length += rec.length;
+            return MODERNFS_SUCCESS;
+        }
+    }
+
+    return node_insert_at(cache, inode, node, i + 1, rec, split_out, split);
+}
+
+static int insert_rec(inode_cache_t *cache, inode_t_mem *inode, ext_node_t *node,
+                      extent_t rec, extent_t *split_out, bool *split) {
+    if (node->hdr->depth == 0) {
+        return leaf_insert(cache, inode, node, rec, split_out, split);
+    }
+
+    *split = false;
+
+    // 比所有键都小时进入第一个子树,随后下调它的键
+    int i = node_search(node, rec.logical);
+    if (i < 0) {
+        i = 0;
+    }
+
+    ext_node_t child;
+    int ret = node_load(cache, node->ext[i].physical, node->hdr->depth - 1, true, &child);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    extent_t child_split;
+    bool child_did_split;
+    ret = insert_rec(cache, inode, &child, rec, &child_split, &child_did_split);
+    node_put(cache, &child, true);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    if (rec.logical < node->ext[i].logical) {
+        node->ext[i].logical = rec.logical;
+    }
+
+    if (!child_did_split) {
+        return MODERNFS_SUCCESS;
+    }
+    return node_insert_at(cache, inode, node, i + 1, child_split, split_out, split);
+}
+
+// ============ 截断 ============
+
+static int free_run(inode_cache_t *cache, inode_t_mem *inode, block_t start, uint32_t count) {
+    int ret = block_free_multiple(cache->balloc, start, count);
+    if (ret < 0) {
+        return ret;
+    }
+    inode->disk.blocks -= count;
+    return MODERNFS_SUCCESS;
+}
+
+// 删除节点中逻辑块号>=from的映射,变空的子节点随之释放
+static int truncate_node(inode_cache_t *cache, inode_t_mem *inode, ext_node_t *node,
+                         uint32_t from) {
+    extent_header_t *hdr = node->hdr;
+
+    if (hdr->depth == 0) {
+        while (hdr->entries > 0) {
+            extent_t *e = &node->ext[hdr->entries - 1];
+            if (e->logical >= from) {
+                int ret = free_run(cache, inode, e->physical, e->length);
+                if (ret != MODERNFS_SUCCESS) {
+                    return ret;
+                }
+                hdr->entries--;
+                continue;
+            }
+
+            if (from - e->logical < e->length) {
+                uint32_t keep = from - e->logical;
+                int ret = free_run(cache, inode, e->physical + keep, e->length - keep);
+                if (ret != MODERNFS_SUCCESS) {
+                    return ret;
+                }
+                e->length = keep;
+            }
+            break;
+        }
+        return MODERNFS_SUCCESS;
+    }
+
+    // 从最后一个子树往前处理,键小于from的子树是最后一个需要处理的
+    while (hdr->entries > 0) {
+        extent_t idx = node->ext[hdr->entries - 1];
+
+        ext_node_t child;
+        int ret = node_load(cache, idx.physical, hdr->depth - 1, true, &child);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+
+        ret = truncate_node(cache, inode, &child, from);
+        bool empty = (child.hdr->entries == 0);
+        node_put(cache, &child, !empty);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+
+        if (empty) {
+            node_free(cache, inode, idx.physical);
+            hdr->entries--;
+        }
+        if (idx.logical < from) {
+            break;
+        }
+    }
+    return MODERNFS_SUCCESS;
+}
+
+// 根只剩一个子节点且放得下时,把子节点提升为根
+static int shrink_root(inode_cache_t *cache, inode_t_mem *inode, ext_node_t *root) {
+    if (root->hdr->entries == 0) {
+        root->hdr->depth = 0;
+        return MODERNFS_SUCCESS;
+    }
+
+    while (root->hdr->depth > 0 && root->hdr->entries == 1) {
+        block_t child_block = root->ext[0].physical;
+
+        ext_node_t child;
+        int ret = node_load(cache, child_block, root->hdr->depth - 1, false, &child);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+
+        uint16_t n = child.hdr->entries;
+        if (n > EXTENT_ROOT_ENTRIES) {
+            node_put(cache, &child, false);
+            break;
+        }
+
+        memcpy(root->ext, child.ext, n * sizeof(extent_t));
+        root->hdr->entries = n;
+        root->hdr->depth = child.hdr->depth;
+        node_put(cache, &child, false);
+        node_free(cache, inode, child_block);
+    }
+    return MODERNFS_SUCCESS;
+}
+
+// ============ 公共接口 ============
+
+void extent_tree_init(inode_t_mem *inode) {
+    memset(inode->disk.extent_root, 0, INODE_EXTENT_ROOT_SIZE);
+
+    extent_header_t *hdr = (extent_header_t *)inode->disk.extent_root;
+    hdr->magic = EXTENT_MAGIC;
+    hdr->entries = 0;
+    hdr->max = EXTENT_ROOT_ENTRIES;
+    hdr->depth = 0;
+
+    inode->disk.flags |= INODE_FLAG_EXTENTS;
+    inode->dirty = 1;
+}
+
+int extent_map(inode_cache_t *cache, inode_t_mem *inode, uint32_t lblk,
+               block_t *pblk_out, uint32_t *len_out) {
+    if (!inode || !pblk_out || !len_out || lblk == UINT32_MAX) {
+        return MODERNFS_EINVAL;
+    }
+
+    ext_node_t node;
+    int ret = node_root(inode, &node);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    // end为当前子树覆盖范围的上界(不含),用于计算末尾空洞的长度
+    uint32_t end = UINT32_MAX;
+
+    while (node.hdr->depth > 0 && node.hdr->entries > 0) {
+        int i = node_search(&node, lblk);
+        if (i < 0) {
+            i = 0;
+        }
+        if (i + 1 < node.hdr->entries) {
+            end = node.ext[i + 1].logical;
+        }
+
+        block_t child = node.ext[i].physical;
+        uint16_t depth = node.hdr->depth - 1;
+        node_put(cache, &node, false);
+
+        ret = node_load(cache, child, depth, false, &node);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+    }
+
+    int i = node_search(&node, lblk);
+    if (i >= 0 && lblk - node.ext[i].logical < node.ext[i].length) {
+        uint32_t delta = lblk - node.ext[i].logical;
+        *pblk_out = node.ext[i].physical + delta;
+        *len_out = node.ext[i].length - delta;
+    } else {
+        uint32_t next = (i + 1 < node.hdr->entries) ? node.ext[i + 1].logical : end;
+        *pblk_out = 0;
+        *len_out = next - lblk;
+    }
+
+    node_put(cache, &node, false);
+    return MODERNFS_SUCCESS;
+}
+
+int extent_insert(inode_cache_t *cache, inode_t_mem *inode, uint32_t lblk,
+                  block_t pblk, uint32_t len) {
+    if (!inode || pblk == 0 || len == 0 || len > UINT32_MAX - lblk) {
+        return MODERNFS_EINVAL;
+    }
+
+    ext_node_t root;
+    int ret = node_root(inode, &root);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    extent_t rec = { .logical = lblk, .physical = pblk, .length = len };
+    extent_t split_rec;
+    bool split;
+
+    ret = insert_rec(cache, inode, &root, rec, &split_rec, &split);
+    inode_mark_dirty(cache, inode);
+    return ret;
+}
+
+int extent_truncate(inode_cache_t *cache, inode_t_mem *inode, uint32_t first_lblk) {
+    if (!inode) {
+        return MODERNFS_EINVAL;
+    }
+
+    ext_node_t root;
+    int ret = node_root(inode, &root);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    ret = truncate_node(cache, inode, &root, first_lblk);
+    if (ret == MODERNFS_SUCCESS) {
+        ret = shrink_root(cache, inode, &root);
+    }
+    inode_mark_dirty(cache, inode);
+    return ret;
+}
+
+static int count_extents(inode_cache_t *cache, ext_node_t *node, uint32_t *count) {
+    if (node->hdr->depth == 0) {
+        *count += node->hdr->entries;
+        return MODERNFS_SUCCESS;
+    }
+
+    for (uint16_t i = 0; i < node->hdr->entries; i++) {
+        ext_node_t child;
+        int ret = node_load(cache, node->ext[i].physical, node->hdr->depth - 1, false, &child);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+        ret = count_extents(cache, &child, count);
+        node_put(cache, &child, false);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+    }
+    return MODERNFS_SUCCESS;
+}
+
+int extent_stats(inode_cache_t *cache, inode_t_mem *inode,
+                 uint32_t *extents_out, uint32_t *depth_out) {
+    if (!inode) {
+        return MODERNFS_EINVAL;
+    }
+
+    ext_node_t root;
+    int ret = node_root(inode, &root);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    uint32_t count = 0;
+    ret = count_extents(cache, &root, &count);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    if (extents_out) {
+        *extents_out = count;
+    }
+    if (depth_out) {
+        *depth_out = root.hdr->depth;
+    }
+    return MODERNFS_SUCCESS;
+}
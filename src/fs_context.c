@@ -12,6 +12,19 @@
 static void* checkpoint_thread_func(void *arg);
 
 fs_context_t* fs_context_init(const char *device_path, bool read_only) {
+    fs_mount_opts_t opts = {
+        .read_only = read_only,
+        .io_engine = IO_ENGINE_SYNC,
+    };
+    return fs_context_init_opts(device_path, &opts);
+}
+
+fs_context_t* fs_context_init_opts(const char *device_path, const fs_mount_opts_t *opts) {
+    static const fs_mount_opts_t default_opts = { 0 };
+    if (!opts) {
+        opts = &default_opts;
+    }
+
     if (!device_path) {
         fprintf(stderr, "fs_context_init: device_path is NULL\n");
         return NULL;
@@ -25,10 +38,11 @@ fs_context_t* fs_context_init(const char *device_path, bool read_only) {
 
     // 保存设备路径和挂载选项
     strncpy(ctx->device_path, device_path, sizeof(ctx->device_path) - 1);
-    ctx->read_only = read_only;
+    ctx->read_only = opts->read_only;
+    ctx->io_engine = opts->io_engine;
 
     // 打开块设备
-    ctx->dev = blkdev_open(device_path);
+    ctx->dev = blkdev_open_ex(device_path, opts->io_engine);
     if (!ctx->dev) {
         fprintf(stderr, "fs_context_init: failed to open device %s\n", device_path);
         free(ctx);
@@ -85,12 +99,27 @@ fs_context_t* fs_context_init(const char *device_path, bool read_only) {
         return NULL;
     }
 
+    // 按超级块中的分配组切分数据区(旧镜像group_data_blocks为0,整个数据区一组)
+    if (block_alloc_set_groups(ctx->balloc, ctx->sb->group_data_blocks) != 0) {
+        fprintf(stderr, "fs_context_init: invalid allocation group size %u\n",
+                ctx->sb->group_data_blocks);
+        block_alloc_destroy(ctx->balloc);
+        blkdev_close(ctx->dev);
+        free(ctx);
+        return NULL;
+    }
+
+    // 并发写入时各线程从自己的预留窗口分配单块,不在组锁上排队
+    if (!ctx->read_only) {
+        block_alloc_set_reservation(ctx->balloc, BALLOC_RESV_DEFAULT);
+    }
+
     // 初始化Inode缓存
     ctx->icache = inode_cache_init(
         ctx->dev,
         ctx->balloc,
-        64,  // 缓存64个Inode
-        32   // 哈希表32个桶
+        INODE_SLAB_ENTRIES,  // 先按一个slab,下面按内存预算调整
+        INODE_HASH_MIN       // 哈希表随条目数伸缩
     );
     if (!ctx->icache) {
         fprintf(stderr, "fs_context_init: failed to init inode cache\n");
@@ -99,6 +128,12 @@ fs_context_t* fs_context_init(const char *device_path, bool read_only) {
         free(ctx);
         return NULL;
     }
+    ctx->icache->delalloc = opts->delalloc && !opts->read_only;
+    ctx->icache->inline_data = opts->inline_data;
+    ctx->icache->atime_mode = opts->atime_mode;
+    ctx->icache->lazytime = opts->lazytime;
+    inode_cache_set_budget(ctx->icache, opts->icache_mb ?
+                           (size_t)opts->icache_mb << 20 : INODE_CACHE_DEFAULT_BUDGET);
 
     // 设置根目录Inode号
     ctx->root_inum = ctx->sb->root_inum;
@@ -129,7 +164,7 @@ fs_context_t* fs_context_init(const char *device_path, bool read_only) {
     inode_put(ctx->icache, root);
 
     // Week 7: 初始化Journal Manager (Rust)
-    if (!read_only) {
+    if (!ctx->read_only) {
         int fd_dup = dup(ctx->dev->fd);  // 复制fd给Rust使用
         if (fd_dup < 0) {
             fprintf(stderr, "fs_context_init: failed to dup fd\n");
@@ -170,34 +205,6 @@ fs_context_t* fs_context_init(const char *device_path, bool read_only) {
         }
         printf("ModernFS: journal recovery complete, recovered %d transactions\n", recovered);
 
-        // Week 7: 初始化Extent Allocator (Rust)
-        fd_dup = dup(ctx->dev->fd);  // 再次复制fd
-        if (fd_dup < 0) {
-            fprintf(stderr, "fs_context_init: failed to dup fd for extent allocator\n");
-            rust_journal_destroy(ctx->journal);
-            inode_cache_destroy(ctx->icache);
-            block_alloc_destroy(ctx->balloc);
-            blkdev_close(ctx->dev);  // This also frees ctx->sb via dev->superblock
-            free(ctx);
-            return NULL;
-        }
-
-        ctx->extent_alloc = rust_extent_alloc_init(
-            fd_dup,
-            ctx->sb->data_bitmap_start,
-            ctx->sb->data_blocks
-        );
-        if (!ctx->extent_alloc) {
-            fprintf(stderr, "fs_context_init: failed to init extent allocator\n");
-            close(fd_dup);
-            rust_journal_destroy(ctx->journal);
-            inode_cache_destroy(ctx->icache);
-            block_alloc_destroy(ctx->balloc);
-            blkdev_close(ctx->dev);  // This also frees ctx->sb via dev->superblock
-            free(ctx);
-            return NULL;
-        }
-
         // 启动后台Checkpoint线程
         ctx->checkpoint_running = true;
         pthread_mutex_init(&ctx->checkpoint_lock, NULL);
@@ -206,7 +213,6 @@ fs_context_t* fs_context_init(const char *device_path, bool read_only) {
         if (pthread_create(&ctx->checkpoint_thread, NULL, checkpoint_thread_func, ctx) != 0) {
             fprintf(stderr, "fs_context_init: failed to create checkpoint thread\n");
             ctx->checkpoint_running = false;
-            rust_extent_alloc_destroy(ctx->extent_alloc);
             rust_journal_destroy(ctx->journal);
             inode_cache_destroy(ctx->icache);
             block_alloc_destroy(ctx->balloc);
@@ -218,10 +224,14 @@ fs_context_t* fs_context_init(const char *device_path, bool read_only) {
         // 给线程一点时间启动（避免竞态条件）
         usleep(10000);  // 10ms
 
-        printf("ModernFS: Journal and Extent Allocator initialized\n");
+        // 启动脏块后台写回线程,失败时退化为只在sync/淘汰时写回
+        if (buffer_cache_start_flusher(ctx->dev->cache) < 0) {
+            fprintf(stderr, "fs_context_init: failed to start cache flusher\n");
+        }
+
+        printf("ModernFS: Journal initialized\n");
     } else {
         ctx->journal = NULL;
-        ctx->extent_alloc = NULL;
         ctx->checkpoint_running = false;
     }
 
@@ -251,6 +261,9 @@ void fs_context_destroy(fs_context_t *ctx) {
         printf("ModernFS: checkpoint thread stopped\n");
     }
 
+    // 停止脏块写回线程,剩余脏块由下面的sync写回
+    buffer_cache_stop_flusher(ctx->dev->cache);
+
     // 同步所有数据
     if (!ctx->read_only) {
         fs_context_sync(ctx);
@@ -258,12 +271,6 @@ void fs_context_destroy(fs_context_t *ctx) {
 
     // Week 7: 销毁Rust模块
     printf("ModernFS: destroying Rust modules...\n");
-    if (ctx->extent_alloc) {
-        printf("ModernFS: destroying extent allocator...\n");
-        rust_extent_alloc_destroy(ctx->extent_alloc);
-        printf("ModernFS: extent allocator destroyed\n");
-    }
-
     if (ctx->journal) {
         printf("ModernFS: destroying journal manager...\n");
         rust_journal_destroy(ctx->journal);
@@ -309,6 +316,12 @@ int fs_context_sync(fs_context_t *ctx) {
     if (!ctx) return -EINVAL;
     if (ctx->read_only) return 0;
 
+    // 先为延迟分配的数据分配块,后面的步骤才能把映射和位图一起写下去
+    if (inode_flush_all_delalloc(ctx->icache) < 0) {
+        fprintf(stderr, "fs_context_sync: failed to flush delayed allocations\n");
+        return -EIO;
+    }
+
     // Week 7: 执行Journal checkpoint
     if (ctx->journal) {
         if (rust_journal_checkpoint(ctx->journal) < 0) {
@@ -317,21 +330,13 @@ int fs_context_sync(fs_context_t *ctx) {
         }
     }
 
-    // Week 7: 同步Extent Allocator位图
-    if (ctx->extent_alloc) {
-        if (rust_extent_sync(ctx->extent_alloc) < 0) {
-            fprintf(stderr, "fs_context_sync: failed to sync extent allocator\n");
-            return -EIO;
-        }
-    }
-
-    // 同步Inode缓存
-    if (inode_sync_all(ctx->icache) < 0) {
+    // 同步Inode缓存;显式的sync/fsync连lazytime暂留的时间戳一起写回
+    if (inode_sync_times(ctx->icache) < 0) {
         fprintf(stderr, "fs_context_sync: failed to sync inode cache\n");
         return -EIO;
     }
 
-    // 同步块分配器
+    // 同步块分配器(数据位图唯一的持有者)
     if (block_alloc_sync(ctx->balloc) < 0) {
         fprintf(stderr, "fs_context_sync: failed to sync block allocator\n");
         return -EIO;
@@ -413,19 +418,23 @@ static void* checkpoint_thread_func(void *arg) {
 
         pthread_mutex_unlock(&ctx->checkpoint_lock);
 
+        // 定期为延迟分配的数据分配块
+        if (ret == ETIMEDOUT && inode_flush_all_delalloc(ctx->icache) < 0) {
+            fprintf(stderr, "ModernFS: delayed allocation flush failed\n");
+        }
+
+        // lazytime: 定期批量写回只改了时间戳的Inode
+        if (ret == ETIMEDOUT && ctx->icache->lazytime &&
+            inode_sync_times(ctx->icache) < 0) {
+            fprintf(stderr, "ModernFS: lazy timestamp writeback failed\n");
+        }
+
         // 执行checkpoint
         if (ctx->journal && ret == ETIMEDOUT) {
             // printf("ModernFS: performing background checkpoint...\n");
             if (rust_journal_checkpoint(ctx->journal) < 0) {
                 fprintf(stderr, "ModernFS: background checkpoint failed\n");
             }
-
-            // 同步Extent Allocator
-            if (ctx->extent_alloc) {
-                if (rust_extent_sync(ctx->extent_alloc) < 0) {
-                    fprintf(stderr, "ModernFS: extent allocator sync failed\n");
-                }
-            }
         }
     }
 
@@ -166,7 +166,7 @@ int modernfs_mkdir(const char *path, mode_t mode) {
     }
 
     // 分配新Inode
-    inode_t_mem *new_inode = inode_alloc(ctx->icache, INODE_TYPE_DIR);
+    inode_t_mem *new_inode = inode_alloc_near(ctx->icache, INODE_TYPE_DIR, parent_inode->inum);
     if (!new_inode) {
         inode_unlock(parent_inode);
         inode_put(ctx->icache, parent_inode);
@@ -189,7 +189,7 @@ int modernfs_mkdir(const char *path, mode_t mode) {
         return -EIO;
     }
 
-    new_inode->dirty = true;
+    inode_mark_dirty(ctx->icache, new_inode);
     inode_unlock(new_inode);
 
     // 添加到父目录
@@ -202,7 +202,7 @@ int modernfs_mkdir(const char *path, mode_t mode) {
     }
 
     parent_inode->disk.nlink++;  // 子目录的 .. 指向父目录
-    parent_inode->dirty = true;
+    inode_mark_dirty(ctx->icache, parent_inode);
 
     inode_unlock(parent_inode);
     inode_put(ctx->icache, parent_inode);
@@ -274,7 +274,7 @@ int modernfs_rmdir(const char *path) {
     }
 
     parent_inode->disk.nlink--;
-    parent_inode->dirty = true;
+    inode_mark_dirty(ctx->icache, parent_inode);
 
     // 释放Inode
     inode_free(ctx->icache, target_inode);
@@ -313,7 +313,7 @@ int modernfs_create(const char *path, mode_t mode, struct fuse_file_info *fi) {
     }
 
     // 分配新Inode
-    inode_t_mem *new_inode = inode_alloc(ctx->icache, INODE_TYPE_FILE);
+    inode_t_mem *new_inode = inode_alloc_near(ctx->icache, INODE_TYPE_FILE, parent_inode->inum);
     if (!new_inode) {
         inode_unlock(parent_inode);
         inode_put(ctx->icache, parent_inode);
@@ -325,7 +325,7 @@ int modernfs_create(const char *path, mode_t mode, struct fuse_file_info *fi) {
     new_inode->disk.nlink = 1;
     new_inode->disk.uid = fuse_get_context()->uid;
     new_inode->disk.gid = fuse_get_context()->gid;
-    new_inode->dirty = true;
+    inode_mark_dirty(ctx->icache, new_inode);
 
     // 设置文件句柄为Inode号，供后续write使用
     fi->fh = new_inode->inum;
@@ -341,7 +341,7 @@ int modernfs_create(const char *path, mode_t mode, struct fuse_file_info *fi) {
         return ret;
     }
 
-    parent_inode->dirty = true;
+    inode_mark_dirty(ctx->icache, parent_inode);
 
     inode_unlock(parent_inode);
     inode_put(ctx->icache, parent_inode);
@@ -392,16 +392,9 @@ int modernfs_read(const char *path, char *buf, size_t size, off_t offset,
 
     inode_lock(inode);
 
-    // 读取数据
+    // 读取数据(inode_read按挂载的atime策略更新访问时间,不在这里写回)
     ssize_t bytes_read = inode_read(ctx->icache, inode, (uint8_t *)buf, offset, size);
 
-    // 更新访问时间
-    inode->disk.atime = time(NULL);
-    inode->dirty = true;
-
-    // 同步inode到磁盘（可选：访问时间更新的同步可以延迟）
-    // inode_sync(ctx->icache, inode);
-
     inode_unlock(inode);
     inode_put(ctx->icache, inode);
 
@@ -457,7 +450,7 @@ int modernfs_write(const char *path, const char *buf, size_t size,
     // 更新修改时间
     inode->disk.mtime = time(NULL);
     inode->disk.ctime = inode->disk.mtime;
-    inode->dirty = true;
+    inode_mark_dirty(ctx->icache, inode);
 
     // 同步inode到磁盘（确保文件大小等元数据持久化）
     inode_sync(ctx->icache, inode);
@@ -540,7 +533,7 @@ int modernfs_unlink(const char *path) {
         return -EIO;
     }
 
-    parent_inode->dirty = true;
+    inode_mark_dirty(ctx->icache, parent_inode);
 
     // 减少链接数，如果为0则释放Inode
     inode_free(ctx->icache, target_inode);
@@ -587,7 +580,7 @@ int modernfs_truncate(const char *path, off_t size, struct fuse_file_info *fi) {
     if (ret == 0) {
         inode->disk.mtime = time(NULL);
         inode->disk.ctime = inode->disk.mtime;
-        inode->dirty = true;
+        inode_mark_dirty(ctx->icache, inode);
     }
 
     inode_unlock(inode);
@@ -647,7 +640,7 @@ int modernfs_utimens(const char *path, const struct timespec tv[2],
     }
 
     inode->disk.ctime = time(NULL);
-    inode->dirty = true;
+    inode_mark_dirty(ctx->icache, inode);
 
     inode_unlock(inode);
     inode_put(ctx->icache, inode);
@@ -673,7 +666,7 @@ int modernfs_chmod(const char *path, mode_t mode, struct fuse_file_info *fi) {
 
     inode->disk.mode = mode & 0777;
     inode->disk.ctime = time(NULL);
-    inode->dirty = true;
+    inode_mark_dirty(ctx->icache, inode);
 
     inode_unlock(inode);
     inode_put(ctx->icache, inode);
@@ -706,7 +699,7 @@ int modernfs_chown(const char *path, uid_t uid, gid_t gid,
     }
 
     inode->disk.ctime = time(NULL);
-    inode->dirty = true;
+    inode_mark_dirty(ctx->icache, inode);
 
     inode_unlock(inode);
     inode_put(ctx->icache, inode);
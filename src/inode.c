@@ -1,4 +1,5 @@
 #include "modernfs/inode.h"
+#include "modernfs/extent.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -72,21 +73,233 @@ static inode_t_mem *hash_lookup(inode_cache_t *cache, inode_t inum) {
     return p;
 }
 
-// 读取超级块
-static int read_superblock(inode_cache_t *cache) {
-    uint8_t *buf = malloc(BLOCK_SIZE);
-    if (!buf) {
-        return MODERNFS_ERROR;
+// 把哈希表换成new_size个桶,内存不足时保留原表
+static void hash_resize(inode_cache_t *cache, uint32_t new_size) {
+    inode_t_mem **table = calloc(new_size, sizeof(inode_t_mem *));
+    if (!table) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < cache->hash_size; i++) {
+        inode_t_mem *p = cache->hash_table[i];
+        while (p) {
+            inode_t_mem *next = p->hash_next;
+            uint32_t h = inode_hash(p->inum, new_size);
+            p->hash_next = table[h];
+            table[h] = p;
+            p = next;
+        }
+    }
+
+    free(cache->hash_table);
+    cache->hash_table = table;
+    cache->hash_size = new_size;
+}
+
+// 条目数变化后按平均链长伸缩哈希表(调用者持有写锁)
+static void hash_maybe_resize(inode_cache_t *cache) {
+    if (cache->nr_inodes > cache->hash_size * 2) {
+        hash_resize(cache, cache->hash_size * 2);
+    } else if (cache->hash_size > cache->hash_min &&
+               cache->nr_inodes < cache->hash_size / 8) {
+        uint32_t new_size = cache->hash_size / 2;
+        hash_resize(cache, new_size < cache->hash_min ? cache->hash_min : new_size);
+    }
+}
+
+// ============ 缓存条目slab ============
+
+static void slab_unlink(inode_cache_t *cache, inode_slab_t *slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        cache->slabs = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = slab->next = NULL;
+}
+
+static void slab_push_front(inode_cache_t *cache, inode_slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = cache->slabs;
+    if (cache->slabs) {
+        cache->slabs->prev = slab;
+    }
+    cache->slabs = slab;
+}
+
+static void slab_push_back(inode_cache_t *cache, inode_slab_t *slab) {
+    inode_slab_t **pp = &cache->slabs;
+    inode_slab_t *prev = NULL;
+    while (*pp) {
+        prev = *pp;
+        pp = &(*pp)->next;
+    }
+    slab->prev = prev;
+    slab->next = NULL;
+    *pp = slab;
+}
+
+static inode_slab_t *slab_create(inode_cache_t *cache) {
+    inode_slab_t *slab = calloc(1, sizeof(inode_slab_t));
+    if (!slab) {
+        return NULL;
+    }
+
+    for (int i = INODE_SLAB_ENTRIES - 1; i >= 0; i--) {
+        inode_t_mem *inode = &slab->entries[i];
+        pthread_mutex_init(&inode->lock, NULL);
+        inode->slab = slab;
+        inode->next = slab->free_list;
+        slab->free_list = inode;
+    }
+
+    slab_push_front(cache, slab);
+    cache->slab_count++;
+    return slab;
+}
+
+// 有pages个暂存页的Inode需要预留的块: 每页一个数据块,另外为落盘时的extent节点
+// 预留——最坏每页一个extent、叶子分裂后半满,再加上树长高时每层一个节点
+static uint32_t delalloc_reserve_cost(uint32_t pages) {
+    if (pages == 0) {
+        return 0;
+    }
+    return pages + pages / (EXTENT_BLOCK_ENTRIES / 2) + EXTENT_MAX_DEPTH + 1;
+}
+
+// 修改暂存页数并相应调整delalloc_reserved
+static void delalloc_set_count(inode_cache_t *cache, inode_t_mem *inode, uint32_t count) {
+    uint32_t old_cost = delalloc_reserve_cost(inode->delalloc_count);
+    uint32_t new_cost = delalloc_reserve_cost(count);
+
+    inode->delalloc_count = count;
+    if (new_cost > old_cost) {
+        __sync_fetch_and_add(&cache->delalloc_reserved, new_cost - old_cost);
+    } else {
+        __sync_fetch_and_sub(&cache->delalloc_reserved, old_cost - new_cost);
+    }
+}
+
+// 条目被换出或释放时不能再有暂存页,万一有就丢弃并归还预留,
+// 不能留给下一个使用这个条目的Inode
+static void entry_drop_delalloc(inode_cache_t *cache, inode_t_mem *inode) {
+    if (inode->delalloc_count == 0) {
+        return;
+    }
+
+    fprintf(stderr, "inode cache: dropping %u staged pages of inode %u\n",
+            inode->delalloc_count, inode->inum);
+    for (uint32_t i = 0; i < inode->delalloc_count; i++) {
+        free(inode->delalloc_pages[i].data);
+    }
+    delalloc_set_count(cache, inode, 0);
+}
+
+static void slab_destroy(inode_cache_t *cache, inode_slab_t *slab) {
+    slab_unlink(cache, slab);
+    for (int i = 0; i < INODE_SLAB_ENTRIES; i++) {
+        inode_t_mem *inode = &slab->entries[i];
+        for (uint32_t j = 0; j < inode->delalloc_count; j++) {
+            free(inode->delalloc_pages[j].data);
+        }
+        free(inode->delalloc_pages);
+        pthread_mutex_destroy(&inode->lock);
+    }
+    free(slab);
+    cache->slab_count--;
+}
+
+// 取一个空闲条目并挂到LRU头部,内存不足时返回NULL(调用者持有写锁)
+static inode_t_mem *entry_alloc(inode_cache_t *cache) {
+    inode_slab_t *slab = cache->slabs;
+    if (!slab || !slab->free_list) {
+        slab = slab_create(cache);
+        if (!slab) {
+            return NULL;
+        }
+    }
+
+    inode_t_mem *inode = slab->free_list;
+    slab->free_list = inode->next;
+    inode->next = NULL;
+    if (++slab->used == INODE_SLAB_ENTRIES) {
+        // 满的slab挪到后面,前面始终是有空闲条目的slab
+        slab_unlink(cache, slab);
+        slab_push_back(cache, slab);
+    }
+
+    cache->nr_inodes++;
+    lru_push_front(cache, inode);
+    return inode;
+}
+
+// 释放一个不在哈希表中的条目(调用者持有写锁)
+static void entry_free(inode_cache_t *cache, inode_t_mem *inode) {
+    inode_slab_t *slab = inode->slab;
+
+    lru_remove(cache, inode);
+    cache->nr_inodes--;
+
+    entry_drop_delalloc(cache, inode);
+    free(inode->delalloc_pages);
+    inode->delalloc_pages = NULL;
+    inode->delalloc_cap = 0;
+    inode->valid = 0;
+
+    inode->next = slab->free_list;
+    slab->free_list = inode;
+    slab->used--;
+
+    // 空出条目的slab挪到前面;已有的条目超出预算时释放整个空slab
+    slab_unlink(cache, slab);
+    if (slab->used == 0 &&
+        (uint64_t)cache->slab_count * INODE_SLAB_ENTRIES > cache->max_inodes) {
+        slab_push_front(cache, slab);
+        slab_destroy(cache, slab);
+    } else {
+        slab_push_front(cache, slab);
+    }
+}
+
+// 从LRU尾部释放最多limit个没有引用、已写回的条目,直到不超过上限(调用者持有写锁)
+static void shrink_to_budget(inode_cache_t *cache, uint32_t limit) {
+    inode_t_mem *inode = cache->lru_tail;
+
+    while (inode && limit > 0 && cache->nr_inodes > cache->max_inodes) {
+        inode_t_mem *prev = inode->prev;
+
+        // 还挂在脏链表上的条目要等inode_sync_all把它摘下来
+        pthread_mutex_lock(&cache->dirty_lock);
+        bool on_list = inode->on_dirty_list;
+        pthread_mutex_unlock(&cache->dirty_lock);
+
+        if (__atomic_load_n(&inode->ref_count, __ATOMIC_ACQUIRE) == 0 &&
+            !on_list && !inode->dirty && !inode->time_dirty &&
+            inode->delalloc_count == 0) {
+            hash_remove(cache, inode);
+            entry_free(cache, inode);
+            limit--;
+        }
+        inode = prev;
     }
 
-    int ret = blkdev_read(cache->dev, SUPERBLOCK_BLOCK, buf);
-    if (ret != 0) {
-        free(buf);
+    hash_maybe_resize(cache);
+}
+
+// 读取超级块
+static int read_superblock(inode_cache_t *cache) {
+    buffer_head_t *bh = blkdev_get_block(cache->dev, SUPERBLOCK_BLOCK);
+    if (!bh) {
         return MODERNFS_EIO;
     }
 
-    memcpy(&cache->sb, buf, sizeof(superblock_t));
-    free(buf);
+    pthread_rwlock_rdlock(&bh->lock);
+    memcpy(&cache->sb, bh->data, sizeof(superblock_t));
+    pthread_rwlock_unlock(&bh->lock);
+    blkdev_release_block(cache->dev, bh, false);
 
     if (cache->sb.magic != SUPERBLOCK_MAGIC) {
         fprintf(stderr, "Invalid superblock magic: 0x%x\n", cache->sb.magic);
@@ -96,6 +309,94 @@ static int read_superblock(inode_cache_t *cache) {
     return MODERNFS_SUCCESS;
 }
 
+// 从Inode表读取磁盘Inode
+static int load_disk_inode(inode_cache_t *cache, inode_t_mem *inode) {
+    uint32_t inode_block = cache->sb.inode_table_start +
+                           (inode->inum * INODE_SIZE) / BLOCK_SIZE;
+    uint32_t offset = (inode->inum * INODE_SIZE) % BLOCK_SIZE;
+
+    buffer_head_t *bh = blkdev_get_block(cache->dev, inode_block);
+    if (!bh) {
+        return MODERNFS_EIO;
+    }
+
+    pthread_rwlock_rdlock(&bh->lock);
+    memcpy(&inode->disk, bh->data + offset, sizeof(disk_inode_t));
+    pthread_rwlock_unlock(&bh->lock);
+    blkdev_release_block(cache->dev, bh, false);
+
+    // 缓存槽可能刚换了主人,旧的映射一律作废
+    memset(inode->map_runs, 0, sizeof(inode->map_runs));
+    inode->map_next = 0;
+
+    return MODERNFS_SUCCESS;
+}
+
+// ============ Inode位图按字扫描 ============
+
+#define INODES_PER_BLOCK (BLOCK_SIZE / INODE_SIZE)
+
+static inline uint64_t ibitmap_word(const uint8_t *bitmap, uint32_t word) {
+    uint64_t w;
+    memcpy(&w, bitmap + (size_t)word * sizeof(uint64_t), sizeof(w));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+// 返回[from, end)中第一个空闲位,不存在时返回end
+static uint32_t ibitmap_find_free(const uint8_t *bitmap, uint32_t from, uint32_t end) {
+    if (from >= end) {
+        return end;
+    }
+
+    uint32_t end_word = (end + 63) / 64;
+    uint32_t word = from / 64;
+    uint64_t w = ~ibitmap_word(bitmap, word) & (~0ULL << (from % 64));
+
+    while (w == 0) {
+        if (++word >= end_word) {
+            return end;
+        }
+        w = ~ibitmap_word(bitmap, word);
+    }
+
+    uint32_t bit = word * 64 + (uint32_t)__builtin_ctzll(w);
+    return bit < end ? bit : end;
+}
+
+// 按超级块的分配组切分Inode号空间并统计各组空闲数
+static int init_inode_groups(inode_cache_t *cache) {
+    uint32_t total = cache->sb.total_inodes;
+    uint32_t per_group = cache->sb.group_inodes ? cache->sb.group_inodes : total;
+    uint32_t count = cache->sb.group_count ? cache->sb.group_count : 1;
+
+    cache->groups = calloc(count, sizeof(inode_group_t));
+    if (!cache->groups) {
+        return MODERNFS_ERROR;
+    }
+    cache->group_count = count;
+
+    // Inode 0保留,不参与分配
+    cache->inode_bitmap[0] |= 0x01;
+
+    for (uint32_t g = 0; g < count; g++) {
+        inode_group_t *grp = &cache->groups[g];
+        uint64_t start = (uint64_t)g * per_group;
+        grp->start = start < total ? (uint32_t)start : total;
+        grp->len = (total - grp->start < per_group) ? total - grp->start : per_group;
+        grp->cursor = grp->start;
+        for (uint32_t i = grp->start; i < grp->start + grp->len; i++) {
+            if (!(cache->inode_bitmap[i / 8] & (1 << (i % 8)))) {
+                grp->free++;
+            }
+        }
+    }
+
+    return MODERNFS_SUCCESS;
+}
+
 // 加载Inode位图
 static int load_inode_bitmap(inode_cache_t *cache) {
     cache->bitmap_blocks = cache->sb.inode_bitmap_blocks;
@@ -116,24 +417,25 @@ static int load_inode_bitmap(inode_cache_t *cache) {
         }
     }
 
+    if (init_inode_groups(cache) != MODERNFS_SUCCESS) {
+        free(cache->inode_bitmap);
+        cache->inode_bitmap = NULL;
+        return MODERNFS_ERROR;
+    }
+
     return MODERNFS_SUCCESS;
 }
 
-// 同步Inode位图到磁盘
-static int sync_inode_bitmap(inode_cache_t *cache) {
-    pthread_mutex_lock(&cache->bitmap_lock);
-
-    for (uint32_t i = 0; i < cache->bitmap_blocks; i++) {
-        int ret = blkdev_write(cache->dev, cache->sb.inode_bitmap_start + i,
-                               cache->inode_bitmap + i * BLOCK_SIZE);
-        if (ret != 0) {
-            pthread_mutex_unlock(&cache->bitmap_lock);
-            return MODERNFS_EIO;
-        }
-    }
+// 把inum所在的Inode位图块写回磁盘(每次分配和释放只改动这一块)
+static int sync_inode_bitmap(inode_cache_t *cache, inode_t inum) {
+    uint32_t block = inum / (BLOCK_SIZE * 8);
 
+    pthread_mutex_lock(&cache->bitmap_lock);
+    int ret = blkdev_write(cache->dev, cache->sb.inode_bitmap_start + block,
+                           cache->inode_bitmap + (size_t)block * BLOCK_SIZE);
     pthread_mutex_unlock(&cache->bitmap_lock);
-    return MODERNFS_SUCCESS;
+
+    return ret != 0 ? MODERNFS_EIO : MODERNFS_SUCCESS;
 }
 
 // ============ Inode缓存初始化和销毁 ============
@@ -150,7 +452,8 @@ inode_cache_t *inode_cache_init(block_device_t *dev,
     cache->dev = dev;
     cache->balloc = balloc;
     cache->max_inodes = max_inodes;
-    cache->hash_size = hash_size;
+    cache->hash_min = hash_size < INODE_HASH_MIN ? INODE_HASH_MIN : hash_size;
+    cache->hash_size = cache->hash_min;
 
     // 读取超级块
     if (read_superblock(cache) != MODERNFS_SUCCESS) {
@@ -158,36 +461,20 @@ inode_cache_t *inode_cache_init(block_device_t *dev,
         return NULL;
     }
 
-    // 分配Inode池
-    cache->inodes = calloc(max_inodes, sizeof(inode_t_mem));
-    if (!cache->inodes) {
-        free(cache);
-        return NULL;
-    }
-
-    // 初始化每个Inode
-    for (uint32_t i = 0; i < max_inodes; i++) {
-        pthread_mutex_init(&cache->inodes[i].lock, NULL);
-        cache->inodes[i].ref_count = 0;
-        cache->inodes[i].valid = 0;
-        lru_push_front(cache, &cache->inodes[i]);
-    }
-
-    // 分配哈希表
-    cache->hash_table = calloc(hash_size, sizeof(inode_t_mem *));
+    // 分配哈希表,缓存条目在inode_get未命中时才分配
+    cache->hash_table = calloc(cache->hash_size, sizeof(inode_t_mem *));
     if (!cache->hash_table) {
-        free(cache->inodes);
         free(cache);
         return NULL;
     }
 
     pthread_rwlock_init(&cache->cache_lock, NULL);
     pthread_mutex_init(&cache->bitmap_lock, NULL);
+    pthread_mutex_init(&cache->dirty_lock, NULL);
 
     // 加载Inode位图
     if (load_inode_bitmap(cache) != MODERNFS_SUCCESS) {
         free(cache->hash_table);
-        free(cache->inodes);
         free(cache);
         return NULL;
     }
@@ -198,58 +485,197 @@ inode_cache_t *inode_cache_init(block_device_t *dev,
 void inode_cache_destroy(inode_cache_t *cache) {
     if (!cache) return;
 
-    // 同步所有脏Inode
-    inode_sync_all(cache);
+    // 写出延迟分配的数据,再同步所有脏Inode(包括只改了时间戳的)
+    inode_flush_all_delalloc(cache);
+    inode_sync_times(cache);
 
-    // 同步位图
-    sync_inode_bitmap(cache);
+    // Inode位图在每次分配和释放时已经写回,这里不用再写
 
     // 释放资源
     if (cache->inode_bitmap) {
         free(cache->inode_bitmap);
     }
+    free(cache->groups);
 
     if (cache->hash_table) {
         free(cache->hash_table);
     }
 
-    if (cache->inodes) {
-        for (uint32_t i = 0; i < cache->max_inodes; i++) {
-            pthread_mutex_destroy(&cache->inodes[i].lock);
-        }
-        free(cache->inodes);
+    while (cache->slabs) {
+        slab_destroy(cache, cache->slabs);
     }
 
     pthread_rwlock_destroy(&cache->cache_lock);
     pthread_mutex_destroy(&cache->bitmap_lock);
+    pthread_mutex_destroy(&cache->dirty_lock);
 
     free(cache);
 }
 
+void inode_cache_set_budget(inode_cache_t *cache, size_t bytes) {
+    size_t slabs = bytes / sizeof(inode_slab_t);
+    if (slabs == 0) {
+        slabs = 1;
+    }
+    if (slabs > UINT32_MAX / INODE_SLAB_ENTRIES) {
+        slabs = UINT32_MAX / INODE_SLAB_ENTRIES;
+    }
+
+    pthread_rwlock_wrlock(&cache->cache_lock);
+    cache->max_inodes = (uint32_t)slabs * INODE_SLAB_ENTRIES;
+    shrink_to_budget(cache, UINT32_MAX);
+    pthread_rwlock_unlock(&cache->cache_lock);
+}
+
 // ============ Inode分配和释放 ============
 
+// 组内空闲数据块数,块分配器没有按同样的组切分时返回UINT32_MAX(不作限制)
+static uint32_t group_free_blocks(inode_cache_t *cache, uint32_t g) {
+    block_allocator_t *balloc = cache->balloc;
+    if (!balloc || balloc->group_count != cache->group_count) {
+        return UINT32_MAX;
+    }
+    return __atomic_load_n(&balloc->groups[g].free, __ATOMIC_RELAXED);
+}
+
+static uint32_t avg_free_blocks(inode_cache_t *cache) {
+    block_allocator_t *balloc = cache->balloc;
+    if (!balloc || balloc->group_count != cache->group_count) {
+        return 0;
+    }
+    return __atomic_load_n(&balloc->free_blocks, __ATOMIC_RELAXED) / cache->group_count;
+}
+
+// 分散放置目录: 从dir_rotor开始,在空闲块不低于平均值的组中取空闲Inode最多的组,
+// 都不满足时只看空闲Inode。调用者持有bitmap_lock
+static uint32_t pick_spread_group(inode_cache_t *cache) {
+    uint32_t avg_blocks = avg_free_blocks(cache);
+    uint32_t best = UINT32_MAX;
+    uint32_t fallback = UINT32_MAX;
+
+    for (uint32_t i = 0; i < cache->group_count; i++) {
+        uint32_t g = (cache->dir_rotor + i) % cache->group_count;
+        uint32_t free_inodes = cache->groups[g].free;
+        if (free_inodes == 0) {
+            continue;
+        }
+        if (fallback == UINT32_MAX || free_inodes > cache->groups[fallback].free) {
+            fallback = g;
+        }
+        if (group_free_blocks(cache, g) >= avg_blocks &&
+            (best == UINT32_MAX || free_inodes > cache->groups[best].free)) {
+            best = g;
+        }
+    }
+
+    if (best == UINT32_MAX) {
+        best = (fallback == UINT32_MAX) ? 0 : fallback;
+    }
+    cache->dir_rotor = (best + 1) % cache->group_count;
+    return best;
+}
+
+// 按Orlov策略选择起始组,调用者持有bitmap_lock
+static uint32_t pick_inode_group(inode_cache_t *cache, uint8_t type, inode_t parent) {
+    uint32_t parent_group = 0;
+    if (parent != 0 && parent < cache->sb.total_inodes) {
+        parent_group = inode_group(cache, parent);
+        if (parent_group >= cache->group_count) {
+            parent_group = 0;
+        }
+    }
+
+    if (type != INODE_TYPE_DIR || cache->group_count == 1) {
+        return parent_group;
+    }
+
+    // 根目录下的目录分散到各组,子目录尽量和父目录在一起
+    if (parent == 0 || parent == cache->sb.root_inum) {
+        return pick_spread_group(cache);
+    }
+
+    uint32_t total_free = 0;
+    for (uint32_t g = 0; g < cache->group_count; g++) {
+        total_free += cache->groups[g].free;
+    }
+    if (cache->groups[parent_group].free >= total_free / cache->group_count &&
+        group_free_blocks(cache, parent_group) >= avg_free_blocks(cache)) {
+        return parent_group;
+    }
+    return pick_spread_group(cache);
+}
+
+// 在组g中取一个空闲Inode: 先看near所在的Inode表块,再从组的Next-Fit游标处找。
+// 没有空闲Inode时返回0。调用者持有bitmap_lock
+static inode_t group_take_inode(inode_cache_t *cache, uint32_t g, inode_t near) {
+    inode_group_t *grp = &cache->groups[g];
+    if (grp->free == 0) {
+        return 0;
+    }
+
+    uint32_t end = grp->start + grp->len;
+    uint32_t bit = end;
+
+    if (near != 0 && near >= grp->start && near < end) {
+        uint32_t lo = near / INODES_PER_BLOCK * INODES_PER_BLOCK;
+        uint32_t hi = lo + INODES_PER_BLOCK;
+        if (lo < grp->start) lo = grp->start;
+        if (hi > end) hi = end;
+        bit = ibitmap_find_free(cache->inode_bitmap, lo, hi);
+        if (bit >= hi) {
+            bit = end;
+        }
+    }
+
+    if (bit >= end) {
+        bit = ibitmap_find_free(cache->inode_bitmap, grp->cursor, end);
+        if (bit >= end) {
+            bit = ibitmap_find_free(cache->inode_bitmap, grp->start, grp->cursor);
+            if (bit >= grp->cursor) {
+                fprintf(stderr, "inode_alloc: inconsistent group %u (free=%u but none found)\n",
+                        g, grp->free);
+                return 0;
+            }
+        }
+        grp->cursor = (bit + 1 == end) ? grp->start : bit + 1;
+    }
+
+    cache->inode_bitmap[bit / 8] |= (1 << (bit % 8));
+    grp->free--;
+    return bit;
+}
+
+// 把Inode还回位图
+static void release_inode_bit(inode_cache_t *cache, inode_t inum) {
+    pthread_mutex_lock(&cache->bitmap_lock);
+    cache->inode_bitmap[inum / 8] &= ~(1 << (inum % 8));
+    uint32_t g = inode_group(cache, inum);
+    if (g >= cache->group_count) {
+        g = 0;
+    }
+    cache->groups[g].free++;
+    pthread_mutex_unlock(&cache->bitmap_lock);
+}
+
 inode_t_mem *inode_alloc(inode_cache_t *cache, uint8_t type) {
+    return inode_alloc_near(cache, type, 0);
+}
+
+inode_t_mem *inode_alloc_near(inode_cache_t *cache, uint8_t type, inode_t parent) {
     pthread_mutex_lock(&cache->bitmap_lock);
 
-    // 在位图中查找空闲Inode
+    // 从选中的组开始找,组满时换下一组
+    uint32_t first = pick_inode_group(cache, type, parent);
+    inode_t near = (type != INODE_TYPE_DIR) ? parent : 0;
     inode_t inum = 0;
-    int found = 0;
-
-    for (uint32_t i = 0; i < cache->sb.total_inodes; i++) {
-        uint32_t byte_idx = i / 8;
-        uint32_t bit_idx = i % 8;
 
-        if (!(cache->inode_bitmap[byte_idx] & (1 << bit_idx))) {
-            inum = i;
-            cache->inode_bitmap[byte_idx] |= (1 << bit_idx);
-            found = 1;
-            break;
-        }
+    for (uint32_t i = 0; i < cache->group_count && inum == 0; i++) {
+        inum = group_take_inode(cache, (first + i) % cache->group_count, near);
     }
 
     pthread_mutex_unlock(&cache->bitmap_lock);
 
-    if (!found) {
+    if (inum == 0) {
         errno = ENOSPC;
         return NULL;
     }
@@ -258,11 +684,7 @@ inode_t_mem *inode_alloc(inode_cache_t *cache, uint8_t type) {
     inode_t_mem *inode = inode_get(cache, inum);
     if (!inode) {
         // 回滚位图
-        pthread_mutex_lock(&cache->bitmap_lock);
-        uint32_t byte_idx = inum / 8;
-        uint32_t bit_idx = inum % 8;
-        cache->inode_bitmap[byte_idx] &= ~(1 << bit_idx);
-        pthread_mutex_unlock(&cache->bitmap_lock);
+        release_inode_bit(cache, inum);
         return NULL;
     }
 
@@ -274,6 +696,10 @@ inode_t_mem *inode_alloc(inode_cache_t *cache, uint8_t type) {
     inode->disk.size = 0;
     inode->disk.blocks = 0;
     inode->disk.ctime = inode->disk.mtime = inode->disk.atime = time(NULL);
+    if (type == INODE_TYPE_FILE) {
+        // 普通文件使用extent树;目录和符号链接保留直接/间接块映射
+        extent_tree_init(inode);
+    }
     inode->valid = 1;  // 确保 valid=1 以便 inode_sync 可以正常工作
     inode->dirty = 1;
 
@@ -281,11 +707,7 @@ inode_t_mem *inode_alloc(inode_cache_t *cache, uint8_t type) {
     if (inode_sync(cache, inode) != MODERNFS_SUCCESS) {
         inode_unlock(inode);
         // 回滚位图
-        pthread_mutex_lock(&cache->bitmap_lock);
-        uint32_t byte_idx = inum / 8;
-        uint32_t bit_idx = inum % 8;
-        cache->inode_bitmap[byte_idx] &= ~(1 << bit_idx);
-        pthread_mutex_unlock(&cache->bitmap_lock);
+        release_inode_bit(cache, inum);
         inode_put(cache, inode);
         return NULL;
     }
@@ -295,7 +717,7 @@ inode_t_mem *inode_alloc(inode_cache_t *cache, uint8_t type) {
     cache->sb.free_inodes--;
 
     // 同步位图
-    sync_inode_bitmap(cache);
+    sync_inode_bitmap(cache, inum);
 
     return inode;
 }
@@ -320,465 +742,1577 @@ int inode_free(inode_cache_t *cache, inode_t_mem *inode) {
     inode_put(cache, inode);
 
     // 清除位图
-    pthread_mutex_lock(&cache->bitmap_lock);
-    uint32_t byte_idx = inum / 8;
-    uint32_t bit_idx = inum % 8;
-    cache->inode_bitmap[byte_idx] &= ~(1 << bit_idx);
-    pthread_mutex_unlock(&cache->bitmap_lock);
+    release_inode_bit(cache, inum);
 
     // 更新超级块
     cache->sb.free_inodes++;
 
     // 同步位图
-    sync_inode_bitmap(cache);
+    sync_inode_bitmap(cache, inum);
 
     return MODERNFS_SUCCESS;
 }
 
 // ============ Inode获取和释放引用 ============
 
-inode_t_mem *inode_get(inode_cache_t *cache, inode_t inum) {
-    pthread_rwlock_wrlock(&cache->cache_lock);
-
-    // 在哈希表中查找
+// 读锁下查找,命中时原子增加引用计数并置访问位,不移动LRU
+static inode_t_mem *lookup_hit(inode_cache_t *cache, inode_t inum) {
+    pthread_rwlock_rdlock(&cache->cache_lock);
     inode_t_mem *inode = hash_lookup(cache, inum);
-
     if (inode) {
-        // 找到了，增加引用计数
-        inode->ref_count++;
-        lru_remove(cache, inode);
-        lru_push_front(cache, inode);
-        pthread_rwlock_unlock(&cache->cache_lock);
+        __atomic_fetch_add(&inode->ref_count, 1, __ATOMIC_ACQUIRE);
+        if (!__atomic_load_n(&inode->referenced, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&inode->referenced, 1, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_rwlock_unlock(&cache->cache_lock);
+    return inode;
+}
 
-        // 如果未加载，从磁盘读取
-        if (!inode->valid) {
-            inode_lock(inode);
-            if (!inode->valid) {
-                uint32_t inode_block = cache->sb.inode_table_start +
-                                       (inum * INODE_SIZE) / BLOCK_SIZE;
-                uint32_t offset = (inum * INODE_SIZE) % BLOCK_SIZE;
-
-                uint8_t *buf = malloc(BLOCK_SIZE);
-                if (!buf || blkdev_read(cache->dev, inode_block, buf) != 0) {
-                    free(buf);
-                    inode_unlock(inode);
-                    inode_put(cache, inode);
-                    return NULL;
-                }
+// 从LRU尾部找淘汰对象(调用者持有写锁): 跳过有引用的,
+// 访问位置位的清零后移到头部再给一次机会
+static inode_t_mem *find_victim(inode_cache_t *cache) {
+    uint32_t scanned = 0;
+    inode_t_mem *inode = cache->lru_tail;
 
-                memcpy(&inode->disk, buf + offset, sizeof(disk_inode_t));
-                free(buf);
+    while (inode && scanned < 2 * cache->nr_inodes) {
+        inode_t_mem *prev = inode->prev;
+        scanned++;
 
-                inode->valid = 1;
+        if (__atomic_load_n(&inode->ref_count, __ATOMIC_ACQUIRE) == 0) {
+            if (!__atomic_exchange_n(&inode->referenced, 0, __ATOMIC_RELAXED)) {
+                return inode;
+            }
+            lru_remove(cache, inode);
+            lru_push_front(cache, inode);
+            if (!prev) {
+                prev = cache->lru_tail;
             }
-            inode_unlock(inode);
         }
+        inode = prev;
+    }
 
+    return NULL;
+}
+
+// 确保缓存条目已从磁盘读取
+static inode_t_mem *ensure_loaded(inode_cache_t *cache, inode_t_mem *inode) {
+    if (__atomic_load_n(&inode->valid, __ATOMIC_ACQUIRE)) {
         return inode;
     }
 
-    // 没找到，需要分配一个缓存条目
-    // 从LRU尾部查找引用计数为0的Inode
-    inode = cache->lru_tail;
-    while (inode && inode->ref_count > 0) {
-        inode = inode->prev;
+    inode_lock(inode);
+    if (!inode->valid) {
+        if (load_disk_inode(cache, inode) != MODERNFS_SUCCESS) {
+            inode_unlock(inode);
+            inode_put(cache, inode);
+            return NULL;
+        }
+        __atomic_store_n(&inode->valid, 1, __ATOMIC_RELEASE);
     }
+    inode_unlock(inode);
 
-    if (!inode) {
-        pthread_rwlock_unlock(&cache->cache_lock);
-        errno = ENOMEM;
-        return NULL;
+    return inode;
+}
+
+inode_t_mem *inode_get(inode_cache_t *cache, inode_t inum) {
+    // 命中: 只加读锁
+    inode_t_mem *inode = lookup_hit(cache, inum);
+    if (inode) {
+        return ensure_loaded(cache, inode);
     }
 
-    // 如果是脏的，先写回
-    if (inode->dirty && inode->valid) {
-        inode_sync(cache, inode);
+    inode_t_mem *flushed = NULL;
+    bool flush_failed = false;    // 本次有暂存页落盘失败
+    bool fresh = false;
+    for (;;) {
+        pthread_rwlock_wrlock(&cache->cache_lock);
+
+        // 加写锁前可能已被其他线程换入
+        inode = hash_lookup(cache, inum);
+        if (inode) {
+            __atomic_fetch_add(&inode->ref_count, 1, __ATOMIC_ACQUIRE);
+            __atomic_store_n(&inode->referenced, 1, __ATOMIC_RELAXED);
+            pthread_rwlock_unlock(&cache->cache_lock);
+            return ensure_loaded(cache, inode);
+        }
+
+        // 没到上限时分配新条目;到了上限先换出,全部被引用时临时超出上限
+        if (cache->nr_inodes < cache->max_inodes) {
+            inode = entry_alloc(cache);
+            if (inode) {
+                fresh = true;
+                break;
+            }
+        }
+
+        inode = find_victim(cache);
+        if (!inode) {
+            inode = entry_alloc(cache);
+            if (!inode) {
+                pthread_rwlock_unlock(&cache->cache_lock);
+                errno = ENOMEM;
+                return NULL;
+            }
+            fresh = true;
+            break;
+        }
+
+        // 写回过一次仍是脏的(写回出错)时不再重试,与直接淘汰一样处理
+        if (!inode->valid ||
+            (inode->delalloc_count == 0 &&
+             (inode == flushed || (!inode->dirty && !inode->time_dirty)))) {
+            break;
+        }
+
+        // 暂存页落盘失败(如空间不足)的条目不能换出,否则数据会丢失或被带到
+        // 新的Inode上。落盘已经失败过一次时不再逐个重试,临时超出上限
+        if (inode->delalloc_count > 0 && (inode == flushed || flush_failed)) {
+            inode = entry_alloc(cache);
+            if (!inode) {
+                pthread_rwlock_unlock(&cache->cache_lock);
+                errno = ENOMEM;
+                return NULL;
+            }
+            fresh = true;
+            break;
+        }
+
+        // 脏的淘汰对象: 持有引用防止被别人换出,放开缓存锁后再写回,然后重新选择。
+        // 拿不到Inode锁说明它正被使用,置访问位让下一轮跳过它
+        __atomic_fetch_add(&inode->ref_count, 1, __ATOMIC_ACQUIRE);
+        pthread_rwlock_unlock(&cache->cache_lock);
+
+        if (pthread_mutex_trylock(&inode->lock) == 0) {
+            // 暂存的延迟分配页先落盘,再写回Inode;落盘失败时置访问位先换别的
+            if (inode->delalloc_count > 0 &&
+                inode_flush_delalloc(cache, inode) != MODERNFS_SUCCESS) {
+                __atomic_store_n(&inode->referenced, 1, __ATOMIC_RELAXED);
+                flush_failed = true;
+            }
+            inode_sync(cache, inode);
+            inode_unlock(inode);
+            flushed = inode;
+        } else {
+            __atomic_store_n(&inode->referenced, 1, __ATOMIC_RELAXED);
+        }
+        inode_put(cache, inode);
     }
 
-    // 从哈希表和LRU中移除
-    if (inode->valid) {
+    // 干净的淘汰对象直接在写锁下换出
+    if (!fresh) {
+        entry_drop_delalloc(cache, inode);
         hash_remove(cache, inode);
+        lru_remove(cache, inode);
+        lru_push_front(cache, inode);
     }
-    lru_remove(cache, inode);
 
-    // 重新初始化
     inode->inum = inum;
     inode->ref_count = 1;
     inode->valid = 0;
     inode->dirty = 0;
+    inode->time_dirty = 0;
+    inode->referenced = 0;
 
-    // 插入哈希表和LRU
     hash_insert(cache, inode);
-    lru_push_front(cache, inode);
+
+    // 之前超出上限的条目在这里逐步收缩回来
+    if (cache->nr_inodes > cache->max_inodes) {
+        shrink_to_budget(cache, 8);
+    } else {
+        hash_maybe_resize(cache);
+    }
 
     pthread_rwlock_unlock(&cache->cache_lock);
 
     // 从磁盘读取
-    inode_lock(inode);
-    uint32_t inode_block = cache->sb.inode_table_start +
-                           (inum * INODE_SIZE) / BLOCK_SIZE;
-    uint32_t offset = (inum * INODE_SIZE) % BLOCK_SIZE;
+    return ensure_loaded(cache, inode);
+}
 
-    uint8_t *buf = malloc(BLOCK_SIZE);
-    if (!buf || blkdev_read(cache->dev, inode_block, buf) != 0) {
-        free(buf);
-        inode_unlock(inode);
-        inode_put(cache, inode);
-        return NULL;
+void inode_put(inode_cache_t *cache, inode_t_mem *inode) {
+    (void)cache;
+    if (!inode) return;
+
+    __atomic_fetch_sub(&inode->ref_count, 1, __ATOMIC_RELEASE);
+}
+
+void inode_lock(inode_t_mem *inode) {
+    pthread_mutex_lock(&inode->lock);
+}
+
+void inode_unlock(inode_t_mem *inode) {
+    pthread_mutex_unlock(&inode->lock);
+}
+
+// ============ Inode读写 ============
+
+// 写回前清除脏标志(acquire,看到置脏之前的修改);修改disk字段的一方在修改之后
+// 才置脏(release),修改因此要么被这次写回拷贝到,要么在清除之后重新置脏
+static void clear_dirty(inode_t_mem *inode) {
+    __atomic_exchange_n(&inode->dirty, 0, __ATOMIC_ACQUIRE);
+    __atomic_exchange_n(&inode->time_dirty, 0, __ATOMIC_ACQUIRE);
+}
+
+int inode_sync(inode_cache_t *cache, inode_t_mem *inode) {
+    if (!inode || !inode->valid || (!inode->dirty && !inode->time_dirty)) {
+        return MODERNFS_SUCCESS;
+    }
+
+    uint32_t inode_block = cache->sb.inode_table_start +
+                           (inode->inum * INODE_SIZE) / BLOCK_SIZE;
+    uint32_t offset = (inode->inum * INODE_SIZE) % BLOCK_SIZE;
+
+    // 直接在缓存块上修改,Inode表块中其他Inode保持不变
+    buffer_head_t *bh = blkdev_get_block(cache->dev, inode_block);
+    if (!bh) {
+        return MODERNFS_EIO;
     }
 
-    memcpy(&inode->disk, buf + offset, sizeof(disk_inode_t));
-    free(buf);
+    // 与批量写回一样先清脏标志再拷贝
+    clear_dirty(inode);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
 
-    inode->valid = 1;
-    inode_unlock(inode);
+    pthread_rwlock_wrlock(&bh->lock);
+    memcpy(bh->data + offset, &inode->disk, sizeof(disk_inode_t));
+    pthread_rwlock_unlock(&bh->lock);
+    blkdev_release_block(cache->dev, bh, true);
+
+    return MODERNFS_SUCCESS;
+}
+
+// 挂到脏Inode链表头部(已在链表上时不动)
+static void dirty_list_add(inode_cache_t *cache, inode_t_mem *inode) {
+    pthread_mutex_lock(&cache->dirty_lock);
+    if (!inode->on_dirty_list) {
+        inode->on_dirty_list = true;
+        inode->dirty_next = cache->dirty_head;
+        cache->dirty_head = inode;
+        cache->dirty_count++;
+    }
+    pthread_mutex_unlock(&cache->dirty_lock);
+}
+
+void inode_mark_dirty(inode_cache_t *cache, inode_t_mem *inode) {
+    __atomic_store_n(&inode->dirty, 1, __ATOMIC_RELEASE);
+    dirty_list_add(cache, inode);
+}
+
+void inode_mark_time_dirty(inode_cache_t *cache, inode_t_mem *inode) {
+    if (!cache->lazytime) {
+        inode_mark_dirty(cache, inode);
+        return;
+    }
+
+    __atomic_store_n(&inode->time_dirty, 1, __ATOMIC_RELEASE);
+    dirty_list_add(cache, inode);
+}
+
+void inode_touch_atime(inode_cache_t *cache, inode_t_mem *inode) {
+    uint64_t now = (uint64_t)time(NULL);
+    uint64_t atime = inode->disk.atime;
+
+    switch (cache->atime_mode) {
+    case INODE_ATIME_NOATIME:
+        return;
+    case INODE_ATIME_RELATIME:
+        // 上次访问之后没有修改过,且atime还不到一天,不用更新
+        if (atime > inode->disk.mtime && atime > inode->disk.ctime &&
+            now < atime + INODE_RELATIME_INTERVAL) {
+            return;
+        }
+        break;
+    case INODE_ATIME_STRICT:
+        break;
+    }
+
+    if (atime == now) {
+        return;
+    }
+    inode->disk.atime = now;
+    inode_mark_time_dirty(cache, inode);
+}
+
+static int cmp_inode_num(const void *a, const void *b) {
+    inode_t x = (*(inode_t_mem *const *)a)->inum;
+    inode_t y = (*(inode_t_mem *const *)b)->inum;
+    return (x > y) - (x < y);
+}
+
+// 把同一Inode表块中的一批脏Inode写进块缓存,块只取一次
+static int sync_table_block(inode_cache_t *cache, inode_t_mem **batch, uint32_t n) {
+    uint32_t inode_block = cache->sb.inode_table_start +
+                           (batch[0]->inum * INODE_SIZE) / BLOCK_SIZE;
+
+    buffer_head_t *bh = blkdev_get_block(cache->dev, inode_block);
+    if (!bh) {
+        return MODERNFS_EIO;
+    }
+
+    // 批量写回不持有Inode锁: 先清脏标志再拷贝,拷贝期间被修改的Inode会被
+    // inode_mark_dirty重新置脏并挂回链表,不会丢失这次修改
+    for (uint32_t i = 0; i < n; i++) {
+        clear_dirty(batch[i]);
+    }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    pthread_rwlock_wrlock(&bh->lock);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t offset = (batch[i]->inum * INODE_SIZE) % BLOCK_SIZE;
+        memcpy(bh->data + offset, &batch[i]->disk, sizeof(disk_inode_t));
+    }
+    pthread_rwlock_unlock(&bh->lock);
+    blkdev_release_block(cache->dev, bh, true);
+
+    return MODERNFS_SUCCESS;
+}
+
+// 批量写回脏链表上的Inode,with_times为false时只改了时间戳的Inode留在链表上
+static int sync_dirty_list(inode_cache_t *cache, bool with_times) {
+    pthread_rwlock_rdlock(&cache->cache_lock);
+
+    // 摘下整条脏链表,之后新弄脏的Inode挂到新链表上
+    pthread_mutex_lock(&cache->dirty_lock);
+    inode_t_mem *list = cache->dirty_head;
+    uint32_t count = cache->dirty_count;
+    cache->dirty_head = NULL;
+    cache->dirty_count = 0;
+
+    inode_t_mem **batch = count ? malloc(count * sizeof(inode_t_mem *)) : NULL;
+    uint32_t n = 0;
+    for (inode_t_mem *inode = list; inode; ) {
+        inode_t_mem *next = inode->dirty_next;
+        // 不持有Inode锁,脏标志可能正被并发置位
+        int dirty = __atomic_load_n(&inode->dirty, __ATOMIC_RELAXED);
+        int time_dirty = __atomic_load_n(&inode->time_dirty, __ATOMIC_RELAXED);
+        if (!with_times && !dirty && time_dirty) {
+            inode->dirty_next = cache->dirty_head;
+            cache->dirty_head = inode;
+            cache->dirty_count++;
+            inode = next;
+            continue;
+        }
+        inode->dirty_next = NULL;
+        inode->on_dirty_list = false;
+        if (inode->valid && (dirty || time_dirty)) {
+            if (batch) {
+                batch[n++] = inode;
+            } else {
+                // 内存不足时逐个写回
+                inode_sync(cache, inode);
+            }
+        }
+        inode = next;
+    }
+    pthread_mutex_unlock(&cache->dirty_lock);
+
+    int ret = MODERNFS_SUCCESS;
+    if (batch) {
+        // 按Inode号排序,同一表块的Inode相邻
+        qsort(batch, n, sizeof(inode_t_mem *), cmp_inode_num);
+
+        uint32_t i = 0;
+        while (i < n) {
+            uint32_t blk = batch[i]->inum / (BLOCK_SIZE / INODE_SIZE);
+            uint32_t j = i + 1;
+            while (j < n && batch[j]->inum / (BLOCK_SIZE / INODE_SIZE) == blk) {
+                j++;
+            }
+
+            if (sync_table_block(cache, batch + i, j - i) != MODERNFS_SUCCESS) {
+                // 没写出去的Inode重新挂回脏链表
+                for (uint32_t k = i; k < j; k++) {
+                    inode_mark_dirty(cache, batch[k]);
+                }
+                ret = MODERNFS_EIO;
+            }
+            i = j;
+        }
+        free(batch);
+    }
+
+    pthread_rwlock_unlock(&cache->cache_lock);
+
+    return ret;
+}
+
+int inode_sync_all(inode_cache_t *cache) {
+    return sync_dirty_list(cache, false);
+}
+
+int inode_sync_times(inode_cache_t *cache) {
+    return sync_dirty_list(cache, true);
+}
+
+// ============ 分配组 ============
+
+uint32_t inode_group(inode_cache_t *cache, inode_t inum) {
+    if (cache->sb.group_inodes == 0) {
+        return BALLOC_NO_GROUP;
+    }
+    return inum / cache->sb.group_inodes;
+}
+
+// 不动用延迟分配预留时最多还能分配的块数;落盘暂存页时预留本来就是给它用的
+static uint32_t unreserved_blocks(inode_cache_t *cache, const inode_t_mem *inode) {
+    uint32_t reserved = __atomic_load_n(&cache->delalloc_reserved, __ATOMIC_RELAXED);
+    if (reserved == 0 || inode->delalloc_flushing) {
+        return UINT32_MAX;
+    }
+
+    uint32_t free_blocks;
+    block_alloc_stats(cache->balloc, NULL, &free_blocks, NULL, NULL);
+    return free_blocks > reserved ? free_blocks - reserved : 0;
+}
+
+block_t inode_alloc_block(inode_cache_t *cache, inode_t_mem *inode) {
+    if (unreserved_blocks(cache, inode) == 0) {
+        return 0;
+    }
+    return block_alloc_in_group(cache->balloc, inode_group(cache, inode->inum));
+}
+
+// ============ 数据块映射 ============
+
+// 每个间接块可以存储多少个块号
+#define INDIRECT_BLOCKS_PER_BLOCK (BLOCK_SIZE / sizeof(block_t))
+
+// 单次区间读写最多覆盖的块数(1MB)
+#define INODE_RUN_MAX_BLOCKS BLKDEV_RANGE_PIN_BLOCKS
+
+// 新分配的间接块清零
+static int init_indirect_block(inode_cache_t *cache, block_t block) {
+    buffer_head_t *bh = blkdev_get_new_block(cache->dev, block);
+    if (!bh) {
+        return MODERNFS_EIO;
+    }
+
+    blkdev_release_block(cache->dev, bh, true);
+    return MODERNFS_SUCCESS;
+}
+
+// 读取间接块的第idx项,缺失且alloc_if_missing时分配新块并写入该项
+// child_is_indirect表示新分配的块本身是间接块,需要清零
+static int indirect_entry(inode_cache_t *cache,
+                          inode_t_mem *inode,
+                          block_t indirect_block,
+                          uint32_t idx,
+                          bool alloc_if_missing,
+                          bool child_is_indirect,
+                          block_t *block_out) {
+    buffer_head_t *bh = blkdev_get_block(cache->dev, indirect_block);
+    if (!bh) {
+        return MODERNFS_EIO;
+    }
+
+    pthread_rwlock_rdlock(&bh->lock);
+    block_t entry = ((block_t *)bh->data)[idx];
+    pthread_rwlock_unlock(&bh->lock);
+
+    if (entry != 0 || !alloc_if_missing) {
+        blkdev_release_block(cache->dev, bh, false);
+        *block_out = entry;
+        return MODERNFS_SUCCESS;
+    }
+
+    // 分配新块
+    block_t new_block = inode_alloc_block(cache, inode);
+    if (new_block == 0) {
+        blkdev_release_block(cache->dev, bh, false);
+        return MODERNFS_ENOSPC;
+    }
+
+    if (child_is_indirect && init_indirect_block(cache, new_block) != MODERNFS_SUCCESS) {
+        block_free(cache->balloc, new_block);
+        blkdev_release_block(cache->dev, bh, false);
+        return MODERNFS_EIO;
+    }
+
+    pthread_rwlock_wrlock(&bh->lock);
+    ((block_t *)bh->data)[idx] = new_block;
+    pthread_rwlock_unlock(&bh->lock);
+    blkdev_release_block(cache->dev, bh, true);
+
+    inode->disk.blocks++;
+    inode_mark_dirty(cache, inode);
+
+    *block_out = new_block;
+    return MODERNFS_SUCCESS;
+}
+
+// ============ Extent映射 ============
+
+static bool inode_uses_extents(const inode_t_mem *inode) {
+    return (inode->disk.flags & INODE_FLAG_EXTENTS) != 0;
+}
+
+// 逻辑块号须小于UINT32_MAX,extent树才能表示
+static int extent_lblk(uint64_t offset, uint32_t *lblk_out) {
+    uint64_t lblk = offset / BLOCK_SIZE;
+    if (lblk >= UINT32_MAX) {
+        return MODERNFS_EINVAL;
+    }
+    *lblk_out = (uint32_t)lblk;
+    return MODERNFS_SUCCESS;
+}
+
+// 为从lblk起的count块空洞分配一段连续块,目标位置紧接前一个逻辑块的物理块,
+// 使顺序写入的文件在磁盘上保持连续。实际分配的块数可能少于count
+static int extent_alloc_run(inode_cache_t *cache,
+                            inode_t_mem *inode,
+                            uint32_t lblk,
+                            uint32_t count,
+                            block_t *block_out,
+                            uint32_t *run_out) {
+    block_t goal = 0;
+    if (lblk > 0) {
+        uint32_t len;
+        int ret = extent_map(cache, inode, lblk - 1, &goal, &len);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+        if (goal != 0) {
+            goal++;
+        }
+    }
+
+    uint32_t avail = unreserved_blocks(cache, inode);
+    if (avail == 0) {
+        return MODERNFS_ENOSPC;
+    }
+    if (count > avail) {
+        count = avail;
+    }
+
+    // 文件的第一段数据放在Inode所在的组
+    block_t start;
+    uint32_t got;
+    int ret = (goal != 0) ?
+        block_alloc_near(cache->balloc, goal, count, &start, &got) :
+        block_alloc_group_extent(cache->balloc, inode_group(cache, inode->inum),
+                                 1, count, &start, &got);
+    if (ret < 0) {
+        return (ret == -ENOSPC) ? MODERNFS_ENOSPC : ret;
+    }
+
+    ret = extent_insert(cache, inode, lblk, start, got);
+    if (ret != MODERNFS_SUCCESS) {
+        block_free_multiple(cache->balloc, start, got);
+        return ret;
+    }
+
+    inode->disk.blocks += got;
+    inode_mark_dirty(cache, inode);
+
+    *block_out = start;
+    *run_out = got;
+    return MODERNFS_SUCCESS;
+}
+
+static int extent_bmap(inode_cache_t *cache,
+                       inode_t_mem *inode,
+                       uint64_t offset,
+                       bool alloc_if_missing,
+                       block_t *block_out) {
+    uint32_t lblk, len;
+    int ret = extent_lblk(offset, &lblk);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    ret = extent_map(cache, inode, lblk, block_out, &len);
+    if (ret != MODERNFS_SUCCESS || *block_out != 0 || !alloc_if_missing) {
+        return ret;
+    }
+
+    return extent_alloc_run(cache, inode, lblk, 1, block_out, &len);
+}
+
+int inode_bmap(inode_cache_t *cache,
+               inode_t_mem *inode,
+               uint64_t offset,
+               bool alloc_if_missing,
+               block_t *block_out) {
+    if (!inode || !block_out) {
+        return MODERNFS_EINVAL;
+    }
+
+    // 内联Inode没有数据块,需要分配时先搬到数据块
+    if (inode_is_inline(inode)) {
+        if (!alloc_if_missing) {
+            *block_out = 0;
+            return MODERNFS_SUCCESS;
+        }
+        int ret = inode_inline_spill(cache, inode);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+    }
+
+    if (inode_uses_extents(inode)) {
+        return extent_bmap(cache, inode, offset, alloc_if_missing, block_out);
+    }
+
+    uint32_t block_idx = offset / BLOCK_SIZE;
+
+    // 直接块
+    if (block_idx < INODE_DIRECT_BLOCKS) {
+        if (inode->disk.direct[block_idx] == 0) {
+            if (!alloc_if_missing) {
+                *block_out = 0;
+                return MODERNFS_SUCCESS;
+            }
+
+            // 分配新块
+            block_t new_block = inode_alloc_block(cache, inode);
+            if (new_block == 0) {
+                return MODERNFS_ENOSPC;
+            }
+
+            inode->disk.direct[block_idx] = new_block;
+            inode->disk.blocks++;
+            inode_mark_dirty(cache, inode);
+        }
+
+        *block_out = inode->disk.direct[block_idx];
+        return MODERNFS_SUCCESS;
+    }
+
+    block_idx -= INODE_DIRECT_BLOCKS;
+
+    // 一级间接块
+    if (block_idx < INDIRECT_BLOCKS_PER_BLOCK) {
+        if (inode->disk.indirect == 0) {
+            if (!alloc_if_missing) {
+                *block_out = 0;
+                return MODERNFS_SUCCESS;
+            }
+
+            // 分配间接块
+            block_t new_block = inode_alloc_block(cache, inode);
+            if (new_block == 0) {
+                return MODERNFS_ENOSPC;
+            }
+
+            if (init_indirect_block(cache, new_block) != MODERNFS_SUCCESS) {
+                block_free(cache->balloc, new_block);
+                return MODERNFS_EIO;
+            }
+
+            inode->disk.indirect = new_block;
+            inode->disk.blocks++;
+            inode_mark_dirty(cache, inode);
+        }
+
+        return indirect_entry(cache, inode, inode->disk.indirect, block_idx,
+                              alloc_if_missing, false, block_out);
+    }
+
+    block_idx -= INDIRECT_BLOCKS_PER_BLOCK;
+
+    // 二级间接块
+    if (block_idx < INDIRECT_BLOCKS_PER_BLOCK * INDIRECT_BLOCKS_PER_BLOCK) {
+        if (inode->disk.double_indirect == 0) {
+            if (!alloc_if_missing) {
+                *block_out = 0;
+                return MODERNFS_SUCCESS;
+            }
+
+            // 分配二级间接块
+            block_t new_block = inode_alloc_block(cache, inode);
+            if (new_block == 0) {
+                return MODERNFS_ENOSPC;
+            }
+
+            if (init_indirect_block(cache, new_block) != MODERNFS_SUCCESS) {
+                block_free(cache->balloc, new_block);
+                return MODERNFS_EIO;
+            }
+
+            inode->disk.double_indirect = new_block;
+            inode->disk.blocks++;
+            inode_mark_dirty(cache, inode);
+        }
+
+        uint32_t l1_idx = block_idx / INDIRECT_BLOCKS_PER_BLOCK;
+        uint32_t l2_idx = block_idx % INDIRECT_BLOCKS_PER_BLOCK;
+
+        // 读取二级间接块,得到一级间接块
+        block_t indirect_block;
+        int ret = indirect_entry(cache, inode, inode->disk.double_indirect, l1_idx,
+                                 alloc_if_missing, true, &indirect_block);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+
+        if (indirect_block == 0) {
+            *block_out = 0;
+            return MODERNFS_SUCCESS;
+        }
+
+        // 读取一级间接块
+        return indirect_entry(cache, inode, indirect_block, l2_idx,
+                              alloc_if_missing, false, block_out);
+    }
+
+    // 超出范围
+    return MODERNFS_EINVAL;
+}
+
+// ============ 块映射缓存 ============
+//
+// 只缓存已映射的区间。写入只会填补空洞,不会改变已有块的位置,
+// 所以缓存的区间在截断之前一直有效。
+
+static void map_cache_invalidate(inode_t_mem *inode) {
+    memset(inode->map_runs, 0, sizeof(inode->map_runs));
+    inode->map_next = 0;
+}
+
+static bool map_cache_lookup(inode_t_mem *inode, uint32_t lblk,
+                             block_t *pblk_out, uint32_t *len_out) {
+    for (int i = 0; i < INODE_MAP_CACHE_RUNS; i++) {
+        const inode_map_run_t *r = &inode->map_runs[i];
+        if (lblk - r->lblk < r->len) {
+            *pblk_out = r->pblk + (lblk - r->lblk);
+            *len_out = r->len - (lblk - r->lblk);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void map_cache_insert(inode_t_mem *inode, uint32_t lblk, block_t pblk, uint32_t len) {
+    inode->map_runs[inode->map_next] = (inode_map_run_t){ .lblk = lblk, .pblk = pblk, .len = len };
+    inode->map_next = (inode->map_next + 1) % INODE_MAP_CACHE_RUNS;
+}
+
+// 直接/间接块映射的区间查找: 整段区间只读取一次所在的间接块,
+// 区间不跨越直接块数组或单个间接块的边界
+static int legacy_bmap_run(inode_cache_t *cache,
+                           inode_t_mem *inode,
+                           uint64_t lblk,
+                           uint32_t max_blocks,
+                           block_t *block_out,
+                           uint32_t *run_out) {
+    block_t direct[INODE_DIRECT_BLOCKS];
+    const block_t *table;
+    uint32_t pos;
+    uint32_t span;
+    buffer_head_t *bh = NULL;
+
+    if (lblk < INODE_DIRECT_BLOCKS) {
+        for (int i = 0; i < INODE_DIRECT_BLOCKS; i++) {
+            direct[i] = inode->disk.direct[i];
+        }
+        table = direct;
+        pos = lblk;
+        span = INODE_DIRECT_BLOCKS;
+    } else {
+        uint64_t idx = lblk - INODE_DIRECT_BLOCKS;
+        block_t table_block;
+
+        if (idx < INDIRECT_BLOCKS_PER_BLOCK) {
+            table_block = inode->disk.indirect;
+        } else {
+            idx -= INDIRECT_BLOCKS_PER_BLOCK;
+            if (idx >= INDIRECT_BLOCKS_PER_BLOCK * INDIRECT_BLOCKS_PER_BLOCK) {
+                return MODERNFS_EINVAL;
+            }
+
+            table_block = inode->disk.double_indirect;
+            if (table_block != 0) {
+                int ret = indirect_entry(cache, inode, table_block,
+                                         idx / INDIRECT_BLOCKS_PER_BLOCK,
+                                         false, false, &table_block);
+                if (ret != MODERNFS_SUCCESS) {
+                    return ret;
+                }
+            }
+        }
+
+        pos = idx % INDIRECT_BLOCKS_PER_BLOCK;
+        span = INDIRECT_BLOCKS_PER_BLOCK;
+
+        if (table_block == 0) {
+            // 间接块不存在,它覆盖的范围都是空洞
+            *block_out = 0;
+            *run_out = (span - pos < max_blocks) ? span - pos : max_blocks;
+            return MODERNFS_SUCCESS;
+        }
+
+        bh = blkdev_get_block(cache->dev, table_block);
+        if (!bh) {
+            return MODERNFS_EIO;
+        }
+        pthread_rwlock_rdlock(&bh->lock);
+        table = (const block_t *)bh->data;
+    }
+
+    block_t first = table[pos];
+    uint32_t run = 1;
+    while (run < max_blocks && pos + run < span) {
+        block_t next = table[pos + run];
+        bool contiguous = (first == 0) ? (next == 0) : (next == first + run);
+        if (!contiguous) {
+            break;
+        }
+        run++;
+    }
+
+    if (bh) {
+        pthread_rwlock_unlock(&bh->lock);
+        blkdev_release_block(cache->dev, bh, false);
+    }
+
+    *block_out = first;
+    *run_out = run;
+    return MODERNFS_SUCCESS;
+}
+
+// 不分配的区间查找,先查映射缓存
+static int lookup_run(inode_cache_t *cache,
+                      inode_t_mem *inode,
+                      uint64_t offset,
+                      uint32_t max_blocks,
+                      block_t *block_out,
+                      uint32_t *run_out) {
+    uint64_t lblk = offset / BLOCK_SIZE;
+    uint32_t len;
+    int ret;
+
+    if (lblk < UINT32_MAX && map_cache_lookup(inode, lblk, block_out, &len)) {
+        *run_out = len < max_blocks ? len : max_blocks;
+        return MODERNFS_SUCCESS;
+    }
+
+    if (inode_uses_extents(inode)) {
+        uint32_t ext_lblk;
+        ret = extent_lblk(offset, &ext_lblk);
+        if (ret == MODERNFS_SUCCESS) {
+            ret = extent_map(cache, inode, ext_lblk, block_out, &len);
+        }
+    } else {
+        // 缓存整段区间而不只是本次请求的部分
+        ret = legacy_bmap_run(cache, inode, lblk, UINT32_MAX, block_out, &len);
+    }
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
+
+    if (*block_out != 0) {
+        map_cache_insert(inode, lblk, *block_out, len);
+    }
+    *run_out = len < max_blocks ? len : max_blocks;
+    return MODERNFS_SUCCESS;
+}
+
+// ============ 延迟分配 ============
+//
+// 写入空洞的数据先按逻辑块号暂存在Inode中,不分配物理块;读取时空洞部分
+// 从暂存页取数据。落盘时逻辑连续的页整段分配,文件因此在磁盘上保持连续,
+// 而落盘前就被截断或删除的数据(临时文件)完全不需要分配。
+
+static bool delalloc_enabled(const inode_cache_t *cache, const inode_t_mem *inode) {
+    return cache->delalloc && inode_uses_extents(inode);
+}
+
+// 返回第一个逻辑块号>=lblk的暂存页下标
+static uint32_t delalloc_search(const inode_t_mem *inode, uint32_t lblk) {
+    uint32_t lo = 0;
+    uint32_t hi = inode->delalloc_count;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (inode->delalloc_pages[mid].lblk < lblk) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// 释放下标>=from的暂存页
+static void delalloc_drop(inode_cache_t *cache, inode_t_mem *inode, uint32_t from) {
+    for (uint32_t i = from; i < inode->delalloc_count; i++) {
+        free(inode->delalloc_pages[i].data);
+    }
+    delalloc_set_count(cache, inode, from);
+}
+
+// 取得lblk对应的暂存页,不存在时新建一个清零的页
+static int delalloc_page(inode_cache_t *cache, inode_t_mem *inode, uint32_t lblk,
+                         uint8_t **page_out) {
+    uint32_t idx = delalloc_search(inode, lblk);
+    if (idx < inode->delalloc_count && inode->delalloc_pages[idx].lblk == lblk) {
+        *page_out = inode->delalloc_pages[idx].data;
+        return MODERNFS_SUCCESS;
+    }
+
+    // 暂存页过多时先把已有的落盘,lblk本身仍是空洞
+    if (inode->delalloc_count >= INODE_DELALLOC_MAX_PAGES) {
+        int ret = inode_flush_delalloc(cache, inode);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+        idx = 0;
+    }
+
+    // 每个暂存页都要保证落盘时有数据块和extent节点可用
+    uint32_t need = delalloc_reserve_cost(inode->delalloc_count + 1) -
+                    delalloc_reserve_cost(inode->delalloc_count);
+    uint32_t free_blocks;
+    block_alloc_stats(cache->balloc, NULL, &free_blocks, NULL, NULL);
+    if (free_blocks < cache->delalloc_reserved + need) {
+        return MODERNFS_ENOSPC;
+    }
+
+    if (inode->delalloc_count == inode->delalloc_cap) {
+        uint32_t cap = inode->delalloc_cap ? inode->delalloc_cap * 2 : 16;
+        inode_delalloc_page_t *pages = realloc(inode->delalloc_pages, cap * sizeof(*pages));
+        if (!pages) {
+            return MODERNFS_ERROR;
+        }
+        inode->delalloc_pages = pages;
+        inode->delalloc_cap = cap;
+    }
+
+    uint8_t *data = calloc(1, BLOCK_SIZE);
+    if (!data) {
+        return MODERNFS_ERROR;
+    }
+
+    memmove(&inode->delalloc_pages[idx + 1], &inode->delalloc_pages[idx],
+            (inode->delalloc_count - idx) * sizeof(inode_delalloc_page_t));
+    inode->delalloc_pages[idx] = (inode_delalloc_page_t){ .lblk = lblk, .data = data };
+    delalloc_set_count(cache, inode, inode->delalloc_count + 1);
+
+    *page_out = data;
+    return MODERNFS_SUCCESS;
+}
+
+// 把落在空洞中的一段数据写入暂存页
+static int delalloc_write(inode_cache_t *cache, inode_t_mem *inode, uint64_t offset,
+                          const uint8_t *src, size_t len) {
+    while (len > 0) {
+        uint32_t block_offset = offset % BLOCK_SIZE;
+        size_t n = BLOCK_SIZE - block_offset;
+        if (n > len) {
+            n = len;
+        }
+
+        uint8_t *page;
+        int ret = delalloc_page(cache, inode, (uint32_t)(offset / BLOCK_SIZE), &page);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+        memcpy(page + block_offset, src, n);
+
+        offset += n;
+        src += n;
+        len -= n;
+    }
+    return MODERNFS_SUCCESS;
+}
+
+// 读取一段空洞: 有暂存页的块取页内数据,其余填0
+static void delalloc_read(const inode_t_mem *inode, uint64_t offset, uint8_t *dest, size_t len) {
+    memset(dest, 0, len);
+    if (inode->delalloc_count == 0) {
+        return;
+    }
+
+    uint64_t end = offset + len;
+    uint32_t idx = delalloc_search(inode, (uint32_t)(offset / BLOCK_SIZE));
+
+    for (; idx < inode->delalloc_count; idx++) {
+        const inode_delalloc_page_t *page = &inode->delalloc_pages[idx];
+        uint64_t page_start = (uint64_t)page->lblk * BLOCK_SIZE;
+        if (page_start >= end) {
+            break;
+        }
+
+        uint64_t from = page_start > offset ? page_start : offset;
+        uint64_t to = page_start + BLOCK_SIZE < end ? page_start + BLOCK_SIZE : end;
+        memcpy(dest + (from - offset), page->data + (from - page_start), to - from);
+    }
+}
+
+// 截断时丢弃新大小之外的暂存页,截断点所在页的尾部清零
+static void delalloc_truncate(inode_cache_t *cache, inode_t_mem *inode, uint64_t new_size) {
+    uint32_t keep_blocks = (new_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint32_t idx = delalloc_search(inode, keep_blocks);
+    delalloc_drop(cache, inode, idx);
+
+    uint32_t tail = new_size % BLOCK_SIZE;
+    if (tail != 0 && idx > 0 && inode->delalloc_pages[idx - 1].lblk == new_size / BLOCK_SIZE) {
+        memset(inode->delalloc_pages[idx - 1].data + tail, 0, BLOCK_SIZE - tail);
+    }
+}
+
+int inode_flush_delalloc(inode_cache_t *cache, inode_t_mem *inode) {
+    if (!inode) {
+        return MODERNFS_EINVAL;
+    }
+
+    inode_delalloc_page_t *pages = inode->delalloc_pages;
+    uint32_t count = inode->delalloc_count;
+    uint32_t done = 0;
+    int ret = MODERNFS_SUCCESS;
+
+    inode->delalloc_flushing = true;
+    while (done < count) {
+        // 逻辑连续的一段页一次分配
+        uint32_t n = 1;
+        while (done + n < count && n < INODE_RUN_MAX_BLOCKS &&
+               pages[done + n].lblk == pages[done].lblk + n) {
+            n++;
+        }
+
+        block_t start;
+        uint32_t got;
+        ret = extent_alloc_run(cache, inode, pages[done].lblk, n, &start, &got);
+        if (ret != MODERNFS_SUCCESS) {
+            break;
+        }
+
+        for (uint32_t k = 0; k < got && ret == MODERNFS_SUCCESS; k++) {
+            ret = blkdev_write(cache->dev, start + k, pages[done].data);
+            if (ret == MODERNFS_SUCCESS) {
+                free(pages[done].data);
+                done++;
+            }
+        }
+        if (ret != MODERNFS_SUCCESS) {
+            break;
+        }
+    }
+    inode->delalloc_flushing = false;
+
+    memmove(pages, pages + done, (count - done) * sizeof(inode_delalloc_page_t));
+    delalloc_set_count(cache, inode, count - done);
+
+    if (ret != MODERNFS_SUCCESS) {
+        fprintf(stderr, "inode_flush_delalloc: inode %u, %u pages left: %d\n",
+                inode->inum, inode->delalloc_count, ret);
+    }
+    return ret;
+}
+
+int inode_flush_all_delalloc(inode_cache_t *cache) {
+    if (!cache || !cache->delalloc) {
+        return MODERNFS_SUCCESS;
+    }
+
+    // 在缓存锁内持有引用,加Inode锁之前释放缓存锁(与inode_get的加锁顺序一致)
+    uint32_t n = 0;
+    pthread_rwlock_wrlock(&cache->cache_lock);
+    inode_t_mem **pending = malloc((cache->nr_inodes + 1) * sizeof(inode_t_mem *));
+    if (!pending) {
+        pthread_rwlock_unlock(&cache->cache_lock);
+        return MODERNFS_ERROR;
+    }
+
+    for (inode_t_mem *inode = cache->lru_head; inode; inode = inode->next) {
+        if (inode->valid && inode->delalloc_count > 0) {
+            __atomic_fetch_add(&inode->ref_count, 1, __ATOMIC_ACQUIRE);
+            pending[n++] = inode;
+        }
+    }
+    pthread_rwlock_unlock(&cache->cache_lock);
+
+    int result = MODERNFS_SUCCESS;
+    for (uint32_t i = 0; i < n; i++) {
+        inode_lock(pending[i]);
+        int ret = inode_flush_delalloc(cache, pending[i]);
+        inode_unlock(pending[i]);
+        inode_put(cache, pending[i]);
+
+        if (ret != MODERNFS_SUCCESS && result == MODERNFS_SUCCESS) {
+            result = ret;
+        }
+    }
+
+    free(pending);
+    return result;
+}
+
+// ============ 截断 ============
+
+// 截断时把释放的块攒成物理连续的区间,一段只调用一次block_free_multiple
+typedef struct free_run {
+    block_t start;
+    uint32_t len;
+    uint32_t freed;                 // 已交给分配器的块数
+} free_run_t;
+
+static void free_run_flush(inode_cache_t *cache, free_run_t *run) {
+    if (run->len > 0 && block_free_multiple(cache->balloc, run->start, run->len) == 0) {
+        run->freed += run->len;
+    }
+    run->len = 0;
+}
+
+static void free_run_add(inode_cache_t *cache, free_run_t *run, block_t block) {
+    if (block == 0) {
+        return;
+    }
+    if (run->len > 0 && block == run->start + run->len) {
+        run->len++;
+        return;
+    }
+    free_run_flush(cache, run);
+    run->start = block;
+    run->len = 1;
+}
+
+// 释放间接块中下标>=from的项指向的块并清零这些项;from为0时整块都会被
+// 调用者释放,不用清零。child_is_indirect表示各项本身是一级间接块
+static int truncate_table(inode_cache_t *cache, block_t table_block, uint32_t from,
+                          bool child_is_indirect, free_run_t *run) {
+    buffer_head_t *bh = blkdev_get_block(cache->dev, table_block);
+    if (!bh) {
+        return MODERNFS_EIO;
+    }
+
+    block_t entries[INDIRECT_BLOCKS_PER_BLOCK];
+    pthread_rwlock_wrlock(&bh->lock);
+    block_t *table = (block_t *)bh->data;
+    memcpy(entries, table, sizeof(entries));
+    if (from > 0) {
+        memset(table + from, 0, (INDIRECT_BLOCKS_PER_BLOCK - from) * sizeof(block_t));
+    }
+    pthread_rwlock_unlock(&bh->lock);
+    blkdev_release_block(cache->dev, bh, from > 0);
+
+    int ret = MODERNFS_SUCCESS;
+    for (uint32_t i = from; i < INDIRECT_BLOCKS_PER_BLOCK; i++) {
+        if (entries[i] == 0) {
+            continue;
+        }
+        if (child_is_indirect) {
+            int r = truncate_table(cache, entries[i], 0, false, run);
+            if (r != MODERNFS_SUCCESS) {
+                ret = r;
+                continue;   // 读不出来的一级间接块和它指向的块留着,宁可泄漏也不误释放
+            }
+        }
+        free_run_add(cache, run, entries[i]);
+    }
+    return ret;
+}
+
+// 直接/间接块映射的截断: 只保留前keep个逻辑块。每个间接块只读一次,
+// 数据块和变空的间接块按物理连续区间成段释放
+static int legacy_truncate(inode_cache_t *cache, inode_t_mem *inode, uint64_t keep) {
+    free_run_t run = {0};
+    int ret = MODERNFS_SUCCESS;
+
+    for (uint64_t i = keep; i < INODE_DIRECT_BLOCKS; i++) {
+        free_run_add(cache, &run, inode->disk.direct[i]);
+        inode->disk.direct[i] = 0;
+    }
+
+    // 一级间接块覆盖[INODE_DIRECT_BLOCKS, INODE_DIRECT_BLOCKS + PPB)
+    uint64_t base = INODE_DIRECT_BLOCKS;
+    if (inode->disk.indirect != 0) {
+        uint32_t from = keep > base ? (uint32_t)(keep - base) : 0;
+        if (from < INDIRECT_BLOCKS_PER_BLOCK) {
+            int r = truncate_table(cache, inode->disk.indirect, from, false, &run);
+            if (r != MODERNFS_SUCCESS) {
+                ret = r;
+            } else if (from == 0) {
+                free_run_add(cache, &run, inode->disk.indirect);
+                inode->disk.indirect = 0;
+            }
+        }
+    }
+
+    // 二级间接块: 保留部分所在的一级间接块只截掉尾部,其后的整块释放
+    base += INDIRECT_BLOCKS_PER_BLOCK;
+    if (inode->disk.double_indirect != 0) {
+        uint64_t rel = keep > base ? keep - base : 0;
+        uint32_t l1 = (uint32_t)(rel / INDIRECT_BLOCKS_PER_BLOCK);
+        uint32_t l2 = (uint32_t)(rel % INDIRECT_BLOCKS_PER_BLOCK);
+
+        if (l1 < INDIRECT_BLOCKS_PER_BLOCK) {
+            int r = MODERNFS_SUCCESS;
+            if (l2 > 0) {
+                block_t partial;
+                r = indirect_entry(cache, inode, inode->disk.double_indirect, l1,
+                                   false, false, &partial);
+                if (r == MODERNFS_SUCCESS && partial != 0) {
+                    r = truncate_table(cache, partial, l2, false, &run);
+                }
+                l1++;
+            }
+            if (r != MODERNFS_SUCCESS) {
+                ret = r;
+            } else if (l1 < INDIRECT_BLOCKS_PER_BLOCK) {
+                r = truncate_table(cache, inode->disk.double_indirect, l1, true, &run);
+                if (r != MODERNFS_SUCCESS) {
+                    ret = r;
+                } else if (l1 == 0) {
+                    free_run_add(cache, &run, inode->disk.double_indirect);
+                    inode->disk.double_indirect = 0;
+                }
+            }
+        }
+    }
+
+    free_run_flush(cache, &run);
+    inode->disk.blocks = inode->disk.blocks > run.freed ? inode->disk.blocks - run.freed : 0;
+    return ret;
+}
+
+int inode_truncate(inode_cache_t *cache, inode_t_mem *inode, uint64_t new_size) {
+    if (!inode) {
+        return MODERNFS_EINVAL;
+    }
+
+    // 内联Inode: 放得下时只调整大小并清掉截掉的字节,放不下时先搬到数据块
+    if (inode_is_inline(inode)) {
+        if (new_size <= INODE_INLINE_SIZE) {
+            if (new_size < inode->disk.size) {
+                memset(inode->disk.inline_data + new_size, 0,
+                       INODE_INLINE_SIZE - new_size);
+            }
+            inode->disk.size = new_size;
+            inode_mark_dirty(cache, inode);
+            return MODERNFS_SUCCESS;
+        }
+        int ret = inode_inline_spill(cache, inode);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+    }
+
+    if (new_size >= inode->disk.size) {
+        inode->disk.size = new_size;
+        inode_mark_dirty(cache, inode);
+        return MODERNFS_SUCCESS;
+    }
+
+    map_cache_invalidate(inode);
+    if (inode->delalloc_count > 0) {
+        delalloc_truncate(cache, inode, new_size);
+    }
+
+    // 计算需要保留的块数
+    uint32_t new_blocks = (new_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    if (inode_uses_extents(inode)) {
+        int ret = extent_truncate(cache, inode, new_blocks);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+        inode->disk.size = new_size;
+        inode_mark_dirty(cache, inode);
+        return MODERNFS_SUCCESS;
+    }
 
-    return inode;
-}
+    // 释放多余的数据块和变空的间接块
+    int ret = legacy_truncate(cache, inode, new_blocks);
 
-void inode_put(inode_cache_t *cache, inode_t_mem *inode) {
-    if (!inode) return;
+    inode->disk.size = new_size;
+    inode_mark_dirty(cache, inode);
 
-    pthread_rwlock_wrlock(&cache->cache_lock);
-    inode->ref_count--;
-    pthread_rwlock_unlock(&cache->cache_lock);
+    return ret;
 }
 
-void inode_lock(inode_t_mem *inode) {
-    pthread_mutex_lock(&inode->lock);
-}
+// ============ 内联数据 ============
 
-void inode_unlock(inode_t_mem *inode) {
-    pthread_mutex_unlock(&inode->lock);
+bool inode_is_inline(const inode_t_mem *inode) {
+    return (inode->disk.flags & INODE_FLAG_INLINE) != 0;
 }
 
-// ============ Inode读写 ============
-
-int inode_sync(inode_cache_t *cache, inode_t_mem *inode) {
-    if (!inode || !inode->valid || !inode->dirty) {
-        return MODERNFS_SUCCESS;
+// 写入[offset, offset + size)后能否(继续)内联存放: 已经内联,
+// 或者是还没有任何数据块的空文件/符号链接(目录由directory.c自己转换)
+static bool inline_fits(const inode_cache_t *cache, const inode_t_mem *inode,
+                        uint64_t offset, size_t size) {
+    if (offset + size > INODE_INLINE_SIZE) {
+        return false;
     }
-
-    uint32_t inode_block = cache->sb.inode_table_start +
-                           (inode->inum * INODE_SIZE) / BLOCK_SIZE;
-    uint32_t offset = (inode->inum * INODE_SIZE) % BLOCK_SIZE;
-
-    uint8_t *buf = malloc(BLOCK_SIZE);
-    if (!buf) {
-        return MODERNFS_ERROR;
+    if (inode_is_inline(inode)) {
+        return true;
     }
+    return cache->inline_data && inode->disk.type != INODE_TYPE_DIR &&
+           inode->disk.size == 0 && inode->disk.blocks == 0 &&
+           inode->delalloc_count == 0;
+}
 
-    // 读取-修改-写入
-    if (blkdev_read(cache->dev, inode_block, buf) != 0) {
-        free(buf);
-        return MODERNFS_EIO;
+static ssize_t inline_write(inode_cache_t *cache, inode_t_mem *inode,
+                            const void *buf, uint64_t offset, size_t size) {
+    if (!inode_is_inline(inode)) {
+        // 空的extent树根或块指针直接让给内联数据
+        memset(inode->disk.inline_data, 0, INODE_INLINE_SIZE);
+        inode->disk.flags = (inode->disk.flags & ~INODE_FLAG_EXTENTS) | INODE_FLAG_INLINE;
+        map_cache_invalidate(inode);
     }
 
-    memcpy(buf + offset, &inode->disk, sizeof(disk_inode_t));
-
-    if (blkdev_write(cache->dev, inode_block, buf) != 0) {
-        free(buf);
-        return MODERNFS_EIO;
+    memcpy(inode->disk.inline_data + offset, buf, size);
+    if (offset + size > inode->disk.size) {
+        inode->disk.size = offset + size;
     }
 
-    free(buf);
-    inode->dirty = 0;
+    inode->disk.mtime = time(NULL);
+    inode_mark_dirty(cache, inode);
 
-    return MODERNFS_SUCCESS;
+    return size;
 }
 
-int inode_sync_all(inode_cache_t *cache) {
-    pthread_rwlock_rdlock(&cache->cache_lock);
+int inode_inline_spill(inode_cache_t *cache, inode_t_mem *inode) {
+    if (!inode || !inode_is_inline(inode)) {
+        return MODERNFS_SUCCESS;
+    }
 
-    for (uint32_t i = 0; i < cache->max_inodes; i++) {
-        if (cache->inodes[i].valid && cache->inodes[i].dirty) {
-            inode_sync(cache, &cache->inodes[i]);
+    // 保存内联区,失败时原样恢复
+    uint8_t data[INODE_INLINE_SIZE];
+    uint8_t flags = inode->disk.flags;
+    uint64_t mtime = inode->disk.mtime;
+    memcpy(data, inode->disk.inline_data, INODE_INLINE_SIZE);
+    uint32_t len = inode->disk.size < INODE_INLINE_SIZE ?
+                   (uint32_t)inode->disk.size : INODE_INLINE_SIZE;
+
+    memset(inode->disk.inline_data, 0, INODE_INLINE_SIZE);
+    inode->disk.flags &= ~INODE_FLAG_INLINE;
+    if (inode->disk.type == INODE_TYPE_FILE) {
+        extent_tree_init(inode);
+    }
+    inode_mark_dirty(cache, inode);
+
+    if (len > 0) {
+        ssize_t written = inode_write(cache, inode, data, 0, len, NULL);
+        if (written < 0) {
+            // 写入中途可能已分配了数据块或暂存了页,先全部释放再恢复内联区,
+            // 否则恢复时覆盖掉映射会泄漏这些块并让disk.blocks对不上
+            map_cache_invalidate(inode);
+            delalloc_drop(cache, inode, 0);
+            if (inode_uses_extents(inode)) {
+                extent_truncate(cache, inode, 0);
+            } else {
+                legacy_truncate(cache, inode, 0);
+            }
+            memcpy(inode->disk.inline_data, data, INODE_INLINE_SIZE);
+            inode->disk.flags = flags;
+            inode->disk.mtime = mtime;
+            return (int)written;
         }
     }
 
-    pthread_rwlock_unlock(&cache->cache_lock);
-
+    // 搬运不算一次修改
+    inode->disk.mtime = mtime;
     return MODERNFS_SUCCESS;
 }
 
-// ============ 数据块映射 ============
-
-// 每个间接块可以存储多少个块号
-#define INDIRECT_BLOCKS_PER_BLOCK (BLOCK_SIZE / sizeof(block_t))
+// ============ Inode读写数据 ============
 
-int inode_bmap(inode_cache_t *cache,
-               inode_t_mem *inode,
-               uint64_t offset,
-               bool alloc_if_missing,
-               block_t *block_out) {
-    if (!inode || !block_out) {
+int inode_bmap_run(inode_cache_t *cache,
+                   inode_t_mem *inode,
+                   uint64_t offset,
+                   uint32_t max_blocks,
+                   bool alloc_if_missing,
+                   block_t *block_out,
+                   uint32_t *run_out) {
+    if (!inode || !block_out || !run_out || max_blocks == 0) {
         return MODERNFS_EINVAL;
     }
 
-    uint32_t block_idx = offset / BLOCK_SIZE;
-
-    // 直接块
-    if (block_idx < INODE_DIRECT_BLOCKS) {
-        if (inode->disk.direct[block_idx] == 0) {
-            if (!alloc_if_missing) {
-                *block_out = 0;
-                return MODERNFS_SUCCESS;
-            }
-
-            // 分配新块
-            block_t new_block = block_alloc(cache->balloc);
-            if (new_block == 0) {
-                return MODERNFS_ENOSPC;
-            }
-
-            inode->disk.direct[block_idx] = new_block;
-            inode->disk.blocks++;
-            inode->dirty = 1;
+    if (inode_is_inline(inode)) {
+        if (!alloc_if_missing) {
+            *block_out = 0;
+            *run_out = max_blocks;
+            return MODERNFS_SUCCESS;
+        }
+        int ret = inode_inline_spill(cache, inode);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
         }
-
-        *block_out = inode->disk.direct[block_idx];
-        return MODERNFS_SUCCESS;
     }
 
-    block_idx -= INODE_DIRECT_BLOCKS;
+    // 已映射的区间(或不需要分配时的空洞)一次查找即可得到
+    int ret = lookup_run(cache, inode, offset, max_blocks, block_out, run_out);
+    if (ret != MODERNFS_SUCCESS || *block_out != 0 || !alloc_if_missing) {
+        return ret;
+    }
 
-    // 一级间接块
-    if (block_idx < INDIRECT_BLOCKS_PER_BLOCK) {
-        if (inode->disk.indirect == 0) {
-            if (!alloc_if_missing) {
-                *block_out = 0;
-                return MODERNFS_SUCCESS;
-            }
+    // extent文件: 按本次写入覆盖的空洞大小一次分配一段连续块
+    if (inode_uses_extents(inode)) {
+        return extent_alloc_run(cache, inode, (uint32_t)(offset / BLOCK_SIZE),
+                                *run_out, block_out, run_out);
+    }
 
-            // 分配间接块
-            block_t new_block = block_alloc(cache->balloc);
-            if (new_block == 0) {
-                return MODERNFS_ENOSPC;
-            }
+    // 直接/间接块映射: 逐块分配
+    block_t first;
+    ret = inode_bmap(cache, inode, offset, alloc_if_missing, &first);
+    if (ret != MODERNFS_SUCCESS) {
+        return ret;
+    }
 
-            inode->disk.indirect = new_block;
-            inode->disk.blocks++;
-            inode->dirty = 1;
+    uint64_t base = offset - offset % BLOCK_SIZE;
+    uint32_t run = 1;
 
-            // 清零间接块
-            uint8_t *buf = malloc(BLOCK_SIZE);
-            if (!buf) {
-                return MODERNFS_ERROR;
-            }
-            memset(buf, 0, BLOCK_SIZE);
-            if (blkdev_write(cache->dev, new_block, buf) != 0) {
-                free(buf);
-                return MODERNFS_EIO;
-            }
-            free(buf);
+    while (run < max_blocks) {
+        block_t next;
+        ret = inode_bmap(cache, inode, base + (uint64_t)run * BLOCK_SIZE,
+                         alloc_if_missing, &next);
+        if (ret != MODERNFS_SUCCESS) {
+            // 超出可映射范围时在此截断,已映射的部分仍然有效
+            break;
         }
 
-        // 读取间接块
-        uint8_t *buf = malloc(BLOCK_SIZE);
-        if (!buf) {
-            return MODERNFS_ERROR;
-        }
-        if (blkdev_read(cache->dev, inode->disk.indirect, buf) != 0) {
-            free(buf);
-            return MODERNFS_EIO;
+        bool contiguous = (first == 0) ? (next == 0) : (next == first + run);
+        if (!contiguous) {
+            break;
         }
+        run++;
+    }
 
-        block_t *indirect = (block_t *)buf;
-
-        if (indirect[block_idx] == 0) {
-            if (!alloc_if_missing) {
-                free(buf);
-                *block_out = 0;
-                return MODERNFS_SUCCESS;
-            }
-
-            // 分配新块
-            block_t new_block = block_alloc(cache->balloc);
-            if (new_block == 0) {
-                free(buf);
-                return MODERNFS_ENOSPC;
-            }
+    *block_out = first;
+    *run_out = run;
+    return MODERNFS_SUCCESS;
+}
 
-            indirect[block_idx] = new_block;
-            if (blkdev_write(cache->dev, inode->disk.indirect, buf) != 0) {
-                free(buf);
-                return MODERNFS_EIO;
-            }
-            inode->disk.blocks++;
-            inode->dirty = 1;
-        }
+// 线程私有暂存块的用途
+#define SCRATCH_HEAD    0           // 区间首部不完整的块
+#define SCRATCH_TAIL    1           // 区间尾部不完整的块
+#define SCRATCH_JOURNAL 2           // 写入Journal的整块镜像
+
+// 读取一段物理连续的块: 整段一次preadv,首尾不完整的块经由暂存块
+static int read_run(inode_cache_t *cache, block_t block, uint32_t nblocks,
+                    uint32_t block_offset, uint8_t *dest, size_t len) {
+    uint8_t *head = blkdev_scratch(SCRATCH_HEAD);
+    uint8_t *tail = blkdev_scratch(SCRATCH_TAIL);
+    struct iovec iov[3];
+    int iovcnt = 0;
+
+    uint32_t tail_len = (block_offset + len) % BLOCK_SIZE;
+    size_t head_len = block_offset ? BLOCK_SIZE - block_offset : 0;
+    uint32_t middle = nblocks - (block_offset ? 1 : 0) - (tail_len ? 1 : 0);
+
+    if (block_offset) {
+        iov[iovcnt++] = (struct iovec){ head, BLOCK_SIZE };
+    }
+    if (middle > 0) {
+        iov[iovcnt++] = (struct iovec){ dest + head_len, (size_t)middle * BLOCK_SIZE };
+    }
+    if (tail_len) {
+        iov[iovcnt++] = (struct iovec){ tail, BLOCK_SIZE };
+    }
 
-        *block_out = indirect[block_idx];
-        free(buf);
+    if (blkdev_read_range(cache->dev, block, iov, iovcnt) < 0) {
+        return MODERNFS_EIO;
+    }
 
-        return MODERNFS_SUCCESS;
+    if (block_offset) {
+        memcpy(dest, head + block_offset, head_len);
+    }
+    if (tail_len) {
+        memcpy(dest + len - tail_len, tail, tail_len);
     }
 
-    block_idx -= INDIRECT_BLOCKS_PER_BLOCK;
+    return MODERNFS_SUCCESS;
+}
 
-    // 二级间接块
-    if (block_idx < INDIRECT_BLOCKS_PER_BLOCK * INDIRECT_BLOCKS_PER_BLOCK) {
-        if (inode->disk.double_indirect == 0) {
-            if (!alloc_if_missing) {
-                *block_out = 0;
-                return MODERNFS_SUCCESS;
-            }
+// 把块的当前内容读入缓冲区(用于不完整块的读-改-写)
+static int read_block_copy(inode_cache_t *cache, block_t block, uint8_t *buf) {
+    buffer_head_t *bh = blkdev_get_block(cache->dev, block);
+    if (!bh) {
+        return MODERNFS_EIO;
+    }
 
-            // 分配二级间接块
-            block_t new_block = block_alloc(cache->balloc);
-            if (new_block == 0) {
-                return MODERNFS_ENOSPC;
-            }
+    pthread_rwlock_rdlock(&bh->lock);
+    memcpy(buf, bh->data, BLOCK_SIZE);
+    pthread_rwlock_unlock(&bh->lock);
+    blkdev_release_block(cache->dev, bh, false);
 
-            inode->disk.double_indirect = new_block;
-            inode->disk.blocks++;
-            inode->dirty = 1;
+    return MODERNFS_SUCCESS;
+}
 
-            // 清零
-            uint8_t *buf = malloc(BLOCK_SIZE);
-            if (!buf) {
-                return MODERNFS_ERROR;
-            }
-            memset(buf, 0, BLOCK_SIZE);
-            if (blkdev_write(cache->dev, new_block, buf) != 0) {
-                free(buf);
-                return MODERNFS_EIO;
-            }
-            free(buf);
-        }
+// 写入一段物理连续的块: 首尾不完整的块先读出合并,整段一次pwritev
+static int write_run(inode_cache_t *cache, block_t block, uint32_t nblocks,
+                     uint32_t block_offset, const uint8_t *src, size_t len) {
+    uint8_t *head = blkdev_scratch(SCRATCH_HEAD);
+    uint8_t *tail = blkdev_scratch(SCRATCH_TAIL);
+    struct iovec iov[3];
+    int iovcnt = 0;
 
-        uint32_t l1_idx = block_idx / INDIRECT_BLOCKS_PER_BLOCK;
-        uint32_t l2_idx = block_idx % INDIRECT_BLOCKS_PER_BLOCK;
+    uint32_t tail_len = (block_offset + len) % BLOCK_SIZE;
+    size_t head_len = block_offset ? BLOCK_SIZE - block_offset : 0;
+    uint32_t middle = nblocks - (block_offset ? 1 : 0) - (tail_len ? 1 : 0);
 
-        // 读取二级间接块
-        uint8_t *buf1 = malloc(BLOCK_SIZE);
-        if (!buf1) {
-            return MODERNFS_ERROR;
+    if (block_offset) {
+        if (read_block_copy(cache, block, head) != MODERNFS_SUCCESS) {
+            return MODERNFS_EIO;
         }
-        if (blkdev_read(cache->dev, inode->disk.double_indirect, buf1) != 0) {
-            free(buf1);
+        memcpy(head + block_offset, src, head_len);
+        iov[iovcnt++] = (struct iovec){ head, BLOCK_SIZE };
+    }
+    if (middle > 0) {
+        iov[iovcnt++] = (struct iovec){ (void *)(src + head_len), (size_t)middle * BLOCK_SIZE };
+    }
+    if (tail_len) {
+        if (read_block_copy(cache, block + nblocks - 1, tail) != MODERNFS_SUCCESS) {
             return MODERNFS_EIO;
         }
+        memcpy(tail, src + len - tail_len, tail_len);
+        iov[iovcnt++] = (struct iovec){ tail, BLOCK_SIZE };
+    }
 
-        block_t *double_indirect = (block_t *)buf1;
-
-        if (double_indirect[l1_idx] == 0) {
-            if (!alloc_if_missing) {
-                free(buf1);
-                *block_out = 0;
-                return MODERNFS_SUCCESS;
-            }
+    if (blkdev_write_range(cache->dev, block, iov, iovcnt) < 0) {
+        return MODERNFS_EIO;
+    }
 
-            // 分配一级间接块
-            block_t new_block = block_alloc(cache->balloc);
-            if (new_block == 0) {
-                free(buf1);
-                return MODERNFS_ENOSPC;
-            }
+    return MODERNFS_SUCCESS;
+}
 
-            double_indirect[l1_idx] = new_block;
-            if (blkdev_write(cache->dev, inode->disk.double_indirect, buf1) != 0) {
-                free(buf1);
-                return MODERNFS_EIO;
-            }
-            inode->disk.blocks++;
-            inode->dirty = 1;
-
-            // 清零新分配的间接块
-            uint8_t *buf2 = malloc(BLOCK_SIZE);
-            if (!buf2) {
-                free(buf1);
-                return MODERNFS_ERROR;
-            }
-            memset(buf2, 0, BLOCK_SIZE);
-            if (blkdev_write(cache->dev, new_block, buf2) != 0) {
-                free(buf2);
-                free(buf1);
-                return MODERNFS_EIO;
-            }
-            free(buf2);
-        }
+// 写入单个块(或其一部分)
+static int write_block(inode_cache_t *cache, block_t block, uint32_t block_offset,
+                       const uint8_t *src, uint32_t len, void *txn) {
+    bool full_block = (block_offset == 0 && len == BLOCK_SIZE);
 
-        block_t indirect_block = double_indirect[l1_idx];
-        free(buf1);
+    // Week 7: 如果有Journal事务，记录到Journal；否则直接写入磁盘
+    if (txn != NULL) {
+        // Journal需要完整的块镜像,且提交前不能污染缓存,在暂存块中组装
+        uint8_t *bbuf = blkdev_scratch(SCRATCH_JOURNAL);
 
-        // 读取一级间接块
-        uint8_t *buf2 = malloc(BLOCK_SIZE);
-        if (!buf2) {
-            return MODERNFS_ERROR;
-        }
-        if (blkdev_read(cache->dev, indirect_block, buf2) != 0) {
-            free(buf2);
+        // 如果不是整块写入，需要先读取
+        if (!full_block && read_block_copy(cache, block, bbuf) != MODERNFS_SUCCESS) {
             return MODERNFS_EIO;
         }
 
-        block_t *indirect = (block_t *)buf2;
-
-        if (indirect[l2_idx] == 0) {
-            if (!alloc_if_missing) {
-                free(buf2);
-                *block_out = 0;
-                return MODERNFS_SUCCESS;
-            }
-
-            // 分配新块
-            block_t new_block = block_alloc(cache->balloc);
-            if (new_block == 0) {
-                free(buf2);
-                return MODERNFS_ENOSPC;
-            }
+        memcpy(bbuf + block_offset, src, len);
 
-            indirect[l2_idx] = new_block;
-            if (blkdev_write(cache->dev, indirect_block, buf2) != 0) {
-                free(buf2);
-                return MODERNFS_EIO;
-            }
-            inode->disk.blocks++;
-            inode->dirty = 1;
+        // 调用Rust FFI记录块写入到Journal事务
+        extern int rust_journal_write(void *txn, uint32_t block_num, const uint8_t *data);
+        if (rust_journal_write(txn, block, bbuf) < 0) {
+            fprintf(stderr, "inode_write: rust_journal_write failed for block %u\n", block);
+            return MODERNFS_EIO;
         }
 
-        *block_out = indirect[l2_idx];
-        free(buf2);
-
-        return MODERNFS_SUCCESS;
-    }
-
-    // 超出范围
-    return MODERNFS_EINVAL;
-}
-
-int inode_truncate(inode_cache_t *cache, inode_t_mem *inode, uint64_t new_size) {
-    if (!inode) {
-        return MODERNFS_EINVAL;
-    }
-
-    if (new_size >= inode->disk.size) {
-        inode->disk.size = new_size;
-        inode->dirty = 1;
         return MODERNFS_SUCCESS;
     }
 
-    // 计算需要保留的块数
-    uint32_t new_blocks = (new_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
-    uint32_t old_blocks = (inode->disk.size + BLOCK_SIZE - 1) / BLOCK_SIZE;
-
-    // 释放多余的块（从后往前）
-    for (uint32_t i = new_blocks; i < old_blocks; i++) {
-        block_t block;
-        int ret = inode_bmap(cache, inode, i * BLOCK_SIZE, false, &block);
-        if (ret == MODERNFS_SUCCESS && block != 0) {
-            block_free(cache->balloc, block);
-            inode->disk.blocks--;
-        }
+    // 无Journal，直接修改缓存块;整块覆盖时无需读盘
+    buffer_head_t *bh = full_block ? blkdev_get_new_block(cache->dev, block)
+                                   : blkdev_get_block(cache->dev, block);
+    if (!bh) {
+        return MODERNFS_EIO;
     }
 
-    inode->disk.size = new_size;
-    inode->dirty = 1;
+    pthread_rwlock_wrlock(&bh->lock);
+    memcpy(bh->data + block_offset, src, len);
+    pthread_rwlock_unlock(&bh->lock);
+    blkdev_release_block(cache->dev, bh, true);
 
     return MODERNFS_SUCCESS;
 }
 
-// ============ Inode读写数据 ============
+// 从cur_offset起还需要覆盖的块数(不超过INODE_RUN_MAX_BLOCKS)
+static uint32_t blocks_needed(uint64_t cur_offset, size_t remaining) {
+    uint64_t blocks = (cur_offset % BLOCK_SIZE + remaining + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    return blocks > INODE_RUN_MAX_BLOCKS ? INODE_RUN_MAX_BLOCKS : (uint32_t)blocks;
+}
 
 ssize_t inode_read(inode_cache_t *cache,
                    inode_t_mem *inode,
@@ -805,57 +2339,65 @@ ssize_t inode_read(inode_cache_t *cache,
     size_t total_read = 0;
     uint8_t *dest = (uint8_t *)buf;
 
+    // 内联数据随Inode一起读入,不用再读数据块
+    if (inode_is_inline(inode)) {
+        memcpy(dest, inode->disk.inline_data + offset, size);
+        total_read = size;
+    }
+
     while (total_read < size) {
         uint64_t cur_offset = offset + total_read;
         uint32_t block_offset = cur_offset % BLOCK_SIZE;
-        uint32_t to_read = BLOCK_SIZE - block_offset;
-
-        if (to_read > size - total_read) {
-            to_read = size - total_read;
-        }
+        size_t remaining = size - total_read;
 
+        // 找出从当前位置开始的物理连续区间
         block_t block;
-        int ret = inode_bmap(cache, inode, cur_offset, false, &block);
+        uint32_t run;
+        int ret = inode_bmap_run(cache, inode, cur_offset,
+                                 blocks_needed(cur_offset, remaining), false,
+                                 &block, &run);
         if (ret < 0) {
             // fprintf(stderr, "[DEBUG] inode_read: bmap failed with %d\n", ret);
             return ret;
         }
 
-        // fprintf(stderr, "[DEBUG] inode_read: cur_offset=%lu, block=%u, block_offset=%u, to_read=%u\n",
-        //         cur_offset, block, block_offset, to_read);
+        size_t to_read = (size_t)run * BLOCK_SIZE - block_offset;
+        if (to_read > remaining) {
+            to_read = remaining;
+        }
+
+        // fprintf(stderr, "[DEBUG] inode_read: cur_offset=%lu, block=%u, run=%u, to_read=%zu\n",
+        //         cur_offset, block, run, to_read);
 
         if (block == 0) {
-            // 空洞，填充0
+            // 空洞，填充0(延迟分配的数据取自暂存页)
             // fprintf(stderr, "[DEBUG] inode_read: hole detected, filling with zeros\n");
-            memset(dest + total_read, 0, to_read);
-        } else {
-            uint8_t *bbuf = malloc(BLOCK_SIZE);
-            if (!bbuf) {
-                return MODERNFS_ERROR;
+            delalloc_read(inode, cur_offset, dest + total_read, to_read);
+        } else if (run > 1) {
+            // 多块一次读取,直接进入调用者缓冲区
+            ret = read_run(cache, block, run, block_offset, dest + total_read, to_read);
+            if (ret < 0) {
+                return ret;
             }
-
-            if (blkdev_read(cache->dev, block, bbuf) != 0) {
-                // fprintf(stderr, "[DEBUG] inode_read: blkdev_read failed for block %u\n", block);
-                free(bbuf);
+        } else {
+            buffer_head_t *bh = blkdev_get_block(cache->dev, block);
+            if (!bh) {
+                // fprintf(stderr, "[DEBUG] inode_read: blkdev_get_block failed for block %u\n", block);
                 return MODERNFS_EIO;
             }
 
-            // fprintf(stderr, "[DEBUG] inode_read: read block %u successfully, first 16 bytes: ", block);
-            // for (int i = 0; i < 16 && i < BLOCK_SIZE; i++) {
-            //     fprintf(stderr, "%02x ", bbuf[i]);
-            // }
-            // fprintf(stderr, "\n");
-
-            memcpy(dest + total_read, bbuf + block_offset, to_read);
-            free(bbuf);
+            // 直接从缓存块拷贝到调用者缓冲区
+            pthread_rwlock_rdlock(&bh->lock);
+            memcpy(dest + total_read, bh->data + block_offset, to_read);
+            pthread_rwlock_unlock(&bh->lock);
+            blkdev_release_block(cache->dev, bh, false);
         }
 
         total_read += to_read;
     }
 
-    // 更新访问时间
-    inode->disk.atime = time(NULL);
-    inode->dirty = 1;
+    // 按atime策略更新访问时间
+    inode_touch_atime(cache, inode);
 
     // fprintf(stderr, "[DEBUG] inode_read: total_read=%zu\n", total_read);
     return total_read;
@@ -871,59 +2413,85 @@ ssize_t inode_write(inode_cache_t *cache,
         return MODERNFS_EINVAL;
     }
 
+    // 小文件的内容直接写进Inode;写不下时先把已有的内联数据搬到数据块
+    if (inline_fits(cache, inode, offset, size)) {
+        return inline_write(cache, inode, buf, offset, size);
+    }
+    if (inode_is_inline(inode)) {
+        int ret = inode_inline_spill(cache, inode);
+        if (ret != MODERNFS_SUCCESS) {
+            return ret;
+        }
+    }
+
     size_t total_written = 0;
     const uint8_t *src = (const uint8_t *)buf;
 
     while (total_written < size) {
         uint64_t cur_offset = offset + total_written;
         uint32_t block_offset = cur_offset % BLOCK_SIZE;
-        uint32_t to_write = BLOCK_SIZE - block_offset;
+        size_t remaining = size - total_written;
+
+        block_t block;
+        uint32_t run;
+        int ret;
 
-        if (to_write > size - total_written) {
-            to_write = size - total_written;
+        // 延迟分配: 落在空洞中的部分只写入暂存页,不经过Journal
+        if (delalloc_enabled(cache, inode)) {
+            ret = lookup_run(cache, inode, cur_offset, blocks_needed(cur_offset, remaining),
+                             &block, &run);
+            if (ret < 0) {
+                return ret;
+            }
+            if (block == 0) {
+                size_t to_write = (size_t)run * BLOCK_SIZE - block_offset;
+                if (to_write > remaining) {
+                    to_write = remaining;
+                }
+                ret = delalloc_write(cache, inode, cur_offset, src + total_written, to_write);
+                if (ret < 0) {
+                    return ret;
+                }
+                total_written += to_write;
+                continue;
+            }
         }
 
-        block_t block;
-        int ret = inode_bmap(cache, inode, cur_offset, true, &block);
+        // 按本次写入覆盖的大小映射(空洞整段分配),有无事务都一样
+        ret = inode_bmap_run(cache, inode, cur_offset, blocks_needed(cur_offset, remaining),
+                             true, &block, &run);
         if (ret < 0) {
             return ret;
         }
 
-        uint8_t *bbuf = malloc(BLOCK_SIZE);
-        if (!bbuf) {
-            return MODERNFS_ERROR;
-        }
-
-        // 如果不是整块写入，需要先读取
-        if (block_offset != 0 || to_write != BLOCK_SIZE) {
-            if (blkdev_read(cache->dev, block, bbuf) != 0) {
-                free(bbuf);
-                return MODERNFS_EIO;
-            }
+        size_t to_write = (size_t)run * BLOCK_SIZE - block_offset;
+        if (to_write > remaining) {
+            to_write = remaining;
         }
 
-        memcpy(bbuf + block_offset, src + total_written, to_write);
-
-        // Week 7: 如果有Journal事务，记录到Journal；否则直接写入磁盘
-        if (txn != NULL) {
-            // 调用Rust FFI记录块写入到Journal事务
-            extern int rust_journal_write(void *txn, uint32_t block_num, const uint8_t *data);
-            ret = rust_journal_write(txn, block, bbuf);
+        if (run > 1 && !txn) {
+            ret = write_run(cache, block, run, block_offset, src + total_written, to_write);
             if (ret < 0) {
-                fprintf(stderr, "inode_write: rust_journal_write failed for block %u\n", block);
-                free(bbuf);
-                return MODERNFS_EIO;
+                return ret;
             }
         } else {
-            // 无Journal，直接写入磁盘
-            if (blkdev_write(cache->dev, block, bbuf) != 0) {
-                free(bbuf);
-                return MODERNFS_EIO;
+            // Journal按块记录: 区间内逐块写入事务
+            size_t done = 0;
+            uint32_t boff = block_offset;
+            for (uint32_t k = 0; done < to_write; k++) {
+                uint32_t len = BLOCK_SIZE - boff;
+                if (len > to_write - done) {
+                    len = (uint32_t)(to_write - done);
+                }
+                ret = write_block(cache, block + k, boff, src + total_written + done, len, txn);
+                if (ret < 0) {
+                    return ret;
+                }
+                done += len;
+                boff = 0;
             }
         }
 
-        free(bbuf);
-
         total_written += to_write;
     }
 
@@ -934,7 +2502,7 @@ ssize_t inode_write(inode_cache_t *cache,
 
     // 更新修改时间
     inode->disk.mtime = time(NULL);
-    inode->dirty = 1;
+    inode_mark_dirty(cache, inode);
 
     return total_written;
 }
@@ -0,0 +1,454 @@
+#define _GNU_SOURCE
+
+#include "modernfs/io_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+// <linux/io_uring.h>间接包含<linux/fs.h>,会把BLOCK_SIZE重定义为1024,
+// 必须在包含它之前把块偏移计算固定下来
+static inline off_t block_offset(block_t block) {
+    return (off_t)block * BLOCK_SIZE;
+}
+
+#if defined(__linux__) && !defined(MODERNFS_DISABLE_IO_URING) && \
+    defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define MODERNFS_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef MODERNFS_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// ============ 引擎结构 ============
+
+#ifdef MODERNFS_HAVE_IO_URING
+typedef struct uring {
+    int ring_fd;
+    uint32_t entries;
+
+    // 提交队列
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+
+    // 完成队列
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // mmap区域
+    void *sq_ptr;
+    size_t sq_len;
+    void *cq_ptr;
+    size_t cq_len;
+    size_t sqes_len;
+} uring_t;
+#endif
+
+struct io_engine {
+    int fd;
+    io_engine_type_t type;
+    pthread_mutex_t lock;           // 保护环形队列,同一时刻只有一个批次在提交
+#ifdef MODERNFS_HAVE_IO_URING
+    uring_t ring;
+#endif
+};
+
+// ============ 同步路径 ============
+
+// 从第skip字节开始逐段补齐向量请求(首次preadv/pwritev短读写后使用)
+static int finish_vec_request(int fd, io_request_t *req, size_t skip) {
+    off_t offset = block_offset(req->block);
+    size_t pos = 0;
+
+    for (int i = 0; i < req->iovcnt; i++) {
+        uint8_t *base = req->iov[i].iov_base;
+        size_t seg = req->iov[i].iov_len;
+        size_t done = skip > pos ? skip - pos : 0;
+
+        while (done < seg) {
+            ssize_t n = (req->op == IO_OP_READ)
+                            ? pread(fd, base + done, seg - done, offset + pos + done)
+                            : pwrite(fd, base + done, seg - done, offset + pos + done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -errno;
+            }
+            if (n == 0) {
+                return -EIO;
+            }
+            done += n;
+        }
+        pos += seg;
+    }
+
+    return 0;
+}
+
+static int do_sync_request(int fd, io_request_t *req) {
+    if (req->iov) {
+        off_t offset = block_offset(req->block);
+        ssize_t n = (req->op == IO_OP_READ)
+                        ? preadv(fd, req->iov, req->iovcnt, offset)
+                        : pwritev(fd, req->iov, req->iovcnt, offset);
+        if (n < 0 && errno != EINTR) {
+            return -errno;
+        }
+        return finish_vec_request(fd, req, n < 0 ? 0 : (size_t)n);
+    }
+
+    uint8_t *p = req->buf;
+    uint32_t done = 0;
+    off_t offset = block_offset(req->block);
+
+    while (done < req->len) {
+        ssize_t n = (req->op == IO_OP_READ)
+                        ? pread(fd, p + done, req->len - done, offset + done)
+                        : pwrite(fd, p + done, req->len - done, offset + done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (n == 0) {
+            return -EIO;            // 读到文件末尾
+        }
+        done += n;
+    }
+
+    return 0;
+}
+
+int io_submit_sync(int fd, io_request_t *reqs, uint32_t count) {
+    int first_err = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        reqs[i].result = do_sync_request(fd, &reqs[i]);
+        if (reqs[i].result < 0 && first_err == 0) {
+            first_err = reqs[i].result;
+        }
+    }
+
+    return first_err;
+}
+
+// ============ io_uring路径 ============
+
+#ifdef MODERNFS_HAVE_IO_URING
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void uring_unmap(uring_t *ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_len);
+    }
+    if (ring->cq_ptr && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_len);
+    }
+    if (ring->sq_ptr && ring->sq_ptr != MAP_FAILED) {
+        munmap(ring->sq_ptr, ring->sq_len);
+    }
+    if (ring->ring_fd >= 0) {
+        close(ring->ring_fd);
+    }
+}
+
+static int uring_init(uring_t *ring, uint32_t depth) {
+    memset(ring, 0, sizeof(*ring));
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    ring->ring_fd = sys_io_uring_setup(depth, &p);
+    if (ring->ring_fd < 0) {
+        return -errno;
+    }
+
+    ring->entries = p.sq_entries;
+    ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    // 新内核SQ和CQ共用一块映射
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_len > ring->sq_len) {
+            ring->sq_len = ring->cq_len;
+        }
+        ring->cq_len = ring->sq_len;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        int err = -errno;
+        uring_unmap(ring);
+        return err;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            int err = -errno;
+            uring_unmap(ring);
+            return err;
+        }
+    }
+
+    ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        int err = -errno;
+        uring_unmap(ring);
+        return err;
+    }
+
+    uint8_t *sq = ring->sq_ptr;
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+
+    uint8_t *cq = ring->cq_ptr;
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // SQ数组与SQE一一对应,之后只需填写SQE
+    for (uint32_t i = 0; i < p.sq_entries; i++) {
+        ring->sq_array[i] = i;
+    }
+
+    return 0;
+}
+
+// 提交一个不超过队列深度的批次并等待全部完成
+static int uring_submit_chunk(io_engine_t *engine, io_request_t *reqs, uint32_t count) {
+    uring_t *ring = &engine->ring;
+
+    unsigned tail = *ring->sq_tail;
+    unsigned mask = *ring->sq_mask;
+
+    for (uint32_t i = 0; i < count; i++) {
+        struct io_uring_sqe *sqe = &ring->sqes[(tail + i) & mask];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->fd = engine->fd;
+        sqe->off = block_offset(reqs[i].block);
+        if (reqs[i].iov) {
+            sqe->opcode = (reqs[i].op == IO_OP_READ) ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->addr = (uint64_t)(uintptr_t)reqs[i].iov;
+            sqe->len = reqs[i].iovcnt;
+        } else {
+            sqe->opcode = (reqs[i].op == IO_OP_READ) ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->addr = (uint64_t)(uintptr_t)reqs[i].buf;
+            sqe->len = reqs[i].len;
+        }
+        sqe->user_data = i;
+        reqs[i].result = -EINPROGRESS;
+    }
+
+    // 发布新的SQ尾指针,内核看到尾指针时SQE必须已经写好
+    __atomic_store_n(ring->sq_tail, tail + count, __ATOMIC_RELEASE);
+
+    uint32_t submitted = 0;
+    uint32_t completed = 0;
+
+    while (completed < count) {
+        int ret = sys_io_uring_enter(ring->ring_fd, count - submitted, 1,
+                                     IORING_ENTER_GETEVENTS);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            // 环已不可用,剩余请求交由同步路径处理
+            int err = -errno;
+            perror("io_engine: io_uring_enter failed");
+            return err;
+        }
+        submitted += ret;
+
+        // 收割完成事件
+        unsigned head = *ring->cq_head;
+        unsigned cq_tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        unsigned cq_mask = *ring->cq_mask;
+
+        while (head != cq_tail) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & cq_mask];
+            io_request_t *req = &reqs[cqe->user_data];
+
+            if (cqe->res < 0) {
+                req->result = cqe->res;
+            } else if ((uint32_t)cqe->res < req->len && req->iov) {
+                req->result = finish_vec_request(engine->fd, req, cqe->res);
+            } else if ((uint32_t)cqe->res < req->len) {
+                // 短读写很少见,剩余部分同步补齐
+                uint8_t *p = (uint8_t *)req->buf + cqe->res;
+                size_t rest = req->len - cqe->res;
+                off_t offset = block_offset(req->block) + cqe->res;
+                ssize_t n = (req->op == IO_OP_READ)
+                                ? pread(engine->fd, p, rest, offset)
+                                : pwrite(engine->fd, p, rest, offset);
+                req->result = (n == (ssize_t)rest) ? 0 : -EIO;
+            } else {
+                req->result = 0;
+            }
+
+            head++;
+            completed++;
+        }
+
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return 0;
+}
+
+#endif // MODERNFS_HAVE_IO_URING
+
+// ============ 引擎创建和销毁 ============
+
+io_engine_t* io_engine_create(int fd, io_engine_type_t type, uint32_t queue_depth) {
+    io_engine_t *engine = calloc(1, sizeof(io_engine_t));
+    if (!engine) {
+        fprintf(stderr, "io_engine_create: calloc failed\n");
+        return NULL;
+    }
+
+    engine->fd = fd;
+    engine->type = IO_ENGINE_SYNC;
+    pthread_mutex_init(&engine->lock, NULL);
+
+    if (type == IO_ENGINE_URING) {
+#ifdef MODERNFS_HAVE_IO_URING
+        if (queue_depth == 0) {
+            queue_depth = IO_ENGINE_DEFAULT_DEPTH;
+        }
+
+        int ret = uring_init(&engine->ring, queue_depth);
+        if (ret == 0) {
+            engine->type = IO_ENGINE_URING;
+        } else {
+            memset(&engine->ring, 0, sizeof(engine->ring));
+            fprintf(stderr, "io_engine_create: io_uring unavailable (%s), using sync\n",
+                    strerror(-ret));
+        }
+#else
+        (void)queue_depth;
+        fprintf(stderr, "io_engine_create: built without io_uring, using sync\n");
+#endif
+    }
+
+    return engine;
+}
+
+void io_engine_destroy(io_engine_t *engine) {
+    if (!engine) return;
+
+#ifdef MODERNFS_HAVE_IO_URING
+    // 提交出错后type会降级为SYNC,但环仍需释放
+    if (engine->ring.sq_ptr) {
+        uring_unmap(&engine->ring);
+    }
+#endif
+
+    pthread_mutex_destroy(&engine->lock);
+    free(engine);
+}
+
+io_engine_type_t io_engine_type(const io_engine_t *engine) {
+    return engine ? engine->type : IO_ENGINE_SYNC;
+}
+
+const char* io_engine_name(io_engine_type_t type) {
+    return type == IO_ENGINE_URING ? "uring" : "sync";
+}
+
+int io_engine_parse(const char *name, io_engine_type_t *type_out) {
+    if (!name || !type_out) {
+        return -EINVAL;
+    }
+
+    if (strcmp(name, "sync") == 0 || strcmp(name, "pread") == 0) {
+        *type_out = IO_ENGINE_SYNC;
+    } else if (strcmp(name, "uring") == 0 || strcmp(name, "io_uring") == 0) {
+        *type_out = IO_ENGINE_URING;
+    } else {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+// ============ 批量提交 ============
+
+int io_engine_submit(io_engine_t *engine, io_request_t *reqs, uint32_t count) {
+    if (!engine || (!reqs && count > 0)) {
+        return -EINVAL;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+#ifdef MODERNFS_HAVE_IO_URING
+    // 环被其他线程占用时直接走同步路径,避免所有批次串行排队
+    if (engine->type == IO_ENGINE_URING && count > 1 &&
+        pthread_mutex_trylock(&engine->lock) == 0) {
+        uint32_t done = 0;
+
+        while (done < count) {
+            uint32_t n = count - done;
+            if (n > engine->ring.entries) {
+                n = engine->ring.entries;
+            }
+
+            if (uring_submit_chunk(engine, reqs + done, n) < 0) {
+                // 环出错后不再使用
+                engine->type = IO_ENGINE_SYNC;
+                break;
+            }
+            done += n;
+        }
+
+        pthread_mutex_unlock(&engine->lock);
+
+        // 未完成的请求(环出错时)同步补齐
+        int first_err = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (i >= done || reqs[i].result == -EINPROGRESS) {
+                reqs[i].result = do_sync_request(engine->fd, &reqs[i]);
+            }
+            if (reqs[i].result < 0 && first_err == 0) {
+                first_err = reqs[i].result;
+            }
+        }
+
+        return first_err;
+    }
+#endif
+
+    return io_submit_sync(engine->fd, reqs, count);
+}
@@ -17,8 +17,15 @@
 
 struct modernfs_config {
     char *device;
+    char *io_engine;
     int show_help;
     int read_only;
+    int delalloc;
+    unsigned int icache_mb;
+    int inline_data;
+    int noatime;
+    int strictatime;
+    int lazytime;
 };
 
 #define MODERNFS_OPT(t, p) { t, offsetof(struct modernfs_config, p), 1 }
@@ -27,6 +34,13 @@ static const struct fuse_opt modernfs_opts[] = {
     MODERNFS_OPT("--device=%s", device),
     MODERNFS_OPT("-r", read_only),
     MODERNFS_OPT("--read-only", read_only),
+    MODERNFS_OPT("--io-engine=%s", io_engine),
+    MODERNFS_OPT("--delalloc", delalloc),
+    MODERNFS_OPT("--inode-cache-mb=%u", icache_mb),
+    MODERNFS_OPT("--inline-data", inline_data),
+    MODERNFS_OPT("--noatime", noatime),
+    MODERNFS_OPT("--strictatime", strictatime),
+    MODERNFS_OPT("--lazytime", lazytime),
     FUSE_OPT_KEY("-h", 0),
     FUSE_OPT_KEY("--help", 0),
     FUSE_OPT_END
@@ -37,6 +51,13 @@ static void show_help(const char *progname) {
     printf("ModernFS options:\n");
     printf("    --device=<s>         Device path (disk image file)\n");
     printf("    -r, --read-only      Mount filesystem read-only\n");
+    printf("    --io-engine=<s>      Block I/O engine: sync (default) or uring\n");
+    printf("    --delalloc           Delay data block allocation until sync/checkpoint\n");
+    printf("    --inode-cache-mb=<n> Memory budget for cached inodes (default 16)\n");
+    printf("    --inline-data        Store small files and directories inside the inode\n");
+    printf("    --noatime            Do not update access times on read\n");
+    printf("    --strictatime        Update access times on every read (default: relatime)\n");
+    printf("    --lazytime           Keep timestamp-only updates in memory, write back in batches\n");
     printf("\n");
     printf("General options:\n");
     printf("    -h, --help           Show this help message\n");
@@ -102,14 +123,42 @@ int main(int argc, char *argv[]) {
     printf("║       ModernFS FUSE Driver v1.0        ║\n");
     printf("╚════════════════════════════════════════╝\n\n");
 
+    fs_mount_opts_t mount_opts = {
+        .read_only = config.read_only,
+        .io_engine = IO_ENGINE_SYNC,
+        .delalloc = config.delalloc,
+        .icache_mb = config.icache_mb,
+        .inline_data = config.inline_data,
+        .atime_mode = config.noatime ? INODE_ATIME_NOATIME :
+                      config.strictatime ? INODE_ATIME_STRICT : INODE_ATIME_RELATIME,
+        .lazytime = config.lazytime,
+    };
+
+    if (config.io_engine && io_engine_parse(config.io_engine, &mount_opts.io_engine) < 0) {
+        fprintf(stderr, "Error: unknown io engine '%s' (expected sync or uring)\n",
+                config.io_engine);
+        free(config.device);
+        free(config.io_engine);
+        fuse_opt_free_args(&args);
+        return 1;
+    }
+
     printf("Device: %s\n", config.device);
-    printf("Mode: %s\n\n", config.read_only ? "read-only" : "read-write");
+    printf("Mode: %s\n", config.read_only ? "read-only" : "read-write");
+    printf("IO engine: %s\n", io_engine_name(mount_opts.io_engine));
+    printf("Delayed allocation: %s\n", mount_opts.delalloc ? "on" : "off");
+    printf("Inline data: %s\n", mount_opts.inline_data ? "on" : "off");
+    printf("Atime: %s%s\n\n",
+           mount_opts.atime_mode == INODE_ATIME_NOATIME ? "noatime" :
+           mount_opts.atime_mode == INODE_ATIME_STRICT ? "strictatime" : "relatime",
+           mount_opts.lazytime ? ", lazytime" : "");
 
     // 初始化文件系统上下文
-    ctx = fs_context_init(config.device, config.read_only);
+    ctx = fs_context_init_opts(config.device, &mount_opts);
     if (!ctx) {
         fprintf(stderr, "Failed to initialize filesystem context\n");
         free(config.device);
+        free(config.io_engine);
         fuse_opt_free_args(&args);
         return 1;
     }
@@ -127,6 +176,7 @@ int main(int argc, char *argv[]) {
     // 清理
     // 注意: ctx会在modernfs_destroy中被清理
     free(config.device);
+    free(config.io_engine);
     fuse_opt_free_args(&args);
 
     return ret;
@@ -68,9 +68,44 @@ int superblock_validate(const superblock_t *sb) {
         return -EINVAL;
     }
 
+    // 检查分配组: 组大小按64位字对齐,各组恰好覆盖数据区和Inode表
+    if (sb->group_count != 0) {
+        uint64_t data_span = (uint64_t)sb->group_count * sb->group_data_blocks;
+        uint64_t inode_span = (uint64_t)sb->group_count * sb->group_inodes;
+        if (sb->group_data_blocks == 0 || sb->group_data_blocks % 64 != 0 ||
+            sb->group_inodes == 0 ||
+            data_span < sb->data_blocks || data_span - sb->data_blocks >= sb->group_data_blocks ||
+            inode_span < sb->total_inodes) {
+            fprintf(stderr, "superblock_validate: invalid group layout (%u groups of %u blocks, %u inodes)\n",
+                    sb->group_count, sb->group_data_blocks, sb->group_inodes);
+            return -EINVAL;
+        }
+    }
+
     return 0;
 }
 
+void superblock_init_groups(superblock_t *sb) {
+    if (!sb) return;
+
+    // 组大小取2的幂,从一个位图块的容量往下减半,直到至少有GROUP_MIN_COUNT组
+    uint32_t group_blocks = GROUP_MAX_DATA_BLOCKS;
+    while (group_blocks > GROUP_MIN_DATA_BLOCKS &&
+           sb->data_blocks / group_blocks < GROUP_MIN_COUNT) {
+        group_blocks /= 2;
+    }
+
+    sb->group_data_blocks = group_blocks;
+    sb->group_count = (sb->data_blocks + group_blocks - 1) / group_blocks;
+    if (sb->group_count == 0) {
+        sb->group_count = 1;
+    }
+
+    // 每组的Inode占整数个Inode表块(每块32个)
+    uint32_t per_group = (sb->total_inodes + sb->group_count - 1) / sb->group_count;
+    sb->group_inodes = (per_group + 31) / 32 * 32;
+}
+
 void superblock_init(superblock_t *sb, uint32_t total_blocks) {
     if (!sb) return;
 
@@ -150,6 +185,9 @@ void superblock_init(superblock_t *sb, uint32_t total_blocks) {
     // 根目录
     sb->root_inum = 1;
 
+    // 分配组
+    superblock_init_groups(sb);
+
     printf("Superblock initialized:\n");
     printf("  Total blocks: %u\n", sb->total_blocks);
     printf("  Data blocks: %u\n", sb->data_blocks);
@@ -169,4 +207,6 @@ void superblock_init(superblock_t *sb, uint32_t total_blocks) {
     printf("  Data area: blocks %u-%u (%u blocks)\n",
            sb->data_start, sb->data_start + sb->data_blocks - 1,
            sb->data_blocks);
+    printf("  Groups: %u (%u data blocks, %u inodes each)\n",
+           sb->group_count, sb->group_data_blocks, sb->group_inodes);
 }
\ No newline at end of file
@@ -0,0 +1,162 @@
+/*
+ * 并发测试: Buffer Cache读吞吐随线程数的扩展性
+ * 对比单分片(等价于旧的全局cache_lock)与默认分片数
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include "modernfs/block_dev.h"
+#include "modernfs/buffer_cache.h"
+
+#define TEST_IMG "test_cache_scaling.img"
+#define TEST_IMG_SIZE (64 * 1024 * 1024)   // 64MB
+#define WORKING_SET 512                     // 工作集小于缓存,测试命中路径
+#define OPS_PER_THREAD 20000
+#define MAX_THREADS 32
+
+typedef struct {
+    block_device_t *dev;
+    unsigned int seed;
+    int errors;
+} thread_arg_t;
+
+static void* read_worker(void* arg) {
+    thread_arg_t* targ = (thread_arg_t*)arg;
+    uint8_t buf[BLOCK_SIZE];
+
+    for (int i = 0; i < OPS_PER_THREAD; i++) {
+        block_t block = 1 + rand_r(&targ->seed) % WORKING_SET;
+        if (blkdev_read(targ->dev, block, buf) != 0 || buf[0] != (uint8_t)block) {
+            targ->errors++;
+        }
+    }
+
+    return NULL;
+}
+
+// 以指定线程数运行一轮,返回吞吐量(次/秒),出错返回负数
+static double run_round(block_device_t *dev, int nthreads) {
+    pthread_t threads[MAX_THREADS];
+    thread_arg_t args[MAX_THREADS];
+
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    for (int i = 0; i < nthreads; i++) {
+        args[i].dev = dev;
+        args[i].seed = 12345 + i;
+        args[i].errors = 0;
+        if (pthread_create(&threads[i], NULL, read_worker, &args[i]) != 0) {
+            fprintf(stderr, "Failed to create thread %d\n", i);
+            return -1;
+        }
+    }
+
+    int errors = 0;
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    double elapsed = (end_time.tv_sec - start_time.tv_sec) +
+                     (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+
+    if (errors > 0) {
+        fprintf(stderr, "%d read errors with %d threads\n", errors, nthreads);
+        return -1;
+    }
+
+    return (double)nthreads * OPS_PER_THREAD / elapsed;
+}
+
+int main(void) {
+    printf("╔════════════════════════════════════════╗\n");
+    printf("║  Buffer Cache并发扩展性测试            ║\n");
+    printf("║  1-%d threads × %d reads             ║\n", MAX_THREADS, OPS_PER_THREAD);
+    printf("╚════════════════════════════════════════╝\n\n");
+
+    int fd = open(TEST_IMG, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, TEST_IMG_SIZE) != 0) {
+        fprintf(stderr, "Failed to create %s\n", TEST_IMG);
+        return 1;
+    }
+    close(fd);
+
+    block_device_t *dev = blkdev_open(TEST_IMG);
+    if (!dev) {
+        fprintf(stderr, "Failed to open device\n");
+        return 1;
+    }
+
+    // 准备工作集: 每块首字节为块号,便于校验
+    uint8_t buf[BLOCK_SIZE];
+    for (block_t b = 1; b <= WORKING_SET; b++) {
+        memset(buf, (uint8_t)b, BLOCK_SIZE);
+        blkdev_write(dev, b, buf);
+    }
+    blkdev_sync(dev);
+
+    uint32_t shard_configs[] = { 1, CACHE_DEFAULT_SHARDS };
+    int thread_counts[] = { 1, 2, 4, 8, 16, 32 };
+    int failed = 0;
+
+    printf("  %-8s", "threads");
+    for (size_t c = 0; c < sizeof(shard_configs) / sizeof(shard_configs[0]); c++) {
+        printf("  %10u shard(s)", shard_configs[c]);
+    }
+    printf("\n");
+
+    double results[2][6];
+
+    for (size_t c = 0; c < 2; c++) {
+        // 替换为指定分片数的缓存并预热
+        buffer_cache_destroy(dev->cache);
+        dev->cache = buffer_cache_init(1024, shard_configs[c], dev->fd);
+        if (!dev->cache) {
+            fprintf(stderr, "Failed to init cache\n");
+            blkdev_close(dev);
+            return 1;
+        }
+        for (block_t b = 1; b <= WORKING_SET; b++) {
+            blkdev_read(dev, b, buf);
+        }
+
+        for (size_t t = 0; t < 6; t++) {
+            results[c][t] = run_round(dev, thread_counts[t]);
+            if (results[c][t] < 0) {
+                failed = 1;
+            }
+        }
+    }
+
+    for (size_t t = 0; t < 6; t++) {
+        printf("  %-8d  %14.0f/s  %14.0f/s\n",
+               thread_counts[t], results[0][t], results[1][t]);
+    }
+
+    float hit_rate;
+    buffer_cache_stats(dev->cache, NULL, NULL, NULL, &hit_rate);
+    printf("\n[STATS] Hit rate: %.2f%%\n", hit_rate * 100);
+
+    blkdev_close(dev);
+    remove(TEST_IMG);
+
+    printf("\n");
+    if (!failed) {
+        printf("╔════════════════════════════════════════╗\n");
+        printf("║  测试结果: ✅ PASS                     ║\n");
+        printf("╚════════════════════════════════════════╝\n");
+        return 0;
+    } else {
+        printf("╔════════════════════════════════════════╗\n");
+        printf("║  测试结果: ❌ FAIL                     ║\n");
+        printf("╚════════════════════════════════════════╝\n");
+        return 1;
+    }
+}
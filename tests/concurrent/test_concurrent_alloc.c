@@ -1,6 +1,6 @@
 /*
  * 并发测试: 多线程Extent分配
- * 验证Extent Allocator的线程安全性
+ * 验证Extent Allocator的线程安全性,并测量C块分配器在不同线程数下的吞吐量
  */
 
 #include <stdio.h>
@@ -12,9 +12,11 @@
 #include "modernfs/rust_ffi.h"
 #include "modernfs/superblock.h"
 #include "modernfs/block_dev.h"
+#include "modernfs/block_alloc.h"
 
 #define NUM_THREADS 8
 #define ALLOCS_PER_THREAD 50
+#define BALLOC_MAX_ALLOCS 20000     // 块分配器吞吐测试每线程最多分配次数
 
 typedef struct {
     int thread_id;
@@ -68,6 +70,128 @@ void* alloc_worker(void* arg) {
     return NULL;
 }
 
+// ============ 块分配器吞吐量 ============
+
+typedef struct {
+    block_allocator_t *alloc;
+    block_t *blocks;
+    uint32_t count;
+    uint32_t got;
+} balloc_arg_t;
+
+static void* balloc_worker(void* arg) {
+    balloc_arg_t* targ = (balloc_arg_t*)arg;
+
+    for (uint32_t i = 0; i < targ->count; i++) {
+        block_t block = block_alloc(targ->alloc);
+        if (block == 0) {
+            break;
+        }
+        targ->blocks[targ->got++] = block;
+    }
+    return NULL;
+}
+
+// 多线程各分配per_thread个单块,返回分配/秒;检查没有块被分配两次,最后全部释放
+static double balloc_run(block_allocator_t *alloc, int nthreads, uint32_t per_thread,
+                         int *errors) {
+    pthread_t threads[NUM_THREADS];
+    balloc_arg_t args[NUM_THREADS];
+    struct timespec t0, t1;
+
+    for (int i = 0; i < nthreads; i++) {
+        args[i].alloc = alloc;
+        args[i].blocks = malloc(per_thread * sizeof(block_t));
+        args[i].count = per_thread;
+        args[i].got = 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < nthreads; i++) {
+        pthread_create(&threads[i], NULL, balloc_worker, &args[i]);
+    }
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    uint64_t total = 0;
+
+    uint8_t *seen = calloc(alloc->total_blocks, 1);
+    for (int i = 0; i < nthreads; i++) {
+        if (args[i].got != per_thread) {
+            (*errors)++;
+        }
+        for (uint32_t j = 0; j < args[i].got; j++) {
+            uint32_t bit = args[i].blocks[j] - alloc->data_start;
+            if (seen[bit]++) {
+                fprintf(stderr, "[BALLOC] block %u allocated twice\n", args[i].blocks[j]);
+                (*errors)++;
+            }
+            block_free(alloc, args[i].blocks[j]);
+        }
+        total += args[i].got;
+        free(args[i].blocks);
+    }
+    free(seen);
+
+    return total / elapsed;
+}
+
+static int run_balloc_scaling(block_device_t *dev, const superblock_t *sb) {
+    printf("\n════════════════════════════════════════\n");
+    printf("  块分配器吞吐量 (block_alloc, 分配/秒)\n");
+    printf("════════════════════════════════════════\n");
+
+    block_allocator_t *alloc = block_alloc_init(dev, sb->data_bitmap_start,
+                                                sb->data_bitmap_blocks,
+                                                sb->data_start, sb->data_blocks);
+    if (!alloc) {
+        fprintf(stderr, "Failed to init block allocator\n");
+        return -1;
+    }
+
+    uint32_t free_before;
+    block_alloc_stats(alloc, NULL, &free_before, NULL, NULL);
+
+    // 每轮最多用掉一半空闲块
+    uint32_t per_thread = free_before / (2 * NUM_THREADS);
+    if (per_thread > BALLOC_MAX_ALLOCS) {
+        per_thread = BALLOC_MAX_ALLOCS;
+    }
+
+    int errors = 0;
+    printf("  %-8s %16s %16s %16s\n", "threads", "global lock", "reservation", "groups");
+    for (int n = 1; n <= NUM_THREADS; n *= 2) {
+        block_alloc_set_groups(alloc, 0);
+        block_alloc_set_reservation(alloc, 0);
+        double locked = balloc_run(alloc, n, per_thread, &errors);
+
+        block_alloc_set_reservation(alloc, BALLOC_RESV_DEFAULT);
+        double reserved = balloc_run(alloc, n, per_thread, &errors);
+
+        // 按超级块切分分配组,各线程落在不同组上
+        block_alloc_set_reservation(alloc, 0);
+        block_alloc_set_groups(alloc, sb->group_data_blocks);
+        double grouped = balloc_run(alloc, n, per_thread, &errors);
+
+        printf("  %-8d %16.0f %16.0f %16.0f\n", n, locked, reserved, grouped);
+    }
+
+    uint32_t free_after;
+    block_alloc_stats(alloc, NULL, &free_after, NULL, NULL);
+    if (free_after != free_before) {
+        printf("  ❌ 空闲块数不一致: %u -> %u\n", free_before, free_after);
+        errors++;
+    } else {
+        printf("  ✅ 所有块已释放,没有重复分配\n");
+    }
+
+    block_alloc_destroy(alloc);
+    return errors ? -1 : 0;
+}
+
 int main(int argc, char* argv[]) {
     if (argc != 2) {
         fprintf(stderr, "Usage: %s <image>\n", argv[0]);
@@ -192,12 +316,15 @@ int main(int argc, char* argv[]) {
     float frag = rust_extent_fragmentation(alloc);
     printf("[STATS] Fragmentation: %.2f%%\n", frag * 100);
 
-    // 清理
     rust_extent_alloc_destroy(alloc);
+
+    int balloc_ret = run_balloc_scaling(dev, &sb);
+
+    // 清理
     blkdev_close(dev);
 
     printf("\n");
-    if (total_failed == 0 &&
+    if (total_failed == 0 && balloc_ret == 0 &&
         final_allocated - init_allocated == total_allocated_blocks) {
         printf("╔════════════════════════════════════════╗\n");
         printf("║  测试结果: ✅ PASS                     ║\n");
@@ -0,0 +1,437 @@
+/*
+ * 位图分配器测试: 按字扫描的正确性 + 不同填充率下的分配延迟
+ */
+
+#include "modernfs/types.h"
+#include "modernfs/block_dev.h"
+#include "modernfs/block_alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define TEST_IMG "test_bitmap_alloc.img"
+#define BITMAP_START 1
+#define BITMAP_BLOCKS 64
+#define DATA_START (BITMAP_START + BITMAP_BLOCKS)
+#define MAX_BITS (BITMAP_BLOCKS * BLOCK_SIZE * 8)      // 2M块
+#define BENCH_ALLOCS 1024
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void create_image(void) {
+    int fd = open(TEST_IMG, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    assert(ftruncate(fd, (off_t)DATA_START * BLOCK_SIZE) == 0);
+    close(fd);
+}
+
+// ============ 辅助函数 ============
+
+static void set_bit(uint8_t *bitmap, uint32_t bit) {
+    bitmap[bit / 8] |= 1 << (bit % 8);
+}
+
+static int test_bit(const uint8_t *bitmap, uint32_t bit) {
+    return (bitmap[bit / 8] >> (bit % 8)) & 1;
+}
+
+// 替换分配器的内存位图并重新切分为一组(同时重置游标和空闲计数),
+// 用于在同一个分配器上构造不同场景
+static void load_bitmap(block_allocator_t *alloc, const uint8_t *bitmap, uint32_t total) {
+    memcpy(alloc->bitmap, bitmap, (size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    alloc->total_blocks = total;
+    assert(block_alloc_set_groups(alloc, 0) == 0);
+}
+
+// 交替生成已分配区间和空闲区间,空闲区间长度为1..max_free,整体占用率约为fill
+static void fill_bitmap(uint8_t *bitmap, uint32_t total, double fill,
+                        uint32_t max_free, unsigned int *seed) {
+    memset(bitmap, 0, (size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    if (fill <= 0) {
+        return;
+    }
+
+    double mean_used = (max_free + 1) / 2.0 * fill / (1 - fill);
+    uint32_t max_used = (uint32_t)(2 * mean_used) + 1;
+    uint32_t bit = 0;
+
+    while (bit < total) {
+        uint32_t used = 1 + rand_r(seed) % max_used;
+        for (uint32_t i = 0; i < used && bit < total; i++) {
+            set_bit(bitmap, bit++);
+        }
+        bit += 1 + rand_r(seed) % max_free;
+    }
+}
+
+// 参考实现: 逐位扫描的首次适配
+static int naive_find(const uint8_t *bitmap, uint32_t total, uint32_t count) {
+    uint32_t run = 0;
+    for (uint32_t i = 0; i < total; i++) {
+        if (test_bit(bitmap, i)) {
+            run = 0;
+        } else if (++run == count) {
+            return (int)(i + 1 - count);
+        }
+    }
+    return -1;
+}
+
+// ============ 正确性 ============
+
+static void test_word_boundaries(block_allocator_t *alloc) {
+    printf("========== Test: word boundaries ==========\n");
+
+    uint8_t *bitmap = malloc((size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    assert(bitmap != NULL);
+
+    // 跨越两个64位字的空闲区间
+    memset(bitmap, 0xFF, (size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    for (uint32_t i = 60; i < 72; i++) {
+        bitmap[i / 8] &= ~(1 << (i % 8));
+    }
+    load_bitmap(alloc, bitmap, 256);
+
+    block_t start;
+    uint32_t got;
+    assert(block_alloc_multiple(alloc, 13, &start, &got) < 0);
+    assert(block_alloc_multiple(alloc, 12, &start, &got) == 0);
+    assert(start == DATA_START + 60 && got == 12);
+    printf("✅ Run across word boundary found\n");
+
+    // 总块数不是64的倍数时,末尾字中超出范围的位不能被分配
+    memset(bitmap, 0xFF, (size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    bitmap[16] = 0x01;      // 块129空闲, 130..135超出范围
+    load_bitmap(alloc, bitmap, 130);
+    assert(alloc->free_blocks == 1);
+    assert(block_alloc(alloc) == DATA_START + 129);
+    assert(block_alloc(alloc) == 0);
+    assert(block_alloc_near(alloc, DATA_START + 120, 4, &start, &got) == -ENOSPC);
+    printf("✅ Tail bits beyond total_blocks ignored\n");
+
+    free(bitmap);
+    printf("✅ Word boundary test passed\n\n");
+}
+
+static void test_next_fit(block_allocator_t *alloc) {
+    printf("========== Test: next-fit cursor ==========\n");
+
+    uint8_t *bitmap = calloc(1, (size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    assert(bitmap != NULL);
+    load_bitmap(alloc, bitmap, 1000);
+
+    // 释放的块不会被立即重用,游标继续向后
+    block_t a = block_alloc(alloc);
+    block_t b = block_alloc(alloc);
+    assert(a == DATA_START && b == DATA_START + 1);
+    assert(block_free(alloc, a) == 0);
+    assert(block_alloc(alloc) == DATA_START + 2);
+
+    block_t start;
+    uint32_t got;
+    assert(block_alloc_multiple(alloc, 8, &start, &got) == 0);
+    assert(start == DATA_START + 3);
+    assert(alloc->groups[0].cursor == 11);
+    printf("✅ Cursor advances past freed blocks\n");
+
+    // 游标之后没有足够长的区间时回绕到开头
+    assert(block_alloc_near(alloc, DATA_START + 995, 5, &start, &got) == 0);
+    assert(start == DATA_START + 995 && got == 5);
+    assert(alloc->groups[0].cursor == 0);
+    assert(block_alloc_near(alloc, DATA_START + 990, 10, &start, &got) == 0);
+    assert(start == DATA_START + 11 && got == 10);
+    printf("✅ Search wraps around the end\n");
+
+    // 起点在游标之前、终点越过游标的区间也能在回绕后找到
+    memset(bitmap, 0xFF, (size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    for (uint32_t i = 100; i < 120; i++) {
+        bitmap[i / 8] &= ~(1 << (i % 8));
+    }
+    load_bitmap(alloc, bitmap, 1000);
+    alloc->groups[0].cursor = 110;
+    assert(block_alloc_multiple(alloc, 20, &start, &got) == 0);
+    assert(start == DATA_START + 100);
+    printf("✅ Run straddling the cursor found\n");
+
+    // 找不到完整区间时就近分配退而取第一段空闲区间
+    load_bitmap(alloc, bitmap, 1000);
+    for (uint32_t i = 100; i < 120; i += 4) {
+        set_bit(alloc->bitmap, i);
+        alloc->free_blocks--;
+        alloc->groups[0].free--;
+    }
+    assert(block_alloc_near(alloc, DATA_START + 500, 8, &start, &got) == 0);
+    assert(start == DATA_START + 101 && got == 3);
+    printf("✅ Partial run fallback\n");
+
+    free(bitmap);
+    printf("✅ Next-fit test passed\n\n");
+}
+
+static void test_reservation(block_allocator_t *alloc) {
+    printf("========== Test: per-thread reservation ==========\n");
+
+    uint8_t *bitmap = calloc(1, (size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    assert(bitmap != NULL);
+    load_bitmap(alloc, bitmap, 1000);
+    assert(block_alloc_set_reservation(alloc, 16) == 0);
+
+    // 窗口中的块连续分配,未分配的部分仍计为空闲
+    block_t a = block_alloc(alloc);
+    block_t b = block_alloc(alloc);
+    assert(b == a + 1);
+    uint32_t free_blocks;
+    block_alloc_stats(alloc, NULL, &free_blocks, NULL, NULL);
+    assert(free_blocks == 998);
+    assert(alloc->free_blocks == 1000 - 16);
+
+    // 其他分配绕开窗口
+    block_t start;
+    uint32_t got;
+    assert(block_alloc_multiple(alloc, 4, &start, &got) == 0);
+    assert(start >= a + 16 || start + got <= a);
+    printf("✅ Window blocks handed out in order\n");
+
+    // 收回后窗口剩余的块回到位图
+    block_alloc_release_reservations(alloc);
+    assert(alloc->free_blocks == 1000 - 6);
+    assert(!block_is_allocated(alloc, a + 2));
+    printf("✅ Leftover blocks returned\n");
+
+    // 空间被窗口占满时收回后仍能分配
+    load_bitmap(alloc, bitmap, 20);
+    assert(block_alloc(alloc) == DATA_START);
+    assert(block_alloc_multiple(alloc, 19, &start, &got) == 0);
+    assert(start == DATA_START + 1);
+    assert(block_alloc(alloc) == 0);
+    printf("✅ Reservations reclaimed on ENOSPC\n");
+
+    block_alloc_set_reservation(alloc, 0);
+    free(bitmap);
+    printf("✅ Reservation test passed\n\n");
+}
+
+static void test_groups(block_allocator_t *alloc) {
+    printf("========== Test: allocation groups ==========\n");
+
+    uint8_t *bitmap = calloc(1, (size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    assert(bitmap != NULL);
+    load_bitmap(alloc, bitmap, 4000);
+    assert(block_alloc_set_groups(alloc, 100) == -EINVAL);
+    assert(block_alloc_set_groups(alloc, 1024) == 0);
+    assert(alloc->group_count == 4);
+    assert(alloc->groups[3].len == 4000 - 3 * 1024);
+    assert(block_alloc_group_of(alloc, DATA_START + 2047) == 1);
+    assert(block_alloc_group_of(alloc, DATA_START + 4000) == BALLOC_NO_GROUP);
+
+    // 指定组时从该组的游标开始,就近分配落在goal所在组
+    block_t start;
+    uint32_t got;
+    assert(block_alloc_group_extent(alloc, 2, 8, 8, &start, &got) == 0);
+    assert(start == DATA_START + 2048 && got == 8);
+    assert(block_alloc_in_group(alloc, 3) == DATA_START + 3072);
+    assert(block_alloc_extent(alloc, DATA_START + 1500, 4, 4, &start, &got) == 0);
+    assert(start == DATA_START + 1500);
+    assert(alloc->groups[2].free == 1024 - 8);
+    printf("✅ Allocations stay in the requested group\n");
+
+    // 组满时换下一组
+    assert(block_alloc_extent(alloc, DATA_START + 1024, 476, 476, &start, &got) == 0);
+    assert(block_alloc_extent(alloc, DATA_START + 1504, 544, 544, &start, &got) == 0);
+    assert(alloc->groups[1].free == 0);
+    assert(block_alloc_in_group(alloc, 1) == DATA_START + 2056);
+    printf("✅ Full group falls through to the next one\n");
+
+    // 区间不越过组边界,跨组的连续区间可以一起释放
+    memset(bitmap, 0xFF, (size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    for (uint32_t i = 1020; i < 1030; i++) {
+        bitmap[i / 8] &= ~(1 << (i % 8));
+    }
+    load_bitmap(alloc, bitmap, 4000);
+    assert(block_alloc_set_groups(alloc, 1024) == 0);
+    assert(block_alloc_multiple(alloc, 10, &start, &got) == -ENOSPC);
+    assert(block_alloc_near(alloc, DATA_START + 1020, 10, &start, &got) == 0);
+    assert(start == DATA_START + 1020 && got == 4);
+    assert(block_alloc_multiple(alloc, 6, &start, &got) == 0);
+    assert(start == DATA_START + 1024);
+    assert(block_free_multiple(alloc, DATA_START + 1020, 10) == 0);
+    assert(alloc->groups[0].free == 4 && alloc->groups[1].free == 6);
+    assert(alloc->free_blocks == 10);
+    printf("✅ Runs respect group boundaries\n");
+
+    free(bitmap);
+    printf("✅ Allocation group test passed\n\n");
+}
+
+static void test_dirty_blocks(block_allocator_t *alloc) {
+    printf("========== Test: dirty bitmap blocks ==========\n");
+
+    uint8_t *bitmap = calloc(1, (size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    assert(bitmap != NULL);
+    load_bitmap(alloc, bitmap, MAX_BITS);
+    assert(block_alloc_sync(alloc) == 0);
+    assert(alloc->dirty[0] == 0);
+
+    // 只有改动过的位图块被标脏,跨块的区间标记两块
+    block_t start;
+    uint32_t got;
+    uint32_t per_block = BLOCK_SIZE * 8;
+    assert(block_alloc_extent(alloc, DATA_START + 3 * per_block + 5, 1, 1, &start, &got) == 0);
+    assert(block_alloc_extent(alloc, DATA_START + per_block - 2, 4, 4, &start, &got) == 0);
+    assert(alloc->dirty[0] == ((1ULL << 3) | (1ULL << 0) | (1ULL << 1)));
+
+    assert(block_alloc_sync(alloc) == 0);
+    assert(alloc->dirty[0] == 0);
+
+    assert(block_free_multiple(alloc, start, got) == 0);
+    assert(alloc->dirty[0] == ((1ULL << 0) | (1ULL << 1)));
+    assert(block_alloc_sync(alloc) == 0);
+    printf("✅ Only touched bitmap blocks are written\n");
+
+    free(bitmap);
+    printf("✅ Dirty bitmap test passed\n\n");
+}
+
+static void test_against_reference(block_allocator_t *alloc) {
+    printf("========== Test: compare with bit-by-bit scan ==========\n");
+
+    uint8_t *bitmap = malloc((size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    assert(bitmap != NULL);
+    unsigned int seed = 7;
+
+    const double fills[] = { 0.5, 0.9, 0.99 };
+    const uint32_t counts[] = { 1, 3, 8, 31, 64, 100 };
+    int checks = 0;
+
+    for (size_t f = 0; f < sizeof(fills) / sizeof(fills[0]); f++) {
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            uint32_t total = 4096 + rand_r(&seed) % 60000;
+            fill_bitmap(bitmap, total, fills[f], 2 * counts[c], &seed);
+            load_bitmap(alloc, bitmap, total);
+
+            // 游标在0时Next-Fit与首次适配的结果一致
+            int expect = naive_find(bitmap, total, counts[c]);
+            block_t start;
+            uint32_t got;
+            int ret = block_alloc_multiple(alloc, counts[c], &start, &got);
+            if (expect < 0) {
+                assert(ret < 0);
+            } else {
+                assert(ret == 0 && start == DATA_START + (uint32_t)expect);
+            }
+            checks++;
+        }
+    }
+
+    free(bitmap);
+    printf("✅ %d random bitmaps matched the reference scan\n\n", checks);
+}
+
+// ============ 性能测试 ============
+
+static double bench_alloc(block_allocator_t *alloc, uint32_t count) {
+    block_t start;
+    uint32_t got;
+    double begin = now_sec();
+    for (int i = 0; i < BENCH_ALLOCS; i++) {
+        if (count == 1) {
+            block_alloc(alloc);
+        } else {
+            block_alloc_multiple(alloc, count, &start, &got);
+        }
+    }
+    return (now_sec() - begin) / BENCH_ALLOCS * 1e9;
+}
+
+// 旧实现: 每次从位图开头逐位查找
+static double bench_naive(uint8_t *bitmap, uint32_t count) {
+    double begin = now_sec();
+    for (int i = 0; i < BENCH_ALLOCS; i++) {
+        int bit = naive_find(bitmap, MAX_BITS, count);
+        if (bit < 0) {
+            continue;
+        }
+        for (uint32_t j = 0; j < count; j++) {
+            set_bit(bitmap, (uint32_t)bit + j);
+        }
+    }
+    return (now_sec() - begin) / BENCH_ALLOCS * 1e9;
+}
+
+static void run_benchmark(block_allocator_t *alloc) {
+    printf("========== Benchmark: allocation latency vs fill ==========\n");
+    printf("  %u blocks, %d allocations per cell (ns/alloc)\n", MAX_BITS, BENCH_ALLOCS);
+    printf("  %-6s %14s %14s %14s %14s\n",
+           "fill", "1 blk word", "1 blk bit", "8 blk word", "8 blk bit");
+
+    uint8_t *bitmap = malloc((size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    uint8_t *scratch = malloc((size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+    assert(bitmap && scratch);
+
+    const double fills[] = { 0.0, 0.5, 0.9, 0.99 };
+    for (size_t f = 0; f < sizeof(fills) / sizeof(fills[0]); f++) {
+        unsigned int seed = 1234;
+        fill_bitmap(bitmap, MAX_BITS, fills[f], 16, &seed);
+
+        double result[4];
+        const uint32_t counts[] = { 1, 8 };
+        for (int c = 0; c < 2; c++) {
+            load_bitmap(alloc, bitmap, MAX_BITS);
+            result[c * 2] = bench_alloc(alloc, counts[c]);
+
+            memcpy(scratch, bitmap, (size_t)BITMAP_BLOCKS * BLOCK_SIZE);
+            result[c * 2 + 1] = bench_naive(scratch, counts[c]);
+        }
+
+        printf("  %5.0f%% %14.0f %14.0f %14.0f %14.0f\n", fills[f] * 100,
+               result[0], result[1], result[2], result[3]);
+    }
+
+    free(bitmap);
+    free(scratch);
+    printf("\n");
+}
+
+int main(void) {
+    printf("\n");
+    printf("========================================\n");
+    printf("  ModernFS Bitmap Allocator Test Suite\n");
+    printf("========================================\n\n");
+
+    create_image();
+
+    block_device_t *dev = blkdev_open(TEST_IMG);
+    assert(dev != NULL);
+    block_allocator_t *alloc = block_alloc_init(dev, BITMAP_START, BITMAP_BLOCKS,
+                                                DATA_START, MAX_BITS);
+    assert(alloc != NULL);
+    assert(alloc->free_blocks == MAX_BITS);
+
+    test_word_boundaries(alloc);
+    test_next_fit(alloc);
+    test_reservation(alloc);
+    test_groups(alloc);
+    test_dirty_blocks(alloc);
+    test_against_reference(alloc);
+
+    run_benchmark(alloc);
+
+    block_alloc_destroy(alloc);
+    blkdev_close(dev);
+    remove(TEST_IMG);
+
+    printf("========================================\n");
+    printf("  All Tests Passed!\n");
+    printf("========================================\n\n");
+
+    return 0;
+}
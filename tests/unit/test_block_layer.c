@@ -207,6 +207,27 @@ void test_block_allocator() {
 
     printf("✅ Multiple block allocation test passed\n");
 
+    // 测试就近分配: 目标位置空闲时从goal开始,区间不够长时向后寻找
+    block_t near1, near2, near3;
+    uint32_t near1_count, near2_count, near3_count;
+    ret = block_alloc_near(alloc, start + count + 5, 4, &near1, &near1_count);
+    assert(ret == 0);
+    assert(near1 == start + count + 5 && near1_count == 4);
+
+    ret = block_alloc_near(alloc, near1, 4, &near2, &near2_count);
+    assert(ret == 0);
+    assert(near2 == near1 + 4 && near2_count == 4);
+
+    ret = block_alloc_near(alloc, start + count, 8, &near3, &near3_count);
+    assert(ret == 0);
+    assert(near3 == near2 + 4 && near3_count == 8);
+
+    assert(block_free_multiple(alloc, near1, near1_count) == 0);
+    assert(block_free_multiple(alloc, near2, near2_count) == 0);
+    assert(block_free_multiple(alloc, near3, near3_count) == 0);
+
+    printf("✅ Near-goal allocation test passed\n");
+
     // 测试释放块
     ret = block_free(alloc, block1);
     assert(ret == 0);
@@ -263,6 +284,321 @@ void test_concurrent_access() {
     blkdev_close(dev);
 }
 
+void test_cache_eviction() {
+    printf("========== Test: Cache Eviction (2Q) ==========\n");
+
+    block_device_t *dev = blkdev_open(TEST_DISK_IMAGE);
+    assert(dev != NULL);
+
+    uint32_t max = dev->cache->max_buffers;
+    uint8_t buf[BLOCK_SIZE];
+    uint8_t read_buf[BLOCK_SIZE];
+
+    // 写入超过缓存容量的块,淘汰的脏块必须写回
+    uint32_t nblocks = max * 2;
+    for (uint32_t i = 0; i < nblocks; i++) {
+        memset(buf, (i * 7) % 256, BLOCK_SIZE);
+        assert(blkdev_write(dev, 1000 + i, buf) == 0);
+    }
+
+    uint32_t cached;
+    uint64_t writebacks;
+    buffer_cache_usage(dev->cache, &cached, NULL);
+    assert(cached <= max);
+
+    for (uint32_t i = 0; i < nblocks; i++) {
+        memset(buf, (i * 7) % 256, BLOCK_SIZE);
+        assert(blkdev_read(dev, 1000 + i, read_buf) == 0);
+        assert(memcmp(buf, read_buf, BLOCK_SIZE) == 0);
+    }
+
+    uint64_t hits, misses, evicts;
+    buffer_cache_stats(dev->cache, &hits, &misses, &evicts, NULL);
+    buffer_cache_usage(dev->cache, NULL, &writebacks);
+    printf("Cache stats: hits=%lu, misses=%lu, evicts=%lu, writebacks=%lu\n",
+           hits, misses, evicts, writebacks);
+    assert(evicts > 0);
+    assert(writebacks > 0);
+
+    printf("✅ Dirty victim write-back test passed\n");
+
+    blkdev_close(dev);
+
+    // 抗扫描: 热块经A1out晋升到Am后,大规模顺序扫描不应把它们挤出缓存
+    dev = blkdev_open(TEST_DISK_IMAGE);
+    assert(dev != NULL);
+
+    uint32_t hot = 100;
+    for (uint32_t i = 0; i < hot; i++) {
+        assert(blkdev_read(dev, 1000 + i, read_buf) == 0);
+    }
+    for (uint32_t i = 0; i < max + hot; i++) {
+        assert(blkdev_read(dev, 4000 + i, read_buf) == 0);
+    }
+    for (uint32_t i = 0; i < hot; i++) {
+        assert(blkdev_read(dev, 1000 + i, read_buf) == 0);
+    }
+    for (uint32_t i = 0; i < max * 2; i++) {
+        assert(blkdev_read(dev, 8000 + i, read_buf) == 0);
+    }
+
+    uint64_t hits_before;
+    buffer_cache_stats(dev->cache, &hits_before, NULL, NULL, NULL);
+    for (uint32_t i = 0; i < hot; i++) {
+        assert(blkdev_read(dev, 1000 + i, read_buf) == 0);
+    }
+    buffer_cache_stats(dev->cache, &hits, NULL, NULL, NULL);
+    printf("Hot set hits after scan: %lu/%u\n", hits - hits_before, hot);
+    assert(hits - hits_before == hot);
+
+    printf("✅ Scan resistance test passed\n\n");
+
+    blkdev_close(dev);
+}
+
+void test_pinned_blocks() {
+    printf("========== Test: Pinned Buffer API ==========\n");
+
+    block_device_t *dev = blkdev_open(TEST_DISK_IMAGE);
+    assert(dev != NULL);
+
+    uint8_t buf[BLOCK_SIZE];
+    memset(buf, 0x5A, BLOCK_SIZE);
+    assert(blkdev_write(dev, 300, buf) == 0);
+
+    // 原地读取
+    buffer_head_t *bh = blkdev_get_block(dev, 300);
+    assert(bh != NULL);
+    assert(bh->ref_count >= 1);
+    pthread_rwlock_rdlock(&bh->lock);
+    assert(memcmp(bh->data, buf, BLOCK_SIZE) == 0);
+    pthread_rwlock_unlock(&bh->lock);
+
+    // 原地修改后通过普通读取可见
+    pthread_rwlock_wrlock(&bh->lock);
+    bh->data[0] = 0xA5;
+    pthread_rwlock_unlock(&bh->lock);
+    blkdev_release_block(dev, bh, true);
+
+    assert(blkdev_read(dev, 300, buf) == 0);
+    assert(buf[0] == 0xA5 && buf[1] == 0x5A);
+
+    printf("✅ In-place read/modify test passed\n");
+
+    // 新块不读盘,内容全零
+    memset(buf, 0xFF, BLOCK_SIZE);
+    assert(blkdev_write(dev, 301, buf) == 0);
+    assert(blkdev_sync(dev) == 0);
+
+    bh = blkdev_get_new_block(dev, 301);
+    assert(bh != NULL);
+    pthread_rwlock_rdlock(&bh->lock);
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        assert(bh->data[i] == 0);
+    }
+    pthread_rwlock_unlock(&bh->lock);
+    blkdev_release_block(dev, bh, true);
+
+    // 脏块同步后重新打开仍可见
+    assert(blkdev_sync(dev) == 0);
+    blkdev_close(dev);
+
+    dev = blkdev_open(TEST_DISK_IMAGE);
+    assert(dev != NULL);
+    assert(blkdev_read(dev, 300, buf) == 0);
+    assert(buf[0] == 0xA5);
+    assert(blkdev_read(dev, 301, buf) == 0);
+    assert(buf[0] == 0 && buf[BLOCK_SIZE - 1] == 0);
+
+    // 越界
+    assert(blkdev_get_block(dev, TEST_TOTAL_BLOCKS + 100) == NULL);
+
+    printf("✅ Pinned buffer API test passed\n\n");
+
+    blkdev_close(dev);
+}
+
+static void* scratch_worker(void *arg) {
+    uint8_t **out = arg;
+    out[0] = blkdev_scratch(0);
+    memset(out[0], 0xCD, BLOCK_SIZE);
+    return NULL;
+}
+
+void test_buffer_pool() {
+    printf("========== Test: Buffer Pool ==========\n");
+
+    block_device_t *dev = blkdev_open(TEST_DISK_IMAGE);
+    assert(dev != NULL);
+
+    buffer_cache_t *cache = dev->cache;
+    uint8_t *pool_start = cache->page_pool;
+    uint8_t *pool_end = pool_start + (size_t)cache->max_buffers * BLOCK_SIZE;
+
+    // 写入超过缓存容量的块,淘汰后缓冲区从池中复用
+    uint8_t buf[BLOCK_SIZE];
+    for (block_t b = 3000; b < 3000 + cache->max_buffers * 2; b++) {
+        memset(buf, (uint8_t)b, BLOCK_SIZE);
+        assert(blkdev_write(dev, b, buf) == 0);
+    }
+
+    for (block_t b = 3000 + cache->max_buffers; b < 3000 + cache->max_buffers * 2; b += 97) {
+        buffer_head_t *bh = blkdev_get_block(dev, b);
+        assert(bh != NULL);
+        assert(bh >= cache->bh_pool && bh < cache->bh_pool + cache->max_buffers);
+        assert(bh->data >= pool_start && bh->data < pool_end);
+        assert(((uintptr_t)bh->data % BLOCK_SIZE) == 0);
+        assert(bh->data[0] == (uint8_t)b);
+        blkdev_release_block(dev, bh, false);
+    }
+
+    uint32_t buffers;
+    buffer_cache_usage(cache, &buffers, NULL);
+    assert(buffers <= cache->max_buffers);
+
+    printf("✅ Buffers recycled from pool (%s pages)\n", cache->huge_pages ? "huge" : "4K");
+
+    // 暂存块每个线程独立
+    uint8_t *mine = blkdev_scratch(0);
+    assert(mine != NULL && blkdev_scratch(0) == mine);
+    assert(blkdev_scratch(1) != mine);
+    assert(blkdev_scratch(BLKDEV_SCRATCH_SLOTS) == NULL);
+    memset(mine, 0xAB, BLOCK_SIZE);
+
+    uint8_t *theirs = NULL;
+    pthread_t tid;
+    assert(pthread_create(&tid, NULL, scratch_worker, &theirs) == 0);
+    pthread_join(tid, NULL);
+    assert(theirs != NULL && theirs != mine);
+    assert(mine[0] == 0xAB && mine[BLOCK_SIZE - 1] == 0xAB);
+
+    printf("✅ Buffer pool test passed\n\n");
+
+    assert(blkdev_sync(dev) == 0);
+    blkdev_close(dev);
+}
+
+// 轮询等待脏块数降到limit以下,超时返回false
+static bool wait_dirty_below(buffer_cache_t *cache, uint32_t limit, int timeout_ms) {
+    for (int waited = 0; waited < timeout_ms; waited += 10) {
+        if (buffer_cache_dirty_count(cache) <= limit) {
+            return true;
+        }
+        usleep(10000);
+    }
+    return buffer_cache_dirty_count(cache) <= limit;
+}
+
+void test_background_flusher() {
+    printf("========== Test: Background Flusher ==========\n");
+
+    block_device_t *dev = blkdev_open(TEST_DISK_IMAGE);
+    assert(dev != NULL);
+
+    int raw_fd = open(TEST_DISK_IMAGE, O_RDONLY);
+    assert(raw_fd >= 0);
+
+    // 缩短过期时间和周期,便于测试
+    dev->cache->dirty_expire_ms = 100;
+    dev->cache->flush_interval_ms = 50;
+    assert(buffer_cache_start_flusher(dev->cache) == 0);
+
+    uint8_t buf[BLOCK_SIZE];
+    uint8_t disk[BLOCK_SIZE];
+
+    // 少量脏块: 不触发比例阈值,过期后由写回线程写回
+    for (block_t b = 400; b < 420; b++) {
+        memset(buf, (uint8_t)b, BLOCK_SIZE);
+        assert(blkdev_write(dev, b, buf) == 0);
+    }
+    assert(buffer_cache_dirty_count(dev->cache) == 20);
+
+    assert(wait_dirty_below(dev->cache, 0, 2000));
+    for (block_t b = 400; b < 420; b++) {
+        assert(pread(raw_fd, disk, BLOCK_SIZE, (off_t)b * BLOCK_SIZE) == BLOCK_SIZE);
+        assert(disk[0] == (uint8_t)b && disk[BLOCK_SIZE - 1] == (uint8_t)b);
+    }
+
+    printf("✅ Expired dirty buffers written back\n");
+
+    // 大量脏块: 不等过期,超过后台阈值即写回
+    dev->cache->dirty_expire_ms = 60000;
+    uint32_t bg_limit = dev->cache->max_buffers * CACHE_DIRTY_BG_RATIO / 100;
+    uint32_t count = dev->cache->max_buffers * CACHE_DIRTY_RATIO / 100 + 100;
+
+    for (block_t b = 1000; b < 1000 + count; b++) {
+        memset(buf, (uint8_t)(b + 1), BLOCK_SIZE);
+        assert(blkdev_write(dev, b, buf) == 0);
+    }
+
+    assert(wait_dirty_below(dev->cache, bg_limit, 2000));
+
+    // 停止后不再写回,剩余脏块由sync写回
+    buffer_cache_stop_flusher(dev->cache);
+    assert(dev->cache->flusher_writebacks >= 20 + count - bg_limit);
+
+    printf("✅ Dirty ratio threshold triggers writeback\n");
+    memset(buf, 0x77, BLOCK_SIZE);
+    assert(blkdev_write(dev, 430, buf) == 0);
+    usleep(200000);
+    assert(buffer_cache_dirty_count(dev->cache) >= 1);
+
+    assert(blkdev_sync(dev) == 0);
+    assert(buffer_cache_dirty_count(dev->cache) == 0);
+    assert(pread(raw_fd, disk, BLOCK_SIZE, (off_t)430 * BLOCK_SIZE) == BLOCK_SIZE);
+    assert(disk[0] == 0x77);
+
+    printf("✅ Background flusher test passed\n\n");
+
+    close(raw_fd);
+    blkdev_close(dev);
+}
+
+void test_sorted_flush() {
+    printf("========== Test: Sorted Coalesced Flush ==========\n");
+
+    block_device_t *dev = blkdev_open(TEST_DISK_IMAGE);
+    assert(dev != NULL);
+
+    // 逆序写入两段相邻块,中间隔开,LRU顺序与块号顺序相反
+    uint8_t buf[BLOCK_SIZE];
+    for (block_t b = 2000 + 199; b >= 2000; b--) {
+        memset(buf, (uint8_t)(b * 3), BLOCK_SIZE);
+        assert(blkdev_write(dev, b, buf) == 0);
+    }
+    for (block_t b = 2300 + 9; b >= 2300; b--) {
+        memset(buf, (uint8_t)(b * 3), BLOCK_SIZE);
+        assert(blkdev_write(dev, b, buf) == 0);
+    }
+
+    uint64_t blocks_before, reqs_before, blocks_after, reqs_after;
+    buffer_cache_flush_stats(dev->cache, &blocks_before, &reqs_before);
+    assert(blkdev_sync(dev) == 0);
+    buffer_cache_flush_stats(dev->cache, &blocks_after, &reqs_after);
+
+    // 200块需要4个请求(每个最多CACHE_FLUSH_MAX_RUN块),10块需要1个
+    assert(blocks_after - blocks_before == 210);
+    assert(reqs_after - reqs_before ==
+           (200 + CACHE_FLUSH_MAX_RUN - 1) / CACHE_FLUSH_MAX_RUN + 1);
+    assert(buffer_cache_dirty_count(dev->cache) == 0);
+
+    printf("✅ 210 dirty blocks written with %lu requests\n", reqs_after - reqs_before);
+
+    int raw_fd = open(TEST_DISK_IMAGE, O_RDONLY);
+    assert(raw_fd >= 0);
+    uint8_t disk[BLOCK_SIZE];
+    for (block_t b = 2000; b < 2310; b++) {
+        if (b >= 2200 && b < 2300) continue;
+        assert(pread(raw_fd, disk, BLOCK_SIZE, (off_t)b * BLOCK_SIZE) == BLOCK_SIZE);
+        assert(disk[0] == (uint8_t)(b * 3) && disk[BLOCK_SIZE - 1] == (uint8_t)(b * 3));
+    }
+    close(raw_fd);
+
+    printf("✅ Sorted coalesced flush test passed\n\n");
+
+    blkdev_close(dev);
+}
+
 void test_edge_cases() {
     printf("========== Test: Edge Cases ==========\n");
 
@@ -304,6 +640,11 @@ int main() {
     test_buffer_cache();
     test_block_allocator();
     test_concurrent_access();
+    test_cache_eviction();
+    test_pinned_blocks();
+    test_buffer_pool();
+    test_background_flusher();
+    test_sorted_flush();
     test_edge_cases();
 
     // 清理
@@ -65,7 +65,7 @@ static int test_disk_space_exhaustion() {
     
     // 获取初始空闲块数
     uint32_t total, free_blocks, allocated;
-    int ret = rust_extent_get_stats(ctx->extent_alloc, &total, &free_blocks, &allocated);
+    block_alloc_stats(ctx->balloc, &total, &free_blocks, &allocated, NULL);
     printf("  初始状态: total=%u, free=%u, allocated=%u\n", total, free_blocks, allocated);
     
     // 持续分配直到失败
@@ -98,7 +98,7 @@ static int test_disk_space_exhaustion() {
             break;
         }
         
-        ret = dir_add(ctx->icache, root, filename, file->inum);
+        int ret = dir_add(ctx->icache, root, filename, file->inum);
         inode_unlock(file);
         inode_put(ctx->icache, file);
         
@@ -110,7 +110,7 @@ static int test_disk_space_exhaustion() {
         files_created++;
     }
     
-    rust_extent_get_stats(ctx->extent_alloc, &total, &free_blocks, &allocated);
+    block_alloc_stats(ctx->balloc, &total, &free_blocks, &allocated, NULL);
     printf("  最终状态: total=%u, free=%u, allocated=%u\n", total, free_blocks, allocated);
     printf("  ✓ 成功创建了%d个文件\n", files_created);
     
@@ -181,7 +181,7 @@ static int test_double_free() {
     
     // 分配一个extent
     uint32_t start, len;
-    int ret = rust_extent_alloc(ctx->extent_alloc, 0, 10, 20, &start, &len);
+    int ret = block_alloc_extent(ctx->balloc, 0, 10, 20, &start, &len);
     if (ret < 0) {
         fprintf(stderr, "  ✗ Extent分配失败\n");
         fs_context_destroy(ctx);
@@ -190,7 +190,7 @@ static int test_double_free() {
     printf("  ✓ 分配extent: [%u, +%u]\n", start, len);
     
     // 第一次释放
-    ret = rust_extent_free(ctx->extent_alloc, start, len);
+    ret = block_free_multiple(ctx->balloc, start, len);
     if (ret < 0) {
         fprintf(stderr, "  ✗ 第一次释放失败\n");
         fs_context_destroy(ctx);
@@ -199,7 +199,7 @@ static int test_double_free() {
     printf("  ✓ 第一次释放成功\n");
     
     // 第二次释放（应该失败）
-    ret = rust_extent_free(ctx->extent_alloc, start, len);
+    ret = block_free_multiple(ctx->balloc, start, len);
     if (ret >= 0) {
         fprintf(stderr, "  ✗ Double-free应该被检测并拒绝\n");
         fs_context_destroy(ctx);
@@ -363,22 +363,22 @@ static int test_extent_boundary() {
     
     // 获取总块数
     uint32_t total, free, allocated;
-    rust_extent_get_stats(ctx->extent_alloc, &total, &free, &allocated);
+    block_alloc_stats(ctx->balloc, &total, &free, &allocated, NULL);
     printf("  文件系统总块数: %u\n", total);
     
     // 尝试分配超过可用空间的extent
     uint32_t start, len;
-    int ret = rust_extent_alloc(ctx->extent_alloc, 0, total + 1000, total + 2000, &start, &len);
+    int ret = block_alloc_extent(ctx->balloc, 0, total + 1000, total + 2000, &start, &len);
     if (ret >= 0) {
         fprintf(stderr, "  ✗ 应该拒绝超过总容量的分配\n");
-        rust_extent_free(ctx->extent_alloc, start, len);
+        block_free_multiple(ctx->balloc, start, len);
         fs_context_destroy(ctx);
         return -1;
     }
     printf("  ✓ 超过容量的分配被正确拒绝\n");
     
     // 尝试释放无效范围
-    ret = rust_extent_free(ctx->extent_alloc, total + 1000, 100);
+    ret = block_free_multiple(ctx->balloc, ctx->balloc->data_start + total + 1000, 100);
     if (ret >= 0) {
         fprintf(stderr, "  ✗ 应该拒绝无效范围的释放\n");
         fs_context_destroy(ctx);
@@ -110,12 +110,12 @@ static int test_full_initialization() {
     }
     printf("  ✓ Journal Manager已初始化 (Rust)\n");
     
-    if (!ctx->extent_alloc) {
-        fprintf(stderr, "  ✗ Extent Allocator未初始化\n");
+    if (!ctx->balloc) {
+        fprintf(stderr, "  ✗ 块分配器未初始化\n");
         fs_context_destroy(ctx);
         return -1;
     }
-    printf("  ✓ Extent Allocator已初始化 (Rust)\n");
+    printf("  ✓ 块分配器已初始化\n");
     
     if (!ctx->checkpoint_running) {
         fprintf(stderr, "  ✗ Checkpoint线程未启动\n");
@@ -465,7 +465,7 @@ static int test_rust_c_integration() {
     
     // 1. 使用Extent分配块
     uint32_t start, len;
-    int ret = rust_extent_alloc(ctx->extent_alloc, 0, 50, 100, &start, &len);
+    int ret = block_alloc_extent(ctx->balloc, 0, 50, 100, &start, &len);
     if (ret < 0) {
         fprintf(stderr, "  ✗ Extent分配失败\n");
         fs_context_destroy(ctx);
@@ -477,7 +477,7 @@ static int test_rust_c_integration() {
     RustTransaction *txn = rust_journal_begin(ctx->journal);
     if (!txn) {
         fprintf(stderr, "  ✗ Journal事务开始失败\n");
-        rust_extent_free(ctx->extent_alloc, start, len);
+        block_free_multiple(ctx->balloc, start, len);
         fs_context_destroy(ctx);
         return -1;
     }
@@ -492,7 +492,7 @@ static int test_rust_c_integration() {
         if (ret < 0) {
             fprintf(stderr, "  ✗ Journal写入块%u失败\n", i);
             rust_journal_abort(txn);
-            rust_extent_free(ctx->extent_alloc, start, len);
+            block_free_multiple(ctx->balloc, start, len);
             fs_context_destroy(ctx);
             return -1;
         }
@@ -503,24 +503,24 @@ static int test_rust_c_integration() {
     ret = rust_journal_commit(ctx->journal, txn);
     if (ret < 0) {
         fprintf(stderr, "  ✗ Journal事务提交失败\n");
-        rust_extent_free(ctx->extent_alloc, start, len);
+        block_free_multiple(ctx->balloc, start, len);
         fs_context_destroy(ctx);
         return -1;
     }
     printf("  ✓ Journal事务已提交\n");
     
-    // 5. 同步（checkpoint + extent sync）
+    // 5. 同步（checkpoint + 位图同步）
     ret = fs_context_sync(ctx);
     if (ret < 0) {
         fprintf(stderr, "  ✗ fs_context_sync失败\n");
-        rust_extent_free(ctx->extent_alloc, start, len);
+        block_free_multiple(ctx->balloc, start, len);
         fs_context_destroy(ctx);
         return -1;
     }
-    printf("  ✓ 系统同步成功（checkpoint + extent sync）\n");
+    printf("  ✓ 系统同步成功（checkpoint + 位图同步）\n");
     
     // 6. 释放extent
-    ret = rust_extent_free(ctx->extent_alloc, start, len);
+    ret = block_free_multiple(ctx->balloc, start, len);
     if (ret < 0) {
         fprintf(stderr, "  ✗ Extent释放失败\n");
         fs_context_destroy(ctx);
@@ -629,7 +629,6 @@ static int test_crash_consistency() {
         pthread_join(ctx->checkpoint_thread, NULL);
         
         // 手动清理（不调用完整的destroy）
-        if (ctx->extent_alloc) rust_extent_alloc_destroy(ctx->extent_alloc);
         if (ctx->journal) rust_journal_destroy(ctx->journal);
         if (ctx->icache) inode_cache_destroy(ctx->icache);
         if (ctx->balloc) block_alloc_destroy(ctx->balloc);
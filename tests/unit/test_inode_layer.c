@@ -1,7 +1,9 @@
 #include "modernfs/types.h"
 #include "modernfs/block_dev.h"
+#include "modernfs/buffer_cache.h"
 #include "modernfs/block_alloc.h"
 #include "modernfs/inode.h"
+#include "modernfs/extent.h"
 #include "modernfs/directory.h"
 #include "modernfs/path.h"
 #include <stdio.h>
@@ -9,6 +11,7 @@
 #include <string.h>
 #include <assert.h>
 #include <time.h>
+#include <pthread.h>
 
 #define TEST_DISK_IMAGE "test_inode_disk.img"
 #define TEST_DISK_SIZE (64 * 1024 * 1024)  // 64MB
@@ -406,6 +409,944 @@ static void test_data_block_mapping() {
     printf("\n✅ 测试5通过\n\n");
 }
 
+static void test_range_read_write() {
+    printf("========================================\n");
+    printf("测试6: 连续区间读写\n");
+    printf("========================================\n\n");
+
+    printf("1. 分配文件Inode\n");
+    inode_t_mem *inode = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(inode != NULL);
+
+    printf("2. 非对齐的大块写入\n");
+    size_t len = BLOCK_SIZE * 200 + 123;
+    uint64_t offset = 1000;
+    uint8_t *data = malloc(len);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)(i * 7 + 3);
+    }
+    ssize_t written = inode_write(g_icache, inode, data, offset, len, NULL);
+    assert(written == (ssize_t)len);
+    printf("  写入 %zd 字节\n", written);
+
+    printf("3. 连续区间映射\n");
+    block_t block;
+    uint32_t run;
+    int ret = inode_bmap_run(g_icache, inode, 0, 16, false, &block, &run);
+    assert(ret == MODERNFS_SUCCESS);
+    assert(block != 0 && run >= 1 && run <= 16);
+    printf("  首段: block=%u, run=%u\n", block, run);
+
+    printf("4. 缓存中的脏块对区间读取可见\n");
+    const char *patch = "patched-in-cache";
+    size_t patch_off = offset + BLOCK_SIZE * 5 + 17;
+    written = inode_write(g_icache, inode, patch, patch_off, strlen(patch), NULL);
+    assert(written == (ssize_t)strlen(patch));
+    memcpy(data + (patch_off - offset), patch, strlen(patch));
+
+    printf("5. 多个非对齐窗口读取并验证\n");
+    uint8_t *read_buf = malloc(len);
+    size_t windows[][2] = {
+        { 0, len },
+        { 1, BLOCK_SIZE * 3 },
+        { BLOCK_SIZE - 1000, BLOCK_SIZE * 17 + 5 },
+        { BLOCK_SIZE * 10, BLOCK_SIZE * 64 },
+        { len - 200, 200 },
+    };
+    for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        ssize_t n = inode_read(g_icache, inode, read_buf, offset + windows[w][0], windows[w][1]);
+        assert(n == (ssize_t)windows[w][1]);
+        assert(memcmp(read_buf, data + windows[w][0], windows[w][1]) == 0);
+    }
+    printf("  数据验证成功\n");
+
+    printf("6. 区间覆盖写更新已缓存的块\n");
+    memset(data, 'Z', BLOCK_SIZE * 8);
+    written = inode_write(g_icache, inode, data, offset, BLOCK_SIZE * 8, NULL);
+    assert(written == BLOCK_SIZE * 8);
+    char small[32];
+    ssize_t n = inode_read(g_icache, inode, small, patch_off, sizeof(small));
+    assert(n == (ssize_t)sizeof(small));
+    assert(memcmp(small, data + (patch_off - offset), sizeof(small)) == 0);
+    printf("  缓存与磁盘一致\n");
+
+    free(data);
+    free(read_buf);
+
+    printf("7. 清理\n");
+    inode_free(g_icache, inode);
+
+    printf("\n✅ 测试6通过\n\n");
+}
+
+static void test_extent_mapping() {
+    printf("========================================\n");
+    printf("测试7: Extent树映射\n");
+    printf("========================================\n\n");
+
+    uint32_t free_before, free_now;
+    block_alloc_stats(g_balloc, NULL, &free_before, NULL, NULL);
+
+    printf("1. 普通文件使用extent树\n");
+    inode_t_mem *inode = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(inode != NULL);
+    assert(inode->disk.flags & INODE_FLAG_EXTENTS);
+
+    printf("2. 顺序写入的大文件只需少量extent\n");
+    size_t len = BLOCK_SIZE * 2000;
+    uint8_t *data = malloc(len);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)(i * 13 + 1);
+    }
+    ssize_t written = inode_write(g_icache, inode, data, 0, len, NULL);
+    assert(written == (ssize_t)len);
+
+    uint32_t extents, depth;
+    assert(extent_stats(g_icache, inode, &extents, &depth) == MODERNFS_SUCCESS);
+    printf("  2000块 -> %u个extent, 深度%u\n", extents, depth);
+    assert(extents <= 8);
+
+    block_t block;
+    uint32_t run;
+    assert(inode_bmap_run(g_icache, inode, 0, 1024, false, &block, &run) == MODERNFS_SUCCESS);
+    assert(block != 0 && run > 1);
+    printf("  首段: block=%u, run=%u\n", block, run);
+
+    uint8_t *read_buf = malloc(len);
+    assert(inode_read(g_icache, inode, read_buf, 0, len) == (ssize_t)len);
+    assert(memcmp(read_buf, data, len) == 0);
+    printf("  数据验证成功\n");
+
+    printf("3. 逆序稀疏写入触发节点分裂\n");
+    inode_t_mem *sparse = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(sparse != NULL);
+    const uint32_t nblocks = 800;
+    uint8_t buf[BLOCK_SIZE];
+    for (int i = nblocks - 1; i >= 0; i--) {
+        memset(buf, (uint8_t)(i + 1), BLOCK_SIZE);
+        written = inode_write(g_icache, sparse, buf, (uint64_t)i * 2 * BLOCK_SIZE, BLOCK_SIZE, NULL);
+        assert(written == BLOCK_SIZE);
+    }
+    assert(extent_stats(g_icache, sparse, &extents, &depth) == MODERNFS_SUCCESS);
+    printf("  %u个extent, 深度%u\n", extents, depth);
+    assert(extents == nblocks);
+    assert(depth >= 1);
+
+    for (uint32_t i = 0; i < nblocks; i++) {
+        assert(inode_read(g_icache, sparse, buf, (uint64_t)i * 2 * BLOCK_SIZE, BLOCK_SIZE) == BLOCK_SIZE);
+        assert(buf[0] == (uint8_t)(i + 1) && buf[BLOCK_SIZE - 1] == (uint8_t)(i + 1));
+    }
+    // 空洞读出为零
+    assert(inode_bmap_run(g_icache, sparse, BLOCK_SIZE, 16, false, &block, &run) == MODERNFS_SUCCESS);
+    assert(block == 0 && run == 1);
+    assert(inode_read(g_icache, sparse, buf, BLOCK_SIZE, BLOCK_SIZE) == BLOCK_SIZE);
+    assert(buf[0] == 0 && buf[BLOCK_SIZE - 1] == 0);
+    printf("  数据和空洞验证成功\n");
+
+    printf("4. 截断释放数据块和节点块\n");
+    block_alloc_stats(g_balloc, NULL, &free_now, NULL, NULL);
+    uint64_t blocks_before = sparse->disk.blocks;
+    assert(inode_truncate(g_icache, sparse, (uint64_t)300 * BLOCK_SIZE) == MODERNFS_SUCCESS);
+    assert(extent_stats(g_icache, sparse, &extents, NULL) == MODERNFS_SUCCESS);
+    assert(extents == 150);
+    uint32_t free_after;
+    block_alloc_stats(g_balloc, NULL, &free_after, NULL, NULL);
+    assert(free_after - free_now == blocks_before - sparse->disk.blocks);
+    assert(inode_read(g_icache, sparse, buf, 298 * BLOCK_SIZE, BLOCK_SIZE) == BLOCK_SIZE);
+    assert(buf[0] == (uint8_t)150);
+
+    assert(inode_truncate(g_icache, sparse, 0) == MODERNFS_SUCCESS);
+    assert(extent_stats(g_icache, sparse, &extents, &depth) == MODERNFS_SUCCESS);
+    assert(extents == 0 && depth == 0);
+    assert(sparse->disk.blocks == 0);
+    printf("  截断后extent=%u, 深度=%u\n", extents, depth);
+
+    free(data);
+    free(read_buf);
+
+    printf("5. 清理\n");
+    inode_free(g_icache, sparse);
+    inode_free(g_icache, inode);
+    block_alloc_stats(g_balloc, NULL, &free_now, NULL, NULL);
+    assert(free_now == free_before);
+
+    printf("\n✅ 测试7通过\n\n");
+}
+
+// 自上次调用以来块缓存的查找次数(命中+未命中)
+static uint64_t cache_lookups_since(uint64_t *last) {
+    uint64_t hits, misses;
+    buffer_cache_stats(g_dev->cache, &hits, &misses, NULL, NULL);
+    uint64_t delta = hits + misses - *last;
+    *last = hits + misses;
+    return delta;
+}
+
+static void test_map_cache() {
+    printf("========================================\n");
+    printf("测试8: 块映射缓存\n");
+    printf("========================================\n\n");
+
+    printf("1. 间接块映射的文件(目录类型Inode)\n");
+    inode_t_mem *inode = inode_alloc(g_icache, INODE_TYPE_DIR);
+    assert(inode != NULL);
+    assert(!(inode->disk.flags & INODE_FLAG_EXTENTS));
+
+    size_t len = BLOCK_SIZE * 600;
+    uint8_t *data = malloc(len);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)(i * 31 + 5);
+    }
+    assert(inode_write(g_icache, inode, data, 0, len, NULL) == (ssize_t)len);
+    assert(inode->disk.indirect != 0);
+
+    printf("2. 一段区间只读取一次间接块\n");
+    uint64_t last = 0;
+    cache_lookups_since(&last);
+    block_t block;
+    uint32_t run;
+    uint64_t offset = (uint64_t)(INODE_DIRECT_BLOCKS + 10) * BLOCK_SIZE;
+    assert(inode_bmap_run(g_icache, inode, offset, 1024, false, &block, &run) == MODERNFS_SUCCESS);
+    assert(block != 0 && run > 1);
+    assert(cache_lookups_since(&last) == 1);
+    printf("  block=%u, run=%u\n", block, run);
+
+    printf("3. 区间内的后续查找命中映射缓存\n");
+    block_t block2;
+    uint32_t run2;
+    assert(inode_bmap_run(g_icache, inode, offset + BLOCK_SIZE * 5, 1024, false,
+                          &block2, &run2) == MODERNFS_SUCCESS);
+    assert(block2 == block + 5 && run2 == run - 5);
+    assert(cache_lookups_since(&last) == 0);
+
+    printf("4. 截断后缓存失效\n");
+    assert(inode_truncate(g_icache, inode, offset + BLOCK_SIZE) == MODERNFS_SUCCESS);
+    for (int i = 0; i < INODE_MAP_CACHE_RUNS; i++) {
+        assert(inode->map_runs[i].len == 0);
+    }
+
+    uint8_t *read_buf = malloc(BLOCK_SIZE * 11);
+    assert(inode_read(g_icache, inode, read_buf, BLOCK_SIZE * 2, BLOCK_SIZE * 11) == BLOCK_SIZE * 11);
+    assert(memcmp(read_buf, data + BLOCK_SIZE * 2, BLOCK_SIZE * 11) == 0);
+    printf("  数据验证成功\n");
+
+    free(data);
+    free(read_buf);
+
+    printf("5. 清理\n");
+    inode_free(g_icache, inode);
+
+    printf("\n✅ 测试8通过\n\n");
+}
+
+static void test_contiguous_alloc() {
+    printf("========================================\n");
+    printf("测试9: 连续块分配\n");
+    printf("========================================\n\n");
+
+    printf("1. 制造碎片: 交替释放64块大小的文件\n");
+    inode_t_mem *frag[8];
+    uint8_t *data = malloc(BLOCK_SIZE * 512);
+    memset(data, 'F', BLOCK_SIZE * 64);
+    for (int i = 0; i < 8; i++) {
+        frag[i] = inode_alloc(g_icache, INODE_TYPE_FILE);
+        assert(frag[i] != NULL);
+        assert(inode_write(g_icache, frag[i], data, 0, BLOCK_SIZE * 64, NULL) == BLOCK_SIZE * 64);
+    }
+    for (int i = 0; i < 8; i += 2) {
+        inode_free(g_icache, frag[i]);
+    }
+
+    printf("2. 一次写入512块按写入大小整段分配\n");
+    inode_t_mem *inode = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(inode != NULL);
+    for (size_t i = 0; i < BLOCK_SIZE * 512; i++) {
+        data[i] = (uint8_t)(i * 17 + 9);
+    }
+    assert(inode_write(g_icache, inode, data, 0, BLOCK_SIZE * 512, NULL) == BLOCK_SIZE * 512);
+
+    uint32_t extents;
+    assert(extent_stats(g_icache, inode, &extents, NULL) == MODERNFS_SUCCESS);
+    printf("  512块 -> %u个extent\n", extents);
+    assert(extents == 1);
+
+    printf("3. 小块追加写紧接文件末尾分配\n");
+    for (int i = 0; i < 64; i++) {
+        assert(inode_write(g_icache, inode, data, (uint64_t)(512 + i) * BLOCK_SIZE,
+                           BLOCK_SIZE, NULL) == BLOCK_SIZE);
+    }
+    assert(extent_stats(g_icache, inode, &extents, NULL) == MODERNFS_SUCCESS);
+    printf("  追加64块后 %u个extent\n", extents);
+    assert(extents == 1);
+
+    uint8_t *read_buf = malloc(BLOCK_SIZE * 512);
+    assert(inode_read(g_icache, inode, read_buf, 0, BLOCK_SIZE * 512) == BLOCK_SIZE * 512);
+    assert(memcmp(read_buf, data, BLOCK_SIZE * 512) == 0);
+    printf("  数据验证成功\n");
+
+    free(data);
+    free(read_buf);
+
+    printf("4. 清理\n");
+    inode_free(g_icache, inode);
+    for (int i = 1; i < 8; i += 2) {
+        inode_free(g_icache, frag[i]);
+    }
+
+    printf("\n✅ 测试9通过\n\n");
+}
+
+static void test_delayed_allocation() {
+    printf("========================================\n");
+    printf("测试10: 延迟分配\n");
+    printf("========================================\n\n");
+
+    g_icache->delalloc = true;
+
+    uint32_t free_before, free_now;
+    block_alloc_stats(g_balloc, NULL, &free_before, NULL, NULL);
+
+    printf("1. 两个文件交替追加写,写入时不分配块\n");
+    inode_t_mem *a = inode_alloc(g_icache, INODE_TYPE_FILE);
+    inode_t_mem *b = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(a != NULL && b != NULL);
+
+    uint8_t buf[BLOCK_SIZE];
+    for (int i = 0; i < 64; i++) {
+        memset(buf, 'a' + i % 26, BLOCK_SIZE);
+        assert(inode_write(g_icache, a, buf, (uint64_t)i * BLOCK_SIZE, BLOCK_SIZE, NULL) == BLOCK_SIZE);
+        memset(buf, 'A' + i % 26, BLOCK_SIZE);
+        assert(inode_write(g_icache, b, buf, (uint64_t)i * BLOCK_SIZE, BLOCK_SIZE, NULL) == BLOCK_SIZE);
+    }
+    assert(a->disk.blocks == 0 && b->disk.blocks == 0);
+    assert(a->delalloc_count == 64 && b->delalloc_count == 64);
+    block_alloc_stats(g_balloc, NULL, &free_now, NULL, NULL);
+    assert(free_now == free_before);
+
+    // 未分配的数据可以读出
+    assert(inode_read(g_icache, a, buf, 10 * BLOCK_SIZE + 7, 100) == 100);
+    assert(buf[0] == 'a' + 10 && buf[99] == 'a' + 10);
+    printf("  暂存页: a=%u, b=%u\n", a->delalloc_count, b->delalloc_count);
+
+    printf("2. 落盘时每个文件整段分配\n");
+    assert(inode_flush_all_delalloc(g_icache) == MODERNFS_SUCCESS);
+    assert(a->delalloc_count == 0 && b->delalloc_count == 0);
+    assert(g_icache->delalloc_reserved == 0);
+
+    uint32_t extents_a, extents_b;
+    assert(extent_stats(g_icache, a, &extents_a, NULL) == MODERNFS_SUCCESS);
+    assert(extent_stats(g_icache, b, &extents_b, NULL) == MODERNFS_SUCCESS);
+    printf("  extent: a=%u, b=%u\n", extents_a, extents_b);
+    assert(extents_a == 1 && extents_b == 1);
+    assert(a->disk.blocks == 64 && b->disk.blocks == 64);
+
+    for (int i = 0; i < 64; i++) {
+        assert(inode_read(g_icache, b, buf, (uint64_t)i * BLOCK_SIZE, BLOCK_SIZE) == BLOCK_SIZE);
+        assert(buf[0] == 'A' + i % 26 && buf[BLOCK_SIZE - 1] == 'A' + i % 26);
+    }
+    printf("  数据验证成功\n");
+
+    printf("3. 落盘前删除的临时文件不分配块\n");
+    block_alloc_stats(g_balloc, NULL, &free_before, NULL, NULL);
+    inode_t_mem *tmp = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(tmp != NULL);
+    for (int i = 0; i < 32; i++) {
+        assert(inode_write(g_icache, tmp, buf, (uint64_t)i * BLOCK_SIZE, BLOCK_SIZE, NULL) == BLOCK_SIZE);
+    }
+    inode_free(g_icache, tmp);
+    block_alloc_stats(g_balloc, NULL, &free_now, NULL, NULL);
+    assert(free_now == free_before);
+    assert(g_icache->delalloc_reserved == 0);
+
+    printf("4. 截断丢弃暂存页并清零页尾\n");
+    memset(buf, 'T', BLOCK_SIZE);
+    assert(inode_write(g_icache, a, buf, 64 * BLOCK_SIZE, BLOCK_SIZE, NULL) == BLOCK_SIZE);
+    assert(inode_write(g_icache, a, buf, 65 * BLOCK_SIZE, BLOCK_SIZE, NULL) == BLOCK_SIZE);
+    assert(a->delalloc_count == 2);
+    assert(inode_truncate(g_icache, a, 64 * BLOCK_SIZE + 100) == MODERNFS_SUCCESS);
+    assert(a->delalloc_count == 1);
+    assert(inode_truncate(g_icache, a, 66 * BLOCK_SIZE) == MODERNFS_SUCCESS);
+    assert(inode_read(g_icache, a, buf, 64 * BLOCK_SIZE + 99, 2) == 2);
+    assert(buf[0] == 'T' && buf[1] == 0);
+
+    printf("5. 已分配的块照常原地覆盖写\n");
+    memset(buf, 'O', BLOCK_SIZE);
+    assert(inode_write(g_icache, a, buf, 3 * BLOCK_SIZE, BLOCK_SIZE, NULL) == BLOCK_SIZE);
+    assert(a->delalloc_count == 1);
+    assert(inode_read(g_icache, a, buf, 3 * BLOCK_SIZE, BLOCK_SIZE) == BLOCK_SIZE);
+    assert(buf[0] == 'O');
+
+    printf("6. 清理\n");
+    inode_free(g_icache, a);
+    inode_free(g_icache, b);
+    assert(g_icache->delalloc_reserved == 0);
+    g_icache->delalloc = false;
+
+    printf("\n✅ 测试10通过\n\n");
+}
+
+static void test_inode_placement() {
+    printf("========================================\n");
+    printf("测试11: Inode就近分配\n");
+    printf("========================================\n\n");
+
+    printf("1. Next-Fit游标: 释放的Inode不会被立即重用\n");
+    inode_t_mem *a = inode_alloc(g_icache, INODE_TYPE_FILE);
+    inode_t_mem *b = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(a && b);
+    assert(a->inum != 0 && b->inum == a->inum + 1);
+    inode_t freed = a->inum;
+    assert(inode_free(g_icache, a) == MODERNFS_SUCCESS);
+
+    inode_t_mem *c = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(c && c->inum == b->inum + 1);
+    printf("  %u释放后下一次分配得到%u\n", freed, c->inum);
+
+    printf("2. 文件优先放在父目录所在的Inode表块\n");
+    inode_t_mem *d = inode_alloc_near(g_icache, INODE_TYPE_FILE, b->inum);
+    assert(d);
+    // freed和b在同一表块,所以该块一定有空位
+    if (freed / (BLOCK_SIZE / INODE_SIZE) == b->inum / (BLOCK_SIZE / INODE_SIZE)) {
+        assert(d->inum / (BLOCK_SIZE / INODE_SIZE) == b->inum / (BLOCK_SIZE / INODE_SIZE));
+        assert(d->inum < c->inum);
+    }
+    printf("  父Inode %u, 新Inode %u\n", b->inum, d->inum);
+
+    assert(inode_free(g_icache, b) == MODERNFS_SUCCESS);
+    assert(inode_free(g_icache, c) == MODERNFS_SUCCESS);
+    assert(inode_free(g_icache, d) == MODERNFS_SUCCESS);
+
+    printf("\n✅ 测试11通过\n\n");
+}
+
+#define SYNC_WRITER_ITERS 20000
+
+// 持有Inode锁不断修改uid并置脏,与不加Inode锁的inode_sync_all并发
+static void *sync_writer(void *arg) {
+    inode_t_mem *inode = arg;
+    for (int i = 1; i <= SYNC_WRITER_ITERS; i++) {
+        inode_lock(inode);
+        inode->disk.uid = (uint16_t)i;
+        inode_mark_dirty(g_icache, inode);
+        inode_unlock(inode);
+    }
+    return NULL;
+}
+
+// Inode表中(块缓存里)的uid
+static uint16_t table_uid(inode_t inum) {
+    block_t blk = g_icache->sb.inode_table_start + inum * INODE_SIZE / BLOCK_SIZE;
+    buffer_head_t *bh = blkdev_get_block(g_dev, blk);
+    assert(bh != NULL);
+    uint16_t uid = ((disk_inode_t *)(bh->data + inum * INODE_SIZE % BLOCK_SIZE))->uid;
+    blkdev_release_block(g_dev, bh, false);
+    return uid;
+}
+
+static void test_batched_sync() {
+    printf("========================================\n");
+    printf("测试12: 脏Inode按表块批量写回\n");
+    printf("========================================\n\n");
+
+    printf("1. 修改一批Inode并标记为脏\n");
+    inode_t_mem *nodes[8];
+    for (int i = 0; i < 8; i++) {
+        nodes[i] = inode_alloc(g_icache, INODE_TYPE_FILE);
+        assert(nodes[i] != NULL);
+        nodes[i]->disk.mode = 0600 + i;
+        inode_mark_dirty(g_icache, nodes[i]);
+    }
+    // 重复标记不会重复入链
+    inode_mark_dirty(g_icache, nodes[0]);
+    assert(g_icache->dirty_count >= 8);
+    printf("  脏链表长度: %u\n", g_icache->dirty_count);
+
+    printf("2. inode_sync_all清空脏链表\n");
+    assert(inode_sync_all(g_icache) == MODERNFS_SUCCESS);
+    assert(g_icache->dirty_count == 0);
+    assert(g_icache->dirty_head == NULL);
+
+    printf("3. 验证Inode表中的内容\n");
+    for (int i = 0; i < 8; i++) {
+        assert(!nodes[i]->dirty);
+        assert(!nodes[i]->on_dirty_list);
+
+        block_t blk = g_icache->sb.inode_table_start +
+                      nodes[i]->inum * INODE_SIZE / BLOCK_SIZE;
+        buffer_head_t *bh = blkdev_get_block(g_dev, blk);
+        assert(bh != NULL);
+        disk_inode_t *di = (disk_inode_t *)(bh->data + nodes[i]->inum * INODE_SIZE % BLOCK_SIZE);
+        assert(di->mode == 0600 + i);
+        blkdev_release_block(g_dev, bh, false);
+    }
+    printf("  写回内容正确\n");
+
+    printf("4. 批量写回与修改并发,最后一次修改不丢失\n");
+    pthread_t tid;
+    assert(pthread_create(&tid, NULL, sync_writer, nodes[0]) == 0);
+    for (int i = 0; i < 2000; i++) {
+        assert(inode_sync_all(g_icache) == MODERNFS_SUCCESS);
+    }
+    pthread_join(tid, NULL);
+    assert(inode_sync_all(g_icache) == MODERNFS_SUCCESS);
+    assert(table_uid(nodes[0]->inum) == SYNC_WRITER_ITERS);
+
+    for (int i = 0; i < 8; i++) {
+        assert(inode_free(g_icache, nodes[i]) == MODERNFS_SUCCESS);
+    }
+
+    printf("\n✅ 测试12通过\n\n");
+}
+
+#define CONC_THREADS 4
+#define CONC_FIRST   500    // 远离前面测试分配的Inode
+#define CONC_RANGE   200    // 大于缓存容量(64),保证不断换出
+#define CONC_ITERS   4000
+
+static uint8_t g_conc_written[CONC_RANGE];
+
+static void *conc_worker(void *arg) {
+    unsigned int seed = (unsigned int)(uintptr_t)arg;
+
+    for (int i = 0; i < CONC_ITERS; i++) {
+        inode_t inum = CONC_FIRST + rand_r(&seed) % CONC_RANGE;
+        inode_t_mem *inode = inode_get(g_icache, inum);
+        if (!inode) {
+            continue;   // 所有缓存条目都被引用
+        }
+        assert(inode->inum == inum);
+
+        // 四分之一的访问弄脏Inode,换出时必须先写回
+        if (rand_r(&seed) % 4 == 0) {
+            inode_lock(inode);
+            inode->disk.uid = (uint16_t)inum;
+            inode_mark_dirty(g_icache, inode);
+            inode_unlock(inode);
+            __atomic_store_n(&g_conc_written[inum - CONC_FIRST], 1, __ATOMIC_RELAXED);
+        }
+
+        inode_put(g_icache, inode);
+    }
+    return NULL;
+}
+
+static void test_concurrent_get() {
+    printf("========================================\n");
+    printf("测试13: 并发inode_get与脏Inode换出\n");
+    printf("========================================\n\n");
+
+    printf("1. %d个线程随机访问%d个Inode\n", CONC_THREADS, CONC_RANGE);
+    pthread_t threads[CONC_THREADS];
+    for (uintptr_t t = 0; t < CONC_THREADS; t++) {
+        assert(pthread_create(&threads[t], NULL, conc_worker, (void *)(t + 1)) == 0);
+    }
+    for (int t = 0; t < CONC_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    printf("2. 引用计数全部归零\n");
+    for (inode_t_mem *inode = g_icache->lru_head; inode; inode = inode->next) {
+        assert(inode->ref_count == 0);
+    }
+
+    printf("3. 换出过的Inode修改没有丢失\n");
+    assert(inode_sync_all(g_icache) == MODERNFS_SUCCESS);
+    uint32_t checked = 0;
+    for (uint32_t i = 0; i < CONC_RANGE; i++) {
+        inode_t_mem *inode = inode_get(g_icache, CONC_FIRST + i);
+        assert(inode != NULL);
+        if (g_conc_written[i]) {
+            assert(inode->disk.uid == (uint16_t)(CONC_FIRST + i));
+            checked++;
+        }
+        inode_put(g_icache, inode);
+    }
+    printf("  验证了%u个Inode\n", checked);
+
+    printf("\n✅ 测试13通过\n\n");
+}
+
+static void test_elastic_cache() {
+    printf("========================================\n");
+    printf("测试14: 按内存预算伸缩的Inode缓存\n");
+    printf("========================================\n\n");
+
+    inode_cache_set_budget(g_icache, sizeof(inode_slab_t));
+    assert(g_icache->max_inodes == INODE_SLAB_ENTRIES);
+    uint32_t hash_before = g_icache->hash_size;
+
+    printf("1. 同时引用的Inode超过上限时缓存临时扩大\n");
+    enum { HELD = 3 * INODE_SLAB_ENTRIES };
+    inode_t_mem *held[HELD];
+    for (int i = 0; i < HELD; i++) {
+        held[i] = inode_get(g_icache, 700 + i);
+        assert(held[i] != NULL);
+    }
+    assert(g_icache->nr_inodes >= HELD);
+    assert(g_icache->hash_size > hash_before);
+    printf("  条目数: %u, slab数: %u, 哈希桶: %u\n",
+           g_icache->nr_inodes, g_icache->slab_count, g_icache->hash_size);
+
+    printf("2. 引用释放后收缩回预算\n");
+    for (int i = 0; i < HELD; i++) {
+        inode_put(g_icache, held[i]);
+    }
+    inode_cache_set_budget(g_icache, sizeof(inode_slab_t));
+    assert(g_icache->nr_inodes <= g_icache->max_inodes);
+    assert(g_icache->slab_count <= 2);
+    printf("  条目数: %u, slab数: %u, 哈希桶: %u\n",
+           g_icache->nr_inodes, g_icache->slab_count, g_icache->hash_size);
+
+    printf("3. 收缩后仍能正常访问\n");
+    for (int i = 0; i < HELD; i++) {
+        inode_t_mem *inode = inode_get(g_icache, 700 + i);
+        assert(inode != NULL && inode->inum == (inode_t)(700 + i));
+        inode_put(g_icache, inode);
+        assert(g_icache->nr_inodes <= g_icache->max_inodes);
+    }
+
+    printf("\n✅ 测试14通过\n\n");
+}
+
+static int count_entry_cb(const char *name, inode_t inum, void *arg) {
+    (void)name;
+    (void)inum;
+    (*(int *)arg)++;
+    return 0;
+}
+
+static void test_inline_data() {
+    printf("========================================\n");
+    printf("测试15: 内联数据\n");
+    printf("========================================\n\n");
+
+    g_icache->inline_data = true;
+    char buf[256];
+
+    printf("1. 小文件写入Inode,不占数据块\n");
+    inode_t_mem *f = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(f != NULL);
+    inode_lock(f);
+    assert(inode_write(g_icache, f, "hello", 0, 5, NULL) == 5);
+    assert(inode_is_inline(f) && f->disk.blocks == 0);
+    assert(inode_write(g_icache, f, "world!", INODE_INLINE_SIZE - 6, 6, NULL) == 6);
+    assert(inode_is_inline(f) && f->disk.size == INODE_INLINE_SIZE);
+    assert(inode_read(g_icache, f, buf, 0, sizeof(buf)) == INODE_INLINE_SIZE);
+    assert(memcmp(buf, "hello", 5) == 0 && buf[5] == 0);
+    assert(memcmp(buf + INODE_INLINE_SIZE - 6, "world!", 6) == 0);
+
+    printf("2. 写不下时搬到数据块,原有内容保留\n");
+    assert(inode_write(g_icache, f, "spill", INODE_INLINE_SIZE, 5, NULL) == 5);
+    assert(!inode_is_inline(f) && f->disk.blocks >= 1);
+    assert(inode_read(g_icache, f, buf, 0, sizeof(buf)) == INODE_INLINE_SIZE + 5);
+    assert(memcmp(buf, "hello", 5) == 0);
+    assert(memcmp(buf + INODE_INLINE_SIZE - 6, "world!spill", 11) == 0);
+    inode_unlock(f);
+
+    printf("3. 内联文件截断\n");
+    inode_t_mem *g = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(g != NULL);
+    inode_lock(g);
+    assert(inode_write(g_icache, g, "abcdef", 0, 6, NULL) == 6);
+    assert(inode_truncate(g_icache, g, 2) == MODERNFS_SUCCESS);
+    assert(inode_is_inline(g) && g->disk.size == 2);
+    assert(inode_truncate(g_icache, g, 6) == MODERNFS_SUCCESS);
+    assert(inode_read(g_icache, g, buf, 0, sizeof(buf)) == 6);
+    assert(memcmp(buf, "ab\0\0\0\0", 6) == 0);
+    assert(inode_truncate(g_icache, g, 200) == MODERNFS_SUCCESS);
+    assert(!inode_is_inline(g) && g->disk.size == 200);
+    assert(inode_read(g_icache, g, buf, 0, sizeof(buf)) == 200);
+    assert(memcmp(buf, "ab", 2) == 0 && buf[2] == 0 && buf[199] == 0);
+    inode_unlock(g);
+
+    printf("4. 小目录内联,目录项增多后搬到数据块\n");
+    inode_t_mem *d = inode_alloc(g_icache, INODE_TYPE_DIR);
+    assert(d != NULL);
+    inode_lock(d);
+    assert(dir_add(g_icache, d, ".", d->inum) == MODERNFS_SUCCESS);
+    assert(dir_add(g_icache, d, "..", d->inum) == MODERNFS_SUCCESS);
+    assert(dir_add(g_icache, d, "f", f->inum) == MODERNFS_SUCCESS);
+    assert(inode_is_inline(d) && d->disk.blocks == 0);
+
+    char name[32];
+    for (int i = 0; i < 8; i++) {
+        snprintf(name, sizeof(name), "entry_%d", i);
+        assert(dir_add(g_icache, d, name, g->inum) == MODERNFS_SUCCESS);
+    }
+    assert(!inode_is_inline(d) && d->disk.size == BLOCK_SIZE);
+
+    inode_t found;
+    assert(dir_lookup(g_icache, d, "f", &found) == MODERNFS_SUCCESS && found == f->inum);
+    assert(dir_lookup(g_icache, d, "entry_7", &found) == MODERNFS_SUCCESS && found == g->inum);
+    int count = 0;
+    assert(dir_iterate(g_icache, d, count_entry_cb, &count) == MODERNFS_SUCCESS);
+    assert(count == 11);
+    assert(dir_remove(g_icache, d, "f") == MODERNFS_SUCCESS);
+    assert(dir_lookup(g_icache, d, "f", &found) == MODERNFS_ENOENT);
+    inode_unlock(d);
+    printf("  目录项: %d\n", count);
+
+    printf("5. 空间不足时搬运失败,内联内容和块数不变\n");
+    inode_t_mem *h = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(h != NULL);
+    inode_lock(h);
+    assert(inode_write(g_icache, h, "inline", 0, 6, NULL) == 6);
+    block_t grab_start[256];
+    uint32_t grab_len[256];
+    int grabs = 0;
+    uint32_t free_now;
+    block_alloc_stats(g_balloc, NULL, &free_now, NULL, NULL);
+    while (free_now > 0 && grabs < 256) {
+        assert(block_alloc_near(g_balloc, 0, free_now, &grab_start[grabs],
+                                &grab_len[grabs]) == 0);
+        grabs++;
+        block_alloc_stats(g_balloc, NULL, &free_now, NULL, NULL);
+    }
+    assert(free_now == 0);
+    assert(inode_write(g_icache, h, "x", INODE_INLINE_SIZE, 1, NULL) == MODERNFS_ENOSPC);
+    assert(inode_is_inline(h) && h->disk.blocks == 0 && h->disk.size == 6);
+    assert(inode_read(g_icache, h, buf, 0, sizeof(buf)) == 6);
+    assert(memcmp(buf, "inline", 6) == 0);
+    for (int i = 0; i < grabs; i++) {
+        assert(block_free_multiple(g_balloc, grab_start[i], grab_len[i]) == 0);
+    }
+    inode_unlock(h);
+
+    assert(inode_free(g_icache, d) == MODERNFS_SUCCESS);
+    assert(inode_free(g_icache, f) == MODERNFS_SUCCESS);
+    assert(inode_free(g_icache, g) == MODERNFS_SUCCESS);
+    assert(inode_free(g_icache, h) == MODERNFS_SUCCESS);
+    g_icache->inline_data = false;
+
+    printf("\n✅ 测试15通过\n\n");
+}
+
+// Inode表中(块缓存里)的atime
+static uint64_t table_atime(inode_t inum) {
+    block_t blk = g_icache->sb.inode_table_start + inum * INODE_SIZE / BLOCK_SIZE;
+    buffer_head_t *bh = blkdev_get_block(g_dev, blk);
+    assert(bh != NULL);
+    uint64_t atime = ((disk_inode_t *)(bh->data + inum * INODE_SIZE % BLOCK_SIZE))->atime;
+    blkdev_release_block(g_dev, bh, false);
+    return atime;
+}
+
+static void test_atime_modes() {
+    printf("========================================\n");
+    printf("测试16: atime策略与lazytime\n");
+    printf("========================================\n\n");
+
+    char buf[64];
+    uint64_t now = (uint64_t)time(NULL);
+
+    inode_t_mem *f = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(f != NULL);
+    inode_lock(f);
+    assert(inode_write(g_icache, f, "timestamps", 0, 10, NULL) == 10);
+
+    printf("1. noatime: 读不修改Inode\n");
+    g_icache->atime_mode = INODE_ATIME_NOATIME;
+    f->disk.atime = 1;
+    assert(inode_sync_all(g_icache) == MODERNFS_SUCCESS);
+    assert(inode_read(g_icache, f, buf, 0, sizeof(buf)) == 10);
+    assert(f->disk.atime == 1 && !f->dirty && !f->on_dirty_list);
+
+    printf("2. relatime: 修改后第一次读才更新atime\n");
+    g_icache->atime_mode = INODE_ATIME_RELATIME;
+    f->disk.mtime = f->disk.ctime = now - 10;
+    f->disk.atime = now - 5;
+    assert(inode_sync_all(g_icache) == MODERNFS_SUCCESS);
+    assert(inode_read(g_icache, f, buf, 0, sizeof(buf)) == 10);
+    assert(f->disk.atime == now - 5 && !f->dirty && !f->on_dirty_list);
+    f->disk.atime = now - 20;
+    assert(inode_read(g_icache, f, buf, 0, sizeof(buf)) == 10);
+    assert(f->disk.atime >= now && f->dirty);
+    f->disk.atime = now - INODE_RELATIME_INTERVAL - 1;
+    assert(inode_sync_all(g_icache) == MODERNFS_SUCCESS);
+    assert(inode_read(g_icache, f, buf, 0, sizeof(buf)) == 10);
+    assert(f->disk.atime >= now);
+
+    printf("3. lazytime: 时间戳改动留在内存,例行写回(inode_sync_all)跳过\n");
+    g_icache->atime_mode = INODE_ATIME_STRICT;
+    g_icache->lazytime = true;
+    f->disk.atime = 1;
+    assert(inode_sync_all(g_icache) == MODERNFS_SUCCESS);
+    assert(inode_read(g_icache, f, buf, 0, sizeof(buf)) == 10);
+    assert(f->disk.atime >= now && !f->dirty && f->time_dirty && f->on_dirty_list);
+    assert(inode_sync_all(g_icache) == MODERNFS_SUCCESS);
+    assert(f->time_dirty && f->on_dirty_list);
+    assert(table_atime(f->inum) == 1);
+
+    printf("4. sync/fsync(inode_sync_times)批量写回时间戳\n");
+    assert(inode_sync_times(g_icache) == MODERNFS_SUCCESS);
+    assert(!f->time_dirty && !f->on_dirty_list);
+    assert(g_icache->dirty_count == 0);
+    assert(table_atime(f->inum) == f->disk.atime);
+    inode_unlock(f);
+
+    g_icache->atime_mode = INODE_ATIME_RELATIME;
+    g_icache->lazytime = false;
+    assert(inode_free(g_icache, f) == MODERNFS_SUCCESS);
+
+    printf("\n✅ 测试16通过\n\n");
+}
+
+static uint32_t free_block_count(void) {
+    uint32_t total, free, used;
+    float usage;
+    block_alloc_stats(g_balloc, &total, &free, &used, &usage);
+    return free;
+}
+
+static void test_legacy_truncate() {
+    printf("========================================\n");
+    printf("测试17: 间接块映射的截断\n");
+    printf("========================================\n\n");
+
+    const uint32_t ppb = BLOCK_SIZE / sizeof(block_t);
+    uint32_t free_before = free_block_count();
+
+    printf("1. 写入到二级间接块范围(目录类型Inode)\n");
+    inode_t_mem *inode = inode_alloc(g_icache, INODE_TYPE_DIR);
+    assert(inode != NULL);
+    uint32_t nblocks = INODE_DIRECT_BLOCKS + ppb + ppb + 500;
+    uint8_t *data = malloc(BLOCK_SIZE);
+    for (uint32_t i = 0; i < nblocks; i++) {
+        memset(data, (int)(i & 0xff), BLOCK_SIZE);
+        assert(inode_write(g_icache, inode, data, (uint64_t)i * BLOCK_SIZE,
+                           BLOCK_SIZE, NULL) == BLOCK_SIZE);
+    }
+    // 数据块 + 一级间接块 + 二级间接块 + 两个一级间接块
+    assert(inode->disk.blocks == nblocks + 4);
+    assert(free_block_count() == free_before - (nblocks + 4));
+    printf("  %u块, 占用%lu块\n", nblocks, (unsigned long)inode->disk.blocks);
+
+    printf("2. 截断到二级间接块中间,只读取涉及的间接块\n");
+    uint32_t keep = INODE_DIRECT_BLOCKS + ppb + 100;
+    uint64_t last = 0;
+    cache_lookups_since(&last);
+    assert(inode_truncate(g_icache, inode, (uint64_t)keep * BLOCK_SIZE) == MODERNFS_SUCCESS);
+    uint64_t lookups = cache_lookups_since(&last);
+    assert(lookups <= 4);
+    assert(inode->disk.blocks == keep + 3);
+    assert(free_block_count() == free_before - (keep + 3));
+    printf("  块缓存查找%lu次, 剩余%lu块\n", (unsigned long)lookups,
+           (unsigned long)inode->disk.blocks);
+
+    assert(inode_read(g_icache, inode, data, (uint64_t)(keep - 1) * BLOCK_SIZE,
+                      BLOCK_SIZE) == BLOCK_SIZE);
+    assert(data[0] == (uint8_t)((keep - 1) & 0xff) && data[BLOCK_SIZE - 1] == data[0]);
+
+    printf("3. 截断后重新扩展,截掉的部分是空洞\n");
+    memset(data, 0xee, BLOCK_SIZE);
+    assert(inode_write(g_icache, inode, data, (uint64_t)(nblocks - 1) * BLOCK_SIZE,
+                       BLOCK_SIZE, NULL) == BLOCK_SIZE);
+    assert(inode_read(g_icache, inode, data, (uint64_t)keep * BLOCK_SIZE,
+                      BLOCK_SIZE) == BLOCK_SIZE);
+    assert(data[0] == 0 && data[BLOCK_SIZE - 1] == 0);
+
+    printf("4. 截断为0释放全部数据块和间接块\n");
+    cache_lookups_since(&last);
+    assert(inode_truncate(g_icache, inode, 0) == MODERNFS_SUCCESS);
+    lookups = cache_lookups_since(&last);
+    assert(lookups <= 4);
+    assert(inode->disk.blocks == 0);
+    assert(inode->disk.indirect == 0 && inode->disk.double_indirect == 0);
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; i++) {
+        assert(inode->disk.direct[i] == 0);
+    }
+    assert(free_block_count() == free_before);
+    printf("  块缓存查找%lu次\n", (unsigned long)lookups);
+
+    free(data);
+    inode_free(g_icache, inode);
+
+    printf("\n✅ 测试17通过\n\n");
+}
+
+#define GRAB_MAX 256
+
+static void test_delalloc_eviction() {
+    printf("========================================\n");
+    printf("测试18: 暂存页落盘失败的Inode不被换出\n");
+    printf("========================================\n\n");
+
+    g_icache->delalloc = true;
+    uint8_t buf[BLOCK_SIZE];
+
+    printf("1. 暂存页同时为数据块和extent节点预留空间\n");
+    inode_t_mem *f = inode_alloc(g_icache, INODE_TYPE_FILE);
+    assert(f != NULL);
+    inode_lock(f);
+    for (int i = 0; i < 8; i++) {
+        memset(buf, 'k' + i, BLOCK_SIZE);
+        assert(inode_write(g_icache, f, buf, (uint64_t)i * BLOCK_SIZE,
+                           BLOCK_SIZE, NULL) == BLOCK_SIZE);
+    }
+    inode_unlock(f);
+    assert(f->delalloc_count == 8);
+    assert(g_icache->delalloc_reserved >= 8 + EXTENT_MAX_DEPTH);
+    printf("  8个暂存页预留%u块\n", g_icache->delalloc_reserved);
+
+    printf("2. 其他分配不能动用预留的块\n");
+    block_t grab_start[GRAB_MAX];
+    uint32_t grab_len[GRAB_MAX];
+    int grabs = 0;
+    uint32_t free_now;
+    block_alloc_stats(g_balloc, NULL, &free_now, NULL, NULL);
+    while (free_now > g_icache->delalloc_reserved && grabs < GRAB_MAX) {
+        uint32_t want = free_now - g_icache->delalloc_reserved;
+        assert(block_alloc_near(g_balloc, 0, want, &grab_start[grabs],
+                                &grab_len[grabs]) == 0);
+        grabs++;
+        block_alloc_stats(g_balloc, NULL, &free_now, NULL, NULL);
+    }
+    assert(free_now == g_icache->delalloc_reserved);
+    inode_t_mem *d = inode_alloc(g_icache, INODE_TYPE_DIR);
+    assert(d != NULL);
+    assert(inode_alloc_block(g_icache, d) == 0);
+
+    printf("3. 落盘失败时换出别的条目,暂存页留在原Inode上\n");
+    // 直接从块分配器拿走预留的块,模拟落盘时空间不足
+    while (free_now > 0 && grabs < GRAB_MAX) {
+        assert(block_alloc_near(g_balloc, 0, free_now, &grab_start[grabs],
+                                &grab_len[grabs]) == 0);
+        grabs++;
+        block_alloc_stats(g_balloc, NULL, &free_now, NULL, NULL);
+    }
+    assert(free_now == 0);
+    inode_t inum = f->inum;
+    inode_put(g_icache, f);
+    for (inode_t i = CONC_FIRST; i < CONC_FIRST + CONC_RANGE; i++) {
+        inode_t_mem *other = inode_get(g_icache, i);
+        assert(other != NULL && other->delalloc_count == 0);
+        inode_put(g_icache, other);
+    }
+    f = inode_get(g_icache, inum);
+    assert(f != NULL && f->delalloc_count == 8);
+
+    printf("4. 空间恢复后照常落盘\n");
+    for (int i = 0; i < grabs; i++) {
+        assert(block_free_multiple(g_balloc, grab_start[i], grab_len[i]) == 0);
+    }
+    inode_lock(f);
+    assert(inode_flush_delalloc(g_icache, f) == MODERNFS_SUCCESS);
+    assert(f->delalloc_count == 0 && g_icache->delalloc_reserved == 0);
+    for (int i = 0; i < 8; i++) {
+        assert(inode_read(g_icache, f, buf, (uint64_t)i * BLOCK_SIZE,
+                          BLOCK_SIZE) == BLOCK_SIZE);
+        assert(buf[0] == 'k' + i && buf[BLOCK_SIZE - 1] == 'k' + i);
+    }
+    inode_unlock(f);
+    printf("  数据验证成功\n");
+
+    assert(inode_free(g_icache, d) == MODERNFS_SUCCESS);
+    assert(inode_free(g_icache, f) == MODERNFS_SUCCESS);
+    g_icache->delalloc = false;
+
+    printf("\n✅ 测试18通过\n\n");
+}
+
 // ============ 主函数 ============
 
 int main() {
@@ -422,6 +1363,19 @@ int main() {
     test_directory_ops();
     test_path_operations();
     test_data_block_mapping();
+    test_range_read_write();
+    test_extent_mapping();
+    test_map_cache();
+    test_contiguous_alloc();
+    test_delayed_allocation();
+    test_inode_placement();
+    test_batched_sync();
+    test_concurrent_get();
+    test_elastic_cache();
+    test_inline_data();
+    test_atime_modes();
+    test_legacy_truncate();
+    test_delalloc_eviction();
 
     teardown_test_env();
 
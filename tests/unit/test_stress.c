@@ -536,7 +536,7 @@ static int test_fragmentation() {
     printf("  阶段1: 分配%d个extent\n", num_extents);
     for (int i = 0; i < num_extents; i++) {
         uint32_t start, len;
-        int ret = rust_extent_alloc(ctx->extent_alloc, i * 100, 10, 20, &start, &len);
+        int ret = block_alloc_extent(ctx->balloc, i * 100, 10, 20, &start, &len);
         if (ret < 0) {
             printf("  ℹ️  分配停止在第%d个extent\n", i);
             break;
@@ -549,25 +549,25 @@ static int test_fragmentation() {
     printf("  阶段2: 释放奇数编号的extent，制造碎片\n");
     for (int i = 1; i < num_extents; i += 2) {
         if (extents[i][0] != 0) {
-            rust_extent_free(ctx->extent_alloc, extents[i][0], extents[i][1]);
+            block_free_multiple(ctx->balloc, extents[i][0], extents[i][1]);
         }
     }
     
     // 3. 检查碎片率
-    float frag = rust_extent_fragmentation(ctx->extent_alloc);
+    float frag = block_alloc_fragmentation(ctx->balloc);
     printf("  ✓ 碎片化率: %.2f%%\n", frag * 100.0);
     
     // 4. 获取统计
     uint32_t total, free, allocated;
-    rust_extent_get_stats(ctx->extent_alloc, &total, &free, &allocated);
+    block_alloc_stats(ctx->balloc, &total, &free, &allocated, NULL);
     printf("  ✓ 统计: total=%u, free=%u, allocated=%u\n", total, free, allocated);
     
     // 5. 尝试分配一个大extent
     uint32_t large_start, large_len;
-    int ret = rust_extent_alloc(ctx->extent_alloc, 0, 100, 200, &large_start, &large_len);
+    int ret = block_alloc_extent(ctx->balloc, 0, 100, 200, &large_start, &large_len);
     if (ret >= 0) {
         printf("  ✓ 在碎片化磁盘上成功分配大extent: [%u, +%u]\n", large_start, large_len);
-        rust_extent_free(ctx->extent_alloc, large_start, large_len);
+        block_free_multiple(ctx->balloc, large_start, large_len);
     } else {
         printf("  ℹ️  在碎片化磁盘上无法分配大extent（预期）\n");
     }
@@ -575,7 +575,7 @@ static int test_fragmentation() {
     // 清理
     for (int i = 0; i < num_extents; i += 2) {
         if (extents[i][0] != 0) {
-            rust_extent_free(ctx->extent_alloc, extents[i][0], extents[i][1]);
+            block_free_multiple(ctx->balloc, extents[i][0], extents[i][1]);
         }
     }
     
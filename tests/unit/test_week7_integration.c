@@ -6,12 +6,15 @@
  * 2. 崩溃恢复机制
  * 3. Checkpoint线程
  * 4. Journal+Extent协同工作
+ * 5. 事务写入按写入大小分配extent
+ * 6. lazytime下fsync写回时间戳
  */
 
 #define _GNU_SOURCE
 #include "modernfs/fs_context.h"
 #include "modernfs/rust_ffi.h"
 #include "modernfs/inode.h"
+#include "modernfs/extent.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -58,12 +61,12 @@ static int test_fs_context_init() {
     }
     printf("  ✓ Journal Manager已初始化\n");
 
-    if (!ctx->extent_alloc) {
-        fprintf(stderr, "  ✗ Extent Allocator not initialized\n");
+    if (!ctx->balloc) {
+        fprintf(stderr, "  ✗ Block allocator not initialized\n");
         fs_context_destroy(ctx);
         return -1;
     }
-    printf("  ✓ Extent Allocator已初始化\n");
+    printf("  ✓ 块分配器已初始化\n");
 
     // 验证Checkpoint线程已启动
     if (!ctx->checkpoint_running) {
@@ -137,7 +140,7 @@ static int test_extent_allocation() {
     uint32_t start, len;
 
     // 分配extent
-    if (rust_extent_alloc(ctx->extent_alloc, 0, 10, 20, &start, &len) < 0) {
+    if (block_alloc_extent(ctx->balloc, 0, 10, 20, &start, &len) < 0) {
         fprintf(stderr, "  ✗ Failed to allocate extent\n");
         fs_context_destroy(ctx);
         return -1;
@@ -146,15 +149,11 @@ static int test_extent_allocation() {
 
     // 获取统计信息
     uint32_t total, free, allocated;
-    if (rust_extent_get_stats(ctx->extent_alloc, &total, &free, &allocated) < 0) {
-        fprintf(stderr, "  ✗ Failed to get stats\n");
-        fs_context_destroy(ctx);
-        return -1;
-    }
+    block_alloc_stats(ctx->balloc, &total, &free, &allocated, NULL);
     printf("  ✓ 统计信息: total=%u, free=%u, allocated=%u\n", total, free, allocated);
 
     // 释放extent
-    if (rust_extent_free(ctx->extent_alloc, start, len) < 0) {
+    if (block_free_multiple(ctx->balloc, start, len) < 0) {
         fprintf(stderr, "  ✗ Failed to free extent\n");
         fs_context_destroy(ctx);
         return -1;
@@ -162,8 +161,8 @@ static int test_extent_allocation() {
     printf("  ✓ 释放extent成功\n");
 
     // 同步位图
-    if (rust_extent_sync(ctx->extent_alloc) < 0) {
-        fprintf(stderr, "  ✗ Failed to sync extent allocator\n");
+    if (block_alloc_sync(ctx->balloc) < 0) {
+        fprintf(stderr, "  ✗ Failed to sync block allocator\n");
         fs_context_destroy(ctx);
         return -1;
     }
@@ -268,9 +267,6 @@ static int test_crash_recovery() {
         pthread_join(ctx->checkpoint_thread, NULL);
 
         // 销毁但不调用fs_context_sync
-        if (ctx->extent_alloc) {
-            rust_extent_alloc_destroy(ctx->extent_alloc);
-        }
         if (ctx->journal) {
             rust_journal_destroy(ctx->journal);
         }
@@ -354,6 +350,130 @@ static int test_fs_context_sync() {
     return 0;
 }
 
+// 测试7: 带事务的写入(FUSE写路径)同样按写入大小整段分配
+static int test_journaled_write_extent() {
+    printf("\n[测试7] 带事务的写入按写入大小分配extent\n");
+
+    fs_context_t *ctx = fs_context_init(TEST_IMG, false);
+    if (!ctx) {
+        fprintf(stderr, "  ✗ Failed to init fs_context\n");
+        return -1;
+    }
+
+    inode_t_mem *inode = inode_alloc(ctx->icache, INODE_TYPE_FILE);
+    if (!inode) {
+        fprintf(stderr, "  ✗ Failed to allocate inode\n");
+        fs_context_destroy(ctx);
+        return -1;
+    }
+
+    // 在Inode所在组的开头制造单块空洞,逐块分配时会被填进去而得到很多extent
+    uint32_t group = inode_group(ctx->icache, inode->inum);
+    block_t holes[256];
+    for (int i = 0; i < 256; i++) {
+        holes[i] = block_alloc_in_group(ctx->balloc, group);
+    }
+    for (int i = 1; i < 256; i += 2) {
+        block_free(ctx->balloc, holes[i]);
+    }
+    block_alloc_set_groups(ctx->balloc, ctx->sb->group_data_blocks);  // 游标回到组首
+
+    size_t len = 64 * 4096;
+    uint8_t *data = malloc(len);
+    memset(data, 0x5A, len);
+
+    inode_lock(inode);
+    RustTransaction *txn = rust_journal_begin(ctx->journal);
+    if (!txn) {
+        fprintf(stderr, "  ✗ Failed to begin transaction\n");
+        inode_unlock(inode);
+        free(data);
+        fs_context_destroy(ctx);
+        return -1;
+    }
+
+    // 非块对齐的起点,首尾两块都是部分写
+    ssize_t written = inode_write(ctx->icache, inode, data, 100, len, txn);
+    int result = 0;
+    if (written != (ssize_t)len || rust_journal_commit(ctx->journal, txn) < 0) {
+        fprintf(stderr, "  ✗ Journaled write failed: %zd\n", written);
+        result = -1;
+    }
+
+    uint32_t extents = 0, depth = 0;
+    if (result == 0 &&
+        (extent_stats(ctx->icache, inode, &extents, &depth) != MODERNFS_SUCCESS ||
+         extents != 1 || inode->disk.blocks != 65)) {
+        fprintf(stderr, "  ✗ Expected 1 extent of 65 blocks, got %u extents, %lu blocks\n",
+                extents, (unsigned long)inode->disk.blocks);
+        result = -1;
+    }
+    inode_unlock(inode);
+    free(data);
+
+    if (result == 0) {
+        printf("  ✓ 65块 -> %u个extent\n", extents);
+    }
+
+    inode_free(ctx->icache, inode);
+    for (int i = 0; i < 256; i += 2) {
+        block_free(ctx->balloc, holes[i]);
+    }
+    fs_context_destroy(ctx);
+    return result;
+}
+
+// 测试8: lazytime下fs_context_sync(fsync)把暂留的时间戳写回
+static int test_lazytime_fsync() {
+    printf("\n[测试8] lazytime下fsync写回时间戳\n");
+
+    fs_mount_opts_t opts = {
+        .atime_mode = INODE_ATIME_STRICT,
+        .lazytime = true,
+    };
+    fs_context_t *ctx = fs_context_init_opts(TEST_IMG, &opts);
+    if (!ctx) {
+        fprintf(stderr, "  ✗ Failed to init fs_context\n");
+        return -1;
+    }
+
+    inode_t_mem *inode = inode_alloc(ctx->icache, INODE_TYPE_FILE);
+    if (!inode) {
+        fprintf(stderr, "  ✗ Failed to allocate inode\n");
+        fs_context_destroy(ctx);
+        return -1;
+    }
+
+    uint8_t buf[16];
+    int result = 0;
+    inode_lock(inode);
+    inode_write(ctx->icache, inode, "lazy", 0, 4, NULL);
+    inode->disk.atime = 1;
+    inode_sync(ctx->icache, inode);
+    inode_read(ctx->icache, inode, buf, 0, sizeof(buf));
+    if (inode->dirty || !inode->time_dirty) {
+        fprintf(stderr, "  ✗ Read should only dirty the timestamps\n");
+        result = -1;
+    }
+    inode_unlock(inode);
+
+    if (result == 0 && fs_context_sync(ctx) < 0) {
+        fprintf(stderr, "  ✗ fs_context_sync failed\n");
+        result = -1;
+    }
+    if (result == 0 && (inode->time_dirty || inode->on_dirty_list)) {
+        fprintf(stderr, "  ✗ fsync left the timestamp in memory\n");
+        result = -1;
+    }
+    if (result == 0) {
+        printf("  ✓ fsync后时间戳已写回\n");
+    }
+
+    inode_free(ctx->icache, inode);
+    fs_context_destroy(ctx);
+    return result;
+}
+
 int main() {
     printf("╔════════════════════════════════════════╗\n");
     printf("║  ModernFS Week 7 集成测试套件         ║\n");
@@ -398,6 +518,16 @@ int main() {
         failed++;
     }
 
+    if (test_journaled_write_extent() < 0) {
+        fprintf(stderr, "✗ 测试7失败\n");
+        failed++;
+    }
+
+    if (test_lazytime_fsync() < 0) {
+        fprintf(stderr, "✗ 测试8失败\n");
+        failed++;
+    }
+
     // 清理测试文件
     unlink(TEST_IMG);
 
@@ -20,6 +20,10 @@ const INODE_TYPE_SYMLINK: u8 = 3;
 
 const INVALID_BLOCK: u32 = 0xFFFFFFFF;
 
+const INODE_FLAG_INLINE: u8 = 0x02;
+const INODE_INLINE_OFFSET: usize = 52; // 块映射区在磁盘 inode 中的偏移
+const INODE_INLINE_SIZE: usize = 76;
+
 // 文件系统状态（与 C 代码 superblock.h 保持一致）
 const FS_STATE_CLEAN: u32 = 0;
 const FS_STATE_DIRTY: u32 = 1;
@@ -79,7 +83,11 @@ struct Superblock {
     write_time: u64,
     mount_count: u32,
 
-    padding: [u8; 3988],
+    group_count: u32,
+    group_data_blocks: u32,
+    group_inodes: u32,
+
+    padding: [u8; 3976],
 }
 
 #[repr(C, packed)]
@@ -238,6 +246,30 @@ fn check_superblock(ctx: &mut FsckContext) -> Result<()> {
         ctx.errors.push("Data region starts beyond filesystem".to_string());
     }
 
+    // 分配组必须恰好覆盖数据区和 Inode 表（group_count 为 0 的旧镜像只有一组）
+    let group_count = sb.group_count as u64;
+    let group_data_blocks = sb.group_data_blocks as u64;
+    let group_inodes = sb.group_inodes as u64;
+    let data_blocks = sb.data_blocks as u64;
+    let total_inodes = sb.total_inodes as u64;
+    if group_count != 0 {
+        let data_span = group_count * group_data_blocks;
+        if group_data_blocks == 0 || group_data_blocks % 64 != 0
+            || data_span < data_blocks || data_span - data_blocks >= group_data_blocks
+        {
+            ctx.errors.push(format!(
+                "Invalid group layout: {} groups of {} data blocks for {} data blocks",
+                group_count, group_data_blocks, data_blocks
+            ));
+        }
+        if group_inodes == 0 || group_count * group_inodes < total_inodes {
+            ctx.errors.push(format!(
+                "Invalid group layout: {} groups of {} inodes for {} inodes",
+                group_count, group_inodes, total_inodes
+            ));
+        }
+    }
+
     let state = sb.state;
     if state != FS_STATE_CLEAN {
         ctx.warnings.push(format!("Filesystem not cleanly unmounted (state={})", state));
@@ -445,16 +477,22 @@ fn check_directory(ctx: &mut FsckContext, inum: u32, _parent: Option<u32>) -> Re
         bail!("Inode {} is not a directory (type={})", inum, inode_type);
     }
 
-    // 只检查第一个直接块（简化）
-    let block0 = inode.direct[0];
-    if block0 == INVALID_BLOCK {
-        return Ok(()); // 空目录
-    }
+    // 内联目录的目录项就在 inode 的块映射区里
+    let dir_buf = if inode.flags & INODE_FLAG_INLINE != 0 {
+        buf[INODE_INLINE_OFFSET..INODE_INLINE_OFFSET + INODE_INLINE_SIZE].to_vec()
+    } else {
+        // 只检查第一个直接块（简化）
+        let block0 = inode.direct[0];
+        if block0 == INVALID_BLOCK {
+            return Ok(()); // 空目录
+        }
 
-    // 读取目录块
-    let data_offset = (block0 as u64) * (block_size as u64);
-    let mut dir_buf = vec![0u8; block_size as usize];
-    ctx.disk.read_exact_at(&mut dir_buf, data_offset)?;
+        // 读取目录块
+        let data_offset = (block0 as u64) * (block_size as u64);
+        let mut dir_buf = vec![0u8; block_size as usize];
+        ctx.disk.read_exact_at(&mut dir_buf, data_offset)?;
+        dir_buf
+    };
 
     // 简单验证：检查前两个目录项应该是 "." 和 ".."
     if dir_buf.len() >= 8 {
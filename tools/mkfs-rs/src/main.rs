@@ -17,6 +17,11 @@ const SUPERBLOCK_VERSION: u32 = 1;
 const INODE_SIZE: u32 = 128;
 const ROOT_INODE: u32 = 1;
 
+// 分配组大小(与 superblock.h 一致)
+const GROUP_MAX_DATA_BLOCKS: u32 = 32768;
+const GROUP_MIN_DATA_BLOCKS: u32 = 4096;
+const GROUP_MIN_COUNT: u32 = 4;
+
 const JOURNAL_MAGIC: u32 = 0x4A524E4C; // "JRNL"
 
 // ============ 命令行参数 ============
@@ -72,6 +77,10 @@ struct FsLayout {
     data_blocks: u32,
 
     total_inodes: u32,
+
+    group_count: u32,
+    group_data_blocks: u32,
+    group_inodes: u32,
 }
 
 // ============ 超级块结构 ============
@@ -105,7 +114,11 @@ struct Superblock {
     write_time: u64,
     mount_count: u32,
 
-    padding: [u8; 3988],
+    group_count: u32,
+    group_data_blocks: u32,
+    group_inodes: u32,
+
+    padding: [u8; 3976],
 }
 
 // ============ 日志超级块 ============
@@ -328,6 +341,18 @@ fn calculate_layout(total_size: u64, journal_size: u64, block_size: u32) -> Resu
     let data_start = inode_table_start + inode_table_blocks;
     let data_blocks = total_blocks - data_start;
 
+    // 分配组：组大小从一个位图块的容量往下减半，直到至少有 GROUP_MIN_COUNT 组
+    let mut group_data_blocks = GROUP_MAX_DATA_BLOCKS;
+    while group_data_blocks > GROUP_MIN_DATA_BLOCKS
+        && data_blocks / group_data_blocks < GROUP_MIN_COUNT
+    {
+        group_data_blocks /= 2;
+    }
+    let group_count = ((data_blocks + group_data_blocks - 1) / group_data_blocks).max(1);
+    // 每组的 Inode 占整数个 Inode 表块
+    let group_inodes = (total_inodes + group_count - 1) / group_count;
+    let group_inodes = (group_inodes + inodes_per_block - 1) / inodes_per_block * inodes_per_block;
+
     Ok(FsLayout {
         total_blocks,
         block_size,
@@ -342,6 +367,9 @@ fn calculate_layout(total_size: u64, journal_size: u64, block_size: u32) -> Resu
         data_start,
         data_blocks,
         total_inodes,
+        group_count,
+        group_data_blocks,
+        group_inodes,
     })
 }
 
@@ -377,7 +405,11 @@ fn write_superblock(disk: &mut File, layout: &FsLayout) -> Result<()> {
             .as_secs(),
         mount_count: 0,
 
-        padding: [0; 3988],
+        group_count: layout.group_count,
+        group_data_blocks: layout.group_data_blocks,
+        group_inodes: layout.group_inodes,
+
+        padding: [0; 3976],
     };
 
     let sb_bytes = unsafe {